@@ -23,10 +23,15 @@ UTIL_SOURCES = \
     src/celutil/directory.cpp \
     src/celutil/filetype.cpp \
     src/celutil/formatnum.cpp \
+    src/celutil/memorypool.cpp \
+    src/celutil/profiler.cpp \
+    src/celutil/resmanager.cpp \
+    src/celutil/threadpool.cpp \
     src/celutil/utf8.cpp \
     src/celutil/util.cpp
 
 UTIL_HEADERS = \
+    src/celutil/atomic.h \
     src/celutil/basictypes.h \
     src/celutil/bigfix.h \
     src/celutil/bytes.h \
@@ -35,8 +40,13 @@ UTIL_HEADERS = \
     src/celutil/directory.h \
     src/celutil/filetype.h \
     src/celutil/formatnum.h \
+    src/celutil/mappedfile.h \
+    src/celutil/memorypool.h \
+    src/celutil/profiler.h \
     src/celutil/reshandle.h \
     src/celutil/resmanager.h \
+    src/celutil/thread.h \
+    src/celutil/threadpool.h \
     src/celutil/timer.h \
     src/celutil/utf8.h \
     src/celutil/util.h \
@@ -45,6 +55,8 @@ UTIL_HEADERS = \
 win32 {
     UTIL_SOURCES += \
         src/celutil/windirectory.cpp \
+        src/celutil/winmappedfile.cpp \
+        src/celutil/winthread.cpp \
         src/celutil/wintimer.cpp
 
     UTIL_HEADERS += src/celutil/winutil.h
@@ -53,6 +65,8 @@ win32 {
 unix {
     UTIL_SOURCES += \
         src/celutil/unixdirectory.cpp \
+        src/celutil/unixmappedfile.cpp \
+        src/celutil/unixthread.cpp \
         src/celutil/unixtimer.cpp
 }
 
@@ -119,6 +133,7 @@ TXF_HEADERS = \
 #### Ephemeris module ####
 
 EPHEM_SOURCES = \
+    src/celephem/chebyorbit.cpp \
     src/celephem/customorbit.cpp \
     src/celephem/customrotation.cpp \
     src/celephem/jpleph.cpp \
@@ -134,6 +149,7 @@ EPHEM_SOURCES = \
     src/celephem/vsop87.cpp
 
 EPHEM_HEADERS = \
+    src/celephem/chebyorbit.h \
     src/celephem/customorbit.h \
     src/celephem/customrotation.h \
     src/celephem/jpleph.h \
@@ -157,6 +173,7 @@ ENGINE_SOURCES = \
     src/celengine/axisarrow.cpp \
     src/celengine/body.cpp \
     src/celengine/boundaries.cpp \
+    src/celengine/catalogcache.cpp \
     src/celengine/catalogxref.cpp \
     src/celengine/cmdparser.cpp \
     src/celengine/command.cpp \
@@ -186,6 +203,7 @@ ENGINE_SOURCES = \
     src/celengine/nebula.cpp \
     src/celengine/observer.cpp \
     src/celengine/opencluster.cpp \
+    src/celengine/orbitcache.cpp \
     src/celengine/overlay.cpp \
     src/celengine/parseobject.cpp \
     src/celengine/parser.cpp \
@@ -226,6 +244,7 @@ ENGINE_HEADERS = \
     src/celengine/axisarrow.h \
     src/celengine/body.h \
     src/celengine/boundaries.h \
+    src/celengine/catalogcache.h \
     src/celengine/catalogxref.h \
     src/celengine/celestia.h \
     src/celengine/cmdparser.h \
@@ -259,6 +278,7 @@ ENGINE_HEADERS = \
     src/celengine/observer.h \
     src/celengine/octree.h \
     src/celengine/opencluster.h \
+    src/celengine/orbitcache.h \
     src/celengine/overlay.h \
     src/celengine/parseobject.h \
     src/celengine/parser.h \
@@ -314,6 +334,7 @@ APP_SOURCES = \
     src/celestia/destination.cpp \
     src/celestia/eclipsefinder.cpp \
     src/celestia/favorites.cpp \
+    src/celestia/framereadback.cpp \
     src/celestia/imagecapture.cpp \
     src/celestia/scriptmenu.cpp \
     src/celestia/url.cpp \
@@ -334,6 +355,7 @@ APP_HEADERS = \
     src/celestia/destination.h \
     src/celestia/eclipsefinder.h \
     src/celestia/favorites.h \
+    src/celestia/framereadback.h \
     src/celestia/imagecapture.h \
     src/celestia/scriptmenu.h \
     src/celestia/url.h \
@@ -587,7 +609,7 @@ unix {
 
     PKGCONFIG += glu $$LUAPC libpng theora
     INCLUDEPATH += /usr/local/cspice/include
-    LIBS += -ljpeg /usr/local/cspice/lib/cspice.a
+    LIBS += -ljpeg -lpthread /usr/local/cspice/lib/cspice.a
 }
 
 macx {
@@ -13,6 +13,7 @@
 #include <celmath/mathlib.h>
 #include <celutil/util.h>
 #include <celutil/utf8.h>
+#include <celutil/atomic.h>
 #include "geometry.h"
 #include "meshmanager.h"
 #include "body.h"
@@ -34,6 +35,8 @@ Body::Body(PlanetarySystem* _system, const string& _name) :
     satellites(NULL),
     timeline(NULL),
     frameTree(NULL),
+    stateTime(0.0),
+    stateValid(false),
     radius(1.0f),
     semiAxes(1.0f, 1.0f, 1.0f),
     mass(0.0f),
@@ -218,6 +221,7 @@ void Body::setTimeline(Timeline* newTimeline)
 
 void Body::markChanged()
 {
+    stateValid = false;
     if (timeline != NULL)
         timeline->markChanged();
 }
@@ -471,18 +475,32 @@ UniversalCoord Body::getPosition(double tdb) const
     Vector3d position = Vector3d::Zero();
 
     const TimelinePhase* phase = timeline->findPhase(tdb);
-    Vector3d p = phase->orbit()->positionAtTime(tdb);
     ReferenceFrame* frame = phase->orbitFrame();
 
-    while (frame->getCenter().getType() == Selection::Type_Body)
+    if (hasState(tdb))
     {
-        phase = frame->getCenter().body()->timeline->findPhase(tdb);
-        position += frame->getOrientation(tdb).conjugate() * p;
-        p = phase->orbit()->positionAtTime(tdb);
-        frame = phase->orbitFrame();
+        // The saved astrocentric position includes the offsets of all
+        // the frame centers; only the star at the root is needed.
+        while (frame->getCenter().getType() == Selection::Type_Body)
+            frame = frame->getCenter().body()->timeline->findPhase(tdb)->orbitFrame();
+        position = statePosition;
     }
+    else
+    {
+        countOrbitEvaluation();
+        Vector3d p = phase->orbit()->positionAtTime(tdb);
+
+        while (frame->getCenter().getType() == Selection::Type_Body)
+        {
+            phase = frame->getCenter().body()->timeline->findPhase(tdb);
+            position += frame->getOrientation(tdb).conjugate() * p;
+            countOrbitEvaluation();
+            p = phase->orbit()->positionAtTime(tdb);
+            frame = phase->orbitFrame();
+        }
 
-    position += frame->getOrientation(tdb).conjugate() * p;
+        position += frame->getOrientation(tdb).conjugate() * p;
+    }
 
     if (frame->getCenter().star())
         return frame->getCenter().star()->getPosition(tdb).offsetKm(position);
@@ -495,8 +513,7 @@ UniversalCoord Body::getPosition(double tdb) const
  */
 Quaterniond Body::getOrientation(double tdb) const
 {
-    const TimelinePhase* phase = timeline->findPhase(tdb);
-    return phase->rotationModel()->orientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
+    return getEclipticToBodyFixed(tdb);
 }
 
 
@@ -508,6 +525,7 @@ Vector3d Body::getVelocity(double tdb) const
 
     ReferenceFrame* orbitFrame = phase->orbitFrame();
 
+    countOrbitEvaluation();
     Vector3d v = phase->orbit()->velocityAtTime(tdb);
     v = orbitFrame->getOrientation(tdb).conjugate() * v + orbitFrame->getCenter().getVelocity(tdb);
 
@@ -527,6 +545,7 @@ Vector3d Body::getAngularVelocity(double tdb) const
 {
     const TimelinePhase* phase = timeline->findPhase(tdb);
 
+    countRotationEvaluation();
     Vector3d v = phase->rotationModel()->angularVelocityAtTime(tdb);
 
     ReferenceFrame* bodyFrame = phase->bodyFrame();
@@ -548,8 +567,7 @@ Vector3d Body::getAngularVelocity(double tdb) const
  */
 Matrix4d Body::getLocalToAstrocentric(double tdb) const
 {
-    const TimelinePhase* phase = timeline->findPhase(tdb);
-    Vector3d p = phase->orbitFrame()->convertToAstrocentric(phase->orbit()->positionAtTime(tdb), tdb);
+    Vector3d p = getAstrocentricPosition(tdb);
     return Transform3d(Translation3d(p)).matrix();
 }
 
@@ -558,8 +576,12 @@ Matrix4d Body::getLocalToAstrocentric(double tdb) const
  */
 Vector3d Body::getAstrocentricPosition(double tdb) const
 {
+    if (hasState(tdb))
+        return statePosition;
+
     // TODO: Switch the iterative method used in getPosition
     const TimelinePhase* phase = timeline->findPhase(tdb);
+    countOrbitEvaluation();
     return phase->orbitFrame()->convertToAstrocentric(phase->orbit()->positionAtTime(tdb), tdb);
 }
 
@@ -579,6 +601,7 @@ Quaterniond Body::getEclipticToFrame(double tdb) const
 Quaterniond Body::getEclipticToEquatorial(double tdb) const
 {
     const TimelinePhase* phase = timeline->findPhase(tdb);
+    countRotationEvaluation();
     return phase->rotationModel()->equatorOrientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
 }
 
@@ -588,7 +611,11 @@ Quaterniond Body::getEclipticToEquatorial(double tdb) const
  */
 Quaterniond Body::getEclipticToBodyFixed(double tdb) const
 {
+    if (hasState(tdb))
+        return stateOrientation;
+
     const TimelinePhase* phase = timeline->findPhase(tdb);
+    countRotationEvaluation();
     return phase->rotationModel()->orientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
 }
 
@@ -599,6 +626,7 @@ Quaterniond Body::getEclipticToBodyFixed(double tdb) const
 Quaterniond Body::getEquatorialToBodyFixed(double tdb) const
 {
     const TimelinePhase* phase = timeline->findPhase(tdb);
+    countRotationEvaluation();
     return phase->rotationModel()->spin(tdb);
 }
 
@@ -614,6 +642,75 @@ Matrix4d Body::getBodyFixedToAstrocentric(double tdb) const
 }
 
 
+/*! Compute the position and orientation of the body at the specified time
+ *  and save them, so that other requests for the state at that time
+ *  during the same frame don't evaluate the orbit and rotation model
+ *  again. The frame center is the astrocentric position of the center of
+ *  the body's orbit frame; FrameTree::updateStates() visits the bodies in
+ *  the order of the frame hierarchy so that it is already known.
+ *
+ *  The saved state may be read from several threads at once, but it must
+ *  not be updated while any other thread is using the body.
+ */
+void Body::updateState(double tdb, const Vector3d& frameCenter)
+{
+    stateValid = false;
+
+    const TimelinePhase* phase = timeline->findPhase(tdb);
+    countOrbitEvaluation();
+    Vector3d p = phase->orbit()->positionAtTime(tdb);
+    Vector3d position = frameCenter + phase->orbitFrame()->getOrientation(tdb).conjugate() * p;
+    Quaterniond orientation = getEclipticToBodyFixed(tdb);
+
+    stateTime = tdb;
+    statePosition = position;
+    stateOrientation = orientation;
+    stateValid = true;
+}
+
+
+// Evaluation counters shared by all bodies; they're updated atomically,
+// since positions may be computed on worker threads.
+static volatile int32 orbitEvaluationCount = 0;
+static volatile int32 rotationEvaluationCount = 0;
+
+void Body::countOrbitEvaluation()
+{
+    AtomicAdd(orbitEvaluationCount, 1);
+}
+
+
+void Body::countRotationEvaluation()
+{
+    AtomicAdd(rotationEvaluationCount, 1);
+}
+
+
+/*! Return the number of orbit evaluations made by bodies (and by the
+ *  renderer on their behalf) since the counts were last reset.
+ */
+unsigned int Body::getOrbitEvaluationCount()
+{
+    return (unsigned int) AtomicLoad(orbitEvaluationCount);
+}
+
+
+/*! Return the number of rotation model evaluations made by bodies since
+ *  the counts were last reset.
+ */
+unsigned int Body::getRotationEvaluationCount()
+{
+    return (unsigned int) AtomicLoad(rotationEvaluationCount);
+}
+
+
+void Body::resetEvaluationCounts()
+{
+    AtomicStore(orbitEvaluationCount, 0);
+    AtomicStore(rotationEvaluationCount, 0);
+}
+
+
 Vector3d Body::planetocentricToCartesian(double lon, double lat, double alt) const
 {
     double phi = -degToRad(lat) + PI / 2;
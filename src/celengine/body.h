@@ -336,6 +336,24 @@ class Body
     void markChanged();
     void markUpdated();
 
+    void updateState(double tdb, const Eigen::Vector3d& frameCenter);
+
+    /*! Return true if the state of the body at the specified time was
+     *  computed by updateState(), so that getting the position or
+     *  orientation at that time doesn't evaluate the orbit or rotation
+     *  model.
+     */
+    bool hasState(double tdb) const
+    {
+        return stateValid && stateTime == tdb;
+    }
+
+    static void countOrbitEvaluation();
+    static void countRotationEvaluation();
+    static unsigned int getOrbitEvaluationCount();
+    static unsigned int getRotationEvaluationCount();
+    static void resetEvaluationCounts();
+
  private:
     void setName(const std::string& _name);
     void recomputeCullingRadius();
@@ -353,6 +371,13 @@ class Body
     // Children in the frame hierarchy
     FrameTree* frameTree;
 
+    // State at stateTime saved by updateState(): the astrocentric position
+    // and the rotation from the ecliptic to the body fixed frame
+    double stateTime;
+    Eigen::Vector3d statePosition;
+    Eigen::Quaterniond stateOrientation;
+    bool stateValid;
+
     float radius;
     Eigen::Vector3f semiAxes;
     float mass;
@@ -0,0 +1,558 @@
+// catalogcache.cpp
+//
+// Copyright (C) 2009, the Celestia Development Team
+//
+// Cache of parsed catalog files (ssc, stc, dsc) that saves tokenizing and
+// parsing the text of large catalogs every time Celestia starts.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "catalogcache.h"
+#include "parser.h"
+#include <celutil/debug.h>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+using namespace std;
+
+
+/* Cache file format:
+ *   8 byte signature "CELCACHE"
+ *   4 byte cache version
+ *   8 byte size of the catalog file
+ *   8 byte modification time of the catalog file
+ *   4 byte length of the catalog path, followed by the path
+ *   the definitions written by the CatalogFile
+ * All header values are in the byte order of the machine that wrote the
+ * cache; a cache from a machine with a different byte order simply fails
+ * validation and is rebuilt.
+ */
+static const char CacheSignature[8] = { 'C', 'E', 'L', 'C', 'A', 'C', 'H', 'E' };
+// The version must change whenever a catalog is read differently or the
+// definitions are stored differently, so that caches written by older
+// versions are rebuilt.
+// Version 2: numbers are converted exactly.
+// Version 3: parsed definitions are cached instead of tokens.
+static const uint32 CacheVersion = 3;
+
+
+static bool getFileInfo(const string& filename, int64& fileSize, int64& modTime)
+{
+    struct stat s;
+    if (stat(filename.c_str(), &s) != 0)
+        return false;
+
+    fileSize = (int64) s.st_size;
+    modTime = (int64) s.st_mtime;
+
+    return true;
+}
+
+
+static bool isDirectory(const string& directory)
+{
+    struct stat s;
+    return stat(directory.c_str(), &s) == 0 && (s.st_mode & S_IFDIR) != 0;
+}
+
+
+// Create a directory along with any missing parent directories
+static bool makeDirectory(const string& directory)
+{
+    if (isDirectory(directory))
+        return true;
+
+    string::size_type sep = directory.find_last_of("/\\");
+    if (sep != string::npos && sep != 0 && !makeDirectory(directory.substr(0, sep)))
+        return false;
+
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0777);
+#endif
+
+    // Another process may have created the directory in the meantime.
+    return isDirectory(directory);
+}
+
+
+static void writeCacheHeader(ostream& out,
+                             const string& filename,
+                             int64 fileSize,
+                             int64 modTime)
+{
+    uint32 pathLength = (uint32) filename.size();
+
+    out.write(CacheSignature, sizeof(CacheSignature));
+    out.write(reinterpret_cast<const char*>(&CacheVersion), sizeof(CacheVersion));
+    out.write(reinterpret_cast<const char*>(&fileSize), sizeof(fileSize));
+    out.write(reinterpret_cast<const char*>(&modTime), sizeof(modTime));
+    out.write(reinterpret_cast<const char*>(&pathLength), sizeof(pathLength));
+    out.write(filename.data(), filename.size());
+}
+
+
+// Check that a cache file was made from the current version of the
+// catalog file; on success, the stream is left at the start of the
+// definitions.
+static bool checkCacheHeader(istream& in,
+                             const string& filename,
+                             int64 fileSize,
+                             int64 modTime)
+{
+    char signature[sizeof(CacheSignature)];
+    uint32 version = 0;
+    int64 cachedSize = 0;
+    int64 cachedModTime = 0;
+    uint32 pathLength = 0;
+
+    in.read(signature, sizeof(signature));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&cachedSize), sizeof(cachedSize));
+    in.read(reinterpret_cast<char*>(&cachedModTime), sizeof(cachedModTime));
+    in.read(reinterpret_cast<char*>(&pathLength), sizeof(pathLength));
+    if (!in.good() ||
+        memcmp(signature, CacheSignature, sizeof(signature)) != 0 ||
+        version != CacheVersion ||
+        cachedSize != fileSize ||
+        cachedModTime != modTime ||
+        pathLength != filename.size())
+    {
+        return false;
+    }
+
+    string path(pathLength, '\0');
+    if (pathLength > 0)
+        in.read(&path[0], pathLength);
+
+    return in.good() && path == filename;
+}
+
+
+// Value types as stored in a cache file
+enum CachedValueType
+{
+    CachedNumber   = 0,
+    CachedString   = 1,
+    CachedArray    = 2,
+    CachedHash     = 3,
+    CachedFalse    = 4,
+    CachedTrue     = 5,
+};
+
+
+CatalogCacheWriter::CatalogCacheWriter(ostream& _out) :
+    out(_out)
+{
+}
+
+
+void CatalogCacheWriter::writeCount(uint32 n)
+{
+    while (n >= 0x80)
+    {
+        out.put((char) ((n & 0x7f) | 0x80));
+        n >>= 7;
+    }
+    out.put((char) n);
+}
+
+
+void CatalogCacheWriter::writeString(const string& s)
+{
+    writeCount((uint32) s.size());
+    out.write(s.data(), s.size());
+}
+
+
+// A name is written as 0 followed by the string the first time it's seen,
+// and as its index plus one after that.
+void CatalogCacheWriter::writeName(const string& name)
+{
+    map<string, uint32>::const_iterator iter = names.find(name);
+    if (iter != names.end())
+    {
+        writeCount(iter->second + 1);
+    }
+    else
+    {
+        writeCount(0);
+        writeString(name);
+        names.insert(make_pair(name, (uint32) names.size()));
+    }
+}
+
+
+void CatalogCacheWriter::writeValue(const Value* value)
+{
+    switch (value->getType())
+    {
+    case Value::NumberType:
+        {
+            double d = value->getNumber();
+            out.put((char) CachedNumber);
+            out.write(reinterpret_cast<const char*>(&d), sizeof(d));
+        }
+        break;
+
+    case Value::StringType:
+        out.put((char) CachedString);
+        writeString(value->getString());
+        break;
+
+    case Value::BooleanType:
+        out.put((char) (value->getBoolean() ? CachedTrue : CachedFalse));
+        break;
+
+    case Value::ArrayType:
+        {
+            Array* array = value->getArray();
+            out.put((char) CachedArray);
+            writeCount((uint32) array->size());
+            for (Array::const_iterator iter = array->begin(); iter != array->end(); iter++)
+                writeValue(*iter);
+        }
+        break;
+
+    case Value::HashType:
+        {
+            // Hash entries are kept sorted by name, so they're written in
+            // order and can be appended as they're read back.
+            Hash* hash = value->getHash();
+            uint32 count = 0;
+            for (HashIterator iter = hash->begin(); iter != hash->end(); iter++)
+                count++;
+
+            out.put((char) CachedHash);
+            writeCount(count);
+            for (HashIterator iter = hash->begin(); iter != hash->end(); iter++)
+            {
+                writeName(iter->first);
+                writeValue(iter->second);
+            }
+        }
+        break;
+    }
+}
+
+
+CatalogCacheReader::CatalogCacheReader(const string& _data) :
+    data(_data),
+    pos(0),
+    failed(false)
+{
+}
+
+
+bool CatalogCacheReader::readCount(uint32& n)
+{
+    n = 0;
+    for (unsigned int shift = 0; !failed && pos < data.size() && shift < 32; shift += 7)
+    {
+        unsigned char c = (unsigned char) data[pos++];
+        n |= (uint32) (c & 0x7f) << shift;
+        if ((c & 0x80) == 0)
+            return true;
+    }
+
+    failed = true;
+    return false;
+}
+
+
+bool CatalogCacheReader::readString(string& s)
+{
+    uint32 length = 0;
+    if (!readCount(length) || length > data.size() - pos)
+    {
+        failed = true;
+        return false;
+    }
+
+    s.assign(data, pos, length);
+    pos += length;
+
+    return true;
+}
+
+
+// Read a name and return its index in the names read so far
+bool CatalogCacheReader::readName(uint32& index)
+{
+    if (!readCount(index))
+        return false;
+
+    if (index == 0)
+    {
+        string name;
+        if (!readString(name))
+            return false;
+        names.push_back(name);
+        index = (uint32) names.size() - 1;
+        return true;
+    }
+
+    if (index > names.size())
+    {
+        failed = true;
+        return false;
+    }
+    index--;
+
+    return true;
+}
+
+
+Value* CatalogCacheReader::readValue(ValueArena& arena)
+{
+    if (failed || pos >= data.size())
+    {
+        failed = true;
+        return NULL;
+    }
+
+    switch (data[pos++])
+    {
+    case CachedNumber:
+        {
+            double d;
+            if (data.size() - pos < sizeof(d))
+                break;
+            memcpy(&d, data.data() + pos, sizeof(d));
+            pos += sizeof(d);
+            return arena.newValue(d);
+        }
+
+    case CachedString:
+        {
+            string s;
+            if (!readString(s))
+                break;
+            return arena.newValue(s);
+        }
+
+    case CachedFalse:
+        return arena.newValue(false);
+
+    case CachedTrue:
+        return arena.newValue(true);
+
+    case CachedArray:
+        {
+            uint32 count = 0;
+            if (!readCount(count))
+                break;
+
+            Array* array = arena.newArray();
+            for (uint32 i = 0; i < count; i++)
+            {
+                Value* element = readValue(arena);
+                if (element == NULL)
+                    return NULL;
+                array->push_back(element);
+            }
+            return arena.newValue(array);
+        }
+
+    case CachedHash:
+        {
+            uint32 count = 0;
+            if (!readCount(count))
+                break;
+
+            Hash* hash = arena.newHash();
+            for (uint32 i = 0; i < count; i++)
+            {
+                // Nested hashes may add names, so the name is looked up
+                // by index after its value has been read.
+                uint32 name = 0;
+                if (!readName(name))
+                    return NULL;
+                Value* value = readValue(arena);
+                if (value == NULL)
+                    return NULL;
+                hash->addValue(names[name], *value);
+            }
+            return arena.newValue(hash);
+        }
+    }
+
+    failed = true;
+    return NULL;
+}
+
+
+bool CatalogCacheReader::atEnd() const
+{
+    return !failed && pos == data.size();
+}
+
+
+CatalogCache::CatalogCache(const string& _directory) :
+    directory(_directory),
+    rebuild(false),
+    usable(false)
+{
+    if (!directory.empty())
+    {
+        usable = makeDirectory(directory);
+        if (!usable)
+        {
+            DPRINTF(0, "Catalog cache directory %s couldn't be created; catalogs won't be cached.\n",
+                    directory.c_str());
+        }
+    }
+}
+
+
+CatalogCache::~CatalogCache()
+{
+}
+
+
+void CatalogCache::setRebuild(bool _rebuild)
+{
+    rebuild = _rebuild;
+}
+
+
+bool CatalogCache::getRebuild() const
+{
+    return rebuild;
+}
+
+
+const string& CatalogCache::getDirectory() const
+{
+    return directory;
+}
+
+
+// Cache files are named after a hash (64-bit FNV-1a) of the catalog path,
+// so that catalogs with the same name in different directories don't
+// collide. The full path is checked when the cache is read.
+string CatalogCache::cacheFilename(const string& filename) const
+{
+    uint64 hash = 0xcbf29ce484222325ULL;
+    for (string::const_iterator iter = filename.begin(); iter != filename.end(); iter++)
+    {
+        hash ^= (unsigned char) *iter;
+        hash *= 0x100000001b3ULL;
+    }
+
+    char name[32];
+    sprintf(name, "%08x%08x.cache", (uint32) (hash >> 32), (uint32) hash);
+
+    return directory + '/' + name;
+}
+
+
+bool CatalogCache::readCache(const string& filename,
+                             const string& cacheFile,
+                             int64 fileSize,
+                             int64 modTime,
+                             CatalogFile& catalogFile)
+{
+    ifstream in(cacheFile.c_str(), ios::in | ios::binary);
+    if (!in.good() || !checkCacheHeader(in, filename, fileSize, modTime))
+        return false;
+
+    // The definitions are decoded from memory rather than from the stream
+    streampos start = in.tellg();
+    in.seekg(0, ios::end);
+    streampos end = in.tellg();
+    in.seekg(start);
+    if (!in.good() || end < start)
+        return false;
+
+    string data((string::size_type) (end - start), '\0');
+    if (!data.empty())
+        in.read(&data[0], data.size());
+    if (!in.good())
+        return false;
+
+    CatalogCacheReader reader(data);
+    if (catalogFile.readCache(reader) && reader.atEnd())
+        return true;
+
+    DPRINTF(0, "Bad catalog cache file %s for %s; reading the catalog instead.\n",
+            cacheFile.c_str(), filename.c_str());
+
+    return false;
+}
+
+
+bool CatalogCache::writeCache(const string& filename,
+                              const string& cacheFile,
+                              int64 fileSize,
+                              int64 modTime,
+                              const CatalogFile& catalogFile)
+{
+    // Write to a temporary file first so that an interrupted write never
+    // leaves a truncated cache file behind.
+    string tmpFile = cacheFile + ".tmp";
+    bool ok;
+    {
+        ofstream out(tmpFile.c_str(), ios::out | ios::binary | ios::trunc);
+        if (!out.good())
+            return false;
+
+        writeCacheHeader(out, filename, fileSize, modTime);
+        CatalogCacheWriter writer(out);
+        catalogFile.writeCache(writer);
+        out.close();
+        ok = !out.fail();
+    }
+
+    if (ok)
+    {
+        remove(cacheFile.c_str());
+        ok = rename(tmpFile.c_str(), cacheFile.c_str()) == 0;
+    }
+
+    if (!ok)
+        remove(tmpFile.c_str());
+
+    return ok;
+}
+
+
+bool CatalogCache::read(const string& filename, CatalogFile& catalogFile)
+{
+    int64 fileSize = 0;
+    int64 modTime = 0;
+    string cacheFile;
+
+    // The catalog's size and time are taken before it's read, so a catalog
+    // changed while it's being read gets a cache entry that's already out
+    // of date rather than one that's wrongly current.
+    if (usable && getFileInfo(filename, fileSize, modTime))
+    {
+        cacheFile = cacheFilename(filename);
+        if (!rebuild && readCache(filename, cacheFile, fileSize, modTime, catalogFile))
+            return true;
+    }
+
+    ifstream in(filename.c_str(), ios::in);
+    if (!in.good())
+        return false;
+
+    bool complete = catalogFile.read(in);
+    if (complete && !cacheFile.empty())
+    {
+        if (!writeCache(filename, cacheFile, fileSize, modTime, catalogFile))
+            DPRINTF(1, "Couldn't write catalog cache file %s\n", cacheFile.c_str());
+    }
+
+    return true;
+}
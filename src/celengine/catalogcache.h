@@ -0,0 +1,145 @@
+// catalogcache.h
+//
+// Copyright (C) 2009, the Celestia Development Team
+//
+// Cache of parsed catalog files (ssc, stc, dsc) that saves tokenizing and
+// parsing the text of large catalogs every time Celestia starts.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELENGINE_CATALOGCACHE_H_
+#define _CELENGINE_CATALOGCACHE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <celutil/basictypes.h>
+
+class Value;
+class ValueArena;
+
+
+/*! Writes the definitions of a catalog file to a cache file. Counts are
+ *  stored seven bits per byte, low bits first, with the high bit set on
+ *  all but the last byte; numbers are stored as doubles in the byte order
+ *  of the machine writing the cache. The same few property names appear in
+ *  every definition, so each is written once and then referred to by its
+ *  index.
+ */
+class CatalogCacheWriter
+{
+ public:
+    CatalogCacheWriter(std::ostream& out);
+
+    void writeCount(uint32);
+    void writeString(const std::string&);
+    void writeValue(const Value*);
+
+ private:
+    void writeName(const std::string&);
+
+    std::ostream& out;
+    std::map<std::string, uint32> names;
+};
+
+
+/*! Reads the definitions written by a CatalogCacheWriter from the contents
+ *  of a cache file. Once a read fails, because the data is truncated or
+ *  isn't what was expected, all further reads fail too.
+ */
+class CatalogCacheReader
+{
+ public:
+    CatalogCacheReader(const std::string& data);
+
+    bool readCount(uint32&);
+    bool readString(std::string&);
+    // Returns NULL if no valid value could be read
+    Value* readValue(ValueArena&);
+
+    bool atEnd() const;
+
+ private:
+    bool readName(uint32&);
+
+    const std::string& data;
+    std::vector<std::string> names;
+    std::string::size_type pos;
+    bool failed;
+};
+
+
+/*! The definitions read from a catalog file, in a form that can be stored
+ *  in a catalog cache and read back without parsing the catalog again.
+ */
+class CatalogFile
+{
+ public:
+    virtual ~CatalogFile() {};
+
+    /*! Read the definitions from the text of a catalog file. Returns false
+     *  if reading stopped at an error.
+     */
+    virtual bool read(std::istream&) = 0;
+
+    /*! Write the definitions of a completely read catalog file. */
+    virtual void writeCache(CatalogCacheWriter&) const = 0;
+
+    /*! Restore the definitions written by writeCache(). If this fails, the
+     *  catalog file must be left empty, ready to read the text instead.
+     */
+    virtual bool readCache(CatalogCacheReader&) = 0;
+};
+
+
+/*! A CatalogCache keeps a cache file with the parsed definitions of each
+ *  catalog read through it. A cache file records the path, size, and
+ *  modification time of the catalog it was made from; it's only used while
+ *  all three still match, so editing a catalog file invalidates its cache
+ *  entry. Catalogs with syntax errors are never cached.
+ */
+class CatalogCache
+{
+ public:
+    CatalogCache(const std::string& directory);
+    ~CatalogCache();
+
+    /*! Read a catalog file, from its cache entry if there's an up to date
+     *  one and otherwise from the text, which is then cached. Returns false
+     *  if the catalog file can't be opened. May be called from several
+     *  threads at once for different catalog files.
+     */
+    bool read(const std::string& filename, CatalogFile& catalogFile);
+
+    /*! When rebuild is set, existing cache entries are ignored and replaced
+     *  by fresh ones.
+     */
+    void setRebuild(bool rebuild);
+    bool getRebuild() const;
+
+    const std::string& getDirectory() const;
+
+ private:
+    std::string cacheFilename(const std::string& filename) const;
+    bool readCache(const std::string& filename,
+                   const std::string& cacheFile,
+                   int64 fileSize,
+                   int64 modTime,
+                   CatalogFile& catalogFile);
+    bool writeCache(const std::string& filename,
+                    const std::string& cacheFile,
+                    int64 fileSize,
+                    int64 modTime,
+                    const CatalogFile& catalogFile);
+
+ private:
+    std::string directory;
+    bool rebuild;
+    bool usable;
+};
+
+#endif // _CELENGINE_CATALOGCACHE_H_
@@ -15,11 +15,13 @@
 #include <cstdio>
 #include <cassert>
 #include <algorithm>
+#include <sstream>
 #include <celmath/mathlib.h>
 #include <celmath/plane.h>
 #include <celutil/util.h>
 #include <celutil/bytes.h>
 #include <celutil/utf8.h>
+#include <celutil/timer.h>
 #include <celengine/dsodb.h>
 #include "celestia.h"
 #include "astro.h"
@@ -120,13 +122,13 @@ DeepSkyObject* DSODatabase::find(const string& name) const
 }
 
 
-vector<string> DSODatabase::getCompletion(const string& name) const
+vector<string> DSODatabase::getCompletion(const string& name, unsigned int maxCompletions) const
 {
     vector<string> completion;
 
     // only named DSOs are supported by completion.
     if (!name.empty() && namesDB != NULL)
-        return namesDB->getCompletion(name);
+        return namesDB->getCompletion(name, maxCompletions);
     else
         return completion;
 }
@@ -234,53 +236,159 @@ void DSODatabase::setNameDatabase(DSONameDatabase* _namesDB)
 }
 
 
-bool DSODatabase::load(istream& in, const string& resourcePath)
+DSOCatalogFile::DSOCatalogFile() :
+    complete(false)
+{
+}
+
+
+DSOCatalogFile::~DSOCatalogFile()
+{
+}
+
+
+bool DSOCatalogFile::read(istream& in)
 {
+    ostringstream errorStream;
     Tokenizer tokenizer(&in);
-    Parser    parser(&tokenizer);
+    tokenizer.setErrorStream(&errorStream);
+    Parser    parser(&tokenizer, &values);
 
+    complete = false;
     while (tokenizer.nextToken() != Tokenizer::TokenEnd)
     {
-        string objType;
-        string objName;
+        Entry entry;
 
         if (tokenizer.getTokenType() != Tokenizer::TokenName)
         {
-            DPRINTF(0, "Error parsing deep sky catalog file.\n");
+            errorStream << "Error parsing deep sky catalog file.\n";
+            errorMessage = errorStream.str();
             return false;
         }
-        objType = tokenizer.getNameValue();
+        entry.objType = tokenizer.getNameValue();
 
-        bool   autoGenCatalogNumber   = true;
-        uint32 objCatalogNumber       = DeepSkyObject::InvalidCatalogNumber;
+        entry.autoGenCatalogNumber = true;
+        entry.catalogNumber        = DeepSkyObject::InvalidCatalogNumber;
         if (tokenizer.getTokenType() == Tokenizer::TokenNumber)
         {
-            autoGenCatalogNumber   = false;
-            objCatalogNumber       = (uint32) tokenizer.getNumberValue();
+            entry.autoGenCatalogNumber = false;
+            entry.catalogNumber        = (uint32) tokenizer.getNumberValue();
             tokenizer.nextToken();
         }
 
-        if (autoGenCatalogNumber)
+        if (tokenizer.nextToken() != Tokenizer::TokenString)
         {
-            objCatalogNumber   = nextAutoCatalogNumber--;
+            errorStream << "Error parsing deep sky catalog file: bad name.\n";
+            errorMessage = errorStream.str();
+            return false;
         }
+        entry.objName = tokenizer.getStringValue();
 
-        if (tokenizer.nextToken() != Tokenizer::TokenString)
+        entry.objParamsValue = parser.readValue();
+        if (entry.objParamsValue == NULL ||
+            entry.objParamsValue->getType() != Value::HashType)
+        {
+            errorStream << "Error parsing deep sky catalog entry " << entry.objName << '\n';
+            errorMessage = errorStream.str();
+            return false;
+        }
+
+        entries.push_back(entry);
+    }
+
+    errorMessage = errorStream.str();
+    complete = true;
+
+    return true;
+}
+
+
+void DSOCatalogFile::clear()
+{
+    entries.clear();
+    values.clear();
+    errorMessage.clear();
+    complete = false;
+}
+
+
+// Only completely read files are cached, so the errors and completion
+// state don't need to be stored.
+void DSOCatalogFile::writeCache(CatalogCacheWriter& writer) const
+{
+    writer.writeCount((uint32) entries.size());
+    for (vector<Entry>::const_iterator iter = entries.begin(); iter != entries.end(); iter++)
+    {
+        writer.writeString(iter->objType);
+        writer.writeString(iter->objName);
+        writer.writeCount(iter->catalogNumber);
+        writer.writeCount(iter->autoGenCatalogNumber ? 1 : 0);
+        writer.writeValue(iter->objParamsValue);
+    }
+}
+
+
+bool DSOCatalogFile::readCache(CatalogCacheReader& reader)
+{
+    uint32 count = 0;
+    if (!reader.readCount(count))
+        return false;
+
+    Entry entry;
+    for (uint32 i = 0; i < count; i++)
+    {
+        uint32 autoGenCatalogNumber = 0;
+        if (!reader.readString(entry.objType) ||
+            !reader.readString(entry.objName) ||
+            !reader.readCount(entry.catalogNumber) ||
+            !reader.readCount(autoGenCatalogNumber))
         {
-            DPRINTF(0, "Error parsing deep sky catalog file: bad name.\n");
+            clear();
             return false;
         }
-        objName = tokenizer.getStringValue();
+        entry.autoGenCatalogNumber = autoGenCatalogNumber != 0;
 
-        Value* objParamsValue    = parser.readValue();
-        if (objParamsValue == NULL ||
-            objParamsValue->getType() != Value::HashType)
+        entry.objParamsValue = reader.readValue(values);
+        if (entry.objParamsValue == NULL ||
+            entry.objParamsValue->getType() != Value::HashType)
         {
-            DPRINTF(0, "Error parsing deep sky catalog entry %s\n", objName.c_str());
+            clear();
             return false;
         }
 
-        Hash* objParams    = objParamsValue->getHash();
+        entries.push_back(entry);
+    }
+
+    complete = true;
+
+    return true;
+}
+
+
+bool DSODatabase::load(istream& in, const string& resourcePath)
+{
+    DSOCatalogFile catalogFile;
+    catalogFile.read(in);
+
+    return load(catalogFile, resourcePath);
+}
+
+
+bool DSODatabase::load(const DSOCatalogFile& catalogFile, const string& resourcePath)
+{
+    for (vector<DSOCatalogFile::Entry>::const_iterator iter = catalogFile.entries.begin();
+         iter != catalogFile.entries.end(); iter++)
+    {
+        const string& objType = iter->objType;
+        const string& objName = iter->objName;
+
+        uint32 objCatalogNumber = iter->catalogNumber;
+        if (iter->autoGenCatalogNumber)
+        {
+            objCatalogNumber   = nextAutoCatalogNumber--;
+        }
+
+        Hash* objParams    = iter->objParamsValue->getHash();
         assert(objParams != NULL);
 
         DeepSkyObject* obj = NULL;
@@ -295,8 +403,6 @@ bool DSODatabase::load(istream& in, const string& resourcePath)
 
         if (obj != NULL && obj->load(objParams, resourcePath))
         {
-            delete objParamsValue;
-
             // Ensure that the DSO array is large enough
             if (nDSOs == capacity)
             {
@@ -359,11 +465,15 @@ bool DSODatabase::load(istream& in, const string& resourcePath)
         else
         {
             DPRINTF(1, "Bad Deep Sky Object definition--will continue parsing file.\n");
-            delete objParamsValue;
             return false;
         }
     }
-    return true;
+
+    // Errors found while reading the file are reported after the objects
+    // that preceded them have been loaded.
+    cerr << catalogFile.errorMessage;
+
+    return catalogFile.complete;
 }
 
 
@@ -399,12 +509,19 @@ void DSODatabase::buildOctree()
     // TODO: investigate using a different center--it's possible that more
     // objects end up straddling the base level nodes when the center of the
     // octree is at the origin.
+    Timer* timer = CreateTimer();
     DynamicDSOOctree* root   = new DynamicDSOOctree(Vector3d::Zero(), absMag);
+
+    DynamicDSOOctree::ObjectList dsoList(nDSOs);
     for (int i = 0; i < nDSOs; ++i)
     {
-        root->insertObject(DSOs[i], DSO_OCTREE_ROOT_SIZE);
+        dsoList[i] = &DSOs[i];
     }
 
+    ThreadPool pool;
+    root->insertObjects(dsoList, DSO_OCTREE_ROOT_SIZE, &pool);
+    pool.wait();
+
     DPRINTF(1, "Spatially sorting DSOs for improved locality of reference . . .\n");
     DeepSkyObject** sortedDSOs    = new DeepSkyObject*[nDSOs];
     DeepSkyObject** firstDSO      = sortedDSOs;
@@ -418,6 +535,10 @@ void DSODatabase::buildOctree()
             1 + octreeRoot->countChildren(), octreeRoot->countObjects());
     //cout<<"DSOs:  "<< octreeRoot->countObjects()<<"   Nodes:"
     //    <<octreeRoot->countChildren() <<endl;
+    clog << _("DSO octree built in ") << (int) (timer->getTime() * 1000.0)
+         << _(" ms using ") << pool.getThreadCount() + 1 << _(" threads\n");
+    delete timer;
+
     // Clean up . . .
     delete[] DSOs;
     delete   root;
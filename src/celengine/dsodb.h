@@ -19,12 +19,58 @@
 #include <celengine/deepskyobj.h>
 #include <celengine/dsooctree.h>
 #include <celengine/parser.h>
+#include <celengine/catalogcache.h>
 
 
 static const unsigned int MAX_DSO_NAMES = 10;
 
 extern const float DSO_OCTREE_ROOT_SIZE;
 
+/*! The object definitions read from a deep sky catalog (.dsc) file. Reading
+ *  a file doesn't touch the database, so several files may be read at once
+ *  on different threads and then loaded into the database in order.
+ */
+class DSOCatalogFile : public CatalogFile
+{
+ public:
+    DSOCatalogFile();
+    ~DSOCatalogFile();
+
+    /*! Read the object definitions from a stream. Reading stops at the
+     *  first error; the definitions before it are kept, and the error is
+     *  reported when the file is loaded.
+     */
+    bool read(std::istream&);
+
+    void writeCache(CatalogCacheWriter&) const;
+    bool readCache(CatalogCacheReader&);
+
+ private:
+    DSOCatalogFile(const DSOCatalogFile&);
+    DSOCatalogFile& operator=(const DSOCatalogFile&);
+
+    void clear();
+
+    struct Entry
+    {
+        std::string objType;
+        std::string objName;
+        uint32 catalogNumber;
+        bool autoGenCatalogNumber;
+        Value* objParamsValue;
+    };
+
+    std::vector<Entry> entries;
+    std::string errorMessage;
+    bool complete;
+
+    // The property values of all the definitions, freed with the file
+    ValueArena values;
+
+    friend class DSODatabase;
+};
+
+
 //NOTE: this one and starDatabase should be derived from a common base class since they share lots of code and functionality.
 class DSODatabase
 {
@@ -39,7 +85,7 @@ class DSODatabase
     DeepSkyObject* find(const uint32 catalogNumber) const;
     DeepSkyObject* find(const std::string&) const;
 
-    std::vector<std::string> getCompletion(const std::string&) const;
+    std::vector<std::string> getCompletion(const std::string&, unsigned int maxCompletions = 0) const;
 
     void findVisibleDSOs(DSOHandler&    dsoHandler,
                          const Eigen::Vector3d& obsPosition,
@@ -59,6 +105,7 @@ class DSODatabase
     void setNameDatabase(DSONameDatabase*);
 
     bool load(std::istream&, const std::string& resourcePath);
+    bool load(const DSOCatalogFile&, const std::string& resourcePath);
     bool loadBinary(std::istream&);
     void finish();
 
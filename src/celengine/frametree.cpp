@@ -17,6 +17,8 @@
 #include "celengine/timelinephase.h"
 #include "celengine/frame.h"
 
+using namespace Eigen;
+
 
 /* A FrameTree is hierarchy of solar system bodies organized according to
  * the relationship of their reference frames. An object will appear in as
@@ -43,6 +45,7 @@
 FrameTree::FrameTree(Star* star) :
     starParent(star),
     bodyParent(NULL),
+    m_threadSafeChildCount(0),
     m_changed(true),
     defaultFrame(NULL)
 {
@@ -58,6 +61,7 @@ FrameTree::FrameTree(Star* star) :
 FrameTree::FrameTree(Body* body) :
     starParent(NULL),
     bodyParent(body),
+    m_threadSafeChildCount(0),
     m_changed(true),
     defaultFrame(NULL)
 {
@@ -117,11 +121,26 @@ FrameTree::markUpdated()
 }
 
 
+// Return true if the position of a phase's body relative to its frame center
+// may be computed from several threads at once: the orbit must be thread
+// safe, and the frame mustn't depend on rotation models, which cache their
+// results unprotected.
+static bool isPhaseThreadSafe(const TimelinePhase* phase)
+{
+    if (!phase->orbit()->isThreadSafe())
+        return false;
+
+    const ReferenceFrame* frame = phase->orbitFrame();
+    return dynamic_cast<const J2000EclipticFrame*>(frame) != NULL ||
+           dynamic_cast<const J2000EquatorFrame*>(frame) != NULL;
+}
+
+
 /*! Recompute the bounding sphere for this tree and all subtrees marked
  *  as having changed. The bounding sphere is large enough to accommodate
  *  the orbits (and radii) of all child bodies. This method also recomputes
- *  the maximum child radius, secondary illuminator status, and child
- *  class mask.
+ *  the maximum child radius, secondary illuminator status, child class
+ *  mask, and thread safety.
  */
 void
 FrameTree::recomputeBoundingSphere()
@@ -131,12 +150,15 @@ FrameTree::recomputeBoundingSphere()
         m_boundingSphereRadius = 0.0;
         m_maxChildRadius = 0.0;
         m_containsSecondaryIlluminators = false;
+        m_threadSafeChildCount = 0;
+        m_threadSafeChildren.clear();
         m_childClassMask = 0;
 
         for (vector<TimelinePhase*>::iterator iter = children.begin();
              iter != children.end(); iter++)
         {
             TimelinePhase* phase = *iter;
+            bool threadSafe = isPhaseThreadSafe(phase);
             double bodyRadius = phase->body()->getRadius();
             double r = phase->body()->getCullingRadius() + phase->orbit()->getBoundingRadius();
             m_maxChildRadius = max(m_maxChildRadius, bodyRadius);
@@ -151,14 +173,45 @@ FrameTree::recomputeBoundingSphere()
                 m_maxChildRadius = max(m_maxChildRadius, tree->m_maxChildRadius);
                 m_containsSecondaryIlluminators = m_containsSecondaryIlluminators || tree->containsSecondaryIlluminators();
                 m_childClassMask |= tree->childClassMask();
+                threadSafe = threadSafe && tree->isThreadSafe();
             }
 
             m_boundingSphereRadius = max(m_boundingSphereRadius, r);
+            m_threadSafeChildren.push_back(threadSafe);
+            if (threadSafe)
+                m_threadSafeChildCount++;
         }
     }
 }
 
 
+/*! Save the state at the specified time of every body in the tree whose
+ *  timeline phase is active then; see Body::updateState(). Bodies are
+ *  visited before their subtrees, so the position of each body is computed
+ *  just once, from the saved position of its frame center. The frame
+ *  center is the astrocentric position of the object the tree belongs to,
+ *  zero for the tree of a star.
+ */
+void
+FrameTree::updateStates(double tdb, const Vector3d& frameCenter)
+{
+    for (vector<TimelinePhase*>::iterator iter = children.begin();
+         iter != children.end(); iter++)
+    {
+        TimelinePhase* phase = *iter;
+        if (!phase->includes(tdb))
+            continue;
+
+        Body* body = phase->body();
+        body->updateState(tdb, frameCenter);
+
+        FrameTree* tree = body->getFrameTree();
+        if (tree != NULL)
+            tree->updateStates(tdb, body->getAstrocentricPosition(tdb));
+    }
+}
+
+
 /*! Add a new phase to this tree.
  */
 void
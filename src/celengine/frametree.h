@@ -16,6 +16,7 @@
 #include <unistd.h>
 #include <vector>
 #include <cstddef>
+#include <Eigen/Core>
 
 class Star;
 class Body;
@@ -48,6 +49,7 @@ public:
     void markChanged();
     void markUpdated();
     void recomputeBoundingSphere();
+    void updateStates(double tdb, const Eigen::Vector3d& frameCenter);
 
     bool isRoot() const
     {
@@ -90,6 +92,30 @@ public:
         return m_childClassMask;
     }
 
+    /*! Return whether the positions of the nth child and of everything
+     *  in its subtree may be computed from several threads at once.
+     */
+    bool isChildThreadSafe(unsigned int n) const
+    {
+        return m_threadSafeChildren[n];
+    }
+
+    /*! Return the number of children for which isChildThreadSafe()
+     *  is true.
+     */
+    unsigned int threadSafeChildCount() const
+    {
+        return m_threadSafeChildCount;
+    }
+
+    /*! Return whether the positions of all objects in the tree may be
+     *  computed from several threads at once.
+     */
+    bool isThreadSafe() const
+    {
+        return m_threadSafeChildCount == children.size();
+    }
+
 private:
     Star* starParent;
     Body* bodyParent;
@@ -98,6 +124,8 @@ private:
     double m_boundingSphereRadius;
     double m_maxChildRadius;
     bool m_containsSecondaryIlluminators;
+    unsigned int m_threadSafeChildCount;
+    std::vector<bool> m_threadSafeChildren;
     bool m_changed;
     int m_childClassMask;
 
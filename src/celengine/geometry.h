@@ -53,6 +53,14 @@ public:
     virtual void loadTextures()
     {
     }
+
+    /*! Return the approximate number of bytes used by the geometry's
+     *  vertex and index data.
+     */
+    virtual unsigned int getMemoryUsage() const
+    {
+        return 0;
+    }
 };
 
 #endif // _CELENGINE_GEOMETRY_H_
@@ -204,6 +204,20 @@ Geometry* GeometryInfo::load(const string& resolvedFilename)
 }
 
 
+unsigned int GeometryInfo::getResourceSize() const
+{
+    return resource != NULL ? resource->getMemoryUsage() : 0;
+}
+
+
+// Geometry is looked up each time that it's rendered, so it may be unloaded
+// when it hasn't been rendered for a while.
+bool GeometryInfo::canUnload() const
+{
+    return true;
+}
+
+
 struct NoiseMeshParameters
 {
     Vector3f size;
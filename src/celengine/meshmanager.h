@@ -51,6 +51,8 @@ class GeometryInfo : public ResourceInfo<Geometry>
 
     virtual std::string resolve(const std::string&);
     virtual Geometry* load(const std::string&);
+    virtual unsigned int getResourceSize() const;
+    virtual bool canUnload() const;
 };
 
 inline bool operator<(const GeometryInfo& g0, const GeometryInfo& g1)
@@ -197,6 +197,22 @@ ModelGeometry::isNormalized() const
 }
 
 
+unsigned int
+ModelGeometry::getMemoryUsage() const
+{
+    unsigned int size = 0;
+    for (unsigned int i = 0; i < m_model->getMeshCount(); i++)
+    {
+        const Mesh* mesh = m_model->getMesh(i);
+        size += mesh->getVertexCount() * mesh->getVertexStride();
+        for (unsigned int j = 0; j < mesh->getGroupCount(); j++)
+            size += mesh->getGroup(j)->nIndices * sizeof(Mesh::index32);
+    }
+
+    return size;
+}
+
+
 bool
 ModelGeometry::usesTextureType(Material::TextureSemantic t) const
 {
@@ -59,6 +59,14 @@ void MultiResTexture::setTexture(const string& source, const string& path,
 }
 
 
+// Returns true if the texture is still being loaded in the background
+static bool isPending(TextureManager* texMan, ResourceHandle h)
+{
+    const TextureInfo* info = texMan->getResourceInfo(h);
+    return info != NULL && info->state == ResourceLoadPending;
+}
+
+
 Texture* MultiResTexture::find(unsigned int resolution)
 {
     TextureManager* texMan = GetTextureManager();
@@ -67,6 +75,19 @@ Texture* MultiResTexture::find(unsigned int resolution)
     if (res != NULL)
         return res;
 
+    if (isPending(texMan, tex[resolution]))
+    {
+        // Until the texture is ready, use a lower resolution version if
+        // one has already been loaded; otherwise, nothing is drawn.
+        for (unsigned int i = resolution; i > lores; i--)
+        {
+            const TextureInfo* info = texMan->getResourceInfo(tex[i - 1]);
+            if (info != NULL && info->state == ResourceLoaded)
+                return info->resource;
+        }
+        return NULL;
+    }
+
     // Preferred resolution isn't available; try the second choice
     // Set these to some defaults to avoid GCC complaints
     // about possible uninitialized variable usage:
@@ -90,7 +111,7 @@ Texture* MultiResTexture::find(unsigned int resolution)
 
     tex[resolution] = tex[secondChoice];
     res = texMan->find(tex[resolution]);
-    if (res != NULL)
+    if (res != NULL || isPending(texMan, tex[resolution]))
         return res;
 
     tex[resolution] = tex[lastResort];
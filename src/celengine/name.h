@@ -17,6 +17,7 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <algorithm>
 #include <celutil/basictypes.h>
 #include <celutil/debug.h>
 #include <celutil/util.h>
@@ -31,7 +32,7 @@ template <class OBJ> class NameDatabase
     typedef std::multimap<uint32, std::string> NumberIndex;
 
  public:
-    NameDatabase() {};
+    NameDatabase() : completionIndexValid(false) {};
 
 
     uint32 getNameCount() const;
@@ -47,11 +48,39 @@ template <class OBJ> class NameDatabase
     NumberIndex::const_iterator getFirstNameIter(const uint32 catalogNumber) const;
     NumberIndex::const_iterator getFinalNameIter() const;
 
-    std::vector<std::string> getCompletion(const std::string& name) const;
+    std::vector<std::string> getCompletion(const std::string& name,
+                                           unsigned int maxCompletions = 0) const;
 
  protected:
     NameIndex   nameIndex;
     NumberIndex numberIndex;
+
+ private:
+    // Names ordered by their normalized form; the names matching a prefix
+    // are a contiguous range of it.
+    struct CompletionEntry
+    {
+        std::string key;
+        const std::string* name;
+
+        bool operator<(const CompletionEntry& other) const
+        {
+            return key < other.key || (key == other.key && *name < *other.name);
+        }
+    };
+
+    struct CompletionKeyPredicate
+    {
+        bool operator()(const CompletionEntry& entry, const std::string& key) const
+        {
+            return entry.key < key;
+        }
+    };
+
+    void buildCompletionIndex() const;
+
+    mutable std::vector<CompletionEntry> completionIndex;
+    mutable bool completionIndexValid;
 };
 
 
@@ -78,6 +107,7 @@ void NameDatabase<OBJ>::add(const uint32 catalogNumber, const std::string& name)
 
         nameIndex[name]   = catalogNumber;
         numberIndex.insert(NumberIndex::value_type(catalogNumber, name));
+        completionIndexValid = false;
     }
 }
 
@@ -150,18 +180,47 @@ NameDatabase<OBJ>::NumberIndex::const_iterator NameDatabase<OBJ>::getFinalNameIt
 
 
 template <class OBJ>
-std::vector<std::string> NameDatabase<OBJ>::getCompletion(const std::string& name) const
+void NameDatabase<OBJ>::buildCompletionIndex() const
 {
-    std::vector<std::string> completion;
-    int name_length = UTF8Length(name);
+    completionIndex.clear();
+    completionIndex.reserve(nameIndex.size());
 
     for (NameIndex::const_iterator iter = nameIndex.begin(); iter != nameIndex.end(); ++iter)
     {
-        if (!UTF8StringCompare(iter->first, name, name_length))
-        {
-            completion.push_back(iter->first);
-        }
+        CompletionEntry entry;
+        entry.key = UTF8Normalize(iter->first);
+        entry.name = &iter->first;
+        completionIndex.push_back(entry);
     }
+
+    std::sort(completionIndex.begin(), completionIndex.end());
+    completionIndexValid = true;
+}
+
+
+// Return the names beginning with the specified string, compared as in
+// UTF8StringCompare(). The names are sorted, and at most maxCompletions
+// are returned unless it's zero. The index searched is rebuilt on the
+// first completion after names are added.
+template <class OBJ>
+std::vector<std::string> NameDatabase<OBJ>::getCompletion(const std::string& name,
+                                                          unsigned int maxCompletions) const
+{
+    if (!completionIndexValid)
+        buildCompletionIndex();
+
+    std::string prefix = UTF8Normalize(name);
+    std::vector<std::string> completion;
+
+    typename std::vector<CompletionEntry>::const_iterator iter =
+        std::lower_bound(completionIndex.begin(), completionIndex.end(), prefix, CompletionKeyPredicate());
+    for (; iter != completionIndex.end() && iter->key.compare(0, prefix.length(), prefix) == 0; ++iter)
+    {
+        if (maxCompletions != 0 && completion.size() == maxCompletions)
+            break;
+        completion.push_back(*iter->name);
+    }
+
     return completion;
 }
 
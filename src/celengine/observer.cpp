@@ -13,6 +13,7 @@
 #include "frametree.h"
 #include <celmath/mathlib.h>
 #include <celmath/solve.h>
+#include <celutil/profiler.h>
 
 static const double maximumSimTime = 730486721060.00073; // 2000000000 Jan 01 12:00:00 UTC
 static const double minimumSimTime = -730498278941.99951; // -2000000000 Jan 01 12:00:00 UTC
@@ -305,6 +306,8 @@ double Observer::getArrivalTime() const
  */
 void Observer::update(double dt, double timeScale)
 {
+    PROFILE_ZONE("Observer::update");
+
     realTime += dt;
     simTime += (dt / 86400.0) * timeScale;
 
@@ -17,6 +17,7 @@
 #include <Eigen/Geometry>
 #include <celmath/plane.h>
 #include <celengine/observer.h>
+#include <celutil/threadpool.h>
 #include <vector>
 
 // The DynamicOctree and StaticOctree template arguments are:
@@ -50,9 +51,9 @@ template <class OBJ, class PREC> class DynamicOctree
 {
 public:
     typedef Eigen::Matrix<PREC, 3, 1> PointType;
+    typedef std::vector<const OBJ*> ObjectList;
 
 private:
-    typedef std::vector<const OBJ*> ObjectList;
 
 
     typedef bool (LimitingFactorPredicate)     (const OBJ&, const float);
@@ -67,9 +68,23 @@ private:
     void insertObject  (const OBJ&, const PREC);
     void rebuildAndSort(StaticOctree<OBJ, PREC>*&, OBJ*&);
 
+    // Insert a list of objects, building independent subtrees on the
+    // threads of the pool. The resulting octree is identical to the one
+    // produced by calling insertObject for each object in list order. The
+    // caller must wait on the pool before using the octree.
+    void insertObjects (const ObjectList&, const PREC, ThreadPool*);
+
+    // Recreate the node hierarchy and object lists of a previously compiled
+    // StaticOctree, leaving out any object for which isExcluded returns true.
+    // More objects may then be added with insertObject.
+    template <class EXCLUDE_PRED> void restore(const StaticOctree<OBJ, PREC>&, EXCLUDE_PRED& isExcluded);
+
  private:
    static unsigned int SPLIT_THRESHOLD;
 
+   // Object lists shorter than this are inserted without spawning tasks
+   static const unsigned int PARALLEL_INSERT_THRESHOLD = 2000;
+
    static LimitingFactorPredicate*      limitingFactorPredicate;
    static StraddlingPredicate*          straddlingPredicate;
    static ExclusionFactorDecayFunction* decayFunction;
@@ -131,6 +146,18 @@ template <class OBJ, class PREC> class StaticOctree
 
     void computeStatistics(std::vector<OctreeLevelStatistics>& stats, unsigned int level = 0);
 
+    // Node accessors used to save a compiled octree to a file and to
+    // reassemble it afterward.
+    const PointType& getCellCenter()      const { return cellCenterPos; }
+    float            getExclusionFactor() const { return exclusionFactor; }
+    const OBJ*       getFirstObject()     const { return _firstObject; }
+    unsigned int     getObjectCount()     const { return nObjects; }
+    bool             hasChildren()        const { return _children != NULL; }
+    const StaticOctree* getChild(int i)   const { return _children[i]; }
+
+    // Attach an array of eight child nodes; the octree takes ownership.
+    void setChildren(StaticOctree** children);
+
  private:
     static const PREC SQRT3;
 
@@ -224,6 +251,91 @@ inline void DynamicOctree<OBJ, PREC>::insertObject(const OBJ& obj, const PREC sc
 }
 
 
+template <class OBJ, class PREC> class DynamicOctreeInsertTask : public ThreadTask
+{
+ public:
+    typedef typename DynamicOctree<OBJ, PREC>::ObjectList ObjectList;
+
+    DynamicOctreeInsertTask(DynamicOctree<OBJ, PREC>* _node,
+                            ObjectList* _objects,
+                            PREC _scale,
+                            ThreadPool* _pool) :
+        node(_node),
+        objects(_objects),
+        scale(_scale),
+        pool(_pool)
+    {
+    }
+
+    ~DynamicOctreeInsertTask()
+    {
+        delete objects;
+    }
+
+    void run()
+    {
+        node->insertObjects(*objects, scale, pool);
+    }
+
+ private:
+    DynamicOctree<OBJ, PREC>* node;
+    ObjectList* objects;
+    PREC scale;
+    ThreadPool* pool;
+};
+
+
+// Nodes only ever affect their own subtrees once they have split, so after
+// running the insertObject logic for this node alone, the objects passed
+// down to each child can be inserted into it independently--in their
+// original order--on a separate thread.
+template <class OBJ, class PREC>
+inline void DynamicOctree<OBJ, PREC>::insertObjects(const ObjectList& objects, const PREC scale, ThreadPool* pool)
+{
+    if (pool == NULL || pool->getThreadCount() == 0 || objects.size() < PARALLEL_INSERT_THRESHOLD)
+    {
+        for (typename ObjectList::const_iterator iter = objects.begin(); iter != objects.end(); ++iter)
+            insertObject(**iter, scale);
+        return;
+    }
+
+    ObjectList* childObjects[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+
+    for (typename ObjectList::const_iterator iter = objects.begin(); iter != objects.end(); ++iter)
+    {
+        const OBJ& obj = **iter;
+
+        if (limitingFactorPredicate(obj, exclusionFactor) || straddlingPredicate(cellCenterPos, obj, exclusionFactor))
+        {
+            add(obj);
+        }
+        else if (_children == NULL)
+        {
+            if (_objects != NULL && _objects->size() >= DynamicOctree<OBJ, PREC>::SPLIT_THRESHOLD)
+                split(scale * 0.5f);
+            add(obj);
+        }
+        else
+        {
+            DynamicOctree* child = getChild(obj, cellCenterPos);
+            int i = 0;
+            while (_children[i] != child)
+                ++i;
+
+            if (childObjects[i] == NULL)
+                childObjects[i] = new ObjectList;
+            childObjects[i]->push_back(&obj);
+        }
+    }
+
+    for (int i = 0; i < 8; ++i)
+    {
+        if (childObjects[i] != NULL)
+            pool->addTask(new DynamicOctreeInsertTask<OBJ, PREC>(_children[i], childObjects[i], scale * (PREC) 0.5, pool));
+    }
+}
+
+
 template <class OBJ, class PREC>
 inline void DynamicOctree<OBJ, PREC>::add(const OBJ& obj)
 {
@@ -311,6 +423,31 @@ inline void DynamicOctree<OBJ, PREC>::rebuildAndSort(StaticOctree<OBJ, PREC>*& _
 }
 
 
+template <class OBJ, class PREC>
+template <class EXCLUDE_PRED>
+inline void DynamicOctree<OBJ, PREC>::restore(const StaticOctree<OBJ, PREC>& staticNode, EXCLUDE_PRED& isExcluded)
+{
+    for (unsigned int i = 0; i < staticNode.nObjects; ++i)
+    {
+        const OBJ& obj = staticNode._firstObject[i];
+        if (!isExcluded(obj))
+            add(obj);
+    }
+
+    if (staticNode._children != NULL)
+    {
+        _children = new DynamicOctree*[8];
+
+        for (int i = 0; i < 8; ++i)
+        {
+            const StaticOctree<OBJ, PREC>* child = staticNode._children[i];
+            _children[i] = new DynamicOctree(child->cellCenterPos, child->exclusionFactor);
+            _children[i]->restore(*child, isExcluded);
+        }
+    }
+}
+
+
 //MS VC++ wants this to be placed here:
 template <class OBJ, class PREC>
 const PREC StaticOctree<OBJ, PREC>::SQRT3 = (PREC) 1.732050807568877;
@@ -343,6 +480,13 @@ inline StaticOctree<OBJ, PREC>::~StaticOctree()
 }
 
 
+template <class OBJ, class PREC>
+inline void StaticOctree<OBJ, PREC>::setChildren(StaticOctree** children)
+{
+    _children = children;
+}
+
+
 template <class OBJ, class PREC>
 inline int StaticOctree<OBJ, PREC>::countChildren() const
 {
@@ -0,0 +1,431 @@
+// orbitcache.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Cache of sampled orbit paths for rendering.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "orbitcache.h"
+#include <algorithm>
+
+using namespace Eigen;
+using namespace std;
+
+
+// Paths are sampled to within this fraction of the orbit's size--a small
+// fraction of a pixel when the whole orbit is in view--but never more
+// coarsely than MaxSamplingTolerance, so that the path passes through the
+// orbiting object when it's seen up close.
+static const double RelativeSamplingTolerance = 1.0e-4;
+static const double MaxSamplingTolerance = 1.0;   // km
+
+// Limit the number of samples dropped in a row, which bounds the cost of
+// checking a span.
+static const unsigned int MaxDroppedSamples = 64;
+
+// Default limit on the memory used by the samples of all cached paths
+static const unsigned int DefaultMemoryBudget = 32 << 20;
+
+
+static Vector3d cubicInterpolate(const Vector3d& p0, const Vector3d& v0,
+                                 const Vector3d& p1, const Vector3d& v1,
+                                 double t)
+{
+    return p0 + (((2.0 * (p0 - p1) + v1 + v0) * (t * t * t)) +
+                ((3.0 * (p1 - p0) - 2.0 * v0 - v1) * (t * t)) +
+                (v0 * t));
+}
+
+
+OrbitSampler::OrbitSampler(double _tolerance) :
+    tolerance(_tolerance)
+{
+}
+
+
+void OrbitSampler::sample(double t, const Vector3d& position, const Vector3d& velocity)
+{
+    CurvePlotSample samp;
+    samp.t = t;
+    samp.position = position;
+    samp.velocity = velocity;
+
+    if (samples.empty() || tolerance <= 0.0)
+    {
+        samples.push_back(samp);
+        return;
+    }
+
+    // Keep the last pending sample if the span can't be extended to the
+    // new one without exceeding the tolerance.
+    if (!pending.empty() && (pending.size() >= MaxDroppedSamples || !spanFits(samp)))
+    {
+        samples.push_back(pending.back());
+        pending.clear();
+    }
+    pending.push_back(samp);
+}
+
+
+// Check whether the span from the last kept sample to the specified one
+// reproduces all pending samples within the tolerance.
+bool OrbitSampler::spanFits(const CurvePlotSample& end) const
+{
+    const CurvePlotSample& start = samples.back();
+    double dt = end.t - start.t;
+    if (dt <= 0.0)
+        return false;
+
+    for (vector<CurvePlotSample>::const_iterator iter = pending.begin(); iter != pending.end(); ++iter)
+    {
+        Vector3d p = cubicInterpolate(start.position, start.velocity * dt,
+                                      end.position, end.velocity * dt,
+                                      (iter->t - start.t) / dt);
+        if ((p - iter->position).norm() > tolerance)
+            return false;
+    }
+
+    return true;
+}
+
+
+void OrbitSampler::flush()
+{
+    if (!pending.empty())
+    {
+        samples.push_back(pending.back());
+        pending.clear();
+    }
+}
+
+
+const vector<CurvePlotSample>& OrbitSampler::getSamples()
+{
+    flush();
+    return samples;
+}
+
+
+void OrbitSampler::insertForward(CurvePlot* plot)
+{
+    flush();
+    for (vector<CurvePlotSample>::const_iterator iter = samples.begin(); iter != samples.end(); ++iter)
+    {
+        plot->addSample(*iter);
+    }
+}
+
+
+void OrbitSampler::insertBackward(CurvePlot* plot)
+{
+    flush();
+    for (vector<CurvePlotSample>::const_reverse_iterator iter = samples.rbegin(); iter != samples.rend(); ++iter)
+    {
+        plot->addSample(*iter);
+    }
+}
+
+
+OrbitPathCache::OrbitSignature::OrbitSignature(const Orbit* orbit) :
+    period(orbit->getPeriod()),
+    boundingRadius(orbit->getBoundingRadius()),
+    validBegin(0.0),
+    validEnd(0.0),
+    periodic(orbit->isPeriodic())
+{
+    orbit->getValidRange(validBegin, validEnd);
+}
+
+
+bool OrbitPathCache::OrbitSignature::operator==(const OrbitSignature& other) const
+{
+    return period == other.period &&
+           boundingRadius == other.boundingRadius &&
+           validBegin == other.validBegin &&
+           validEnd == other.validEnd &&
+           periodic == other.periodic;
+}
+
+
+OrbitPathCache::SampleTask::SampleTask(OrbitPathCache* _cache,
+                                       const Orbit* _orbit,
+                                       double _startTime,
+                                       double _endTime) :
+    cache(_cache),
+    orbit(_orbit),
+    startTime(_startTime),
+    endTime(_endTime)
+{
+}
+
+
+void OrbitPathCache::SampleTask::run()
+{
+    OrbitSampler sampler(getSamplingTolerance(orbit));
+    orbit->sample(startTime, endTime, sampler);
+
+    CurvePlot* plot = new CurvePlot();
+    sampler.insertForward(plot);
+
+    MutexLock lock(cache->sampledMutex);
+    cache->sampledPaths.push_back(make_pair(orbit, plot));
+}
+
+
+OrbitPathCache::OrbitPathCache() :
+    memoryBudget(DefaultMemoryBudget),
+    lastCull(0),
+    samplerPool(NULL)
+{
+}
+
+
+OrbitPathCache::~OrbitPathCache()
+{
+    delete samplerPool;
+
+    for (EntryMap::iterator iter = entries.begin(); iter != entries.end(); iter++)
+        delete iter->second.plot;
+    for (unsigned int i = 0; i < sampledPaths.size(); i++)
+        delete sampledPaths[i].second;
+}
+
+
+/*! Return the tolerance in kilometers to which the path of an orbit is
+ *  sampled.
+ */
+double OrbitPathCache::getSamplingTolerance(const Orbit* orbit)
+{
+    return min(orbit->getBoundingRadius() * RelativeSamplingTolerance, MaxSamplingTolerance);
+}
+
+
+// Periodic orbits are sampled over the period preceding the current time;
+// the renderer slides the window as time goes on. Trajectories are
+// sampled over their whole valid range.
+void OrbitPathCache::getSampleRange(const Orbit* orbit, double t,
+                                    double& startTime, double& endTime)
+{
+    startTime = t;
+    if (orbit->isPeriodic())
+    {
+        startTime = t - orbit->getPeriod();
+    }
+    else
+    {
+        double begin = 0.0, end = 0.0;
+        orbit->getValidRange(begin, end);
+        if (begin != end)
+            startTime = begin;
+    }
+
+    endTime = startTime + orbit->getPeriod();
+}
+
+
+/*! Return the path of the orbit, sampling it first if it isn't cached. The
+ *  returned path may be modified by the caller, and is kept at least until
+ *  the next frame. NULL is returned while the path is being sampled in the
+ *  background.
+ */
+CurvePlot* OrbitPathCache::find(const Orbit* orbit, double t, uint32 frame)
+{
+    collectSampled(frame);
+
+    EntryMap::iterator iter = entries.find(orbit);
+    if (iter != entries.end())
+    {
+        Entry& entry = iter->second;
+        if (entry.unverified)
+        {
+            if (entry.signature == OrbitSignature(orbit))
+            {
+                entry.unverified = false;
+            }
+            else
+            {
+                delete entry.plot;
+                entries.erase(iter);
+                iter = entries.end();
+            }
+        }
+
+        if (iter != entries.end())
+        {
+            entry.lastUsed = frame;
+            return entry.plot;
+        }
+    }
+
+    if (pendingOrbits.find(orbit) != pendingOrbits.end())
+        return NULL;
+
+    double startTime = 0.0, endTime = 0.0;
+    getSampleRange(orbit, t, startTime, endTime);
+
+    if (samplerPool != NULL && orbit->isThreadSafe())
+    {
+        pendingOrbits.insert(orbit);
+        samplerPool->addTask(new SampleTask(this, orbit, startTime, endTime));
+        return NULL;
+    }
+
+    OrbitSampler sampler(getSamplingTolerance(orbit));
+    orbit->sample(startTime, endTime, sampler);
+
+    CurvePlot* plot = new CurvePlot();
+    sampler.insertForward(plot);
+    addPath(orbit, plot, frame);
+
+    return plot;
+}
+
+
+/*! Mark all paths as possibly out of date. Each path is checked against its
+ *  orbit the next time that it's used, and sampled again if the orbit has
+ *  changed. This must be called before orbits are deleted.
+ */
+void OrbitPathCache::invalidate()
+{
+    // The sampler may still be using an orbit
+    if (samplerPool != NULL)
+        samplerPool->wait();
+
+    for (EntryMap::iterator iter = entries.begin(); iter != entries.end(); iter++)
+        iter->second.unverified = true;
+
+    MutexLock lock(sampledMutex);
+    for (unsigned int i = 0; i < sampledPaths.size(); i++)
+        delete sampledPaths[i].second;
+    sampledPaths.clear();
+    pendingOrbits.clear();
+}
+
+
+/*! Set the limit on the memory used by the samples of all cached paths. */
+void OrbitPathCache::setMemoryBudget(unsigned int bytes)
+{
+    memoryBudget = bytes;
+}
+
+
+void OrbitPathCache::setBackgroundSampling(bool enable)
+{
+    if (enable && samplerPool == NULL)
+    {
+        samplerPool = new ThreadPool(1);
+    }
+    else if (!enable && samplerPool != NULL)
+    {
+        // Paths that are still being sampled are picked up by find() as
+        // usual.
+        delete samplerPool;
+        samplerPool = NULL;
+    }
+}
+
+
+unsigned int OrbitPathCache::getMemoryUsed() const
+{
+    unsigned int nSamples = 0;
+    for (EntryMap::const_iterator iter = entries.begin(); iter != entries.end(); iter++)
+        nSamples += iter->second.plot->sampleCount();
+    return nSamples * sizeof(CurvePlotSample);
+}
+
+
+unsigned int OrbitPathCache::getPathCount() const
+{
+    return (unsigned int) entries.size();
+}
+
+
+void OrbitPathCache::addPath(const Orbit* orbit, CurvePlot* plot, uint32 frame)
+{
+    plot->setLastUsed(frame);
+
+    Entry entry;
+    entry.plot = plot;
+    entry.signature = OrbitSignature(orbit);
+    entry.lastUsed = frame;
+    entry.unverified = false;
+
+    EntryMap::iterator iter = entries.find(orbit);
+    if (iter != entries.end())
+    {
+        delete iter->second.plot;
+        iter->second = entry;
+    }
+    else
+    {
+        entries.insert(EntryMap::value_type(orbit, entry));
+    }
+
+    cull(frame);
+}
+
+
+void OrbitPathCache::collectSampled(uint32 frame)
+{
+    if (pendingOrbits.empty())
+        return;
+
+    vector<pair<const Orbit*, CurvePlot*> > sampled;
+    {
+        MutexLock lock(sampledMutex);
+        sampled.swap(sampledPaths);
+    }
+
+    for (unsigned int i = 0; i < sampled.size(); i++)
+    {
+        pendingOrbits.erase(sampled[i].first);
+        addPath(sampled[i].first, sampled[i].second, frame);
+    }
+}
+
+
+struct OlderPathPredicate
+{
+    OlderPathPredicate(uint32 _frame) : frame(_frame) {};
+
+    template<class I> bool operator()(const I& a, const I& b) const
+    {
+        return frame - a->second.lastUsed > frame - b->second.lastUsed;
+    }
+
+    uint32 frame;
+};
+
+
+// Discard the paths that have gone unused the longest until the cache is
+// within its budget. The samples are only counted once per frame, since
+// there may be thousands of paths.
+void OrbitPathCache::cull(uint32 frame)
+{
+    if (lastCull == frame)
+        return;
+    lastCull = frame;
+
+    unsigned int memoryUsed = getMemoryUsed();
+    if (memoryUsed <= memoryBudget)
+        return;
+
+    vector<EntryMap::iterator> unused;
+    for (EntryMap::iterator iter = entries.begin(); iter != entries.end(); iter++)
+    {
+        if (iter->second.lastUsed != frame)
+            unused.push_back(iter);
+    }
+    sort(unused.begin(), unused.end(), OlderPathPredicate(frame));
+
+    for (unsigned int i = 0; i < unused.size() && memoryUsed > memoryBudget; i++)
+    {
+        memoryUsed -= unused[i]->second.plot->sampleCount() * sizeof(CurvePlotSample);
+        delete unused[i]->second.plot;
+        entries.erase(unused[i]);
+    }
+}
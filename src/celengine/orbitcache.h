@@ -0,0 +1,144 @@
+// orbitcache.h
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Cache of sampled orbit paths for rendering.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELENGINE_ORBITCACHE_H_
+#define _CELENGINE_ORBITCACHE_H_
+
+#include <map>
+#include <set>
+#include <vector>
+#include <celutil/basictypes.h>
+#include <celutil/thread.h>
+#include <celutil/threadpool.h>
+#include <celephem/orbit.h>
+#include <curveplot.h>
+
+
+/*! Collects the samples of an orbit, dropping those that the cubic
+ *  Hermite interpolation of their neighbors--as used to draw the path--
+ *  reproduces within the tolerance. Straight stretches of a trajectory are
+ *  thus drawn with few samples, while tight turns keep all of theirs.
+ */
+class OrbitSampler : public OrbitSampleProc
+{
+ public:
+    OrbitSampler(double _tolerance = 0.0);
+
+    void sample(double t, const Eigen::Vector3d& position, const Eigen::Vector3d& velocity);
+
+    void insertForward(CurvePlot* plot);
+    void insertBackward(CurvePlot* plot);
+
+    const std::vector<CurvePlotSample>& getSamples();
+
+ private:
+    bool spanFits(const CurvePlotSample& end) const;
+    void flush();
+
+ private:
+    double tolerance;
+    std::vector<CurvePlotSample> samples;
+    // Samples after the last one that's certainly kept
+    std::vector<CurvePlotSample> pending;
+};
+
+
+/*! The orbit cache keeps the sampled paths of orbits, so that they don't
+ *  have to be sampled each frame. Paths are sampled with a tolerance
+ *  relative to the size of the orbit, and are refined on screen by the
+ *  curve plot's own subdivision. The cache is bounded by the memory used
+ *  by the samples; when it's exceeded, the paths that have gone unused the
+ *  longest are discarded.
+ *
+ *  Paths are identified by the orbit and checked against the orbit's
+ *  period, size and valid range; invalidating the cache only forces this
+ *  check, so paths of orbits that haven't changed are kept.
+ *
+ *  With background sampling enabled, the paths of orbits that are safe to
+ *  evaluate from another thread are sampled on a loader thread, and find()
+ *  returns NULL until the path is ready.
+ */
+class OrbitPathCache
+{
+ public:
+    OrbitPathCache();
+    ~OrbitPathCache();
+
+    CurvePlot* find(const Orbit* orbit, double t, uint32 frame);
+    void invalidate();
+
+    void setMemoryBudget(unsigned int bytes);
+    void setBackgroundSampling(bool enable);
+
+    unsigned int getMemoryUsed() const;
+    unsigned int getPathCount() const;
+
+    static double getSamplingTolerance(const Orbit* orbit);
+
+ private:
+    struct OrbitSignature
+    {
+        OrbitSignature() {};
+        OrbitSignature(const Orbit* orbit);
+        bool operator==(const OrbitSignature& other) const;
+
+        double period;
+        double boundingRadius;
+        double validBegin;
+        double validEnd;
+        bool periodic;
+    };
+
+    struct Entry
+    {
+        CurvePlot* plot;
+        OrbitSignature signature;
+        uint32 lastUsed;
+        // Set when the cache has been invalidated and the signature must
+        // be checked before the path is used again
+        bool unverified;
+    };
+
+    class SampleTask : public ThreadTask
+    {
+     public:
+        SampleTask(OrbitPathCache* _cache, const Orbit* _orbit,
+                   double _startTime, double _endTime);
+        void run();
+
+     private:
+        OrbitPathCache* cache;
+        const Orbit* orbit;
+        double startTime;
+        double endTime;
+    };
+
+    typedef std::map<const Orbit*, Entry> EntryMap;
+
+    static void getSampleRange(const Orbit* orbit, double t, double& startTime, double& endTime);
+    void addPath(const Orbit* orbit, CurvePlot* plot, uint32 frame);
+    void collectSampled(uint32 frame);
+    void cull(uint32 frame);
+
+ private:
+    EntryMap entries;
+    unsigned int memoryBudget;
+    uint32 lastCull;
+
+    ThreadPool* samplerPool;
+    std::set<const Orbit*> pendingOrbits;
+
+    // Guards the paths handed back by the sampler thread
+    Mutex sampledMutex;
+    std::vector<std::pair<const Orbit*, CurvePlot*> > sampledPaths;
+};
+
+#endif // _CELENGINE_ORBITCACHE_H_
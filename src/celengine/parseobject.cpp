@@ -652,9 +652,13 @@ CreateScriptedOrbit(Hash* orbitData,
     string moduleName;
     orbitData->getString("Module", moduleName);
 
-    string* pathCopy = new string(path);
-    Value* pathValue = new Value(*pathCopy);
-    orbitData->addValue("AddonPath", *pathValue);
+    // The path is only needed while the script is initialized, and the
+    // hash may be allocated from an arena that won't delete its values, so
+    // the value is removed again afterwards.
+    Value pathValue(path);
+    bool addedPath = orbitData->getValue("AddonPath") == NULL;
+    if (addedPath)
+        orbitData->addValue("AddonPath", pathValue);
 
     ScriptedOrbit* scriptedOrbit = new ScriptedOrbit();
     if (scriptedOrbit != NULL)
@@ -666,6 +670,9 @@ CreateScriptedOrbit(Hash* orbitData,
         }
     }
 
+    if (addedPath)
+        orbitData->removeValue("AddonPath");
+
     return scriptedOrbit;
 #endif
 }
@@ -1038,9 +1045,12 @@ CreateScriptedRotation(Hash* rotationData,
     string moduleName;
     rotationData->getString("Module", moduleName);
 
-    string* pathCopy = new string(path);
-    Value* pathValue = new Value(*pathCopy);
-    rotationData->addValue("AddonPath", *pathValue);
+    // As in CreateScriptedOrbit(), the path is only added while the script
+    // is initialized.
+    Value pathValue(path);
+    bool addedPath = rotationData->getValue("AddonPath") == NULL;
+    if (addedPath)
+        rotationData->addValue("AddonPath", pathValue);
 
     ScriptedRotation* scriptedRotation = new ScriptedRotation();
     if (scriptedRotation != NULL)
@@ -1052,6 +1062,9 @@ CreateScriptedRotation(Hash* rotationData,
         }
     }
 
+    if (addedPath)
+        rotationData->removeValue("AddonPath");
+
     return scriptedRotation;
 #endif
 }
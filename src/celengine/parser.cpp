@@ -10,6 +10,7 @@
 
 #include "parser.h"
 #include "astro.h"
+#include <algorithm>
 
 using namespace Eigen;
 
@@ -114,14 +115,68 @@ bool Value::getBoolean() const
 }
 
 
+// Order hash entries by name only, so that the first of several entries
+// with the same name is kept.
+struct HashEntryPredicate
+{
+    bool operator()(const HashEntry& a, const HashEntry& b) const
+    {
+        return a.first < b.first;
+    }
+
+    bool operator()(const HashEntry& a, const string& key) const
+    {
+        return a.first < key;
+    }
+};
+
+// Swap hash entries without copying the keys
+static inline void swapHashEntries(HashEntry& a, HashEntry& b)
+{
+    a.first.swap(b.first);
+    swap(a.second, b.second);
+}
+
+// Stable sort of hash entries by key. Hashes are small, and an insertion
+// sort avoids the temporary buffer allocated by stable_sort.
+static void sortHashEntries(vector<HashEntry>::iterator begin,
+                            vector<HashEntry>::iterator end)
+{
+    if (end - begin > 32)
+    {
+        stable_sort(begin, end, HashEntryPredicate());
+        return;
+    }
+
+    for (vector<HashEntry>::iterator iter = begin; iter != end; iter++)
+    {
+        for (vector<HashEntry>::iterator j = iter; j != begin && (j - 1)->first > j->first; j--)
+            swapHashEntries(*(j - 1), *j);
+    }
+}
+
+
 /****** Parser method implementation ******/
 
-Parser::Parser(Tokenizer* _tokenizer) :
-    tokenizer(_tokenizer)
+/*! Create a parser reading from the tokenizer. If an arena is given, the
+ *  values read are allocated from it, and must not be deleted; otherwise,
+ *  the caller is responsible for deleting them.
+ */
+Parser::Parser(Tokenizer* _tokenizer, ValueArena* _arena) :
+    tokenizer(_tokenizer),
+    arena(_arena)
 {
 }
 
 
+// Free a value read by the parser when it is not part of the result
+void Parser::discard(Value* value)
+{
+    if (arena == NULL)
+        delete value;
+}
+
+
 Array* Parser::readArray()
 {
     Tokenizer::TokenType tok = tokenizer->nextToken();
@@ -131,12 +186,13 @@ Array* Parser::readArray()
         return NULL;
     }
 
-    Array* array = new Array();
-
+    // Collect the values first, so that the array can be created with
+    // the right size.
+    unsigned int first = arrayValues.size();
     Value* v = readValue();
     while (v != NULL)
     {
-        array->insert(array->end(), v);
+        arrayValues.push_back(v);
         v = readValue();
     }
     
@@ -144,10 +200,16 @@ Array* Parser::readArray()
     if (tok != Tokenizer::TokenEndArray)
     {
         tokenizer->pushBack();
-        delete array;
+        for (unsigned int i = first; i < arrayValues.size(); i++)
+            discard(arrayValues[i]);
+        arrayValues.resize(first);
         return NULL;
     }
 
+    Array* array = arena != NULL ? arena->newArray() : new Array();
+    array->assign(arrayValues.begin() + first, arrayValues.end());
+    arrayValues.resize(first);
+
     return array;
 }
 
@@ -161,7 +223,9 @@ Hash* Parser::readHash()
         return NULL;
     }
 
-    Hash* hash = new Hash();
+    // As for arrays, the entries are collected before the hash is created.
+    unsigned int first = hashEntries.size();
+    bool error = false;
 
     tok = tokenizer->nextToken();
     while (tok != Tokenizer::TokenEndGroup)
@@ -169,42 +233,74 @@ Hash* Parser::readHash()
         if (tok != Tokenizer::TokenName)
         {
             tokenizer->pushBack();
-            delete hash;
-            return NULL;
+            error = true;
+            break;
         }
         string name = tokenizer->getNameValue();
         
 #ifndef USE_POSTFIX_UNITS
-        readUnits(name, hash);
+        readUnits(name);
 #endif
 
         Value* value = readValue();
         if (value == NULL)
         {
-            delete hash;
-            return NULL;
+            error = true;
+            break;
         }
 
-        hash->addValue(name, *value);
-        
 #ifdef USE_POSTFIX_UNITS
-        readUnits(name, hash);
+        readUnits(name);
 #endif
 
+        hashEntries.push_back(HashEntry(string(), value));
+        hashEntries.back().first.swap(name);
+
         tok = tokenizer->nextToken();
     }
 
+    Hash* hash = NULL;
+    if (error)
+    {
+        for (unsigned int i = first; i < hashEntries.size(); i++)
+            discard(hashEntries[i].second);
+    }
+    else
+    {
+        // Sort the entries by key, keeping only the first value of any
+        // property that appears more than once.
+        vector<HashEntry>::iterator begin = hashEntries.begin() + first;
+        vector<HashEntry>::iterator end = begin;
+        sortHashEntries(begin, hashEntries.end());
+        for (vector<HashEntry>::iterator iter = begin; iter != hashEntries.end(); iter++)
+        {
+            if (end == begin || iter->first != (end - 1)->first)
+            {
+                if (end != iter)
+                    swapHashEntries(*end, *iter);
+                ++end;
+            }
+            else
+            {
+                discard(iter->second);
+            }
+        }
+
+        hash = arena != NULL ? arena->newHash() : new Hash();
+        hash->moveEntries(begin, end);
+    }
+    hashEntries.erase(hashEntries.begin() + first, hashEntries.end());
+
     return hash;
 }
 
 
 /**
- * Reads a units section into the hash.
+ * Reads a units section into the entries of the hash being read.
  * @param[in] propertyName Name of the current property.
- * @param[in] hash Hash to add units quantities into.
  * @return True if a units section was successfully read, false otherwise.
  */
-bool Parser::readUnits(const string& propertyName, Hash* hash)
+bool Parser::readUnits(const string& propertyName)
 {
     Tokenizer::TokenType tok = tokenizer->nextToken();
     if (tok != Tokenizer::TokenBeginUnits)
@@ -222,29 +318,20 @@ bool Parser::readUnits(const string& propertyName, Hash* hash)
             return false;
         }
        
-        string unit = tokenizer->getNameValue();
-        Value* value = new Value(unit);
+        const string& unit = tokenizer->getNameValue();
+        string keyName;
         
         if (astro::isLengthUnit(unit))
-        {
-            string keyName(propertyName + "%Length");
-            hash->addValue(keyName, *value);
-        }
+            keyName = propertyName + "%Length";
         else if (astro::isTimeUnit(unit))
-        {
-            string keyName(propertyName + "%Time");
-            hash->addValue(keyName, *value);
-        }
+            keyName = propertyName + "%Time";
         else if (astro::isAngleUnit(unit))
-        {
-            string keyName(propertyName + "%Angle");
-            hash->addValue(keyName, *value);
-        }
+            keyName = propertyName + "%Angle";
         else
-        {
-            delete value;
             return false;
-        }
+
+        Value* value = arena != NULL ? arena->newValue(unit) : new Value(unit);
+        hashEntries.push_back(HashEntry(keyName, value));
         
         tok = tokenizer->nextToken();
     }
@@ -259,16 +346,23 @@ Value* Parser::readValue()
     switch (tok)
     {
     case Tokenizer::TokenNumber:
+        if (arena != NULL)
+            return arena->newValue(tokenizer->getNumberValue());
         return new Value(tokenizer->getNumberValue());
 
     case Tokenizer::TokenString:
+        if (arena != NULL)
+            return arena->newValue(tokenizer->getStringValue());
         return new Value(tokenizer->getStringValue());
 
     case Tokenizer::TokenName:
-        if (tokenizer->getNameValue() == "false")
-            return new Value(false);
-        else if (tokenizer->getNameValue() == "true")
-            return new Value(true);
+        if (tokenizer->getNameValue() == "false" || tokenizer->getNameValue() == "true")
+        {
+            bool b = tokenizer->getNameValue() == "true";
+            if (arena != NULL)
+                return arena->newValue(b);
+            return new Value(b);
+        }
         else
         {
             tokenizer->pushBack();
@@ -281,6 +375,8 @@ Value* Parser::readValue()
             Array* array = readArray();
             if (array == NULL)
                 return NULL;
+            else if (arena != NULL)
+                return arena->newValue(array);
             else
                 return new Value(array);
         }
@@ -291,6 +387,8 @@ Value* Parser::readValue()
             Hash* hash = readHash();
             if (hash == NULL)
                 return NULL;
+            else if (arena != NULL)
+                return arena->newValue(hash);
             else
                 return new Value(hash);
         }
@@ -302,36 +400,158 @@ Value* Parser::readValue()
 }
 
 
-AssociativeArray::AssociativeArray()
+/****** ValueArena method implementation ******/
+
+// All objects allocated from the arena are pointer aligned, and the values
+// need double alignment.
+static const unsigned int ValueArenaAlignment = 8;
+static const unsigned int ValueArenaBlockSize = 16384;
+
+ValueArena::ValueArena() :
+    pool(ValueArenaAlignment, ValueArenaBlockSize)
 {
 }
 
-AssociativeArray::~AssociativeArray()
+
+ValueArena::~ValueArena()
 {
-#if 0
-    Hash::iterator iter = data.h->begin();
-    while (iter != data.h->end())
+    clear();
+}
+
+
+/*! Free all values allocated from the arena.
+ */
+void ValueArena::clear()
+{
+    for (vector<Hash*>::const_iterator iter = hashes.begin(); iter != hashes.end(); iter++)
     {
-        delete iter->second;
-        iter++;
+        // The values of the hash are in the arena too; they must not be
+        // deleted by the hash destructor.
+        (*iter)->assoc.clear();
+        (*iter)->~Hash();
     }
-#endif
-    for (map<string, Value*>::iterator iter = assoc.begin(); iter != assoc.end(); iter++)
+    for (vector<Array*>::const_iterator iter = arrays.begin(); iter != arrays.end(); iter++)
+        (*iter)->~Array();
+    for (vector<string*>::const_iterator iter = strings.begin(); iter != strings.end(); iter++)
+        (*iter)->~string();
+
+    hashes.clear();
+    arrays.clear();
+    strings.clear();
+    pool.freeAll();
+}
+
+
+Value* ValueArena::newValue(double d)
+{
+    return new (pool.allocate(sizeof(Value))) Value(d);
+}
+
+
+Value* ValueArena::newValue(const string& s)
+{
+    string* str = new (pool.allocate(sizeof(string))) string(s);
+    strings.push_back(str);
+
+    // Construct the value without the heap allocated string of the
+    // Value(string) constructor.
+    Value* value = new (pool.allocate(sizeof(Value))) Value(0.0);
+    value->type = Value::StringType;
+    value->data.s = str;
+
+    return value;
+}
+
+
+Value* ValueArena::newValue(bool b)
+{
+    return new (pool.allocate(sizeof(Value))) Value(b);
+}
+
+
+Value* ValueArena::newValue(Array* a)
+{
+    return new (pool.allocate(sizeof(Value))) Value(a);
+}
+
+
+Value* ValueArena::newValue(Hash* h)
+{
+    return new (pool.allocate(sizeof(Value))) Value(h);
+}
+
+
+Array* ValueArena::newArray()
+{
+    Array* array = new (pool.allocate(sizeof(Array))) Array();
+    arrays.push_back(array);
+    return array;
+}
+
+
+Hash* ValueArena::newHash()
+{
+    Hash* hash = new (pool.allocate(sizeof(Hash))) Hash();
+    hashes.push_back(hash);
+    return hash;
+}
+
+
+/****** AssociativeArray method implementation ******/
+
+AssociativeArray::AssociativeArray()
+{
+}
+
+AssociativeArray::~AssociativeArray()
+{
+    for (vector<HashEntry>::iterator iter = assoc.begin(); iter != assoc.end(); iter++)
         delete iter->second;
 }
 
-Value* AssociativeArray::getValue(string key) const
+Value* AssociativeArray::getValue(const string& key) const
 {
-    map<string, Value*>::const_iterator iter = assoc.find(key);
-    if (iter == assoc.end())
+    vector<HashEntry>::const_iterator iter =
+        lower_bound(assoc.begin(), assoc.end(), key, HashEntryPredicate());
+    if (iter == assoc.end() || iter->first != key)
         return NULL;
     else
         return iter->second;
 }
 
-void AssociativeArray::addValue(string key, Value& val)
+/*! Add a value to the hash, which takes ownership of it. If the hash
+ *  already has a value with the same key, the new value is ignored, and
+ *  remains owned by the caller.
+ */
+void AssociativeArray::addValue(const string& key, Value& val)
+{
+    vector<HashEntry>::iterator iter =
+        lower_bound(assoc.begin(), assoc.end(), key, HashEntryPredicate());
+    if (iter == assoc.end() || iter->first != key)
+        assoc.insert(iter, HashEntry(key, &val));
+}
+
+Value* AssociativeArray::removeValue(const string& key)
+{
+    vector<HashEntry>::iterator iter =
+        lower_bound(assoc.begin(), assoc.end(), key, HashEntryPredicate());
+    if (iter == assoc.end() || iter->first != key)
+        return NULL;
+
+    Value* val = iter->second;
+    assoc.erase(iter);
+    return val;
+}
+
+// Move entries sorted by key and with no duplicate keys into an empty
+// hash. The keys are swapped rather than copied, and left empty in the
+// range.
+void AssociativeArray::moveEntries(vector<HashEntry>::iterator first,
+                                   vector<HashEntry>::iterator last)
 {
-    assoc.insert(map<string, Value*>::value_type(key, &val));
+    assoc.resize(last - first);
+    for (vector<HashEntry>::iterator iter = assoc.begin(); first != last; iter++, first++)
+        swapHashEntries(*iter, *first);
 }
 
 bool AssociativeArray::getNumber(const string& key, double& val) const
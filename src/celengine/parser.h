@@ -13,26 +13,39 @@
 
 #include <vector>
 #include <map>
+#include <string>
+#include <utility>
 #include <celmath/vecmath.h>
 #include <celmath/quaternion.h>
 #include <celutil/color.h>
 #include <celutil/basictypes.h>
+#include <celutil/memorypool.h>
 #include <celengine/tokenizer.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
 class Value;
+class ValueArena;
 
-typedef map<string, Value*>::const_iterator HashIterator;
+typedef std::pair<std::string, Value*> HashEntry;
+typedef std::vector<HashEntry>::const_iterator HashIterator;
 
+/*! An AssociativeArray maps property names to values. Catalog objects
+ *  rarely have more than twenty properties, so the entries are kept in a
+ *  vector sorted by name rather than in a map; this takes a single
+ *  allocation per hash and lookups are binary searches. As with a map,
+ *  the first value added for a name is the one that is kept.
+ */
 class AssociativeArray
 {
  public:
     AssociativeArray();
     ~AssociativeArray();
 
-    Value* getValue(string) const;
-    void addValue(string, Value&);
+    Value* getValue(const std::string&) const;
+    void addValue(const std::string&, Value&);
+    // Remove a value without deleting it; returns NULL if there's none
+    Value* removeValue(const std::string&);
 
     bool getNumber(const std::string&, double&) const;
     bool getNumber(const std::string&, float&) const;
@@ -68,10 +81,16 @@ class AssociativeArray
     HashIterator end();
     
  private:
-    map<string, Value*> assoc;
+    void moveEntries(std::vector<HashEntry>::iterator first,
+                     std::vector<HashEntry>::iterator last);
+
+    std::vector<HashEntry> assoc;
+
+    friend class Parser;
+    friend class ValueArena;
 };
 
-typedef vector<Value*> Array;
+typedef std::vector<Value*> Array;
 typedef AssociativeArray Hash;
 
 class Value
@@ -109,22 +128,68 @@ private:
         Array* a;
         Hash* h;
     } data;
+
+    friend class ValueArena;
+};
+
+
+/*! A ValueArena holds parse trees in a memory pool. All values, strings,
+ *  arrays and hashes read by a Parser constructed with an arena are
+ *  allocated from it, and they are freed together by clear() or when the
+ *  arena is destroyed. Values allocated from an arena must never be
+ *  deleted.
+ *
+ *  The strings, arrays and hashes still need their destructors run, since
+ *  they may have allocated storage of their own; the arena keeps lists of
+ *  them, which are reused along with the pool's blocks after clear().
+ */
+class ValueArena
+{
+public:
+    ValueArena();
+    ~ValueArena();
+
+    void clear();
+
+    Value* newValue(double);
+    Value* newValue(const std::string&);
+    Value* newValue(bool);
+    Value* newValue(Array*);
+    Value* newValue(Hash*);
+    Array* newArray();
+    Hash* newHash();
+
+private:
+    ValueArena(const ValueArena&);
+    ValueArena& operator=(const ValueArena&);
+
+    MemoryPool pool;
+    std::vector<std::string*> strings;
+    std::vector<Array*> arrays;
+    std::vector<Hash*> hashes;
 };
 
 
 class Parser
 {
 public:
-    Parser(Tokenizer*);
+    Parser(Tokenizer*, ValueArena* arena = NULL);
 
     Value* readValue();
 
 private:
     Tokenizer* tokenizer;
-    
-    bool readUnits(const std::string&, Hash*);
+    ValueArena* arena;
+
+    // Stacks of the values of the arrays and hashes being read; their
+    // storage is reused for every array and hash.
+    std::vector<Value*> arrayValues;
+    std::vector<HashEntry> hashEntries;
+
+    bool readUnits(const std::string&);
     Array* readArray();
     Hash* readHash();
+    void discard(Value*);
 };
 
 #endif // _PARSER_H_
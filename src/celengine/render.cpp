@@ -63,6 +63,7 @@ std::ofstream hdrlog;
 #include "timelinephase.h"
 #include "skygrid.h"
 #include "modelgeometry.h"
+#include "orbitcache.h"
 #include <celutil/debug.h>
 #include <celmath/frustum.h>
 #include <celmath/distance.h>
@@ -71,7 +72,8 @@ std::ofstream hdrlog;
 #include <celutil/utf8.h>
 #include <celutil/util.h>
 #include <celutil/timer.h>
-#include <curveplot.h>
+#include <celutil/threadpool.h>
+#include <celutil/profiler.h>
 #include <GL/glew.h>
 #include <algorithm>
 #include <cstdio>
@@ -195,11 +197,6 @@ static const int MaxSkyRings = 32;
 static const int MaxSkySlices = 180;
 static const int MinSkySlices = 30;
 
-// Size at which the orbit cache will be flushed of old orbit paths
-static const unsigned int OrbitCacheCullThreshold = 200;
-// Age in frames at which unused orbit paths may be eliminated from the cache
-static const uint32 OrbitCacheRetireAge = 16;
-
 Color Renderer::StarLabelColor          (0.471f, 0.356f, 0.682f);
 Color Renderer::PlanetLabelColor        (0.407f, 0.333f, 0.964f);
 Color Renderer::DwarfPlanetLabelColor   (0.407f, 0.333f, 0.964f);
@@ -319,7 +316,6 @@ public:
     inline void addStar(const Eigen::Vector3f& pos, const Color&, float);
 	void setTexture(Texture*);
 
-private:
     struct StarVertex
     {
         Eigen::Vector3f position;
@@ -328,6 +324,9 @@ private:
         float pad;
     };
 
+    void addStars(const std::vector<StarVertex>&);
+
+private:
     unsigned int capacity;
     unsigned int nStars;
     StarVertex* vertices;
@@ -337,6 +336,44 @@ private:
 };
 
 
+// Stars, labels and render list entries produced by a PointStarRenderer.
+// Stars may be culled on worker threads, so nothing is handed to OpenGL
+// or the Renderer until PointStarRenderer::submit() is called on the
+// render thread.
+struct PointStarRendererOutput
+{
+    struct Label
+    {
+        Vector3f position;
+        Color color;
+        string text;
+    };
+
+    // Stars that need an accurate position computed from their orbits
+    struct CloseStar
+    {
+        const Star* star;
+        float distance;
+        float appMag;
+    };
+
+    void clear()
+    {
+        stars.clear();
+        glare.clear();
+        renderList.clear();
+        labels.clear();
+        closeStars.clear();
+    }
+
+    vector<PointStarVertexBuffer::StarVertex> stars;
+    vector<PointStarVertexBuffer::StarVertex> glare;
+    vector<RenderListEntry> renderList;
+    vector<Label> labels;
+    vector<CloseStar> closeStars;
+};
+
+
 StarVertexBuffer::StarVertexBuffer(unsigned int _capacity) :
     capacity(_capacity),
     vertices(NULL),
@@ -574,6 +611,25 @@ inline void PointStarVertexBuffer::addStar(const Eigen::Vector3f& pos,
     }
 }
 
+// Append vertices staged elsewhere, rendering whenever the buffer fills.
+void PointStarVertexBuffer::addStars(const std::vector<StarVertex>& stars)
+{
+    unsigned int first = 0;
+    while (first < stars.size())
+    {
+        unsigned int count = min(capacity - nStars, (unsigned int) stars.size() - first);
+        copy(stars.begin() + first, stars.begin() + first + count, vertices + nStars);
+        nStars += count;
+        first += count;
+
+        if (nStars == capacity)
+        {
+            render();
+            nStars = 0;
+        }
+    }
+}
+
 void PointStarVertexBuffer::setTexture(Texture* _texture)
 {
 	texture = _texture;
@@ -582,6 +638,29 @@ void PointStarVertexBuffer::setTexture(Texture* _texture)
 /**** End star vertex buffer classes ****/
 
 
+// Adds the time spent in its scope to one of the frame timings
+class StageTimer
+{
+public:
+    StageTimer(const Timer* _timer, double& _elapsed) :
+        timer(_timer),
+        elapsed(_elapsed),
+        start(_timer->getTime())
+    {
+    }
+
+    ~StageTimer()
+    {
+        elapsed += timer->getTime() - start;
+    }
+
+private:
+    const Timer* timer;
+    double& elapsed;
+    double start;
+};
+
+
 Renderer::Renderer() :
     context(0),
     windowWidth(0),
@@ -605,13 +684,15 @@ Renderer::Renderer() :
     starVertexBuffer(NULL),
     pointStarVertexBuffer(NULL),
     glareVertexBuffer(NULL),
+    threadPool(NULL),
     useVertexPrograms(false),
     useRescaleNormal(false),
     usePointSprite(false),
     textureResolution(medres),
     useNewStarRendering(false),
     frameCount(0),
-    lastOrbitCacheFlush(0),
+    timer(NULL),
+    orbitCache(new OrbitPathCache()),
     minOrbitSize(MinOrbitSizeForLabel),
     distanceLimit(1.0e6f),
     minFeatureSize(MinFeatureSizeForLabel),
@@ -635,6 +716,9 @@ Renderer::Renderer() :
     starVertexBuffer = new StarVertexBuffer(2048);
     pointStarVertexBuffer = new PointStarVertexBuffer(2048);
     glareVertexBuffer = new PointStarVertexBuffer(2048);
+    threadPool = new ThreadPool();
+    timer = CreateTimer();
+    frameTimings = FrameTimings();
     skyVertices = new SkyVertex[MaxSkySlices * (MaxSkyRings + 1)];
     skyIndices = new uint32[(MaxSkySlices + 1) * 2 * MaxSkyRings];
     skyContour = new SkyContourPoint[MaxSkySlices + 1];
@@ -670,6 +754,15 @@ Renderer::~Renderer()
         delete starVertexBuffer;
     if (pointStarVertexBuffer != NULL)
         delete pointStarVertexBuffer;
+    delete glareVertexBuffer;
+    delete threadPool;
+    delete timer;
+    delete orbitCache;
+    for (vector<PointStarRendererOutput*>::iterator iter = pointStarOutputs.begin();
+         iter != pointStarOutputs.end(); iter++)
+    {
+        delete *iter;
+    }
     delete[] skyVertices;
     delete[] skyIndices;
     delete[] skyContour;
@@ -700,7 +793,9 @@ Renderer::DetailOptions::DetailOptions() :
     ringSystemSections(100),
     orbitPathSamplePoints(100),
     shadowTextureSize(256),
-    eclipseTextureSize(128)
+    eclipseTextureSize(128),
+    orbitCacheMemory(32 << 20),
+    backgroundOrbitSampling(false)
 {
 }
 
@@ -1061,6 +1156,9 @@ bool Renderer::init(GLContext* _context,
     context = _context;
     detailOptions = _detailOptions;
 
+    orbitCache->setMemoryBudget(detailOptions.orbitCacheMemory);
+    orbitCache->setBackgroundSampling(detailOptions.backgroundOrbitSampling);
+
     // Initialize static meshes and textures common to all instances of Renderer
     if (!commonDataInitialized)
     {
@@ -1744,42 +1842,6 @@ static void disableSmoothLines()
 }
 
 
-class OrbitSampler : public OrbitSampleProc
-{
-public:
-    vector<CurvePlotSample> samples;
-
-    OrbitSampler()
-    {
-    }
-
-    void sample(double t, const Vector3d& position, const Vector3d& velocity)
-    {
-        CurvePlotSample samp;
-        samp.t = t;
-        samp.position = position;
-        samp.velocity = velocity;
-        samples.push_back(samp);
-    }
-
-    void insertForward(CurvePlot* plot)
-    {
-        for (vector<CurvePlotSample>::const_iterator iter = samples.begin(); iter != samples.end(); ++iter)
-        {
-            plot->addSample(*iter);
-        }
-    }
-
-    void insertBackward(CurvePlot* plot)
-    {
-        for (vector<CurvePlotSample>::const_reverse_iterator iter = samples.rbegin(); iter != samples.rend(); ++iter)
-        {
-            plot->addSample(*iter);
-        }
-    }
-};
-
-
 Vector4f renderOrbitColor(const Body *body, bool selected, float opacity)
 {
     Color orbitColor;
@@ -1850,6 +1912,8 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
                            float nearDist,
                            float farDist)
 {
+    PROFILE_ZONE("Renderer::renderOrbit");
+
     Body* body = orbitPath.body;
     double nearZ = -nearDist;  // negate, becase z is into the screen in camera space
     double farZ = -farDist;
@@ -1860,82 +1924,8 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
     else
         orbit = orbitPath.star->getOrbit();
 
-    CurvePlot* cachedOrbit = NULL;
-    OrbitCache::iterator cached = orbitCache.find(orbit);
-    if (cached != orbitCache.end())
-    {
-        cachedOrbit = cached->second;
-        cachedOrbit->setLastUsed(frameCount);
-    }
-
-    // If it's not in the cache already
-    if (cachedOrbit == NULL)
-    {
-        double startTime = t;
-        int nSamples = detailOptions.orbitPathSamplePoints;
-
-        // Adjust the number of samples used for aperiodic orbits--these aren't
-        // true orbits, but are sampled trajectories, generally of spacecraft.
-        // Better control is really needed--some sort of adaptive sampling would
-        // be ideal.
-        if (!orbit->isPeriodic())
-        {
-            double begin = 0.0, end = 0.0;
-            orbit->getValidRange(begin, end);
-
-            if (begin != end)
-            {
-                startTime = begin;
-                nSamples = (int) (orbit->getPeriod() * 100.0);
-                nSamples = max(min(nSamples, 1000), 100);
-            }
-            else
-            {
-                // If the orbit is aperiodic and doesn't have a
-                // finite duration, we don't render it. A compromise
-                // would be to pick some time window centered at the
-                // current time, but we'd have to pick some arbitrary
-                // duration.
-                nSamples = 0;
-            }
-        }
-        else
-        {
-            startTime = t - orbit->getPeriod();
-        }
-
-        cachedOrbit = new CurvePlot();
-        cachedOrbit->setLastUsed(frameCount);
-
-        OrbitSampler sampler;
-        orbit->sample(startTime,
-                      startTime + orbit->getPeriod(),
-                      sampler);
-        sampler.insertForward(cachedOrbit);
-
-        // If the orbit cache is full, first try and eliminate some old orbits
-        if (orbitCache.size() > OrbitCacheCullThreshold)
-        {
-            // Check for old orbits at most once per frame
-            if (lastOrbitCacheFlush != frameCount)
-            {
-                for (OrbitCache::iterator iter = orbitCache.begin(); iter != orbitCache.end();)
-                {
-                    // Tricky code to eliminate a node in the orbit cache without screwing
-                    // up the iterator. Should work in all STL implementations.
-                    if (frameCount - iter->second->lastUsed() > OrbitCacheRetireAge)
-                        orbitCache.erase(iter++);
-                    else
-                        ++iter;
-                }
-                lastOrbitCacheFlush = frameCount;
-            }
-        }
-
-        orbitCache[orbit] = cachedOrbit;
-    }
-
-    if (cachedOrbit->empty())
+    CurvePlot* cachedOrbit = orbitCache->find(orbit, t, frameCount);
+    if (cachedOrbit == NULL || cachedOrbit->empty())
         return;
 
     //*** Orbit rendering parameters
@@ -1983,7 +1973,7 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
             cachedOrbit->removeSamplesBefore(cachedOrbit->startTime() * (1.0 + 1.0e-15));
 
             // Add the new samples
-            OrbitSampler sampler;
+            OrbitSampler sampler(OrbitPathCache::getSamplingTolerance(orbit));
             orbit->sample(newWindowStart, min(currentWindowStart, newWindowEnd), sampler);
             sampler.insertBackward(cachedOrbit);
 #if DEBUG_ORBIT_CACHE
@@ -1999,7 +1989,7 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
             cachedOrbit->removeSamplesAfter(cachedOrbit->endTime() * (1.0 - 1.0e-15));
 
             // Add the new samples
-            OrbitSampler sampler;
+            OrbitSampler sampler(OrbitPathCache::getSamplingTolerance(orbit));
             orbit->sample(max(currentWindowEnd, newWindowStart), newWindowEnd, sampler);
             sampler.insertForward(cachedOrbit);
 #if DEBUG_ORBIT_CACHE
@@ -2716,6 +2706,16 @@ void Renderer::render(const Observer& observer,
                       float faintestMagNight,
                       const Selection& sel)
 {
+    PROFILE_ZONE("Renderer::render");
+
+    // Start a new frame for the resource managers: textures decoded in the
+    // background are uploaded within a budget per frame, and resources that
+    // haven't been used recently are unloaded if over the memory budget.
+    UpdateResourceManagers();
+
+    frameTimings = FrameTimings();
+    StageTimer frameTimer(timer, frameTimings.total);
+
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
 
@@ -2871,6 +2871,8 @@ void Renderer::draw(const Observer& observer,
 
     if (renderFlags & ShowPlanets)
     {
+        StageTimer stageTimer(timer, frameTimings.renderLists);
+
         nearStars.clear();
         universe.getNearStars(observer.getPosition(), 1.0f, nearStars);
 
@@ -3188,6 +3190,7 @@ void Renderer::draw(const Observer& observer,
                         ShowOpenClusters)) != 0 &&
         universe.getDSOCatalog() != NULL)
     {
+        StageTimer stageTimer(timer, frameTimings.deepSkyObjects);
         renderDeepSkyObjects(universe, observer, faintestMag);
     }
 
@@ -3202,6 +3205,8 @@ void Renderer::draw(const Observer& observer,
 
     if ((renderFlags & ShowStars) != 0 && universe.getStarCatalog() != NULL)
     {
+        StageTimer stageTimer(timer, frameTimings.stars);
+
         // Disable multisample rendering when drawing point stars
         bool toggleAA = (starStyle == Renderer::PointStars && glIsEnabled(GL_MULTISAMPLE_ARB));
         if (toggleAA)
@@ -3830,6 +3835,7 @@ void Renderer::draw(const Observer& observer,
                 }
 
                 // Scan through the list of orbits and render any that overlap this interval
+                StageTimer stageTimer(timer, frameTimings.orbits);
                 for (vector<OrbitPathListEntry>::const_iterator orbitIter = orbitPathList.begin();
                      orbitIter != orbitPathList.end(); orbitIter++)
                 {
@@ -8247,7 +8253,8 @@ static float luminosityAtOpposition(float sunLuminosity,
 
 void Renderer::addRenderListEntries(RenderListEntry& rle,
                                     Body& body,
-                                    bool isLabeled)
+                                    bool isLabeled,
+                                    vector<RenderListEntry>& entries) const
 {
     bool visibleAsPoint = rle.appMag < faintestPlanetMag && body.isVisibleAsPoint();
 
@@ -8256,20 +8263,12 @@ void Renderer::addRenderListEntries(RenderListEntry& rle,
         rle.renderableType = RenderListEntry::RenderableBody;
         rle.body = &body;
 
-        if (body.getGeometry() != InvalidResource && rle.discSizeInPixels > 1)
-        {
-            Geometry* geometry = GetGeometryManager()->find(body.getGeometry());
-            if (geometry == NULL)
-                rle.isOpaque = true;
-            else
-                rle.isOpaque = geometry->isOpaque();
-        }
-        else
-        {
-            rle.isOpaque = true;
-        }
+        // Opacity of bodies with geometry is determined after the render
+        // lists have been built, since the geometry manager may only be
+        // used from the render thread.
+        rle.isOpaque = true;
         rle.radius = body.getRadius();
-        renderList.push_back(rle);
+        entries.push_back(rle);
     }
 
     if (body.getClassification() == Body::Comet && (renderFlags & ShowCometTails) != 0)
@@ -8283,7 +8282,7 @@ void Renderer::addRenderListEntries(RenderListEntry& rle,
             rle.isOpaque = false;
             rle.radius = radius;
             rle.discSizeInPixels = discSize;
-            renderList.push_back(rle);
+            entries.push_back(rle);
         }
     }
 
@@ -8299,7 +8298,7 @@ void Renderer::addRenderListEntries(RenderListEntry& rle,
             rle.refMark = rm;
             rle.isOpaque = rm->isOpaque();
             rle.radius = rm->boundingSphereRadius();
-            renderList.push_back(rle);
+            entries.push_back(rle);
         }
     }
 }
@@ -8313,15 +8312,182 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                                 const Observer& observer,
                                 double now)
 {
-    int labelClassMask = translateLabelModeToClassMask(labelMode);
+    PROFILE_ZONE("Renderer::buildRenderLists");
+
+    RenderListQuery query;
+    query.astrocentricObserverPos = astrocentricObserverPos;
+    query.viewFrustum = &viewFrustum;
+    query.viewPlaneNormal = viewPlaneNormal;
+    query.viewMatZ = observer.getOrientationf().toRotationMatrix().row(2);
+    query.labelClassMask = translateLabelModeToClassMask(labelMode);
+    query.now = now;
+
+    unsigned int firstEntry = renderList.size();
+    buildRenderLists(query, frameCenter, tree, renderList, secondaryIlluminators, threadPool);
+
+    for (vector<RenderListEntry>::iterator iter = renderList.begin() + firstEntry;
+         iter != renderList.end(); iter++)
+    {
+        if (iter->renderableType == RenderListEntry::RenderableBody &&
+            iter->body->getGeometry() != InvalidResource &&
+            iter->discSizeInPixels > 1)
+        {
+            Geometry* geometry = GetGeometryManager()->find(iter->body->getGeometry());
+            if (geometry != NULL)
+                iter->isOpaque = geometry->isOpaque();
+        }
+    }
+}
+
+
+// Smallest number of children of a frame tree evaluated by one render list
+// task; trees with fewer thread safe children are traversed serially.
+static const unsigned int MinRenderListPartChildren = 64;
+static const unsigned int RenderListPartsPerThread = 4;
+
+
+// Build the render list entries for a range of children of a frame tree,
+// running on a ThreadPool worker.
+class Renderer::RenderListTask : public ThreadTask
+{
+ public:
+    RenderListTask(const Renderer& _renderer,
+                   const RenderListQuery& _query,
+                   const Vector3d& _frameCenter,
+                   const FrameTree* _tree,
+                   unsigned int _firstChild,
+                   unsigned int _endChild,
+                   RenderListPart& _output) :
+        renderer(_renderer),
+        query(_query),
+        frameCenter(_frameCenter),
+        tree(_tree),
+        firstChild(_firstChild),
+        endChild(_endChild),
+        output(_output)
+    {
+    }
+
+    void run()
+    {
+        renderer.buildChildRenderLists(query, frameCenter, tree, firstChild, endChild,
+                                       output.renderList, output.secondaryIlluminators, NULL);
+    }
+
+ private:
+    const Renderer& renderer;
+    const RenderListQuery& query;
+    const Vector3d& frameCenter;
+    const FrameTree* tree;
+    unsigned int firstChild;
+    unsigned int endChild;
+    RenderListPart& output;
+};
+
+
+/*! Build the render lists for all children of a frame tree. If a thread
+ *  pool is given, runs of thread safe children of a large tree are split
+ *  into parts that are evaluated by the workers of the pool, while the
+ *  remaining children are evaluated on the calling thread. The parts are
+ *  appended to the render lists in the order of the children, so the lists
+ *  are the same as those built by a serial traversal.
+ */
+void Renderer::buildRenderLists(const RenderListQuery& query,
+                                const Vector3d& frameCenter,
+                                const FrameTree* tree,
+                                vector<RenderListEntry>& entries,
+                                vector<SecondaryIlluminator>& illuminators,
+                                ThreadPool* pool) const
+{
+    unsigned int nChildren = tree != NULL ? tree->childCount() : 0;
+    if (tree == NULL || pool == NULL || pool->getThreadCount() == 0 ||
+        tree->threadSafeChildCount() < 2 * MinRenderListPartChildren)
+    {
+        buildChildRenderLists(query, frameCenter, tree, 0, nChildren,
+                              entries, illuminators, pool);
+        return;
+    }
+
+    unsigned int nThreads = pool->getThreadCount() + 1;
+    unsigned int maxPartChildren = max(MinRenderListPartChildren,
+                                       nChildren / (nThreads * RenderListPartsPerThread));
+
+    // Split the children into parts: each part is either a run of thread
+    // safe children or a run of children that must be evaluated serially.
+    vector<unsigned int> partStarts;
+    vector<bool> partThreadSafe;
+    unsigned int i = 0;
+    while (i < nChildren)
+    {
+        bool threadSafe = tree->isChildThreadSafe(i);
+        unsigned int end = i + 1;
+        while (end < nChildren && tree->isChildThreadSafe(end) == threadSafe &&
+               (!threadSafe || end - i < maxPartChildren))
+        {
+            end++;
+        }
+
+        partStarts.push_back(i);
+        partThreadSafe.push_back(threadSafe);
+        i = end;
+    }
+    partStarts.push_back(nChildren);
+
+    unsigned int nParts = partThreadSafe.size();
+    vector<RenderListPart> parts(nParts);
+    for (i = 0; i < nParts; i++)
+    {
+        if (partThreadSafe[i])
+        {
+            pool->addTask(new RenderListTask(*this, query, frameCenter, tree,
+                                             partStarts[i], partStarts[i + 1], parts[i]));
+        }
+    }
+
+    for (i = 0; i < nParts; i++)
+    {
+        if (!partThreadSafe[i])
+        {
+            buildChildRenderLists(query, frameCenter, tree, partStarts[i], partStarts[i + 1],
+                                  parts[i].renderList, parts[i].secondaryIlluminators, pool);
+        }
+    }
+
+    pool->wait();
+
+    for (i = 0; i < nParts; i++)
+    {
+        entries.insert(entries.end(), parts[i].renderList.begin(), parts[i].renderList.end());
+        illuminators.insert(illuminators.end(),
+                            parts[i].secondaryIlluminators.begin(),
+                            parts[i].secondaryIlluminators.end());
+    }
+}
+
+
+/*! Add the visible objects among the children of a frame tree in the range
+ *  firstChild to endChild, and in their subtrees, to the render lists. The
+ *  subtrees are split between the workers of the thread pool if one is
+ *  given; without a pool, only state that is safe to access from several
+ *  threads at once is touched.
+ */
+void Renderer::buildChildRenderLists(const RenderListQuery& query,
+                                     const Vector3d& frameCenter,
+                                     const FrameTree* tree,
+                                     unsigned int firstChild,
+                                     unsigned int endChild,
+                                     vector<RenderListEntry>& entries,
+                                     vector<SecondaryIlluminator>& illuminators,
+                                     ThreadPool* pool) const
+{
+    const Vector3d& astrocentricObserverPos = query.astrocentricObserverPos;
+    const Vector3d& viewPlaneNormal = query.viewPlaneNormal;
+    double now = query.now;
 
-    Matrix3f viewMat = observer.getOrientationf().toRotationMatrix();
-    Vector3f viewMatZ = viewMat.row(2);
     double invCosViewAngle = 1.0 / cosViewConeAngle;
     double sinViewAngle = sqrt(1.0 - square(cosViewConeAngle));   
 
-    unsigned int nChildren = tree != NULL ? tree->childCount() : 0;
-    for (unsigned int i = 0; i < nChildren; i++)
+    for (unsigned int i = firstChild; i < endChild; i++)
     {
         const TimelinePhase* phase = tree->getChild(i);
 
@@ -8334,10 +8500,20 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
         // pos_s: sun-relative position of object
         // pos_v: viewer-relative position of object
 
-        // Get the position of the body relative to the sun.
-        Vector3d p = phase->orbit()->positionAtTime(now);
-        ReferenceFrame* frame = phase->orbitFrame();
-        Vector3d pos_s = frameCenter + frame->getOrientation(now).conjugate() * p;
+        // Get the position of the body relative to the sun, reusing the
+        // state computed at the start of the frame if there is one.
+        Vector3d pos_s;
+        if (body->hasState(now))
+        {
+            pos_s = body->getAstrocentricPosition(now);
+        }
+        else
+        {
+            Body::countOrbitEvaluation();
+            Vector3d p = phase->orbit()->positionAtTime(now);
+            ReferenceFrame* frame = phase->orbitFrame();
+            pos_s = frameCenter + frame->getOrientation(now).conjugate() * p;
+        }
 
         // We now have the positions of the observer and the planet relative
         // to the sun.  From these, compute the position of the body
@@ -8377,7 +8553,7 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                         illum.body = body;
                         illum.position_v = pos_v;
                         illum.radius = body->getRadius();
-                        secondaryIlluminators.push_back(illum);
+                        illuminators.push_back(illum);
                     }
                 }
                 else
@@ -8422,7 +8598,7 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
             }
 
             bool visibleAsPoint = appMag < faintestPlanetMag && body->isVisibleAsPoint();
-            bool isLabeled = (body->getOrbitClassification() & labelClassMask) != 0;
+            bool isLabeled = (body->getOrbitClassification() & query.labelClassMask) != 0;
             bool visible = body->isVisible();
 
             if ((discSize > 1 || visibleAsPoint || isLabeled) && visible)
@@ -8431,7 +8607,7 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
 
                 rle.position = pos_v.cast<float>();
                 rle.distance = (float) dist_v;
-                rle.centerZ = pos_v.cast<float>().dot(viewMatZ);
+                rle.centerZ = pos_v.cast<float>().dot(query.viewMatZ);
                 rle.appMag   = appMag;
                 rle.discSizeInPixels = body->getRadius() / ((float) dist_v * pixelSize);
 
@@ -8441,7 +8617,7 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                 // defined relative to the SSB.)
                 rle.sun = -pos_s.cast<float>();
 
-                addRenderListEntries(rle, *body, isLabeled);
+                addRenderListEntries(rle, *body, isLabeled, entries);
             }
         }
 
@@ -8492,7 +8668,7 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
             if (brightestPossible < faintestPlanetMag || largestPossible > 1.0f)
             {
                 // See if the object or any of its children are within the view frustum
-                if (viewFrustum.testSphere(pos_v.cast<float>(), (float) subtree->boundingSphereRadius()) != Frustum::Outside)
+                if (query.viewFrustum->testSphere(pos_v.cast<float>(), (float) subtree->boundingSphereRadius()) != Frustum::Outside)
                 {
                     traverseSubtree = true;
                 }
@@ -8519,13 +8695,7 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
 
             if (traverseSubtree)
             {
-                buildRenderLists(astrocentricObserverPos,
-                                 viewFrustum,
-                                 viewPlaneNormal,
-                                 pos_s,
-                                 subtree,
-                                 observer,
-                                 now);
+                buildRenderLists(query, pos_s, subtree, entries, illuminators, pool);
             }
         } // end subtree traverse
 
@@ -8734,6 +8904,7 @@ void Renderer::buildLabelLists(const Frustum& viewFrustum,
                         // position.
                         if (primary != lastPrimary)
                         {
+                            Body::countOrbitEvaluation();
                             Vector3d p = phase->orbitFrame()->getOrientation(now).conjugate() *
                                          phase->orbit()->positionAtTime(now);
                             Vector3d v = iter->position.cast<double>() - p;
@@ -9138,6 +9309,19 @@ void StarRenderer::process(const Star& star, float distance, float appMag)
 }
 
 
+static inline void addStarVertex(vector<PointStarVertexBuffer::StarVertex>& vertices,
+                                 const Vector3f& pos,
+                                 const Color& color,
+                                 float size)
+{
+    PointStarVertexBuffer::StarVertex v;
+    v.position = pos;
+    v.size = size;
+    color.get(v.color);
+    vertices.push_back(v);
+}
+
+
 class PointStarRenderer : public ObjectRenderer<Star, float>
 {
  public:
@@ -9145,12 +9329,24 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
 
     void process(const Star& star, float distance, float appMag);
 
+    // These must be called on the render thread after all stars have been
+    // processed.
+    void processCloseStars();
+    void submit(PointStarVertexBuffer* starVertexBuffer,
+                PointStarVertexBuffer* glareVertexBuffer,
+                vector<RenderListEntry>& renderList);
+
+ private:
+    void addStar(const Star& star,
+                 const Vector3f& relPos,
+                 float distance,
+                 float appMag,
+                 float discSizeInPixels);
+
  public:
     Vector3d obsPos;
 
-    vector<RenderListEntry>*         renderList;
-    PointStarVertexBuffer* starVertexBuffer;
-    PointStarVertexBuffer* glareVertexBuffer;
+    PointStarRendererOutput* output;
 
     const StarDatabase* starDB;
 
@@ -9176,7 +9372,7 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
 
 PointStarRenderer::PointStarRenderer() :
     ObjectRenderer<Star, float>(STAR_DISTANCE_LIMIT),
-    starVertexBuffer     (NULL),
+    output               (NULL),
     useScaledDiscs       (false),
     maxDiscSize          (1.0f),
     cosFOV               (1.0f),
@@ -9209,20 +9405,33 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
     // cost of a normalize per star.
     if (relPos.dot(viewNormal) > 0.0f || relPos.x() * relPos.x() < 0.1f || hasOrbit)
     {
-#ifdef HDR_COMPRESS
-        Color starColorFull = colorTemp->lookupColor(star.getTemperature());
-        Color starColor(starColorFull.red()   * 0.5f,
-                        starColorFull.green() * 0.5f,
-                        starColorFull.blue()  * 0.5f);
-#else
-        Color starColor = colorTemp->lookupColor(star.getTemperature());
-#endif
-        float discSizeInPixels = 0.0f;
         float orbitSizeInPixels = 0.0f;
 
         if (hasOrbit)
             orbitSizeInPixels = orbitalRadius / (distance * pixelSize);
 
+        // Stars less than one light year away, or with large orbits, are
+        // positioned by evaluating their orbits. That isn't safe to do on
+        // a worker thread, so they're left for processCloseStars().
+        if (distance < 1.0f || orbitSizeInPixels > 1.0f)
+        {
+            PointStarRendererOutput::CloseStar closeStar = { &star, distance, appMag };
+            output->closeStars.push_back(closeStar);
+            return;
+        }
+
+        addStar(star, relPos, distance, appMag, 0.0f);
+    }
+}
+
+
+void PointStarRenderer::processCloseStars()
+{
+    for (vector<PointStarRendererOutput::CloseStar>::const_iterator iter = output->closeStars.begin();
+         iter != output->closeStars.end(); iter++)
+    {
+        const Star& star = *iter->star;
+
         // Special handling for stars less than one light year away . . .
         // We can't just go ahead and render a nearby star in the usual way
         // for two reasons:
@@ -9233,135 +9442,218 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
         // further than one light year away if the star is huge, the fov is
         // very small and the resolution is high.  We'll ignore this for now
         // and use the most inexpensive test possible . . .
-        if (distance < 1.0f || orbitSizeInPixels > 1.0f)
-        {
-            // Compute the position of the observer relative to the star.
-            // This is a much more accurate (and expensive) distance
-            // calculation than the previous one which used the observer's
-            // position rounded off to floats.
-            Vector3d hPos = astrocentricPosition(observer->getPosition(),
-                                                 star,
-                                                 observer->getTime());
-            relPos = hPos.cast<float>() * -astro::kilometersToLightYears(1.0f),
-            distance = relPos.norm();
 
-            // Recompute apparent magnitude using new distance computation
-            appMag = astro::absToAppMag(star.getAbsoluteMagnitude(), distance);
+        // Compute the position of the observer relative to the star.
+        // This is a much more accurate (and expensive) distance
+        // calculation than the previous one which used the observer's
+        // position rounded off to floats.
+        Vector3d hPos = astrocentricPosition(observer->getPosition(),
+                                             star,
+                                             observer->getTime());
+        Vector3f relPos = hPos.cast<float>() * -astro::kilometersToLightYears(1.0f);
+        float distance = relPos.norm();
 
-            float f        = RenderDistance / distance;
-            starPos        = obsPos.cast<float>() + relPos * f;
+        // Recompute apparent magnitude using new distance computation
+        float appMag = astro::absToAppMag(star.getAbsoluteMagnitude(), distance);
 
-            float radius = star.getRadius();
-            discSizeInPixels = radius / astro::lightYearsToKilometers(distance) / pixelSize;
-            ++nClose;
-        }
+        float radius = star.getRadius();
+        float discSizeInPixels = radius / astro::lightYearsToKilometers(distance) / pixelSize;
+        ++nClose;
 
-        // Place labels for stars brighter than the specified label threshold brightness
-        if ((labelMode & Renderer::StarLabels) && appMag < labelThresholdMag)
+        addStar(star, relPos, distance, appMag, discSizeInPixels);
+    }
+}
+
+
+void PointStarRenderer::addStar(const Star& star,
+                                const Vector3f& relPos,
+                                float distance,
+                                float appMag,
+                                float discSizeInPixels)
+{
+#ifdef HDR_COMPRESS
+    Color starColorFull = colorTemp->lookupColor(star.getTemperature());
+    Color starColor(starColorFull.red()   * 0.5f,
+                    starColorFull.green() * 0.5f,
+                    starColorFull.blue()  * 0.5f);
+#else
+    Color starColor = colorTemp->lookupColor(star.getTemperature());
+#endif
+
+    // Place labels for stars brighter than the specified label threshold brightness
+    if ((labelMode & Renderer::StarLabels) && appMag < labelThresholdMag)
+    {
+        Vector3f starDir = relPos;
+        starDir.normalize();
+        if (starDir.dot(viewNormal) > cosFOV)
         {
-            Vector3f starDir = relPos;
-            starDir.normalize();
-            if (starDir.dot(viewNormal) > cosFOV)
-            {
-                char nameBuffer[Renderer::MaxLabelLength];
-                starDB->getStarName(star, nameBuffer, sizeof(nameBuffer), true);
-                float distr = 3.5f * (labelThresholdMag - appMag)/labelThresholdMag;
-                if (distr > 1.0f)
-                    distr = 1.0f;
-                renderer->addBackgroundAnnotation(NULL, nameBuffer,
-                                                  Color(Renderer::StarLabelColor, distr * Renderer::StarLabelColor.alpha()),
-                                                  relPos);
-                nLabelled++;
-            }
+            char nameBuffer[Renderer::MaxLabelLength];
+            starDB->getStarName(star, nameBuffer, sizeof(nameBuffer), true);
+            float distr = 3.5f * (labelThresholdMag - appMag)/labelThresholdMag;
+            if (distr > 1.0f)
+                distr = 1.0f;
+
+            PointStarRendererOutput::Label label;
+            label.position = relPos;
+            label.color = Color(Renderer::StarLabelColor, distr * Renderer::StarLabelColor.alpha());
+            label.text = nameBuffer;
+            output->labels.push_back(label);
+            nLabelled++;
         }
+    }
 
-        // Stars closer than the maximum solar system size are actually
-        // added to the render list and depth sorted, since they may occlude
-        // planets.
-        if (distance > MaxSolarSystemSize)
-        {
+    // Stars closer than the maximum solar system size are actually
+    // added to the render list and depth sorted, since they may occlude
+    // planets.
+    if (distance > MaxSolarSystemSize)
+    {
 #ifdef USE_HDR
-            float satPoint = saturationMag;
-            float alpha = exposure*(faintestMag - appMag)/(faintestMag - saturationMag + 0.001f);
+        float satPoint = saturationMag;
+        float alpha = exposure*(faintestMag - appMag)/(faintestMag - saturationMag + 0.001f);
 #else
-            float satPoint = faintestMag - (1.0f - brightnessBias) / brightnessScale; // TODO: precompute this value
-            float alpha = (faintestMag - appMag) * brightnessScale + brightnessBias;
+        float satPoint = faintestMag - (1.0f - brightnessBias) / brightnessScale; // TODO: precompute this value
+        float alpha = (faintestMag - appMag) * brightnessScale + brightnessBias;
 #endif
 #ifdef DEBUG_HDR_ADAPT
-            minMag = max(minMag, appMag);
-            maxMag = min(maxMag, appMag);
-            minAlpha = min(minAlpha, alpha);
-            maxAlpha = max(maxAlpha, alpha);
-            ++total;
-            if (alpha > above)
-            {
-                ++countAboveN;
-            }
+        minMag = max(minMag, appMag);
+        maxMag = min(maxMag, appMag);
+        minAlpha = min(minAlpha, alpha);
+        maxAlpha = max(maxAlpha, alpha);
+        ++total;
+        if (alpha > above)
+        {
+            ++countAboveN;
+        }
 #endif
 
-            if (useScaledDiscs)
+        if (useScaledDiscs)
+        {
+            float discSize = size;
+            if (alpha < 0.0f)
             {
-                float discSize = size;
-                if (alpha < 0.0f)
-                {
-                    alpha = 0.0f;
-                }
-                else if (alpha > 1.0f)
-                {
-                    float discScale = min(MaxScaledDiscStarSize, (float) pow(2.0f, 0.3f * (satPoint - appMag)));
-                    discSize *= discScale;
+                alpha = 0.0f;
+            }
+            else if (alpha > 1.0f)
+            {
+                float discScale = min(MaxScaledDiscStarSize, (float) pow(2.0f, 0.3f * (satPoint - appMag)));
+                discSize *= discScale;
 
-                    float glareAlpha = min(0.5f, discScale / 4.0f);
-                    glareVertexBuffer->addStar(relPos, Color(starColor, glareAlpha), discSize * 3.0f);
+                float glareAlpha = min(0.5f, discScale / 4.0f);
+                addStarVertex(output->glare, relPos, Color(starColor, glareAlpha), discSize * 3.0f);
 
-                    alpha = 1.0f;
-                }
-                starVertexBuffer->addStar(relPos, Color(starColor, alpha), discSize);
+                alpha = 1.0f;
             }
-            else
+            addStarVertex(output->stars, relPos, Color(starColor, alpha), discSize);
+        }
+        else
+        {
+            if (alpha < 0.0f)
             {
-                if (alpha < 0.0f)
-                {
-                    alpha = 0.0f;
-                }
-                else if (alpha > 1.0f)
-                {
-                    float discScale = min(100.0f, satPoint - appMag + 2.0f);
-                    float glareAlpha = min(GlareOpacity, (discScale - 2.0f) / 4.0f);
-                    glareVertexBuffer->addStar(relPos, Color(starColor, glareAlpha), 2.0f * discScale * size);
+                alpha = 0.0f;
+            }
+            else if (alpha > 1.0f)
+            {
+                float discScale = min(100.0f, satPoint - appMag + 2.0f);
+                float glareAlpha = min(GlareOpacity, (discScale - 2.0f) / 4.0f);
+                addStarVertex(output->glare, relPos, Color(starColor, glareAlpha), 2.0f * discScale * size);
 #ifdef DEBUG_HDR_ADAPT
-                    maxSize = max(maxSize, 2.0f * discScale * size);
+                maxSize = max(maxSize, 2.0f * discScale * size);
 #endif
-                }
-                starVertexBuffer->addStar(relPos, Color(starColor, alpha), size);
             }
-
-            ++nRendered;
+            addStarVertex(output->stars, relPos, Color(starColor, alpha), size);
         }
-        else
+
+        ++nRendered;
+    }
+    else
+    {
+        Matrix3f viewMat = observer->getOrientationf().toRotationMatrix();
+        Vector3f viewMatZ = viewMat.row(2);
+
+        RenderListEntry rle;
+        rle.renderableType = RenderListEntry::RenderableStar;
+        rle.star = &star;
+
+        // Objects in the render list are always rendered relative to
+        // a viewer at the origin--this is different than for distant
+        // stars.
+        float scale = astro::lightYearsToKilometers(1.0f);
+        rle.position = relPos * scale;
+        rle.centerZ = rle.position.dot(viewMatZ);
+        rle.distance = rle.position.norm();
+        rle.radius = star.getRadius();
+        rle.discSizeInPixels = discSizeInPixels;
+        rle.appMag = appMag;
+        rle.isOpaque = true;
+        output->renderList.push_back(rle);
+    }
+}
+
+
+void PointStarRenderer::submit(PointStarVertexBuffer* starVertexBuffer,
+                               PointStarVertexBuffer* glareVertexBuffer,
+                               vector<RenderListEntry>& renderList)
+{
+    starVertexBuffer->addStars(output->stars);
+    glareVertexBuffer->addStars(output->glare);
+    renderList.insert(renderList.end(), output->renderList.begin(), output->renderList.end());
+
+    for (vector<PointStarRendererOutput::Label>::const_iterator iter = output->labels.begin();
+         iter != output->labels.end(); iter++)
+    {
+        renderer->addBackgroundAnnotation(NULL, iter->text, iter->color, iter->position);
+    }
+}
+
+
+// PointStarRendererSet divides the work of a PointStarRenderer between the
+// parts of a star query that is run on a thread pool. Each part gets a copy
+// of the renderer and its own output; the outputs are submitted in part
+// order, so the result is the same as a serial query.
+class PointStarRendererSet : public ParallelStarHandler
+{
+ public:
+    PointStarRendererSet(const PointStarRenderer& _prototype,
+                         vector<PointStarRendererOutput*>& _outputs) :
+        prototype(_prototype),
+        outputs(_outputs)
+    {
+    }
+
+    void setPartCount(unsigned int nParts)
+    {
+        while (outputs.size() < nParts)
+            outputs.push_back(new PointStarRendererOutput());
+
+        parts.assign(nParts, prototype);
+        for (unsigned int i = 0; i < nParts; i++)
         {
-            Matrix3f viewMat = observer->getOrientationf().toRotationMatrix();
-            Vector3f viewMatZ = viewMat.row(2);
+            outputs[i]->clear();
+            parts[i].output = outputs[i];
+        }
+    }
 
-            RenderListEntry rle;
-            rle.renderableType = RenderListEntry::RenderableStar;
-            rle.star = &star;
+    StarHandler& getPartHandler(unsigned int part)
+    {
+        return parts[part];
+    }
 
-            // Objects in the render list are always rendered relative to
-            // a viewer at the origin--this is different than for distant
-            // stars.
-            float scale = astro::lightYearsToKilometers(1.0f);
-            rle.position = relPos * scale;
-            rle.centerZ = rle.position.dot(viewMatZ);
-            rle.distance = rle.position.norm();
-            rle.radius = star.getRadius();
-            rle.discSizeInPixels = discSizeInPixels;
-            rle.appMag = appMag;
-            rle.isOpaque = true;
-            renderList->insert(renderList->end(), rle);
+    void submit(PointStarVertexBuffer* starVertexBuffer,
+                PointStarVertexBuffer* glareVertexBuffer,
+                vector<RenderListEntry>& renderList)
+    {
+        for (vector<PointStarRenderer>::iterator iter = parts.begin(); iter != parts.end(); iter++)
+        {
+            iter->processCloseStars();
+            iter->submit(starVertexBuffer, glareVertexBuffer, renderList);
         }
     }
-}
+
+ private:
+    const PointStarRenderer& prototype;
+    vector<PointStarRendererOutput*>& outputs;
+    vector<PointStarRenderer> parts;
+};
 
 
 // Calculate the maximum field of view (from top left corner to bottom right) of
@@ -9379,6 +9671,8 @@ void Renderer::renderStars(const StarDatabase& starDB,
                            float faintestMagNight,
                            const Observer& observer)
 {
+    PROFILE_ZONE("Renderer::renderStars");
+
     StarRenderer starRenderer;
     Vector3d obsPos = observer.getPosition().toLy();
 
@@ -9466,12 +9760,16 @@ void Renderer::renderStars(const StarDatabase& starDB,
         // Use quad primitives
         starRenderer.starVertexBuffer->start();
     }
-    starDB.findVisibleStars(starRenderer,
-                            obsPos.cast<float>(),
-                            observer.getOrientationf(),
-                            degToRad(fov),
-                            (float) windowWidth / (float) windowHeight,
-                            faintestMagNight);
+
+    {
+        StageTimer stageTimer(timer, frameTimings.starCulling);
+        starDB.findVisibleStars(starRenderer,
+                                obsPos.cast<float>(),
+                                observer.getOrientationf(),
+                                degToRad(fov),
+                                (float) windowWidth / (float) windowHeight,
+                                faintestMagNight);
+    }
 #ifdef DEBUG_HDR_ADAPT
   HDR_LOG <<
       "* minMag = "    << starRenderer.minMag << ", " <<
@@ -9494,6 +9792,8 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
                                 float faintestMagNight,
                                 const Observer& observer)
 {
+    PROFILE_ZONE("Renderer::renderPointStars");
+
     Vector3d obsPos = observer.getPosition().toLy();
 
     PointStarRenderer starRenderer;
@@ -9503,9 +9803,6 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
     starRenderer.observer          = &observer;
     starRenderer.obsPos            = obsPos;
     starRenderer.viewNormal        = observer.getOrientationf().conjugate() * -Vector3f::UnitZ();
-    starRenderer.renderList        = &renderList;
-    starRenderer.starVertexBuffer  = pointStarVertexBuffer;
-    starRenderer.glareVertexBuffer = glareVertexBuffer;
     starRenderer.fov               = fov;
     starRenderer.cosFOV            = (float) cos(degToRad(calcMaxFOV(fov, (float) windowWidth / (float) windowHeight)) / 2.0f);
 
@@ -9551,26 +9848,35 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
 
     glEnable(GL_TEXTURE_2D);
     gaussianDiscTex->bind();
-    starRenderer.starVertexBuffer->setTexture(gaussianDiscTex);
-    starRenderer.glareVertexBuffer->setTexture(gaussianGlareTex);
+    pointStarVertexBuffer->setTexture(gaussianDiscTex);
+    glareVertexBuffer->setTexture(gaussianGlareTex);
 
-    starRenderer.glareVertexBuffer->startSprites(*context);
+    // Cull the stars on the worker threads first; they only fill staging
+    // buffers, which are copied into the vertex buffers below.
+    PointStarRendererSet starRenderers(starRenderer, pointStarOutputs);
+    {
+        StageTimer stageTimer(timer, frameTimings.starCulling);
+        starDB.findVisibleStars(starRenderers,
+                                obsPos.cast<float>(),
+                                observer.getOrientationf(),
+                                degToRad(fov),
+                                (float) windowWidth / (float) windowHeight,
+                                faintestMagNight,
+                                threadPool);
+    }
+
+    glareVertexBuffer->startSprites(*context);
     if (starStyle == PointStars)
-        starRenderer.starVertexBuffer->startPoints(*context);
+        pointStarVertexBuffer->startPoints(*context);
     else
-        starRenderer.starVertexBuffer->startSprites(*context);
+        pointStarVertexBuffer->startSprites(*context);
 
-    starDB.findVisibleStars(starRenderer,
-                            obsPos.cast<float>(),
-                            observer.getOrientationf(),
-                            degToRad(fov),
-                            (float) windowWidth / (float) windowHeight,
-                            faintestMagNight);
+    starRenderers.submit(pointStarVertexBuffer, glareVertexBuffer, renderList);
 
-    starRenderer.starVertexBuffer->render();
-    starRenderer.glareVertexBuffer->render();
-    starRenderer.starVertexBuffer->finish();
-    starRenderer.glareVertexBuffer->finish();
+    pointStarVertexBuffer->render();
+    glareVertexBuffer->render();
+    pointStarVertexBuffer->finish();
+    glareVertexBuffer->finish();
 }
 
 
@@ -9784,6 +10090,8 @@ void Renderer::renderDeepSkyObjects(const Universe&  universe,
                                     const Observer& observer,
                                     const float     faintestMagNight)
 {
+    PROFILE_ZONE("Renderer::renderDeepSkyObjects");
+
     DSORenderer dsoRenderer;
 
     Vector3d obsPos    = observer.getPosition().toLy();
@@ -10030,6 +10338,8 @@ void Renderer::renderSelectionPointer(const Observer& observer,
 void Renderer::labelConstellations(const AsterismList& asterisms,
                                    const Observer& observer)
 {
+    PROFILE_ZONE("Renderer::labelConstellations");
+    StageTimer stageTimer(timer, frameTimings.labels);
     Vector3f observerPos = observer.getPosition().toLy().cast<float>();
 
     for (AsterismList::const_iterator iter = asterisms.begin();
@@ -10161,6 +10471,9 @@ static void renderCrosshair(float pixelSize, double tsec)
 
 void Renderer::renderAnnotations(const vector<Annotation>& annotations, FontStyle fs)
 {
+    PROFILE_ZONE("Renderer::renderAnnotations");
+    StageTimer stageTimer(timer, frameTimings.labels);
+
     if (font[fs] == NULL)
         return;
 
@@ -10304,6 +10617,9 @@ Renderer::renderSortedAnnotations(vector<Annotation>::iterator iter,
                                   float farDist,
                                   FontStyle fs)
 {
+    PROFILE_ZONE("Renderer::renderSortedAnnotations");
+    StageTimer stageTimer(timer, frameTimings.labels);
+
     if (font[fs] == NULL)
         return iter;
 
@@ -10393,6 +10709,9 @@ Renderer::renderAnnotations(vector<Annotation>::iterator startIter,
                             float farDist,
                             FontStyle fs)
 {
+    PROFILE_ZONE("Renderer::renderAnnotations");
+    StageTimer stageTimer(timer, frameTimings.labels);
+
     if (font[fs] == NULL)
         return endIter;
 
@@ -10605,7 +10924,7 @@ void Renderer::loadTextures(Body* body)
 
 void Renderer::invalidateOrbitCache()
 {
-    orbitCache.clear();
+    orbitCache->invalidate();
 }
 
 
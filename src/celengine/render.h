@@ -29,7 +29,7 @@
 class RendererWatcher;
 class FrameTree;
 class ReferenceMark;
-class CurvePlot;
+class OrbitPathCache;
 
 struct LightSource
 {
@@ -84,6 +84,9 @@ struct SecondaryIlluminator
 
 class StarVertexBuffer;
 class PointStarVertexBuffer;
+struct PointStarRendererOutput;
+class ThreadPool;
+class Timer;
 
 class Renderer
 {
@@ -100,6 +103,9 @@ class Renderer
         unsigned int orbitPathSamplePoints;
         unsigned int shadowTextureSize;
         unsigned int eclipseTextureSize;
+        // Limit on the memory used by cached orbit paths, in bytes
+        unsigned int orbitCacheMemory;
+        bool backgroundOrbitSampling;
     };
 
     bool init(GLContext*, int, int, DetailOptions&);
@@ -333,6 +339,23 @@ class Renderer
     void removeWatcher(RendererWatcher*);
     void notifyWatchers() const;
 
+    // CPU time spent in the stages of drawing the last frame, in seconds.
+    // The stages don't cover all of the frame, and star culling is part of
+    // the time for stars. Building render lists includes orbit and label
+    // lists; labels include markers and other annotations.
+    struct FrameTimings
+    {
+        double total;
+        double renderLists;
+        double starCulling;
+        double stars;
+        double deepSkyObjects;
+        double orbits;
+        double labels;
+    };
+
+    const FrameTimings& getFrameTimings() const { return frameTimings; }
+
  public:
     // Internal types
     // TODO: Figure out how to make these private.  Even with a friend
@@ -425,6 +448,27 @@ class Renderer
         float farZ;
     };
 
+    // The view parameters shared by every part of a render list traversal
+    struct RenderListQuery
+    {
+        Eigen::Vector3d astrocentricObserverPos;
+        const Frustum* viewFrustum;
+        Eigen::Vector3d viewPlaneNormal;
+        Eigen::Vector3f viewMatZ;
+        int labelClassMask;
+        double now;
+    };
+
+    // The objects found in a range of children of a frame tree
+    struct RenderListPart
+    {
+        std::vector<RenderListEntry> renderList;
+        std::vector<SecondaryIlluminator> secondaryIlluminators;
+    };
+
+    class RenderListTask;
+    friend class RenderListTask;
+
  private:
     void setFieldOfView(float);
     void renderStars(const StarDatabase& starDB,
@@ -449,6 +493,20 @@ class Renderer
                           const FrameTree* tree,
                           const Observer& observer,
                           double now);
+    void buildRenderLists(const RenderListQuery& query,
+                          const Eigen::Vector3d& frameCenter,
+                          const FrameTree* tree,
+                          std::vector<RenderListEntry>& entries,
+                          std::vector<SecondaryIlluminator>& illuminators,
+                          ThreadPool* pool) const;
+    void buildChildRenderLists(const RenderListQuery& query,
+                               const Eigen::Vector3d& frameCenter,
+                               const FrameTree* tree,
+                               unsigned int firstChild,
+                               unsigned int endChild,
+                               std::vector<RenderListEntry>& entries,
+                               std::vector<SecondaryIlluminator>& illuminators,
+                               ThreadPool* pool) const;
     void buildOrbitLists(const Eigen::Vector3d& astrocentricObserverPos,
                          const Eigen::Quaterniond& observerOrientation,
                          const Frustum& viewFrustum,
@@ -459,7 +517,8 @@ class Renderer
 
     void addRenderListEntries(RenderListEntry& rle,
                               Body& body,
-                              bool isLabeled);
+                              bool isLabeled,
+                              std::vector<RenderListEntry>& entries) const;
 
     void addStarOrbitToRenderList(const Star& star,
                                   const Observer& observer,
@@ -653,6 +712,9 @@ class Renderer
     StarVertexBuffer* starVertexBuffer;
     PointStarVertexBuffer* pointStarVertexBuffer;
 	PointStarVertexBuffer* glareVertexBuffer;
+    // Staging buffers for the stars culled by each thread
+    std::vector<PointStarRendererOutput*> pointStarOutputs;
+    ThreadPool* threadPool;
     std::vector<RenderListEntry> renderList;
     std::vector<SecondaryIlluminator> secondaryIlluminators;
     std::vector<DepthBufferPartition> depthPartitions;
@@ -682,6 +744,9 @@ class Renderer
 
     uint32 frameCount;
 
+    Timer* timer;
+    FrameTimings frameTimings;
+
     int currentIntervalIndex;
 
 
@@ -711,9 +776,7 @@ class Renderer
 #endif
 
  private:
-    typedef std::map<const Orbit*, CurvePlot*> OrbitCache;
-    OrbitCache orbitCache;
-    uint32 lastOrbitCacheFlush;
+    OrbitPathCache* orbitCache;
 
     float minOrbitSize;
     float distanceLimit;
@@ -23,7 +23,7 @@ static RotationModelManager* rotationModelManager = NULL;
 RotationModelManager* GetRotationModelManager()
 {
     if (rotationModelManager == NULL)
-        rotationModelManager = new RotationModelManager("data");
+        rotationModelManager = new RotationModelManager("data", "rotations");
     return rotationModelManager;
 }
 
@@ -13,6 +13,8 @@
 #include <algorithm>
 #include "render.h"
 #include "simulation.h"
+#include "frametree.h"
+#include <celutil/profiler.h>
 
 using namespace Eigen;
 using namespace std;
@@ -126,6 +128,8 @@ double Simulation::getArrivalTime() const
 // Tick the simulation by dt seconds
 void Simulation::update(double dt)
 {
+    PROFILE_ZONE("Simulation::update");
+
     realTime += dt;
 
     for (vector<Observer*>::iterator iter = observers.begin();
@@ -136,6 +140,30 @@ void Simulation::update(double dt)
 
     // Find the closest solar system
     closestSolarSystem = universe->getNearestSolarSystem(activeObserver->getPosition());
+
+    updateBodyStates();
+}
+
+
+// Save the states of all bodies in the solar systems near the active
+// observer at the current time. The renderer, picking, and everything else
+// that needs their positions and orientations during this frame then
+// reuse them instead of evaluating orbits and rotation models again.
+void Simulation::updateBodyStates()
+{
+    PROFILE_ZONE("Simulation::updateBodyStates");
+
+    double t = activeObserver->getTime();
+
+    nearStars.clear();
+    universe->getNearStars(activeObserver->getPosition(), 1.0f, nearStars);
+    for (vector<const Star*>::const_iterator iter = nearStars.begin();
+         iter != nearStars.end(); iter++)
+    {
+        SolarSystem* solarSystem = universe->getSolarSystem(*iter);
+        if (solarSystem != NULL && solarSystem->getFrameTree() != NULL)
+            solarSystem->getFrameTree()->updateStates(t, Vector3d::Zero());
+    }
 }
 
 
@@ -456,7 +484,8 @@ Selection Simulation::findObjectFromPath(string s, bool i18n)
 }
 
 
-vector<std::string> Simulation::getObjectCompletion(string s, bool withLocations)
+vector<std::string> Simulation::getObjectCompletion(string s, bool withLocations,
+                                                    unsigned int maxCompletions)
 {
     Selection path[2];
     int nPathEntries = 0;
@@ -478,7 +507,7 @@ vector<std::string> Simulation::getObjectCompletion(string s, bool withLocations
         path[nPathEntries++] = Selection(closestSolarSystem->getStar());
     }
 
-    return universe->getCompletionPath(s, path, nPathEntries, withLocations);
+    return universe->getCompletionPath(s, path, nPathEntries, withLocations, maxCompletions);
 }
 
 
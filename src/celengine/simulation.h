@@ -61,7 +61,8 @@ class Simulation
     void selectPlanet(int);
     Selection findObject(std::string s, bool i18n = false);
     Selection findObjectFromPath(std::string s, bool i18n = false);
-    std::vector<std::string> getObjectCompletion(std::string s, bool withLocations = false);
+    std::vector<std::string> getObjectCompletion(std::string s, bool withLocations = false,
+                                                 unsigned int maxCompletions = 0);
     void gotoSelection(double gotoTime,
                        const Eigen::Vector3f& up, 
                        ObserverFrame::CoordinateSystem upFrame);
@@ -119,6 +120,7 @@ class Simulation
 
  private:
     SolarSystem* getSolarSystem(const Star* star);
+    void updateBodyStates();
 
  private:
     double realTime;
@@ -136,6 +138,8 @@ class Simulation
 
     float faintestVisible;
     bool pauseState;
+
+    std::vector<const Star*> nearStars;
 };
 
 #endif // _CELENGINE_SIMULATION_H_
@@ -25,6 +25,7 @@
 #include <celutil/util.h>
 #include <cstdio>
 #include <limits>
+#include <sstream>
 #include "astro.h"
 #include "parser.h"
 #include "texmanager.h"
@@ -91,16 +92,17 @@ enum BodyType
   The name and parent name are both mandatory.
 */
 
-static void errorMessagePrelude(const Tokenizer& tok)
+static void errorMessagePrelude(ostream& out, int lineNumber)
 {
-    cerr << _("Error in .ssc file (line ") << tok.getLineNumber() << "): ";
+    out << _("Error in .ssc file (line ") << lineNumber << "): ";
 }
 
-static void sscError(const Tokenizer& tok,
+static void sscError(ostream& out,
+                     int lineNumber,
                      const string& msg)
 {
-    errorMessagePrelude(tok);
-    cerr << msg << '\n';
+    errorMessagePrelude(out, lineNumber);
+    out << msg << '\n';
 }
 
 
@@ -1088,13 +1090,50 @@ static Body* CreateReferencePoint(const string& name,
 }
 
 
-bool LoadSolarSystemObjects(istream& in,
-                            Universe& universe,
-                            const std::string& directory)
+struct SolarSystemCatalogFile::Entry
+{
+    Disposition disposition;
+    string itemType;
+    string nameList;
+    string parentName;
+    Value* objectDataValue;
+    int lineNumber;
+};
+
+
+SolarSystemCatalogFile::SolarSystemCatalogFile() :
+    complete(false)
+{
+}
+
+
+SolarSystemCatalogFile::~SolarSystemCatalogFile()
+{
+    clear();
+}
+
+
+void SolarSystemCatalogFile::clear()
+{
+    for (vector<Entry*>::iterator iter = entries.begin(); iter != entries.end(); iter++)
+    {
+        delete *iter;
+    }
+    entries.clear();
+    values.clear();
+    errors.clear();
+    complete = false;
+}
+
+
+bool SolarSystemCatalogFile::read(istream& in)
 {
+    ostringstream errorStream;
     Tokenizer tokenizer(&in);
-    Parser parser(&tokenizer);
+    tokenizer.setErrorStream(&errorStream);
+    Parser parser(&tokenizer, &values);
 
+    complete = false;
     while (tokenizer.nextToken() != Tokenizer::TokenEnd)
     {
         // Read the disposition; if none is specified, the default is Add.
@@ -1128,7 +1167,8 @@ bool LoadSolarSystemObjects(istream& in,
 
         if (tokenizer.getTokenType() != Tokenizer::TokenString)
         {
-            sscError(tokenizer, "object name expected");
+            sscError(errorStream, tokenizer.getLineNumber(), "object name expected");
+            errors = errorStream.str();
             return false;
         }
         
@@ -1138,7 +1178,8 @@ bool LoadSolarSystemObjects(istream& in,
 
         if (tokenizer.nextToken() != Tokenizer::TokenString)
         {
-            sscError(tokenizer, "bad parent object name");
+            sscError(errorStream, tokenizer.getLineNumber(), "bad parent object name");
+            errors = errorStream.str();
             return false;
         }
         string parentName = tokenizer.getStringValue().c_str();
@@ -1146,17 +1187,119 @@ bool LoadSolarSystemObjects(istream& in,
         Value* objectDataValue = parser.readValue();
         if (objectDataValue == NULL)
         {
-            sscError(tokenizer, "bad object definition");
+            sscError(errorStream, tokenizer.getLineNumber(), "bad object definition");
+            errors = errorStream.str();
             return false;
         }
 
         if (objectDataValue->getType() != Value::HashType)
         {
-            sscError(tokenizer, "{ expected");
-            delete objectDataValue;
+            sscError(errorStream, tokenizer.getLineNumber(), "{ expected");
+            errors = errorStream.str();
             return false;
         }
-        Hash* objectData = objectDataValue->getHash();
+
+        Entry* entry = new Entry();
+        entry->disposition = disposition;
+        entry->itemType = itemType;
+        entry->nameList = nameList;
+        entry->parentName = parentName;
+        entry->objectDataValue = objectDataValue;
+        entry->lineNumber = tokenizer.getLineNumber();
+        entries.push_back(entry);
+    }
+
+    errors = errorStream.str();
+    complete = true;
+
+    return true;
+}
+
+
+// Only completely read files are cached, so the errors and completion
+// state don't need to be stored.
+void SolarSystemCatalogFile::writeCache(CatalogCacheWriter& writer) const
+{
+    writer.writeCount((uint32) entries.size());
+    for (vector<Entry*>::const_iterator iter = entries.begin(); iter != entries.end(); iter++)
+    {
+        const Entry* entry = *iter;
+        writer.writeCount((uint32) entry->disposition);
+        writer.writeString(entry->itemType);
+        writer.writeString(entry->nameList);
+        writer.writeString(entry->parentName);
+        writer.writeCount((uint32) entry->lineNumber);
+        writer.writeValue(entry->objectDataValue);
+    }
+}
+
+
+bool SolarSystemCatalogFile::readCache(CatalogCacheReader& reader)
+{
+    uint32 count = 0;
+    if (!reader.readCount(count))
+        return false;
+
+    for (uint32 i = 0; i < count; i++)
+    {
+        Entry* entry = new Entry();
+        entries.push_back(entry);
+
+        uint32 disposition = 0;
+        uint32 lineNumber = 0;
+        if (!reader.readCount(disposition) ||
+            disposition > (uint32) ModifyObject ||
+            !reader.readString(entry->itemType) ||
+            !reader.readString(entry->nameList) ||
+            !reader.readString(entry->parentName) ||
+            !reader.readCount(lineNumber))
+        {
+            clear();
+            return false;
+        }
+        entry->disposition = (Disposition) disposition;
+        entry->lineNumber = (int) lineNumber;
+
+        entry->objectDataValue = reader.readValue(values);
+        if (entry->objectDataValue == NULL ||
+            entry->objectDataValue->getType() != Value::HashType)
+        {
+            clear();
+            return false;
+        }
+    }
+
+    complete = true;
+
+    return true;
+}
+
+
+bool LoadSolarSystemObjects(istream& in,
+                            Universe& universe,
+                            const std::string& directory)
+{
+    SolarSystemCatalogFile catalogFile;
+    catalogFile.read(in);
+
+    return LoadSolarSystemObjects(catalogFile, universe, directory);
+}
+
+
+bool LoadSolarSystemObjects(const SolarSystemCatalogFile& catalogFile,
+                            Universe& universe,
+                            const std::string& directory)
+{
+    for (vector<SolarSystemCatalogFile::Entry*>::const_iterator iter = catalogFile.entries.begin();
+         iter != catalogFile.entries.end(); iter++)
+    {
+        const SolarSystemCatalogFile::Entry* entry = *iter;
+        Disposition disposition = entry->disposition;
+        const string& itemType = entry->itemType;
+        const string& nameList = entry->nameList;
+        const string& parentName = entry->parentName;
+        int lineNumber = entry->lineNumber;
+        Hash* objectData = entry->objectDataValue->getHash();
 
         Selection parent = universe.findPath(parentName, NULL, 0);
         PlanetarySystem* parentSystem = NULL;
@@ -1223,7 +1366,7 @@ bool LoadSolarSystemObjects(istream& in,
             }
             else
             {
-                errorMessagePrelude(tokenizer);
+                errorMessagePrelude(cerr, lineNumber);
                 cerr << _("parent body '") << parentName << _("' of '") << primaryName << _("' not found.") << endl;
             }
 
@@ -1234,7 +1377,7 @@ bool LoadSolarSystemObjects(istream& in,
                 {
                     if (disposition == AddObject)
                     {
-                        errorMessagePrelude(tokenizer);
+                        errorMessagePrelude(cerr, lineNumber);
                         cerr << _("warning duplicate definition of ") <<
                             parentName << " " <<  primaryName << '\n';
                     }
@@ -1271,7 +1414,7 @@ bool LoadSolarSystemObjects(istream& in,
             if (surface != NULL && parent.body() != NULL)
                 parent.body()->addAlternateSurface(primaryName, surface);
             else
-                sscError(tokenizer, _("bad alternate surface"));
+                sscError(cerr, lineNumber, _("bad alternate surface"));
         }
         else if (itemType == "Location")
         {
@@ -1285,20 +1428,23 @@ bool LoadSolarSystemObjects(istream& in,
                 }
                 else
                 {
-                    sscError(tokenizer, _("bad location"));
+                    sscError(cerr, lineNumber, _("bad location"));
                 }
             }
             else
             {
-                errorMessagePrelude(tokenizer);
+                errorMessagePrelude(cerr, lineNumber);
                 cerr << _("parent body '") << parentName << _("' of '") << primaryName << _("' not found.\n");
             }
         }
-        delete objectDataValue;
     }
 
+    // Errors found while reading the file are reported after the objects
+    // that preceded them have been loaded.
+    cerr << catalogFile.errors;
+
     // TODO: Return some notification if there's an error parsing the file
-    return true;
+    return catalogFile.complete;
 }
 
 
@@ -15,6 +15,7 @@
 #include <iostream>
 #include <celengine/body.h>
 #include <celengine/stardb.h>
+#include <celengine/catalogcache.h>
 
 class FrameTree;
 
@@ -37,10 +38,55 @@ class SolarSystem
 typedef std::map<uint32, SolarSystem*> SolarSystemCatalog;
 
 class Universe;
+class SolarSystemCatalogFile;
 
 bool LoadSolarSystemObjects(std::istream& in,
                             Universe& universe,
                             const std::string& dir = "");
+bool LoadSolarSystemObjects(const SolarSystemCatalogFile& catalogFile,
+                            Universe& universe,
+                            const std::string& dir = "");
+
+
+/*! The object definitions read from a solar system catalog (.ssc) file.
+ *  Reading a file doesn't touch the universe, so several files may be read
+ *  at once on different threads. The definitions are then added to the
+ *  universe by LoadSolarSystemObjects, one file at a time in the original
+ *  order, since later files may modify or replace earlier objects.
+ */
+class SolarSystemCatalogFile : public CatalogFile
+{
+ public:
+    SolarSystemCatalogFile();
+    ~SolarSystemCatalogFile();
+
+    /*! Read the object definitions from a stream. Reading stops at the
+     *  first error; the definitions before it are kept, and the error is
+     *  reported when the file is loaded.
+     */
+    bool read(std::istream& in);
+
+    void writeCache(CatalogCacheWriter&) const;
+    bool readCache(CatalogCacheReader&);
+
+ private:
+    SolarSystemCatalogFile(const SolarSystemCatalogFile&);
+    SolarSystemCatalogFile& operator=(const SolarSystemCatalogFile&);
+
+    void clear();
+
+    struct Entry;
+    std::vector<Entry*> entries;
+    std::string errors;
+    bool complete;
+
+    // The property values of all the definitions, freed with the file
+    ValueArena values;
+
+    friend bool LoadSolarSystemObjects(const SolarSystemCatalogFile&,
+                                       Universe&,
+                                       const std::string&);
+};
 
 #endif // _SOLARSYS_H_
 
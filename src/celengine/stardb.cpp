@@ -14,10 +14,14 @@
 #include <cstdio>
 #include <cassert>
 #include <algorithm>
+#include <fstream>
+#include <sstream>
 #include <celmath/mathlib.h>
 #include <celmath/plane.h>
 #include <celutil/util.h>
 #include <celutil/bytes.h>
+#include <celutil/mappedfile.h>
+#include <celutil/timer.h>
 #include <celengine/stardb.h>
 #include "celestia.h"
 #include "astro.h"
@@ -53,6 +57,34 @@ static const float STAR_EXTRA_ROOM        = 0.01f; // Reserve 1% capacity for ex
 const char* StarDatabase::FILE_HEADER            = "CELSTARS";
 const char* StarDatabase::CROSSINDEX_FILE_HEADER = "CELINDEX";
 
+// Version 2.0 star database files store the stars already sorted into
+// octree order, followed by the octree node table and an index of the stars
+// sorted by catalog number. All values are little endian:
+//
+//   char[8]           "CELSTARS"
+//   uint16            version (0x0200)
+//   uint16            reserved
+//   uint32            star count
+//   uint32            node count
+//   PackedStar[]      stars in octree order
+//   PackedOctreeNode[] octree nodes, depth first; each node with children
+//                     is followed by its eight subtrees
+//   uint32[]          star indices sorted by catalog number
+static const uint16 SORTED_STAR_FILE_VERSION = 0x0200;
+static const unsigned int SORTED_STAR_FILE_HEADER_SIZE = 20;
+static const unsigned int PACKED_STAR_SIZE = 20;
+
+struct PackedOctreeNode
+{
+    float  center[3];
+    float  exclusionFactor;
+    uint32 firstStar;
+    uint32 starCount;
+    uint32 hasChildren;
+};
+
+static const unsigned int PACKED_OCTREE_NODE_SIZE = 28;
+
 
 // Used to sort stars by catalog number
 struct CatalogNumberOrderingPredicate
@@ -95,6 +127,26 @@ struct PtrCatalogNumberOrderingPredicate
 };
 
 
+// Used to leave changed stars out when restoring the octree of a sorted
+// star database
+struct ModifiedStarPredicate
+{
+    const Star* firstStar;
+    const vector<bool>& modified;
+
+    ModifiedStarPredicate(const Star* _firstStar, const vector<bool>& _modified) :
+        firstStar(_firstStar),
+        modified(_modified)
+    {
+    }
+
+    bool operator()(const Star& star) const
+    {
+        return modified[&star - firstStar];
+    }
+};
+
+
 static bool parseSimpleCatalogNumber(const string& name,
                                      const string& prefix,
                                      uint32* catalogNumber)
@@ -183,10 +235,15 @@ StarDatabase::StarDatabase():
     nStars               (0),
     stars                (NULL),
     namesDB              (NULL),
+    catalogNumberIndex   (NULL),
     octreeRoot           (NULL),
+    flatOctree           (NULL),
+    octreeLayout         (FlatOctree),
     nextAutoCatalogNumber(0xfffffffe),
     binFileCatalogNumberIndex(NULL),
-    binFileStarCount(0)
+    binFileStarCount(0),
+    binFileStars(NULL),
+    binFileOctree(NULL)
 {
     crossIndexes.resize(MaxCatalog);
 }
@@ -200,6 +257,12 @@ StarDatabase::~StarDatabase()
     if (catalogNumberIndex != NULL)
         delete [] catalogNumberIndex;
 
+    delete flatOctree;
+
+    // Only present if finish() was never called
+    delete binFileOctree;
+    delete[] binFileStars;
+
     for (vector<CrossIndex*>::iterator iter = crossIndexes.begin(); iter != crossIndexes.end(); ++iter)
     {
         if (*iter != NULL)
@@ -331,13 +394,13 @@ Star* StarDatabase::searchCrossIndex(const Catalog catalog, const uint32 number)
 }
 
 
-vector<string> StarDatabase::getCompletion(const string& name) const
+vector<string> StarDatabase::getCompletion(const string& name, unsigned int maxCompletions) const
 {
     vector<string> completion;
 
     // only named stars are supported by completion.
     if (!name.empty() && namesDB != NULL)
-        return namesDB->getCompletion(name);
+        return namesDB->getCompletion(name, maxCompletions);
     else
         return completion;
 }
@@ -507,15 +570,13 @@ string StarDatabase::getStarNameList(const Star& star, const unsigned int maxNam
 }
 
 
-void StarDatabase::findVisibleStars(StarHandler& starHandler,
-                                    const Vector3f& position,
-                                    const Quaternionf& orientation,
-                                    float fovY,
-                                    float aspectRatio,
-                                    float limitingMag) const
+// Compute the bounding planes of an infinite view frustum
+static void computeFrustumPlanes(Hyperplane<float, 3>* frustumPlanes,
+                                 const Vector3f& position,
+                                 const Quaternionf& orientation,
+                                 float fovY,
+                                 float aspectRatio)
 {
-    // Compute the bounding planes of an infinite view frustum
-    Hyperplane<float, 3> frustumPlanes[5];
     Vector3f planeNormals[5];
     Eigen::Matrix3f rot = orientation.toRotationMatrix();
     float h = (float) tan(fovY / 2);
@@ -530,6 +591,27 @@ void StarDatabase::findVisibleStars(StarHandler& starHandler,
         planeNormals[i] = rot.transpose() * planeNormals[i].normalized();
         frustumPlanes[i] = Hyperplane<float, 3>(planeNormals[i], position);
     }
+}
+
+
+void StarDatabase::findVisibleStars(StarHandler& starHandler,
+                                    const Vector3f& position,
+                                    const Quaternionf& orientation,
+                                    float fovY,
+                                    float aspectRatio,
+                                    float limitingMag) const
+{
+    Hyperplane<float, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+
+    if (flatOctree != NULL && octreeLayout == FlatOctree)
+    {
+        flatOctree->processVisibleObjects(starHandler,
+                                          position,
+                                          frustumPlanes,
+                                          limitingMag);
+        return;
+    }
 
     octreeRoot->processVisibleObjects(starHandler,
                                       position,
@@ -539,10 +621,50 @@ void StarDatabase::findVisibleStars(StarHandler& starHandler,
 }
 
 
+/*! Find visible stars using the threads of a pool. Only the flat octree
+ *  layout supports splitting the query; with the linked layout, the whole
+ *  query is handled as a single part on the calling thread.
+ */
+void StarDatabase::findVisibleStars(ParallelStarHandler& starHandler,
+                                    const Vector3f& position,
+                                    const Quaternionf& orientation,
+                                    float fovY,
+                                    float aspectRatio,
+                                    float limitingMag,
+                                    ThreadPool* pool) const
+{
+    Hyperplane<float, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+
+    if (flatOctree != NULL && octreeLayout == FlatOctree)
+    {
+        flatOctree->processVisibleObjects(starHandler,
+                                          position,
+                                          frustumPlanes,
+                                          limitingMag,
+                                          pool);
+        return;
+    }
+
+    starHandler.setPartCount(1);
+    octreeRoot->processVisibleObjects(starHandler.getPartHandler(0),
+                                      position,
+                                      frustumPlanes,
+                                      limitingMag,
+                                      STAR_OCTREE_ROOT_SIZE);
+}
+
+
 void StarDatabase::findCloseStars(StarHandler& starHandler,
                                   const Vector3f& position,
                                   float radius) const
 {
+    if (flatOctree != NULL && octreeLayout == FlatOctree)
+    {
+        flatOctree->processCloseObjects(starHandler, position, radius);
+        return;
+    }
+
     octreeRoot->processCloseObjects(starHandler,
                                     position,
                                     radius,
@@ -550,6 +672,18 @@ void StarDatabase::findCloseStars(StarHandler& starHandler,
 }
 
 
+StarDatabase::OctreeLayout StarDatabase::getOctreeLayout() const
+{
+    return octreeLayout;
+}
+
+
+void StarDatabase::setOctreeLayout(OctreeLayout layout)
+{
+    octreeLayout = layout;
+}
+
+
 StarNameDatabase* StarDatabase::getNameDatabase() const
 {
     return namesDB;
@@ -630,84 +764,133 @@ bool StarDatabase::loadCrossIndex(const Catalog catalog, istream& in)
 }
 
 
+// Decode a packed star record; fields are little endian and not
+// necessarily aligned.
+static bool unpackStar(const char* record, Star& star)
+{
+    StarDatabase::PackedStar packed;
+    memcpy(&packed, record, PACKED_STAR_SIZE);
+
+    LE_TO_CPU_INT32(packed.catalogNumber, packed.catalogNumber);
+    LE_TO_CPU_FLOAT(packed.x, packed.x);
+    LE_TO_CPU_FLOAT(packed.y, packed.y);
+    LE_TO_CPU_FLOAT(packed.z, packed.z);
+    LE_TO_CPU_INT16(packed.absMag, packed.absMag);
+    LE_TO_CPU_INT16(packed.spectralType, packed.spectralType);
+
+    StarDetails* details = NULL;
+    StellarClass sc;
+    if (sc.unpack(packed.spectralType))
+        details = StarDetails::GetStarDetails(sc);
+    if (details == NULL)
+        return false;
+
+    star.setPosition(packed.x, packed.y, packed.z);
+    star.setAbsoluteMagnitude((float) packed.absMag / 256.0f);
+    star.setDetails(details);
+    star.setCatalogNumber(packed.catalogNumber);
+
+    return true;
+}
+
+
 bool StarDatabase::loadBinary(istream& in)
 {
-    uint32 nStarsInFile = 0;
+    // Star databases are decoded from a single block of memory
+    string contents;
+    char buf[65536];
+    while (in.read(buf, sizeof buf) || in.gcount() > 0)
+        contents.append(buf, (string::size_type) in.gcount());
+    if (in.bad())
+        return false;
 
-    // Verify that the star database file has a correct header
+    return loadBinaryData(contents.data(), contents.size());
+}
+
+
+/*! Load a star database file, memory mapping it when possible. Files
+ *  in the spatially sorted format are used without any per-star parsing.
+ */
+bool StarDatabase::loadBinary(const string& filename)
+{
+    MappedFile* mappedFile = OpenMappedFile(filename);
+    if (mappedFile == NULL)
     {
-        int headerLength = strlen(FILE_HEADER);
-        char* header = new char[headerLength];
-        in.read(header, headerLength);
-        if (strncmp(header, FILE_HEADER, headerLength))
+        // Fall back to stream I/O
+        ifstream in(filename.c_str(), ios::in | ios::binary);
+        if (!in.good())
+        {
+            cerr << _("Error opening ") << filename << '\n';
             return false;
-        delete[] header;
+        }
+
+        return loadBinary(in);
     }
 
-    // Verify the version
+    bool ok = loadBinaryData(mappedFile->data(), mappedFile->size());
+    delete mappedFile;
+
+    return ok;
+}
+
+
+// Check the header of a star database in memory and load it in the format
+// given by its version.
+bool StarDatabase::loadBinaryData(const char* data, size_t size)
+{
+    size_t headerLength = strlen(FILE_HEADER);
+    if (size < headerLength + sizeof(uint16) ||
+        strncmp(data, FILE_HEADER, headerLength) != 0)
     {
-        uint16 version;
-        in.read((char*) &version, sizeof version);
-        LE_TO_CPU_INT16(version, version);
-        if (version != 0x0100)
-            return false;
+        return false;
     }
 
-    // Read the star count
-    in.read((char *) &nStarsInFile, sizeof nStarsInFile);
-    LE_TO_CPU_INT32(nStarsInFile, nStarsInFile);
-    if (!in.good())
+    uint16 version = 0;
+    memcpy(&version, data + headerLength, sizeof version);
+    LE_TO_CPU_INT16(version, version);
+
+    if (version == SORTED_STAR_FILE_VERSION)
+        return loadSortedBinary(data, size);
+    else if (version == 0x0100)
+        return loadUnsortedBinary(data, size);
+    else
         return false;
+}
 
-    unsigned int totalStars = nStars + nStarsInFile;
-
-    while (((unsigned int) nStars) < totalStars)
-    {
-        uint32 catNo = 0;
-        float x = 0.0f, y = 0.0f, z = 0.0f;
-        int16 absMag;
-        uint16 spectralType;
-
-        in.read((char *) &catNo, sizeof catNo);
-        LE_TO_CPU_INT32(catNo, catNo);
-        in.read((char *) &x, sizeof x);
-        LE_TO_CPU_FLOAT(x, x);
-        in.read((char *) &y, sizeof y);
-        LE_TO_CPU_FLOAT(y, y);
-        in.read((char *) &z, sizeof z);
-        LE_TO_CPU_FLOAT(z, z);
-        in.read((char *) &absMag, sizeof absMag);
-        LE_TO_CPU_INT16(absMag, absMag);
-        in.read((char *) &spectralType, sizeof spectralType);
-        LE_TO_CPU_INT16(spectralType, spectralType);
-        if (in.bad())
-        break;
 
-        Star star;
-        star.setPosition(x, y, z);
-        star.setAbsoluteMagnitude((float) absMag / 256.0f);
+/*! Load a star database in the original format from memory: a star count
+ *  after the header, followed by the stars in catalog file order. The stars
+ *  are added to those loaded before.
+ */
+bool StarDatabase::loadUnsortedBinary(const char* data, size_t size)
+{
+    const size_t headerSize = strlen(FILE_HEADER) + sizeof(uint16) + sizeof(uint32);
+    if (size < headerSize)
+        return false;
 
-        StarDetails* details = NULL;
-        StellarClass sc;
-        if (sc.unpack(spectralType))
-            details = StarDetails::GetStarDetails(sc);
+    uint32 nStarsInFile = 0;
+    memcpy(&nStarsInFile, data + headerSize - sizeof(uint32), sizeof nStarsInFile);
+    LE_TO_CPU_INT32(nStarsInFile, nStarsInFile);
+    if ((size - headerSize) / PACKED_STAR_SIZE < nStarsInFile)
+    {
+        cerr << _("Bad size for star database\n");
+        return false;
+    }
 
-        if (details == NULL)
+    const char* starData = data + headerSize;
+    for (uint32 i = 0; i < nStarsInFile; i++)
+    {
+        Star star;
+        if (!unpackStar(starData + i * PACKED_STAR_SIZE, star))
         {
             cerr << _("Bad spectral type in star database, star #") << nStars << "\n";
             return false;
         }
 
-        star.setDetails(details);
-        star.setCatalogNumber(catNo);
         unsortedStars.add(star);
-        
         nStars++;
     }
 
-    if (in.bad())
-        return false;
-
     DPRINTF(0, "StarDatabase::read: nStars = %d\n", nStarsInFile);
     clog << nStars << _(" stars in binary database\n");
     
@@ -731,15 +914,207 @@ bool StarDatabase::loadBinary(istream& in)
 }
 
 
+// Recreate a subtree of the star octree from the node table of a sorted
+// star database. Returns NULL if the node table is malformed.
+static StarOctree* unpackOctree(const char*& nodeData,
+                                const char* nodeEnd,
+                                Star* stars,
+                                unsigned int nStars)
+{
+    if (nodeData + PACKED_OCTREE_NODE_SIZE > nodeEnd)
+        return NULL;
+
+    PackedOctreeNode packed;
+    memcpy(&packed, nodeData, PACKED_OCTREE_NODE_SIZE);
+    nodeData += PACKED_OCTREE_NODE_SIZE;
+
+    for (int i = 0; i < 3; i++)
+        LE_TO_CPU_FLOAT(packed.center[i], packed.center[i]);
+    LE_TO_CPU_FLOAT(packed.exclusionFactor, packed.exclusionFactor);
+    LE_TO_CPU_INT32(packed.firstStar, packed.firstStar);
+    LE_TO_CPU_INT32(packed.starCount, packed.starCount);
+    LE_TO_CPU_INT32(packed.hasChildren, packed.hasChildren);
+
+    if (packed.firstStar > nStars || packed.starCount > nStars - packed.firstStar)
+        return NULL;
+
+    StarOctree* node = new StarOctree(Vector3f(packed.center[0], packed.center[1], packed.center[2]),
+                                      packed.exclusionFactor,
+                                      stars + packed.firstStar,
+                                      packed.starCount);
+    if (packed.hasChildren != 0)
+    {
+        StarOctree** children = new StarOctree*[8];
+        for (int i = 0; i < 8; i++)
+            children[i] = NULL;
+        node->setChildren(children);
+
+        for (int i = 0; i < 8; i++)
+        {
+            children[i] = unpackOctree(nodeData, nodeEnd, stars, nStars);
+            if (children[i] == NULL)
+            {
+                // Fill in the remaining children so that the partial tree
+                // can be deleted normally.
+                for (int j = i; j < 8; j++)
+                    children[j] = new StarOctree(Vector3f::Zero(), 0.0f, stars, 0);
+                delete node;
+                return NULL;
+            }
+        }
+    }
+
+    return node;
+}
+
+
+static float starOctreeRootMagnitude()
+{
+    return astro::appToAbsMag(STAR_OCTREE_MAGNITUDE,
+                              STAR_OCTREE_ROOT_SIZE * (float) sqrt(3.0));
+}
+
+
+static Vector3f starOctreeRootCenter()
+{
+    return Vector3f(1000.0f, 1000.0f, 1000.0f);
+}
+
+
+/*! Load a star database in the spatially sorted format from memory. The
+ *  stars are converted in one pass, and the octree and catalog number index
+ *  are taken from the file instead of being rebuilt.
+ */
+bool StarDatabase::loadSortedBinary(const char* data, size_t size)
+{
+    if (nStars != 0)
+    {
+        cerr << _("A sorted star database must be the first star file loaded\n");
+        return false;
+    }
+
+    if (size < SORTED_STAR_FILE_HEADER_SIZE)
+        return false;
+
+    uint32 nStarsInFile = 0;
+    uint32 nNodes = 0;
+    memcpy(&nStarsInFile, data + 12, sizeof nStarsInFile);
+    LE_TO_CPU_INT32(nStarsInFile, nStarsInFile);
+    memcpy(&nNodes, data + 16, sizeof nNodes);
+    LE_TO_CPU_INT32(nNodes, nNodes);
+
+    // Compute the expected size in double precision to catch overflow from
+    // bogus counts.
+    double expectedSize = (double) SORTED_STAR_FILE_HEADER_SIZE +
+                          (double) nStarsInFile * (PACKED_STAR_SIZE + sizeof(uint32)) +
+                          (double) nNodes * PACKED_OCTREE_NODE_SIZE;
+    if (nNodes == 0 || expectedSize != (double) size)
+    {
+        cerr << _("Bad size for sorted star database\n");
+        return false;
+    }
+
+    const char* starData  = data + SORTED_STAR_FILE_HEADER_SIZE;
+    const char* nodeData  = starData + nStarsInFile * PACKED_STAR_SIZE;
+    const char* nodeEnd   = nodeData + nNodes * PACKED_OCTREE_NODE_SIZE;
+    const char* indexData = nodeEnd;
+
+    Star* sortedStars = new Star[nStarsInFile];
+    for (uint32 i = 0; i < nStarsInFile; i++)
+    {
+        if (!unpackStar(starData + i * PACKED_STAR_SIZE, sortedStars[i]))
+        {
+            cerr << _("Bad spectral type in star database, star #") << i << "\n";
+            delete[] sortedStars;
+            return false;
+        }
+    }
+
+    StarOctree* octree = unpackOctree(nodeData, nodeEnd, sortedStars, nStarsInFile);
+    if (octree == NULL || nodeData != nodeEnd)
+    {
+        cerr << _("Bad octree in sorted star database\n");
+        delete octree;
+        delete[] sortedStars;
+        return false;
+    }
+
+    // The octree may only be reused when it was built with the same root
+    // node as buildOctree() would use; otherwise the stars are just inserted
+    // again.
+    if ((octree->getCellCenter() - starOctreeRootCenter()).norm() > 1.0e-3f ||
+        fabs(octree->getExclusionFactor() - starOctreeRootMagnitude()) > 1.0e-3f)
+    {
+        DPRINTF(0, "Sorted star database has a different octree layout, rebuilding.\n");
+        delete octree;
+        octree = NULL;
+    }
+
+    Star** index = new Star*[nStarsInFile];
+    bool indexSorted = true;
+    for (uint32 i = 0; i < nStarsInFile; i++)
+    {
+        uint32 starIndex;
+        memcpy(&starIndex, indexData + i * sizeof(uint32), sizeof starIndex);
+        LE_TO_CPU_INT32(starIndex, starIndex);
+        if (starIndex >= nStarsInFile)
+        {
+            cerr << _("Bad catalog number index in sorted star database\n");
+            delete[] index;
+            delete octree;
+            delete[] sortedStars;
+            return false;
+        }
+
+        index[i] = sortedStars + starIndex;
+        if (i > 0 && index[i]->getCatalogNumber() < index[i - 1]->getCatalogNumber())
+            indexSorted = false;
+    }
+
+    if (!indexSorted)
+        sort(index, index + nStarsInFile, PtrCatalogNumberOrderingPredicate());
+
+    binFileStars = sortedStars;
+    binFileStarCount = nStarsInFile;
+    binFileCatalogNumberIndex = index;
+    binFileOctree = octree;
+    binFileStarModified.assign(nStarsInFile, false);
+    nStars = nStarsInFile;
+
+    clog << nStars << _(" stars in binary database\n");
+
+    return true;
+}
+
+
 void StarDatabase::finish()
 {
     clog << _("Total star count: ") << nStars << endl;
-    
-    buildOctree();
-    buildIndexes();
+
+    if (binFileOctree != NULL && unsortedStars.size() == 0 &&
+        std::find(binFileStarModified.begin(), binFileStarModified.end(), true) == binFileStarModified.end())
+    {
+        // Nothing was added to or changed in the sorted binary database,
+        // so its octree and catalog number index can be used as they are.
+        stars = binFileStars;
+        octreeRoot = binFileOctree;
+        catalogNumberIndex = binFileCatalogNumberIndex;
+        binFileStars = NULL;
+        binFileOctree = NULL;
+        binFileCatalogNumberIndex = NULL;
+    }
+    else
+    {
+        buildOctree();
+        buildIndexes();
+    }
+
+    flatOctree = new FlatStarOctree(*octreeRoot, stars, STAR_OCTREE_ROOT_SIZE);
 
     // Delete the temporary indices used only during loading
     delete[] binFileCatalogNumberIndex;
+    binFileCatalogNumberIndex = NULL;
+    binFileStarModified.clear();
     stcFileCatalogNumberIndex.clear();
     
     // Resolve all barycenters; this can't be done before star sorting. There's
@@ -765,16 +1140,17 @@ void StarDatabase::finish()
 }
 
 
-static void errorMessagePrelude(const Tokenizer& tok)
+static void errorMessagePrelude(ostream& out, const Tokenizer& tok)
 {
-    cerr << _("Error in .stc file (line ") << tok.getLineNumber() << "): ";
+    out << _("Error in .stc file (line ") << tok.getLineNumber() << "): ";
 }
 
-static void stcError(const Tokenizer& tok,
+static void stcError(ostream& out,
+                     const Tokenizer& tok,
                      const string& msg)
 {
-    errorMessagePrelude(tok);
-    cerr << msg << '\n';
+    errorMessagePrelude(out, tok);
+    out << msg << '\n';
 }
 
 
@@ -1174,75 +1550,28 @@ bool StarDatabase::createStar(Star* star,
  */
 bool StarDatabase::load(istream& in, const string& resourcePath)
 {
-    Tokenizer tokenizer(&in);
-    Parser parser(&tokenizer);
+    StarCatalogFile catalogFile;
+    catalogFile.read(in);
 
-    while (tokenizer.nextToken() != Tokenizer::TokenEnd)
-    {
-        bool isStar = true;
-        
-        // Parse the disposition--either Add, Replace, or Modify. The disposition
-        // may be omitted. The default value is Add.
-        StcDisposition disposition = AddStar;
-        if (tokenizer.getTokenType() == Tokenizer::TokenName)
-        {
-            if (tokenizer.getNameValue() == "Modify")
-            {
-                disposition = ModifyStar;
-                tokenizer.nextToken();
-            }
-            else if (tokenizer.getNameValue() == "Replace")
-            {
-                disposition = ReplaceStar;
-                tokenizer.nextToken();
-            }
-            else if (tokenizer.getNameValue() == "Add")
-            {
-                disposition = AddStar;
-                tokenizer.nextToken();
-            }
-        }
-        
-        // Parse the object type--either Star or Barycenter. The object type
-        // may be omitted. The default is Star.
-        if (tokenizer.getTokenType() == Tokenizer::TokenName)
-        {
-            if (tokenizer.getNameValue() == "Star")
-            {
-                isStar = true;
-            }
-            else if (tokenizer.getNameValue() == "Barycenter")
-            {
-                isStar = false;
-            }
-            else
-            {
-                stcError(tokenizer, "unrecognized object type");
-                return false;
-            }
-            tokenizer.nextToken();
-        }
+    return load(catalogFile, resourcePath);
+}
 
-        // Parse the catalog number; it may be omitted if a name is supplied.
-        uint32 catalogNumber = Star::InvalidCatalogNumber;
-        if (tokenizer.getTokenType() == Tokenizer::TokenNumber)
-        {
-            catalogNumber = (uint32) tokenizer.getNumberValue();
-            tokenizer.nextToken();
-        }
 
-        string objName;
+bool StarDatabase::load(const StarCatalogFile& catalogFile, const string& resourcePath)
+{
+    for (vector<StarCatalogFile::Entry>::const_iterator iter = catalogFile.entries.begin();
+         iter != catalogFile.entries.end(); iter++)
+    {
+        StcDisposition disposition = iter->disposition;
+        bool isStar = iter->isStar;
+        uint32 catalogNumber = iter->catalogNumber;
+        const string& objName = iter->objName;
+
         string firstName;
-        if (tokenizer.getTokenType() == Tokenizer::TokenString)
+        if (!objName.empty())
         {
-            // A star name (or names) is present
-            objName    = tokenizer.getStringValue();
-            tokenizer.nextToken();
-            if (!objName.empty())
-            {
-                string::size_type next = objName.find(':', 0);
-                firstName = objName.substr(0, next);
-            }
+            string::size_type next = objName.find(':', 0);
+            firstName = objName.substr(0, next);
         }
         
         Star* star = NULL;
@@ -1298,22 +1627,15 @@ bool StarDatabase::load(istream& in, const string& resourcePath)
         
         bool isNewStar = star == NULL;
 
-        tokenizer.pushBack();
-
-        Value* starDataValue = parser.readValue();
-        if (starDataValue == NULL)
+        // A changed star from a sorted binary database may no longer belong
+        // in the octree node where it was stored.
+        if (!isNewStar && binFileStars != NULL &&
+            star >= binFileStars && star < binFileStars + binFileStarCount)
         {
-            clog << "Error reading star." << endl;
-            return false;
-        }
-        
-        if (starDataValue->getType() != Value::HashType)
-        {
-            DPRINTF(0, "Bad star definition.\n");
-            delete starDataValue;
-            return false;
+            binFileStarModified[star - binFileStars] = true;
         }
-        Hash* starData = starDataValue->getHash();
+
+        Hash* starData = iter->starDataValue->getHash();
 
         if (isNewStar)
             star = new Star();
@@ -1327,7 +1649,6 @@ bool StarDatabase::load(istream& in, const string& resourcePath)
         {
             ok = createStar(star, disposition, catalogNumber, starData, resourcePath, !isStar);
         }
-        delete starDataValue;
 
         if (ok)
         {
@@ -1376,6 +1697,184 @@ bool StarDatabase::load(istream& in, const string& resourcePath)
         }
     }
 
+    // Errors found while reading the file are reported after the stars
+    // that preceded them have been loaded.
+    cerr << catalogFile.errorMessage;
+
+    return catalogFile.complete;
+}
+
+
+StarCatalogFile::StarCatalogFile() :
+    complete(false)
+{
+}
+
+
+StarCatalogFile::~StarCatalogFile()
+{
+}
+
+
+void StarCatalogFile::clear()
+{
+    entries.clear();
+    values.clear();
+    errorMessage.clear();
+    complete = false;
+}
+
+
+bool StarCatalogFile::read(istream& in)
+{
+    ostringstream errorStream;
+    Tokenizer tokenizer(&in);
+    tokenizer.setErrorStream(&errorStream);
+    Parser parser(&tokenizer, &values);
+
+    complete = false;
+    while (tokenizer.nextToken() != Tokenizer::TokenEnd)
+    {
+        Entry entry;
+        entry.isStar = true;
+        
+        // Parse the disposition--either Add, Replace, or Modify. The disposition
+        // may be omitted. The default value is Add.
+        entry.disposition = StarDatabase::AddStar;
+        if (tokenizer.getTokenType() == Tokenizer::TokenName)
+        {
+            if (tokenizer.getNameValue() == "Modify")
+            {
+                entry.disposition = StarDatabase::ModifyStar;
+                tokenizer.nextToken();
+            }
+            else if (tokenizer.getNameValue() == "Replace")
+            {
+                entry.disposition = StarDatabase::ReplaceStar;
+                tokenizer.nextToken();
+            }
+            else if (tokenizer.getNameValue() == "Add")
+            {
+                entry.disposition = StarDatabase::AddStar;
+                tokenizer.nextToken();
+            }
+        }
+        
+        // Parse the object type--either Star or Barycenter. The object type
+        // may be omitted. The default is Star.
+        if (tokenizer.getTokenType() == Tokenizer::TokenName)
+        {
+            if (tokenizer.getNameValue() == "Star")
+            {
+                entry.isStar = true;
+            }
+            else if (tokenizer.getNameValue() == "Barycenter")
+            {
+                entry.isStar = false;
+            }
+            else
+            {
+                stcError(errorStream, tokenizer, "unrecognized object type");
+                errorMessage = errorStream.str();
+                return false;
+            }
+            tokenizer.nextToken();
+        }
+
+        // Parse the catalog number; it may be omitted if a name is supplied.
+        entry.catalogNumber = Star::InvalidCatalogNumber;
+        if (tokenizer.getTokenType() == Tokenizer::TokenNumber)
+        {
+            entry.catalogNumber = (uint32) tokenizer.getNumberValue();
+            tokenizer.nextToken();
+        }
+
+        if (tokenizer.getTokenType() == Tokenizer::TokenString)
+        {
+            // A star name (or names) is present
+            entry.objName = tokenizer.getStringValue();
+            tokenizer.nextToken();
+        }
+
+        tokenizer.pushBack();
+
+        entry.starDataValue = parser.readValue();
+        if (entry.starDataValue == NULL)
+        {
+            errorStream << "Error reading star.\n";
+            errorMessage = errorStream.str();
+            return false;
+        }
+        
+        if (entry.starDataValue->getType() != Value::HashType)
+        {
+            errorStream << "Bad star definition.\n";
+            errorMessage = errorStream.str();
+            return false;
+        }
+
+        entries.push_back(entry);
+    }
+
+    errorMessage = errorStream.str();
+    complete = true;
+
+    return true;
+}
+
+
+// Only completely read files are cached, so the errors and completion
+// state don't need to be stored.
+void StarCatalogFile::writeCache(CatalogCacheWriter& writer) const
+{
+    writer.writeCount((uint32) entries.size());
+    for (vector<Entry>::const_iterator iter = entries.begin(); iter != entries.end(); iter++)
+    {
+        writer.writeCount((uint32) iter->disposition);
+        writer.writeCount(iter->isStar ? 1 : 0);
+        writer.writeCount(iter->catalogNumber);
+        writer.writeString(iter->objName);
+        writer.writeValue(iter->starDataValue);
+    }
+}
+
+
+bool StarCatalogFile::readCache(CatalogCacheReader& reader)
+{
+    uint32 count = 0;
+    if (!reader.readCount(count))
+        return false;
+
+    Entry entry;
+    for (uint32 i = 0; i < count; i++)
+    {
+        uint32 disposition = 0;
+        uint32 isStar = 0;
+        if (!reader.readCount(disposition) ||
+            disposition > (uint32) StarDatabase::ModifyStar ||
+            !reader.readCount(isStar) ||
+            !reader.readCount(entry.catalogNumber) ||
+            !reader.readString(entry.objName))
+        {
+            clear();
+            return false;
+        }
+        entry.disposition = (StarDatabase::StcDisposition) disposition;
+        entry.isStar = isStar != 0;
+
+        entry.starDataValue = reader.readValue(values);
+        if (entry.starDataValue == NULL ||
+            entry.starDataValue->getType() != Value::HashType)
+        {
+            clear();
+            return false;
+        }
+
+        entries.push_back(entry);
+    }
+
+    complete = true;
+
     return true;
 }
 
@@ -1386,15 +1885,40 @@ void StarDatabase::buildOctree()
     // ASSERT(octreeRoot == NULL);
 
     DPRINTF(1, "Sorting stars into octree . . .\n");
-    float absMag = astro::appToAbsMag(STAR_OCTREE_MAGNITUDE,
-                                      STAR_OCTREE_ROOT_SIZE * (float) sqrt(3.0));
-    DynamicStarOctree* root = new DynamicStarOctree(Vector3f(1000.0f, 1000.0f, 1000.0f),
-                                                    absMag);
+    Timer* timer = CreateTimer();
+
+    DynamicStarOctree* root = new DynamicStarOctree(starOctreeRootCenter(),
+                                                    starOctreeRootMagnitude());
+
+    DynamicStarOctree::ObjectList starList;
+    starList.reserve(nStars);
+
+    if (binFileStars != NULL)
+    {
+        if (binFileOctree != NULL)
+        {
+            // Stars from a sorted binary database are already placed; only
+            // the ones changed by stc files need to be inserted again.
+            ModifiedStarPredicate isModified(binFileStars, binFileStarModified);
+            root->restore(*binFileOctree, isModified);
+        }
+
+        for (unsigned int i = 0; i < binFileStarCount; ++i)
+        {
+            if (binFileOctree == NULL || binFileStarModified[i])
+                starList.push_back(&binFileStars[i]);
+        }
+    }
+
     for (unsigned int i = 0; i < unsortedStars.size(); ++i)
     {
-        root->insertObject(unsortedStars[i], STAR_OCTREE_ROOT_SIZE);
+        starList.push_back(&unsortedStars[i]);
     }
-    
+
+    ThreadPool pool;
+    root->insertObjects(starList, STAR_OCTREE_ROOT_SIZE, &pool);
+    pool.wait();
+
     DPRINTF(1, "Spatially sorting stars for improved locality of reference . . .\n");
     Star* sortedStars    = new Star[nStars];
     Star* firstStar      = sortedStars;
@@ -1417,10 +1941,18 @@ void StarDatabase::buildOctree()
     }
 #endif
 
+    clog << _("Star octree built in ") << (int) (timer->getTime() * 1000.0)
+         << _(" ms using ") << pool.getThreadCount() + 1 << _(" threads\n");
+    delete timer;
+
     // Clean up . . .
     //delete[] stars;
     unsortedStars.clear();
     delete root;
+    delete binFileOctree;
+    binFileOctree = NULL;
+    delete[] binFileStars;
+    binFileStars = NULL;
 
     stars = sortedStars;
 }
@@ -1441,6 +1973,142 @@ void StarDatabase::buildIndexes()
 }
 
 
+template<class T> static void writeLE(ostream& out, T x)
+{
+#if defined(WORDS_BIGENDIAN) || defined(__BIG_ENDIAN__)
+    char* bytes = reinterpret_cast<char*>(&x);
+    reverse(bytes, bytes + sizeof(T));
+#endif
+    out.write(reinterpret_cast<const char*>(&x), sizeof(T));
+}
+
+
+static void writePackedStar(ostream& out, const StarDatabase::PackedStar& star)
+{
+    writeLE(out, star.catalogNumber);
+    writeLE(out, star.x);
+    writeLE(out, star.y);
+    writeLE(out, star.z);
+    writeLE(out, star.absMag);
+    writeLE(out, star.spectralType);
+}
+
+
+static void writeOctreeNode(ostream& out, const StarOctree* node, const Star* firstStar)
+{
+    const Vector3f& center = node->getCellCenter();
+    writeLE(out, center.x());
+    writeLE(out, center.y());
+    writeLE(out, center.z());
+    writeLE(out, node->getExclusionFactor());
+    writeLE(out, (uint32) (node->getFirstObject() - firstStar));
+    writeLE(out, (uint32) node->getObjectCount());
+    writeLE(out, (uint32) (node->hasChildren() ? 1 : 0));
+
+    if (node->hasChildren())
+    {
+        for (int i = 0; i < 8; i++)
+            writeOctreeNode(out, node->getChild(i), firstStar);
+    }
+}
+
+
+// Orders star record indices by catalog number
+struct RecordCatalogNumberOrderingPredicate
+{
+    const vector<StarDatabase::PackedStar>& records;
+
+    RecordCatalogNumberOrderingPredicate(const vector<StarDatabase::PackedStar>& _records) :
+        records(_records)
+    {
+    }
+
+    bool operator()(uint32 index0, uint32 index1) const
+    {
+        return records[index0].catalogNumber < records[index1].catalogNumber;
+    }
+};
+
+
+/*! Write a list of star records as a spatially sorted star database. The
+ *  octree is built exactly as buildOctree() would build it, so that
+ *  loading the file requires neither sorting nor octree construction.
+ */
+bool StarDatabase::writeSortedBinary(ostream& out, const vector<PackedStar>& records)
+{
+    uint32 nRecords = (uint32) records.size();
+
+    // Build the octree from temporary stars; the catalog number of each
+    // temporary star is the index of its record, which lets us find the
+    // record again after the stars have been spatially sorted.
+    Star* unsortedStars = new Star[nRecords];
+    for (uint32 i = 0; i < nRecords; i++)
+    {
+        const PackedStar& record = records[i];
+
+        StarDetails* details = NULL;
+        StellarClass sc;
+        if (sc.unpack(record.spectralType))
+            details = StarDetails::GetStarDetails(sc);
+        if (details == NULL)
+        {
+            cerr << _("Bad spectral type in star database, star #") << i << "\n";
+            delete[] unsortedStars;
+            return false;
+        }
+
+        unsortedStars[i].setPosition(record.x, record.y, record.z);
+        unsortedStars[i].setAbsoluteMagnitude((float) record.absMag / 256.0f);
+        unsortedStars[i].setDetails(details);
+        unsortedStars[i].setCatalogNumber(i);
+    }
+
+    DynamicStarOctree* root = new DynamicStarOctree(starOctreeRootCenter(),
+                                                    starOctreeRootMagnitude());
+    for (uint32 i = 0; i < nRecords; i++)
+        root->insertObject(unsortedStars[i], STAR_OCTREE_ROOT_SIZE);
+
+    Star* sortedStars = new Star[nRecords];
+    Star* firstStar = sortedStars;
+    StarOctree* octree = NULL;
+    root->rebuildAndSort(octree, firstStar);
+    delete root;
+    delete[] unsortedStars;
+
+    uint32 nNodes = 1 + octree->countChildren();
+
+    out.write(FILE_HEADER, strlen(FILE_HEADER));
+    writeLE(out, SORTED_STAR_FILE_VERSION);
+    writeLE(out, (uint16) 0);
+    writeLE(out, nRecords);
+    writeLE(out, nNodes);
+
+    for (uint32 i = 0; i < nRecords; i++)
+        writePackedStar(out, records[sortedStars[i].getCatalogNumber()]);
+
+    writeOctreeNode(out, octree, sortedStars);
+
+    // Catalog number index: positions of stars in the sorted list, ordered
+    // by catalog number.
+    vector<uint32> sortedPosition(nRecords);
+    for (uint32 i = 0; i < nRecords; i++)
+        sortedPosition[sortedStars[i].getCatalogNumber()] = i;
+
+    vector<uint32> recordIndex(nRecords);
+    for (uint32 i = 0; i < nRecords; i++)
+        recordIndex[i] = i;
+    stable_sort(recordIndex.begin(), recordIndex.end(), RecordCatalogNumberOrderingPredicate(records));
+
+    for (uint32 i = 0; i < nRecords; i++)
+        writeLE(out, sortedPosition[recordIndex[i]]);
+
+    delete octree;
+    delete[] sortedStars;
+
+    return out.good();
+}
+
+
 /*! While loading the star catalogs, this function must be called instead of
  *  find(). The final catalog number index for stars cannot be built until
  *  after all stars have been loaded. During catalog loading, there are two
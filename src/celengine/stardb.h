@@ -12,6 +12,7 @@
 #define _CELENGINE_STARDB_H_
 
 #include <iostream>
+#include <string>
 #include <vector>
 #include <map>
 #include <celengine/constellation.h>
@@ -19,10 +20,13 @@
 #include <celengine/star.h>
 #include <celengine/staroctree.h>
 #include <celengine/parser.h>
+#include <celengine/catalogcache.h>
 
 
 static const unsigned int MAX_STAR_NAMES = 10;
 
+class StarCatalogFile;
+
 // TODO: Move BlockArray to celutil; consider making it a full STL
 // style container with iterator support.
 
@@ -114,7 +118,7 @@ class StarDatabase
     Star* find(const std::string&) const;
     uint32 findCatalogNumberByName(const std::string&) const;
 
-    std::vector<std::string> getCompletion(const std::string&) const;
+    std::vector<std::string> getCompletion(const std::string&, unsigned int maxCompletions = 0) const;
 
     void findVisibleStars(StarHandler& starHandler,
                           const Eigen::Vector3f& obsPosition,
@@ -122,11 +126,28 @@ class StarDatabase
                           float fovY,
                           float aspectRatio,
                           float limitingMag) const;
+    void findVisibleStars(ParallelStarHandler& starHandler,
+                          const Eigen::Vector3f& obsPosition,
+                          const Eigen::Quaternionf&   obsOrientation,
+                          float fovY,
+                          float aspectRatio,
+                          float limitingMag,
+                          ThreadPool* pool) const;
 
     void findCloseStars(StarHandler& starHandler,
                         const Eigen::Vector3f& obsPosition,
                         float radius) const;
 
+    // Node layout used by findVisibleStars() and findCloseStars()
+    enum OctreeLayout
+    {
+        LinkedOctree = 0,
+        FlatOctree   = 1,
+    };
+
+    OctreeLayout getOctreeLayout() const;
+    void setOctreeLayout(OctreeLayout);
+
     std::string getStarName    (const Star&, bool i18n = false) const;
     void getStarName(const Star& star, char* nameBuffer, unsigned int bufferSize, bool i18n = false) const;
     std::string getStarNameList(const Star&, const unsigned int maxNames = MAX_STAR_NAMES) const;
@@ -135,7 +156,9 @@ class StarDatabase
     void setNameDatabase(StarNameDatabase*);
     
     bool load(std::istream&, const std::string& resourcePath);
+    bool load(const StarCatalogFile&, const std::string& resourcePath);
     bool loadBinary(std::istream&);
+    bool loadBinary(const std::string& filename);
 
     enum Catalog
     {
@@ -178,6 +201,17 @@ class StarDatabase
     static const char* FILE_HEADER;
     static const char* CROSSINDEX_FILE_HEADER;
 
+    // Star record as it appears in a binary star database file
+    struct PackedStar
+    {
+        uint32 catalogNumber;
+        float  x, y, z;
+        int16  absMag;
+        uint16 spectralType;
+    };
+
+    static bool writeSortedBinary(std::ostream&, const std::vector<PackedStar>&);
+
 private:
     bool createStar(Star* star,
                     StcDisposition disposition,
@@ -186,6 +220,9 @@ private:
                     const std::string& path,
                     const bool isBarycenter);
 
+    bool loadBinaryData(const char* data, std::size_t size);
+    bool loadUnsortedBinary(const char* data, std::size_t size);
+    bool loadSortedBinary(const char* data, std::size_t size);
     void buildOctree();
     void buildIndexes();
     Star* findWhileLoading(uint32 catalogNumber) const;
@@ -196,6 +233,8 @@ private:
     StarNameDatabase* namesDB;
     Star**            catalogNumberIndex;
     StarOctree*       octreeRoot;
+    FlatStarOctree*   flatOctree;
+    OctreeLayout      octreeLayout;
     uint32            nextAutoCatalogNumber;
 
     std::vector<CrossIndex*> crossIndexes;
@@ -206,6 +245,11 @@ private:
     // List of stars loaded from binary file, sorted by catalog number
     Star** binFileCatalogNumberIndex;
     unsigned int binFileStarCount;
+    // Stars and octree loaded from a spatially sorted binary file; stars
+    // changed by stc files are flagged so that they can be placed again.
+    Star* binFileStars;
+    StarOctree* binFileOctree;
+    std::vector<bool> binFileStarModified;
     // Catalog number -> star mapping for stars loaded from stc files
     std::map<uint32, Star*> stcFileCatalogNumberIndex;    
 
@@ -228,4 +272,50 @@ uint32 StarDatabase::size() const
     return nStars;
 }
 
+
+/*! The star definitions read from a star catalog (.stc) file. Reading a
+ *  file doesn't touch the database; the definitions are added to it by
+ *  StarDatabase::load, which resolves the catalog numbers and names they
+ *  refer to.
+ */
+class StarCatalogFile : public CatalogFile
+{
+ public:
+    StarCatalogFile();
+    ~StarCatalogFile();
+
+    /*! Read the star definitions from a stream. Reading stops at the
+     *  first error; the definitions before it are kept, and the error is
+     *  reported when the file is loaded.
+     */
+    bool read(std::istream&);
+
+    void writeCache(CatalogCacheWriter&) const;
+    bool readCache(CatalogCacheReader&);
+
+ private:
+    StarCatalogFile(const StarCatalogFile&);
+    StarCatalogFile& operator=(const StarCatalogFile&);
+
+    void clear();
+
+    struct Entry
+    {
+        StarDatabase::StcDisposition disposition;
+        bool isStar;
+        uint32 catalogNumber;
+        std::string objName;
+        Value* starDataValue;
+    };
+
+    std::vector<Entry> entries;
+    std::string errorMessage;
+    bool complete;
+
+    // The property values of all the definitions, freed with the file
+    ValueArena values;
+
+    friend class StarDatabase;
+};
+
 #endif // _CELENGINE_STARDB_H_
@@ -10,6 +10,8 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <cmath>
+#include <algorithm>
 #include <celengine/staroctree.h>
 
 using namespace Eigen;
@@ -24,6 +26,61 @@ using namespace Eigen;
 // render stars with orbits that are closer than MAX_STAR_ORBIT_RADIUS.
 static const float MAX_STAR_ORBIT_RADIUS = 1.0f;
 
+// Ratio of the bounding sphere radius of an octree node to its half-size
+static const float NODE_RADIUS_FACTOR = 1.732050807568877f;
+
+// Stars are rejected by the flat octree's squared distance test only when
+// they fail it by more than this factor; closer calls are left to the exact
+// magnitude test so that rounding can't change which stars are found.
+static const float DISTANCE_TEST_MARGIN = 1.01f;
+
+// A visible star query run on a thread pool is split into parts of at most
+// this many stars, or enough parts to give each thread several, whichever
+// is larger.
+static const unsigned int MIN_QUERY_PART_STARS = 4096;
+static const unsigned int QUERY_PARTS_PER_THREAD = 8;
+
+
+#ifdef EIGEN_VECTORIZE_SSE
+// Stars whose apparent magnitude computed by the SSE kernel is fainter than
+// the limiting magnitude minus this value are tested again with the scalar
+// code; the kernel's logarithm is accurate to a few parts in 10^7.
+static const float APP_MAG_TOLERANCE = 1.0e-4f;
+
+// Natural logarithm of four positive, normalized floats, using the
+// polynomial approximation from the Cephes library's logf.
+static inline __m128 log_ps(__m128 x)
+{
+    const __m128i bits = _mm_castps_si128(x);
+    __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+
+    // Mantissa in [0.5, 1)
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x807fffff)),
+                                             _mm_set1_epi32(0x3f000000)));
+
+    // Shift the mantissa into [sqrt(0.5), sqrt(2)) for a better fit
+    __m128 small = _mm_cmplt_ps(m, _mm_set1_ps(0.707106781186547524f));
+    e = _mm_sub_ps(e, _mm_and_ps(small, _mm_set1_ps(1.0f)));
+    m = _mm_sub_ps(_mm_add_ps(m, _mm_and_ps(small, m)), _mm_set1_ps(1.0f));
+
+    __m128 z = _mm_mul_ps(m, m);
+    __m128 y = _mm_set1_ps(7.0376836292e-2f);
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(-1.1514610310e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.1676998740e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(-1.2420140846e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.4249322787e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(-1.6668057665e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(2.0000714765e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(-2.4999993993e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(3.3333331174e-1f));
+    y = _mm_mul_ps(_mm_mul_ps(y, m), z);
+
+    y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+    y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    return _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+}
+#endif
+
 
 // The octree node into which a star is placed is dependent on two properties:
 // its obsPosition and its luminosity--the fainter the star, the deeper the node
@@ -190,3 +247,416 @@ void StarOctree::processCloseObjects(StarHandler&    processor,
         }
     }
 }
+
+
+FlatStarOctree::FlatStarOctree(const StarOctree& root,
+                               const Star* _stars,
+                               float rootSize) :
+    stars(_stars)
+{
+    unsigned int nStars = root.countObjects();
+    starX.resize(nStars);
+    starY.resize(nStars);
+    starZ.resize(nStars);
+    starAbsMag.resize(nStars);
+    starBrightness.resize(nStars);
+    for (unsigned int i = 0; i < nStars; i++)
+    {
+        Vector3f pos = stars[i].getPosition();
+        starX[i] = pos.x();
+        starY[i] = pos.y();
+        starZ[i] = pos.z();
+        starAbsMag[i] = stars[i].getAbsoluteMagnitude();
+        starBrightness[i] = (float) pow(10.0, -0.4 * starAbsMag[i]);
+    }
+
+    // Breadth-first walk of the source octree; the node array doubles as
+    // the queue, with source[i] the StarOctree node copied into nodes[i].
+    std::vector<const StarOctree*> source;
+    source.reserve(1 + root.countChildren());
+    nodes.reserve(1 + root.countChildren());
+
+    source.push_back(&root);
+    nodes.push_back(Node());
+    nodes[0].scale = rootSize;
+
+    for (unsigned int i = 0; i < source.size(); i++)
+    {
+        const StarOctree* octree = source[i];
+        Node& node = nodes[i];
+        node.center = octree->getCellCenter();
+        node.exclusionFactor = octree->getExclusionFactor();
+        node.firstStar = octree->getFirstObject() - stars;
+        node.starCount = octree->getObjectCount();
+        node.firstChild = 0;
+
+        if (octree->hasChildren())
+        {
+            float childScale = node.scale * 0.5f;
+            node.firstChild = nodes.size();
+            for (int j = 0; j < 8; j++)
+            {
+                source.push_back(octree->getChild(j));
+                Node child;
+                child.center = Vector3f::Zero();
+                child.exclusionFactor = 0.0f;
+                child.scale = childScale;
+                child.firstChild = child.firstStar = child.starCount = 0;
+                // Note: nodes has enough capacity reserved that this never
+                // invalidates the reference to the current node.
+                nodes.push_back(child);
+            }
+        }
+    }
+
+    // The stars of a subtree are contiguous, following the stars of its
+    // root node; children always come after their parents in the array.
+    subtreeStarCounts.resize(nodes.size());
+    for (unsigned int i = nodes.size(); i-- > 0; )
+    {
+        subtreeStarCounts[i] = nodes[i].starCount;
+        if (nodes[i].firstChild != 0)
+        {
+            for (unsigned int j = 0; j < 8; j++)
+                subtreeStarCounts[i] += subtreeStarCounts[nodes[i].firstChild + j];
+        }
+    }
+}
+
+
+void FlatStarOctree::initVisibleStarQuery(VisibleStarQuery& query,
+                                          const Vector3f& obsPosition,
+                                          const Hyperplane<float, 3>* frustumPlanes,
+                                          float limitingFactor) const
+{
+    query.obsPosition = obsPosition;
+    query.frustumPlanes = frustumPlanes;
+    query.limitingFactor = limitingFactor;
+
+    // The extent of a node along a plane normal is proportional to the node
+    // size, so it's computed once per plane instead of once per node.
+    for (unsigned int i = 0; i < 5; ++i)
+        query.planeExtents[i] = frustumPlanes[i].normal().cwise().abs().sum();
+
+    // A star is brighter than the limiting magnitude when its squared
+    // distance is less than its brightness times this value.
+    float maxDistance10pc = (float) (10.0 * LY_PER_PARSEC * pow(10.0, 0.2 * limitingFactor));
+    query.maxDistanceScale = maxDistance10pc * maxDistance10pc * DISTANCE_TEST_MARGIN;
+}
+
+
+void FlatStarOctree::processVisibleObjects(StarHandler& processor,
+                                           const Vector3f& obsPosition,
+                                           const Hyperplane<float, 3>* frustumPlanes,
+                                           float limitingFactor) const
+{
+    if (nodes.empty())
+        return;
+
+    VisibleStarQuery query;
+    initVisibleStarQuery(query, obsPosition, frustumPlanes, limitingFactor);
+    processVisibleNode(nodes[0], processor, query);
+}
+
+
+// A part of a visible star query run by a ThreadPool worker: either the
+// stars in a single node, or all the stars in a subtree.
+class FlatStarOctree::VisibleStarTask : public ThreadTask
+{
+ public:
+    VisibleStarTask(const FlatStarOctree& _octree,
+                    const QueryPart& _part,
+                    StarHandler& _processor,
+                    const VisibleStarQuery& _query) :
+        octree(_octree),
+        part(_part),
+        processor(_processor),
+        query(_query)
+    {
+    }
+
+    void run()
+    {
+        const Node& node = octree.nodes[part.node];
+        if (part.subtree)
+        {
+            octree.processVisibleNode(node, processor, query);
+        }
+        else
+        {
+            float minDistance;
+            if (octree.isNodeVisible(node, query, minDistance))
+                octree.processNodeStars(node, processor, query, minDistance);
+        }
+    }
+
+ private:
+    const FlatStarOctree& octree;
+    QueryPart part;
+    StarHandler& processor;
+    const VisibleStarQuery& query;
+};
+
+
+void FlatStarOctree::processVisibleObjects(ParallelStarHandler& processor,
+                                           const Vector3f& obsPosition,
+                                           const Hyperplane<float, 3>* frustumPlanes,
+                                           float limitingFactor,
+                                           ThreadPool* pool) const
+{
+    if (nodes.empty())
+    {
+        processor.setPartCount(0);
+        return;
+    }
+
+    VisibleStarQuery query;
+    initVisibleStarQuery(query, obsPosition, frustumPlanes, limitingFactor);
+
+    unsigned int nThreads = pool != NULL ? pool->getThreadCount() + 1 : 1;
+    if (nThreads == 1)
+    {
+        processor.setPartCount(1);
+        processVisibleNode(nodes[0], processor.getPartHandler(0), query);
+        return;
+    }
+
+    unsigned int maxPartStars = std::max(MIN_QUERY_PART_STARS,
+                                         subtreeStarCounts[0] / (nThreads * QUERY_PARTS_PER_THREAD));
+    std::vector<QueryPart> parts;
+    splitVisibleQuery(0, query, maxPartStars, parts);
+
+    processor.setPartCount(parts.size());
+    for (unsigned int i = 0; i < parts.size(); i++)
+        pool->addTask(new VisibleStarTask(*this, parts[i], processor.getPartHandler(i), query));
+    pool->wait();
+}
+
+
+void FlatStarOctree::splitVisibleQuery(unsigned int nodeIndex,
+                                       const VisibleStarQuery& query,
+                                       unsigned int maxPartStars,
+                                       std::vector<QueryPart>& parts) const
+{
+    const Node& node = nodes[nodeIndex];
+
+    float minDistance;
+    if (!isNodeVisible(node, query, minDistance))
+        return;
+
+    // Parts are listed in the order that processVisibleNode would visit
+    // their stars: first the node's own stars, then each child subtree.
+    if (node.starCount != 0)
+        parts.push_back(QueryPart(nodeIndex, false));
+
+    if (childrenMayBeVisible(node, query, minDistance))
+    {
+        for (unsigned int i = 0; i < 8; ++i)
+        {
+            unsigned int child = node.firstChild + i;
+            if (subtreeStarCounts[child] > maxPartStars)
+                splitVisibleQuery(child, query, maxPartStars, parts);
+            else if (subtreeStarCounts[child] != 0)
+                parts.push_back(QueryPart(child, true));
+        }
+    }
+}
+
+
+bool FlatStarOctree::isNodeVisible(const Node& node,
+                                   const VisibleStarQuery& query,
+                                   float& minDistance) const
+{
+    // Same culling as StarOctree::processVisibleObjects
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+        if (query.frustumPlanes[i].signedDistance(node.center) < -node.scale * query.planeExtents[i])
+            return false;
+    }
+
+    minDistance = (query.obsPosition - node.center).norm() - node.scale * NODE_RADIUS_FACTOR;
+
+    return true;
+}
+
+
+bool FlatStarOctree::childrenMayBeVisible(const Node& node,
+                                          const VisibleStarQuery& query,
+                                          float minDistance) const
+{
+    return node.firstChild != 0 &&
+           (minDistance <= 0 || astro::absToAppMag(node.exclusionFactor, minDistance) <= query.limitingFactor);
+}
+
+
+void FlatStarOctree::processVisibleNode(const Node& node,
+                                        StarHandler& processor,
+                                        const VisibleStarQuery& query) const
+{
+    float minDistance;
+    if (!isNodeVisible(node, query, minDistance))
+        return;
+
+    processNodeStars(node, processor, query, minDistance);
+
+    if (childrenMayBeVisible(node, query, minDistance))
+    {
+        for (unsigned int i = 0; i < 8; ++i)
+            processVisibleNode(nodes[node.firstChild + i], processor, query);
+    }
+}
+
+
+void FlatStarOctree::processNodeStars(const Node& node,
+                                      StarHandler& processor,
+                                      const VisibleStarQuery& query,
+                                      float minDistance) const
+{
+    const Vector3f& obsPosition = query.obsPosition;
+    float limitingFactor   = query.limitingFactor;
+    float maxDistanceScale = query.maxDistanceScale;
+    float dimmest          = minDistance > 0 ? astro::appToAbsMag(limitingFactor, minDistance) : 1000;
+
+    const float* x      = &starX[0] + node.firstStar;
+    const float* y      = &starY[0] + node.firstStar;
+    const float* z      = &starZ[0] + node.firstStar;
+    const float* absMag = &starAbsMag[0] + node.firstStar;
+    const float* brightness = &starBrightness[0] + node.firstStar;
+    const float  maxOrbitDistanceSquared = MAX_STAR_ORBIT_RADIUS * MAX_STAR_ORBIT_RADIUS * DISTANCE_TEST_MARGIN;
+
+    // Only stars that pass the approximate tests below are given to
+    // processVisibleStar, which repeats them exactly.
+    unsigned int i = 0;
+
+#ifdef EIGEN_VECTORIZE_SSE
+    // Test four stars at a time, computing the distance and apparent
+    // magnitude of the stars that may be visible.
+    __m128 obsX     = _mm_set1_ps(obsPosition.x());
+    __m128 obsY     = _mm_set1_ps(obsPosition.y());
+    __m128 obsZ     = _mm_set1_ps(obsPosition.z());
+    __m128 dimmest4 = _mm_set1_ps(dimmest);
+    __m128 scale4   = _mm_set1_ps(maxDistanceScale);
+    __m128 orbit4   = _mm_set1_ps(maxOrbitDistanceSquared);
+    // appMag = absMag - 5 + 5 * log10(distance / LY_PER_PARSEC)
+    __m128 magScale  = _mm_set1_ps((float) (5.0 / log(10.0)));
+    __m128 magOffset = _mm_set1_ps((float) (-5.0 - 5.0 * log10(LY_PER_PARSEC)));
+    const Star* obj = stars + node.firstStar;
+
+    for (; i + 4 <= node.starCount; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(obsX, _mm_loadu_ps(x + i));
+        __m128 dy = _mm_sub_ps(obsY, _mm_loadu_ps(y + i));
+        __m128 dz = _mm_sub_ps(obsZ, _mm_loadu_ps(z + i));
+        __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+                                                       _mm_mul_ps(dy, dy)),
+                                            _mm_mul_ps(dz, dz));
+        __m128 absMag4 = _mm_loadu_ps(absMag + i);
+        __m128 bright  = _mm_cmplt_ps(absMag4, dimmest4);
+        __m128 near    = _mm_or_ps(_mm_cmple_ps(distanceSquared,
+                                                _mm_mul_ps(_mm_loadu_ps(brightness + i), scale4)),
+                                   _mm_cmple_ps(distanceSquared, orbit4));
+
+        int mask = _mm_movemask_ps(_mm_and_ps(bright, near));
+        if (mask == 0)
+            continue;
+
+        // The logarithm is only valid for normalized, nonzero distances;
+        // stars at or extremely close to the observer's position are left
+        // to the scalar code.
+        int positive = _mm_movemask_ps(_mm_cmpgt_ps(distanceSquared, _mm_set1_ps(1.0e-30f)));
+
+        float distance[4];
+        float appMag[4];
+        __m128 distance4 = _mm_sqrt_ps(distanceSquared);
+        _mm_storeu_ps(distance, distance4);
+        _mm_storeu_ps(appMag, _mm_add_ps(_mm_add_ps(absMag4, magOffset),
+                                         _mm_mul_ps(log_ps(distance4), magScale)));
+
+        for (unsigned int j = 0; j < 4; j++)
+        {
+            if ((mask & (1 << j)) == 0)
+                continue;
+
+            if ((positive & (1 << j)) != 0 && appMag[j] < limitingFactor - APP_MAG_TOLERANCE)
+                processor.process(obj[i + j], distance[j], appMag[j]);
+            else
+                processVisibleStar(processor, obsPosition, node.firstStar + i + j, limitingFactor);
+        }
+    }
+#endif
+
+    for (; i < node.starCount; ++i)
+    {
+        if (absMag[i] < dimmest)
+        {
+            float distanceSquared = (obsPosition - Vector3f(x[i], y[i], z[i])).squaredNorm();
+            if (distanceSquared <= brightness[i] * maxDistanceScale ||
+                distanceSquared <= maxOrbitDistanceSquared)
+            {
+                processVisibleStar(processor, obsPosition, node.firstStar + i, limitingFactor);
+            }
+        }
+    }
+
+}
+
+
+void FlatStarOctree::processVisibleStar(StarHandler& processor,
+                                        const Vector3f& obsPosition,
+                                        unsigned int starIndex,
+                                        float limitingFactor) const
+{
+    Vector3f starPos(starX[starIndex], starY[starIndex], starZ[starIndex]);
+    float distance    = (obsPosition - starPos).norm();
+    float appMag      = astro::absToAppMag(starAbsMag[starIndex], distance);
+
+    const Star& obj = stars[starIndex];
+    if (appMag < limitingFactor || (distance < MAX_STAR_ORBIT_RADIUS && obj.getOrbit()))
+        processor.process(obj, distance, appMag);
+}
+
+
+void FlatStarOctree::processCloseObjects(StarHandler& processor,
+                                         const Vector3f& obsPosition,
+                                         float boundingRadius) const
+{
+    if (!nodes.empty())
+        processCloseNode(nodes[0], processor, obsPosition, boundingRadius);
+}
+
+
+void FlatStarOctree::processCloseNode(const Node& node,
+                                      StarHandler& processor,
+                                      const Vector3f& obsPosition,
+                                      float boundingRadius) const
+{
+    float nodeDistance    = (obsPosition - node.center).norm() - node.scale * NODE_RADIUS_FACTOR;
+    if (nodeDistance > boundingRadius)
+        return;
+
+    float radiusSquared    = boundingRadius * boundingRadius;
+
+    const float* x      = &starX[0] + node.firstStar;
+    const float* y      = &starY[0] + node.firstStar;
+    const float* z      = &starZ[0] + node.firstStar;
+    const float* absMag = &starAbsMag[0] + node.firstStar;
+    const Star*  obj    = stars + node.firstStar;
+
+    for (unsigned int i = 0; i < node.starCount; ++i)
+    {
+        Vector3f offset = obsPosition - Vector3f(x[i], y[i], z[i]);
+        if (offset.squaredNorm() < radiusSquared)
+        {
+            float distance    = offset.norm();
+            float appMag      = astro::absToAppMag(absMag[i], distance);
+
+            processor.process(obj[i], distance, appMag);
+        }
+    }
+
+    if (node.firstChild != 0)
+    {
+        for (unsigned int i = 0; i < 8; ++i)
+            processCloseNode(nodes[node.firstChild + i], processor, obsPosition, boundingRadius);
+    }
+}
@@ -13,6 +13,7 @@
 #ifndef _CELENGINE_STAROCTREE_H_
 #define _CELENGINE_STAROCTREE_H_
 
+#include <vector>
 #include <celengine/star.h>
 #include <celengine/octree.h>
 
@@ -21,4 +22,130 @@ typedef DynamicOctree  <Star, float> DynamicStarOctree;
 typedef StaticOctree   <Star, float> StarOctree;
 typedef OctreeProcessor<Star, float> StarHandler;
 
+
+/*! A ParallelStarHandler supplies the star handlers for a query that is
+ *  split into parts processed by different threads. The parts are numbered
+ *  in the order that a serial traversal would visit their stars, so
+ *  handling the results part by part gives the same order as a serial
+ *  query.
+ */
+class ParallelStarHandler
+{
+ public:
+    virtual ~ParallelStarHandler() {};
+
+    // Called on the querying thread before any stars are processed.
+    virtual void setPartCount(unsigned int nParts) = 0;
+
+    // Called on the querying thread; the handlers of different parts are
+    // then used by different threads at the same time.
+    virtual StarHandler& getPartHandler(unsigned int part) = 0;
+};
+
+
+/*! FlatStarOctree is a read-only copy of a StarOctree laid out for fast
+ *  traversal. The nodes are stored in a single array in breadth-first
+ *  order, with the eight children of a node adjacent to each other. The
+ *  positions and absolute magnitudes of the stars are copied into separate
+ *  arrays (structure of arrays) so that culling the stars in a node reads
+ *  only the values it needs from contiguous memory. A per-star brightness
+ *  factor lets most stars be rejected by comparing squared distances,
+ *  without a square root or logarithm; where SSE is available, this test
+ *  is applied to four stars at once. Stars are visited in the same order
+ *  as with the StarOctree it was built from, and the same stars are found.
+ *  A visible star query may also be split between the threads of a
+ *  ThreadPool, with a ParallelStarHandler receiving the results.
+ */
+class FlatStarOctree
+{
+ public:
+    // The star array must be the one sorted by the octree; it is not
+    // copied and must remain valid for the lifetime of the FlatStarOctree.
+    FlatStarOctree(const StarOctree& root, const Star* stars, float rootSize);
+
+    void processVisibleObjects(StarHandler& processor,
+                               const Eigen::Vector3f& obsPosition,
+                               const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                               float limitingFactor) const;
+    void processVisibleObjects(ParallelStarHandler& processor,
+                               const Eigen::Vector3f& obsPosition,
+                               const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                               float limitingFactor,
+                               ThreadPool* pool) const;
+    void processCloseObjects(StarHandler& processor,
+                             const Eigen::Vector3f& obsPosition,
+                             float boundingRadius) const;
+
+    unsigned int getNodeCount() const { return nodes.size(); }
+
+ private:
+    struct Node
+    {
+        Eigen::Vector3f center;
+        float        exclusionFactor;
+        float        scale;
+        unsigned int firstChild;    // index of first of eight children, 0 if none
+        unsigned int firstStar;
+        unsigned int starCount;
+    };
+
+    struct VisibleStarQuery
+    {
+        Eigen::Vector3f obsPosition;
+        const Eigen::Hyperplane<float, 3>* frustumPlanes;
+        float planeExtents[5];
+        float limitingFactor;
+        float maxDistanceScale;
+    };
+
+    struct QueryPart
+    {
+        QueryPart(unsigned int _node, bool _subtree) : node(_node), subtree(_subtree) {}
+        unsigned int node;
+        bool subtree;       // false to process only the node's own stars
+    };
+
+    class VisibleStarTask;
+    friend class VisibleStarTask;
+
+    void initVisibleStarQuery(VisibleStarQuery& query,
+                              const Eigen::Vector3f& obsPosition,
+                              const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                              float limitingFactor) const;
+    void splitVisibleQuery(unsigned int nodeIndex,
+                           const VisibleStarQuery& query,
+                           unsigned int maxPartStars,
+                           std::vector<QueryPart>& parts) const;
+    bool isNodeVisible(const Node& node,
+                       const VisibleStarQuery& query,
+                       float& minDistance) const;
+    bool childrenMayBeVisible(const Node& node,
+                              const VisibleStarQuery& query,
+                              float minDistance) const;
+    void processVisibleNode(const Node& node,
+                            StarHandler& processor,
+                            const VisibleStarQuery& query) const;
+    void processNodeStars(const Node& node,
+                          StarHandler& processor,
+                          const VisibleStarQuery& query,
+                          float minDistance) const;
+    inline void processVisibleStar(StarHandler& processor,
+                                   const Eigen::Vector3f& obsPosition,
+                                   unsigned int starIndex,
+                                   float limitingFactor) const;
+    void processCloseNode(const Node& node,
+                          StarHandler& processor,
+                          const Eigen::Vector3f& obsPosition,
+                          float boundingRadius) const;
+
+    std::vector<Node> nodes;
+    std::vector<unsigned int> subtreeStarCounts;
+    std::vector<float> starX;
+    std::vector<float> starY;
+    std::vector<float> starZ;
+    std::vector<float> starAbsMag;
+    std::vector<float> starBrightness;
+    const Star* stars;
+};
+
 #endif  // _CELENGINE_STAROCTREE_H_
@@ -9,6 +9,7 @@
 
 #include "celestia.h"
 #include <celutil/debug.h>
+#include <celutil/filetype.h>
 #include <iostream>
 #include <fstream>
 #include "multitexture.h"
@@ -114,20 +115,30 @@ string TextureInfo::resolve(const string& baseDir)
 }
 
 
-Texture* TextureInfo::load(const string& name)
+static void textureModes(unsigned int flags,
+                         Texture::AddressMode& addressMode,
+                         Texture::MipMapMode& mipMode)
 {
-    Texture::AddressMode addressMode = Texture::EdgeClamp;
-    Texture::MipMapMode mipMode = Texture::DefaultMipMaps;
+    addressMode = Texture::EdgeClamp;
+    mipMode = Texture::DefaultMipMaps;
 
-    if (flags & WrapTexture)
+    if (flags & TextureInfo::WrapTexture)
         addressMode = Texture::Wrap;
-    else if (flags & BorderClamp)
+    else if (flags & TextureInfo::BorderClamp)
         addressMode = Texture::BorderClamp;
 
-    if (flags & NoMipMaps)
+    if (flags & TextureInfo::NoMipMaps)
         mipMode = Texture::NoMipMaps;
-    else if (flags & AutoMipMaps)
+    else if (flags & TextureInfo::AutoMipMaps)
         mipMode = Texture::AutoMipMaps;
+}
+
+
+Texture* TextureInfo::load(const string& name)
+{
+    Texture::AddressMode addressMode;
+    Texture::MipMapMode mipMode;
+    textureModes(flags, addressMode, mipMode);
 
     if (bumpHeight == 0.0f)
     {
@@ -147,3 +158,78 @@ Texture* TextureInfo::load(const string& name)
     return NULL;
 }
 
+
+/*! An image decoded on a loader thread; for bump maps, it's already been
+ *  converted to a normal map.
+ */
+class DecodedTexture : public DecodedResource
+{
+ public:
+    DecodedTexture(Image* _image) : image(_image) {};
+    ~DecodedTexture() { delete image; };
+
+    unsigned int getSize() const { return (unsigned int) image->getSize(); };
+
+    Image* image;
+};
+
+
+bool TextureInfo::canDecodeInBackground(const string& name) const
+{
+    // Virtual textures load their own tiles in the background
+    return DetermineFileType(name) != Content_CelestiaTexture;
+}
+
+
+DecodedResource* TextureInfo::decode(const string& name) const
+{
+    DPRINTF(0, "Decoding texture: %s\n", name.c_str());
+
+    Image* img = LoadImageFromFile(name);
+    if (img == NULL)
+        return NULL;
+
+    if (bumpHeight != 0.0f)
+    {
+        Texture::AddressMode addressMode;
+        Texture::MipMapMode mipMode;
+        textureModes(flags, addressMode, mipMode);
+
+        Image* normalMap = img->computeNormalMap(bumpHeight,
+                                                 addressMode == Texture::Wrap);
+        delete img;
+        if (normalMap == NULL)
+            return NULL;
+        img = normalMap;
+    }
+
+    return new DecodedTexture(img);
+}
+
+
+Texture* TextureInfo::create(const string& name, DecodedResource* decoded)
+{
+    Texture::AddressMode addressMode;
+    Texture::MipMapMode mipMode;
+    textureModes(flags, addressMode, mipMode);
+
+    Image* img = static_cast<DecodedTexture*>(decoded)->image;
+    if (bumpHeight == 0.0f)
+        return CreateTextureFromFileImage(*img, name, addressMode, mipMode);
+    else
+        return CreateTextureFromImage(*img, addressMode, Texture::DefaultMipMaps);
+}
+
+
+unsigned int TextureInfo::getResourceSize() const
+{
+    return resource != NULL ? resource->getMemoryUsage() : 0;
+}
+
+
+// Textures are looked up each time that they're used, so they may be
+// unloaded when they haven't been used for a while.
+bool TextureInfo::canUnload() const
+{
+    return true;
+}
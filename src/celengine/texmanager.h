@@ -67,6 +67,11 @@ class TextureInfo : public ResourceInfo<Texture>
 
     virtual std::string resolve(const std::string&);
     virtual Texture* load(const std::string&);
+    virtual bool canDecodeInBackground(const std::string&) const;
+    virtual DecodedResource* decode(const std::string&) const;
+    virtual Texture* create(const std::string&, DecodedResource*);
+    virtual unsigned int getResourceSize() const;
+    virtual bool canUnload() const;
 };
 
 inline bool operator<(const TextureInfo& ti0, const TextureInfo& ti1)
@@ -348,9 +348,21 @@ static int CalcMipLevelCount(int w, int h)
 }
 
 
+// Estimate the texture memory used by an image; mipmaps generated by
+// OpenGL add another third to the image size.
+static unsigned int TextureMemoryUsage(const Image& img, bool generatedMipMaps)
+{
+    unsigned int size = (unsigned int) img.getSize();
+    if (generatedMipMaps)
+        size += size / 3;
+    return size;
+}
+
+
 Texture::Texture(int w, int h, int d) :
     alpha(false),
     compressed(false),
+    memoryUsage(0),
     width(w),
     height(h),
     depth(d),
@@ -393,6 +405,12 @@ void Texture::setBorderColor(Color)
 }
 
 
+unsigned int Texture::getMemoryUsage() const
+{
+    return memoryUsage;
+}
+
+
 int Texture::getWidth() const
 {
     return width;
@@ -495,6 +513,7 @@ ImageTexture::ImageTexture(Image& img,
 
     alpha = img.hasAlpha();
     compressed = img.isCompressed();
+    memoryUsage = TextureMemoryUsage(img, mipmap && !precomputedMipMaps);
 }
 
 
@@ -567,6 +586,8 @@ TiledTexture::TiledTexture(Image& img,
     if (!precomputedMipMaps && img.isCompressed())
         mipmap = false;
 
+    memoryUsage = TextureMemoryUsage(img, mipmap && !precomputedMipMaps);
+
     GLenum texAddress = GetGLTexAddressMode(EdgeClamp);
     int internalFormat = getInternalFormat(img.getFormat());
     int components = img.getComponents();
@@ -817,6 +838,8 @@ CubeMap::CubeMap(Image* faces[]) :
             LoadMiplessTexture(*face, targetFace);
         }
     }
+
+    memoryUsage = 6 * TextureMemoryUsage(*faces[0], mipmap && !precomputedMipMaps);
 }
 
 
@@ -993,9 +1016,9 @@ static bool isPow2(int x)
 }
 #endif
 
-static Texture* CreateTextureFromImage(Image& img,
-                                       Texture::AddressMode addressMode,
-                                       Texture::MipMapMode mipMode)
+Texture* CreateTextureFromImage(Image& img,
+                                Texture::AddressMode addressMode,
+                                Texture::MipMapMode mipMode)
 {
 #if 0
     // Require texture dimensions to be powers of two.  Even though the
@@ -1063,22 +1086,33 @@ Texture* LoadTextureFromFile(const string& filename,
     if (img == NULL)
         return NULL;
 
-    Texture* tex = CreateTextureFromImage(*img, addressMode, mipMode);
+    Texture* tex = CreateTextureFromFileImage(*img, filename, addressMode, mipMode);
 
-    if (contentType == Content_DXT5NormalMap)
+    delete img;
+
+    return tex;
+}
+
+
+Texture* CreateTextureFromFileImage(Image& img,
+                                    const string& filename,
+                                    Texture::AddressMode addressMode,
+                                    Texture::MipMapMode mipMode)
+{
+    Texture* tex = CreateTextureFromImage(img, addressMode, mipMode);
+
+    if (DetermineFileType(filename) == Content_DXT5NormalMap)
     {
         // If the texture came from a .dxt5nm file then mark it as a dxt5
         // compressed normal map. There's no separate OpenGL format for dxt5
         // normal maps, so the file extension is the only thing that
         // distinguishes it from a plain old dxt5 texture.
-        if (img->getFormat() == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+        if (img.getFormat() == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
         {
             tex->setFormatOptions(Texture::DXT5NormalMap);
         }
     }
 
-    delete img;
-
     return tex;
 }
 
@@ -66,6 +66,9 @@ class Texture
 
     virtual void setBorderColor(Color);
 
+    //! Return the approximate number of bytes of texture memory used
+    virtual unsigned int getMemoryUsage() const;
+
     int getWidth() const;
     int getHeight() const;
     int getDepth() const;
@@ -105,6 +108,7 @@ class Texture
  protected:
     bool alpha;
     bool compressed;
+    unsigned int memoryUsage;
 
  private:
     int width;
@@ -180,6 +184,17 @@ extern Texture* CreateProceduralTexture(int width, int height,
 extern Texture* CreateProceduralCubeMap(int size, int format,
                                         ProceduralTexEval func);
 
+extern Texture* CreateTextureFromImage(Image& img,
+                                       Texture::AddressMode addressMode = Texture::EdgeClamp,
+                                       Texture::MipMapMode mipMode = Texture::DefaultMipMaps);
+
+// Create a texture from an image that was loaded from the named file; the
+// file type determines how the image is interpreted.
+extern Texture* CreateTextureFromFileImage(Image& img,
+                                           const std::string& filename,
+                                           Texture::AddressMode addressMode = Texture::EdgeClamp,
+                                           Texture::MipMapMode mipMode = Texture::DefaultMipMaps);
+
 extern Texture* LoadTextureFromFile(const std::string& filename,
                                     Texture::AddressMode addressMode = Texture::EdgeClamp,
                                     Texture::MipMapMode mipMode = Texture::DefaultMipMaps);
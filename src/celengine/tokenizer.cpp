@@ -8,31 +8,143 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cctype>
 #include <cmath>
 #include <iomanip>
+#include <sstream>
+#include <locale>
+#include <celutil/basictypes.h>
 #include <celutil/utf8.h>
 #include "tokenizer.h"
 
 
+static const unsigned int BufferSize = 65536;
+
+
 static bool issep(char c)
 {
     return !isdigit(c) && !isalpha(c) && c != '.';
 }
 
 
+// Powers of ten that are exactly representable as doubles
+static const double ExactPowersOfTen[] =
+{
+    1.0e0,  1.0e1,  1.0e2,  1.0e3,  1.0e4,  1.0e5,  1.0e6,  1.0e7,
+    1.0e8,  1.0e9,  1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15,
+    1.0e16, 1.0e17, 1.0e18, 1.0e19, 1.0e20, 1.0e21, 1.0e22
+};
+static const int MaxExactPowerOfTen = 22;
+
+// Decimal digits that always fit in a signed 64-bit mantissa
+static const int MaxMantissaDigits = 18;
+
+// Largest integer below which all integers are exactly representable as
+// doubles
+static const uint64 MaxExactMantissa = (uint64) 1 << 53;
+
+
+/*! A number read as a decimal mantissa and a power of ten. Numbers whose
+ *  mantissa and power of ten are both exactly representable are
+ *  converted with a single multiplication or division, which is correctly
+ *  rounded; this covers nearly all numbers in catalog files. Others are
+ *  converted from their text by the C++ library.
+ */
+struct DecimalNumber
+{
+    DecimalNumber() :
+        mantissa(0),
+        digits(0),
+        exponent(0),
+        truncated(false)
+    {
+    }
+
+    void addDigit(int digit, bool fraction)
+    {
+        if (digits < MaxMantissaDigits)
+        {
+            mantissa = mantissa * 10 + (uint64) digit;
+            // Leading zeros aren't significant
+            if (mantissa != 0)
+                digits++;
+            if (fraction)
+                exponent--;
+        }
+        else
+        {
+            if (digit != 0)
+                truncated = true;
+            if (!fraction)
+                exponent++;
+        }
+    }
+
+    double value(int explicitExponent, const string& text) const
+    {
+        if (mantissa == 0)
+            return 0.0;
+
+        int e = exponent + explicitExponent;
+        if (!truncated && mantissa <= MaxExactMantissa)
+        {
+            // Convert through int64, since some compilers can't convert
+            // unsigned 64-bit integers to double
+            double m = (double) (int64) mantissa;
+            if (e >= 0 && e <= MaxExactPowerOfTen)
+                return m * ExactPowersOfTen[e];
+            else if (e < 0 && e >= -MaxExactPowerOfTen)
+                return m / ExactPowersOfTen[-e];
+        }
+
+        // The stream is imbued with the classic locale so that the decimal
+        // point is always a period.
+        istringstream in(text);
+        in.imbue(locale::classic());
+        double x = 0.0;
+        in >> x;
+        if (in.fail())
+            x = (double) (int64) mantissa * pow(10.0, (double) e);
+
+        return x;
+    }
+
+    uint64 mantissa;
+    int digits;
+    int exponent;
+    bool truncated;
+};
+
+
 Tokenizer::Tokenizer(istream* _in) :
     in(_in),
+    bufferPos(0),
+    bufferEnd(0),
     tokenType(TokenBegin),
     haveValidNumber(false),
     haveValidName(false),
     haveValidString(false),
     pushedBack(false),
-    lineNum(1)
+    lineNum(1),
+    errorStream(&cerr)
 {
 }
 
 
+inline int Tokenizer::readChar()
+{
+    if (bufferPos == bufferEnd && !fillBuffer())
+        return -1;
+
+    int c = (unsigned char) buffer[bufferPos++];
+    if (c == '\n')
+        lineNum++;
+
+    return c;
+}
+
+
 Tokenizer::TokenType Tokenizer::nextToken()
 {
     State state = StartState;
@@ -51,7 +163,7 @@ Tokenizer::TokenType Tokenizer::nextToken()
     if (tokenType == TokenBegin)
     {
         nextChar = readChar();
-        if (in->eof())
+        if (nextChar == -1)
             return TokenEnd;
     }
     else if (tokenType == TokenEnd)
@@ -59,12 +171,11 @@ Tokenizer::TokenType Tokenizer::nextToken()
         return tokenType;
     }
 
-    double integerValue = 0;
-    double fractionValue = 0;
+    DecimalNumber number;
     double sign = 1;
-    double fracExp = 1;
-    double exponentValue = 0;
-    double exponentSign = 1;
+    int exponentValue = 0;
+    int exponentSign = 1;
+    numberText.clear();
 
     TokenType newToken = TokenBegin;
     while (newToken == TokenBegin)
@@ -79,25 +190,25 @@ Tokenizer::TokenType Tokenizer::nextToken()
             else if (isdigit(nextChar))
             {
                 state = NumberState;
-                integerValue = (int) nextChar - (int) '0';
+                number.addDigit(nextChar - '0', false);
+                numberText += (char) nextChar;
             }
             else if (nextChar == '-')
             {
                 state = NumberState;
                 sign = -1;
-                integerValue = 0;
             }
             else if (nextChar == '+')
             {
                 state = NumberState;
                 sign = +1;
-                integerValue = 0;
             }
             else if (nextChar == '.')
             {
                 state = FractionState;
                 sign = +1;
-                integerValue = 0;
+                numberText += '0';
+                numberText += '.';
             }
             else if (isalpha(nextChar) || nextChar == '_')
             {
@@ -238,15 +349,18 @@ Tokenizer::TokenType Tokenizer::nextToken()
             if (isdigit(nextChar))
             {
                 state = NumberState;
-                integerValue = integerValue * 10 + (int) nextChar - (int) '0';
+                number.addDigit(nextChar - '0', false);
+                numberText += (char) nextChar;
             }
             else if (nextChar == '.')
             {
                 state = FractionState;
+                numberText += '.';
             }
             else if (nextChar == 'e' || nextChar == 'E')
             {
                 state = ExponentFirstState;
+                numberText += 'e';
             }
             else if (issep(nextChar))
             {
@@ -264,12 +378,13 @@ Tokenizer::TokenType Tokenizer::nextToken()
             if (isdigit(nextChar))
             {
                 state = FractionState;
-                fractionValue = fractionValue * 10 + nextChar - (int) '0';
-                fracExp *= 10;
+                number.addDigit(nextChar - '0', true);
+                numberText += (char) nextChar;
             }
             else if (nextChar == 'e' || nextChar == 'E')
             {
                 state = ExponentFirstState;
+                numberText += 'e';
             }
             else if (issep(nextChar))
             {
@@ -285,12 +400,14 @@ Tokenizer::TokenType Tokenizer::nextToken()
             if (isdigit(nextChar))
             {
                 state = ExponentState;
-                exponentValue = (int) nextChar - (int) '0';
+                exponentValue = nextChar - '0';
+                numberText += (char) nextChar;
             }
             else if (nextChar == '-')
             {
                 state = ExponentState;
                 exponentSign = -1;
+                numberText += '-';
             }
             else if (nextChar == '+')
             {
@@ -298,7 +415,7 @@ Tokenizer::TokenType Tokenizer::nextToken()
             }
             else
             {
-                state = ErrorState;
+                newToken = TokenError;
                 syntaxError("Bad character in number");
             }
             break;
@@ -307,7 +424,10 @@ Tokenizer::TokenType Tokenizer::nextToken()
             if (isdigit(nextChar))
             {
                 state = ExponentState;
-                exponentValue = exponentValue * 10 + (int) nextChar - (int) '0';
+                // Larger exponents overflow or underflow anyway
+                if (exponentValue < 100000)
+                    exponentValue = exponentValue * 10 + nextChar - '0';
+                numberText += (char) nextChar;
             }
             else if (issep(nextChar))
             {
@@ -316,7 +436,7 @@ Tokenizer::TokenType Tokenizer::nextToken()
             }
             else
             {
-                state = ErrorState;
+                newToken = TokenError;
                 syntaxError("Bad character in number");
             }
             break;
@@ -325,12 +445,12 @@ Tokenizer::TokenType Tokenizer::nextToken()
             if (isdigit(nextChar))
             {
                 state = FractionState;
-                fractionValue = fractionValue * 10 + (int) nextChar - (int) '0';
-                fracExp = 10;
+                number.addDigit(nextChar - '0', true);
+                numberText += (char) nextChar;
             }
             else
             {
-                state = ErrorState;
+                newToken = TokenError;
                 syntaxError("'.' in stupid place");
             }
             break;
@@ -357,7 +477,7 @@ Tokenizer::TokenType Tokenizer::nextToken()
             }
             else
             {
-                state = ErrorState;
+                newToken = TokenError;
                 syntaxError("Bad Unicode escape in string");
             }
             break;
@@ -374,12 +494,7 @@ Tokenizer::TokenType Tokenizer::nextToken()
 
     tokenType = newToken;
     if (haveValidNumber)
-    {
-        numberValue = integerValue + fractionValue / fracExp;
-        if (exponentValue != 0)
-            numberValue *= pow(10.0, exponentValue * exponentSign);
-        numberValue *= sign;
-    }
+        numberValue = sign * number.value(exponentValue * exponentSign, numberText);
 
     return tokenType;
 }
@@ -403,30 +518,40 @@ double Tokenizer::getNumberValue()
 }
 
 
-string Tokenizer::getNameValue()
+const string& Tokenizer::getNameValue() const
 {
     return textToken;
 }
 
 
-string Tokenizer::getStringValue()
+const string& Tokenizer::getStringValue() const
 {
     return textToken;
 }
 
 
-int Tokenizer::readChar()
+bool Tokenizer::fillBuffer()
 {
-    int c = (int) in->get();
-    if (c == '\n')
-        lineNum++;
+    if (buffer.empty())
+        buffer.resize(BufferSize);
 
-    return c;
+    in->read(&buffer[0], buffer.size());
+    bufferPos = 0;
+    bufferEnd = (unsigned int) in->gcount();
+
+    return bufferEnd != 0;
 }
 
+
 void Tokenizer::syntaxError(const char* message)
 {
-    cerr << message << '\n';
+    *errorStream << message << '\n';
+}
+
+
+void Tokenizer::setErrorStream(ostream* out)
+{
+    errorStream = out;
 }
 
 
@@ -435,6 +560,7 @@ int Tokenizer::getLineNumber() const
     return lineNum;
 }
 
+
 #if 0
 // Tokenizer test
 int main(int argc, char *argv[])
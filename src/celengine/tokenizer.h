@@ -12,6 +12,7 @@
 #define _TOKENIZER_H_
 
 #include <string>
+#include <vector>
 #include <iostream>
 
 using namespace std;
@@ -45,11 +46,14 @@ public:
     TokenType getTokenType();
     void pushBack();
     double getNumberValue();
-    string getNameValue();
-    string getStringValue();
+    const string& getNameValue() const;
+    const string& getStringValue() const;
 
     int getLineNumber() const;
 
+    // Syntax errors are reported to cerr unless another stream is set.
+    void setErrorStream(ostream*);
+
 private:
     enum State
     {
@@ -69,6 +73,12 @@ private:
 
     istream* in;
 
+    // The stream is read in large blocks rather than a character at a time;
+    // a tokenizer may read past the end of the last token.
+    vector<char> buffer;
+    unsigned int bufferPos;
+    unsigned int bufferEnd;
+
     int nextChar;
     TokenType tokenType;
     bool haveValidNumber;
@@ -81,13 +91,19 @@ private:
     bool pushedBack;
 
     int readChar();
+    bool fillBuffer();
     void syntaxError(const char*);
 
     double numberValue;
 
     string textToken;
+    // Text of the current number, kept for numbers that can't be
+    // converted exactly from their decimal mantissa
+    string numberText;
 
     int lineNum;
+
+    ostream* errorStream;
 };
 
 #endif // _TOKENIZER_H_
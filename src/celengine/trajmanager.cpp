@@ -27,7 +27,7 @@ static const char UniqueSuffixChar = '!';
 TrajectoryManager* GetTrajectoryManager()
 {
     if (trajectoryManager == NULL)
-        trajectoryManager = new TrajectoryManager("data");
+        trajectoryManager = new TrajectoryManager("data", "trajectories");
     return trajectoryManager;
 }
 
@@ -62,7 +62,12 @@ Orbit* TrajectoryInfo::load(const string& filename)
 
     Orbit* sampTrajectory = NULL;
 
-    if (filetype == Content_CelestiaXYZVTrajectory)
+    if (filetype == Content_CelestiaXYZVBinary)
+    {
+        // Binary trajectories are always double precision
+        sampTrajectory = LoadBinaryTrajectory(strippedFilename, interpolation);
+    }
+    else if (filetype == Content_CelestiaXYZVTrajectory)
     {
         switch (precision)
         {
@@ -95,3 +100,11 @@ Orbit* TrajectoryInfo::load(const string& filename)
 
     return sampTrajectory;
 }
+
+
+// Trajectories are kept by the bodies that follow them, so they're never
+// unloaded; their size is only counted.
+unsigned int TrajectoryInfo::getResourceSize() const
+{
+    return resource != NULL ? resource->getMemoryUsage() : 0;
+}
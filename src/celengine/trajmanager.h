@@ -33,6 +33,7 @@ class TrajectoryInfo : public ResourceInfo<Orbit>
 
     virtual std::string resolve(const std::string&);
     virtual Orbit* load(const std::string&);
+    virtual unsigned int getResourceSize() const;
 };
 
 // Sort trajectory info records. The same trajectory can be loaded multiple times with
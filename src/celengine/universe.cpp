@@ -1096,10 +1096,14 @@ Selection Universe::findPath(const string& s,
 }
 
 
+// Return the names of objects beginning with s: solar system objects
+// first, then deep sky objects and stars. If maxCompletions is nonzero,
+// the catalogs are only searched for as many names as are still wanted.
 vector<string> Universe::getCompletion(const string& s,
                                                  Selection* contexts,
                                                  int nContexts,
-                                                 bool withLocations)
+                                                 bool withLocations,
+                                                 unsigned int maxCompletions)
 {
     vector<string> completion;
     int s_length = UTF8Length(s);
@@ -1135,16 +1139,18 @@ vector<string> Universe::getCompletion(const string& s,
     }
 
     // Deep sky objects:
-    if (dsoCatalog != NULL)
+    if (dsoCatalog != NULL && (maxCompletions == 0 || completion.size() < maxCompletions))
     {
-        vector<string> dsos  = dsoCatalog->getCompletion(s);
+        unsigned int remaining = maxCompletions == 0 ? 0 : maxCompletions - completion.size();
+        vector<string> dsos  = dsoCatalog->getCompletion(s, remaining);
         completion.insert(completion.end(), dsos.begin(), dsos.end());
     }
 
     // and finally stars;
-    if (starCatalog != NULL)
+    if (starCatalog != NULL && (maxCompletions == 0 || completion.size() < maxCompletions))
     {
-        vector<string> stars  = starCatalog->getCompletion(s);
+        unsigned int remaining = maxCompletions == 0 ? 0 : maxCompletions - completion.size();
+        vector<string> stars  = starCatalog->getCompletion(s, remaining);
         completion.insert(completion.end(), stars.begin(), stars.end());
     }
 
@@ -1155,14 +1161,15 @@ vector<string> Universe::getCompletion(const string& s,
 vector<string> Universe::getCompletionPath(const string& s,
                                            Selection* contexts,
                                            int nContexts,
-                                           bool withLocations)
+                                           bool withLocations,
+                                           unsigned int maxCompletions)
 {
     vector<string> completion;
     vector<string> locationCompletion;
     string::size_type pos = s.rfind('/', s.length());
 
     if (pos == string::npos)
-        return getCompletion(s, contexts, nContexts, withLocations);
+        return getCompletion(s, contexts, nContexts, withLocations, maxCompletions);
 
     string base(s, 0, pos);
     Selection sel = findPath(base, contexts, nContexts, true);
@@ -71,11 +71,13 @@ class Universe
     std::vector<std::string> getCompletion(const std::string& s,
                                            Selection* contexts = NULL,
                                            int nContexts = 0,
-                                           bool withLocations = false);
+                                           bool withLocations = false,
+                                           unsigned int maxCompletions = 0);
     std::vector<std::string> getCompletionPath(const std::string& s,
                                                Selection* contexts = NULL,
                                                int nContexts = 0,
-                                               bool withLocations = false);
+                                               bool withLocations = false,
+                                               unsigned int maxCompletions = 0);
 
 
     SolarSystem* getNearestSolarSystem(const UniversalCoord& position) const;
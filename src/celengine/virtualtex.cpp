@@ -13,10 +13,13 @@
 #include <cmath>
 #include <cassert>
 #include <cstdio>
+#include <algorithm>
 #include "celutil/debug.h"
 #include "celutil/directory.h"
 #include "celutil/filetype.h"
+#include "celutil/threadpool.h"
 #include "virtualtex.h"
+#include "image.h"
 #include <GL/glew.h>
 #include "parser.h"
 
@@ -24,6 +27,27 @@ using namespace std;
 
 static const int MaxResolutionLevels = 13;
 
+// Tile coordinates are ints, so no virtual texture can have more levels
+static const int MaxTileLOD = 30;
+
+// Tiles being decoded in the background at once, per texture. Tiles that
+// are still needed are requested again on later frames, so keeping the
+// queue short means that the tiles decoded are the ones needed most
+// recently.
+static const unsigned int MaxPendingLoads = 8;
+
+static uint64 memoryBudget = (uint64) 256 << 20;
+static uint64 uploadBudget = (uint64) 4 << 20;
+
+// Tile images are decoded by this pool, which is shared by all virtual
+// textures and created when the first tile is needed.
+static ThreadPool* loaderPool = NULL;
+
+// All virtual textures, for GetVirtualTextureStatistics(); they're only
+// created and destroyed on the render thread.
+static vector<VirtualTexture*> virtualTextures;
+static VirtualTexture::Statistics unloadedStats = { 0, 0, 0, 0, 0, 0 };
+
 
 // Virtual textures are composed of tiles that are loaded from the hard drive
 // as they become visible.  Hidden tiles may be evicted from graphics memory
@@ -35,6 +59,13 @@ static const int MaxResolutionLevels = 13;
 // a power of two, with width = 2 * height.  The baseSplit determines the
 // number of tiles at the lowest LOD.  It is the log base 2 of the width in
 // tiles of LOD zero.  Though it's not required
+//
+// Tile images are read and decoded on a pool of loader threads; the render
+// thread only creates textures from the decoded images, and no more than
+// the upload budget each frame. Until a tile is ready, the most detailed
+// ancestor of the tile that is resident is drawn in its place. When the
+// tiles use more memory than the memory budget, the ones that have gone
+// unused longest are evicted.
 
 static bool isPow2(int x)
 {
@@ -63,7 +94,12 @@ VirtualTexture::VirtualTexture(const string& _tilePath,
     baseSplit(_baseSplit),
     tileSize(_tileSize),
     ticks(0),
-    nResolutionLevels(0)
+    tilesRequested(0),
+    nResolutionLevels(0),
+    residentBytes(0),
+    uploadedBytes(0),
+    loadFinished(loadMutex),
+    pendingLoads(0)
 {
     assert(tileSize != 0 && isPow2(tileSize));
     tileTree[0] = new TileQuadtreeNode();
@@ -71,13 +107,74 @@ VirtualTexture::VirtualTexture(const string& _tilePath,
     tileExt = string(".") + _tileType;
     populateTileTree();
 
+    stats.hits = 0;
+    stats.misses = 0;
+    stats.evictions = 0;
+    stats.uploads = 0;
+    stats.residentTiles = 0;
+    stats.residentBytes = 0;
+
     if (DetermineFileType(tileExt) == Content_DXT5NormalMap)
         setFormatOptions(Texture::DXT5NormalMap);
+
+    virtualTextures.push_back(this);
 }
 
 
 VirtualTexture::~VirtualTexture()
 {
+    // The loader threads hold pointers to our tiles, so wait for them
+    {
+        MutexLock lock(loadMutex);
+        while (pendingLoads != 0)
+            loadFinished.wait();
+    }
+
+    for (unsigned int i = 0; i < decodedTiles.size(); i++)
+        delete decodedTiles[i].second;
+
+    deleteTileTree(tileTree[0]);
+    deleteTileTree(tileTree[1]);
+
+    unloadedStats.hits += stats.hits;
+    unloadedStats.misses += stats.misses;
+    unloadedStats.evictions += stats.evictions;
+    unloadedStats.uploads += stats.uploads;
+    virtualTextures.erase(find(virtualTextures.begin(), virtualTextures.end(), this));
+}
+
+
+/*! Reads and decodes a tile image on a loader thread. */
+class VirtualTexture::TileLoader : public ThreadTask
+{
+public:
+    TileLoader(VirtualTexture* _texture, Tile* _tile, const string& _filename) :
+        texture(_texture),
+        tile(_tile),
+        filename(_filename)
+    {
+    }
+
+    void run()
+    {
+        texture->tileLoaded(tile, LoadImageFromFile(filename));
+    }
+
+private:
+    VirtualTexture* texture;
+    Tile* tile;
+    string filename;
+};
+
+
+// Called on a loader thread; the image is picked up by the render thread
+// at the start of the next frame.
+void VirtualTexture::tileLoaded(Tile* tile, Image* img)
+{
+    MutexLock lock(loadMutex);
+    decodedTiles.push_back(make_pair(tile, img));
+    pendingLoads--;
+    loadFinished.broadcast();
 }
 
 
@@ -90,7 +187,7 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
 
     lod += baseSplit;
 
-    if (lod < 0 || (uint) lod >= nResolutionLevels ||
+    if (lod < 0 || lod > MaxTileLOD || (uint) lod >= nResolutionLevels ||
         u < 0 || u >= (2 << lod) ||
         v < 0 || v >= (1 << lod))
     {
@@ -98,9 +195,19 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
     }
     else
     {
+        // Find the most detailed tile covering the requested one,
+        // remembering the less detailed tiles on the way.
+        Tile* path[MaxTileLOD + 1];
+        uint pathLOD[MaxTileLOD + 1];
+        uint pathLength = 0;
+
         TileQuadtreeNode* node = tileTree[u >> lod];
-        Tile* tile = node->tile;
-        uint tileLOD = 0;
+        if (node->tile != NULL)
+        {
+            path[pathLength] = node->tile;
+            pathLOD[pathLength] = 0;
+            pathLength++;
+        }
 
         for (int n = 0; n < lod; n++)
         {
@@ -116,22 +223,44 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
                 node = node->children[child];
                 if (node->tile != NULL)
                 {
-                    tile = node->tile;
-                    tileLOD = n + 1;
+                    path[pathLength] = node->tile;
+                    pathLOD[pathLength] = n + 1;
+                    pathLength++;
                 }
             }
         }
 
         // No tile was found at all--not even the base texture was found
-        if (tile == NULL)
+        if (pathLength == 0)
         {
             return TextureTile(0);
         }
 
-        // Make the tile resident.
-        uint tileU = u >> (lod - tileLOD);
-        uint tileV = v >> (lod - tileLOD);
-        makeResident(tile, tileLOD, tileU, tileV);
+        // Start loading the tile if it isn't resident already
+        uint i = pathLength - 1;
+        Tile* tile = path[i];
+        tile->lastUsed = ticks;
+        if (tile->tex != NULL)
+        {
+            stats.hits++;
+        }
+        else
+        {
+            stats.misses++;
+            makeResident(tile, pathLOD[i], u >> (lod - pathLOD[i]), v >> (lod - pathLOD[i]), false);
+        }
+
+        // Until the tile is ready, use the most detailed resident tile
+        // covering it instead. If there's none at all, there's nothing
+        // sensible to draw, so load the least detailed tile right away.
+        while (path[i]->tex == NULL && i > 0)
+            i--;
+        if (path[i]->tex == NULL)
+            makeResident(path[i], pathLOD[i], u >> (lod - pathLOD[i]), v >> (lod - pathLOD[i]), true);
+
+        tile = path[i];
+        uint tileLOD = pathLOD[i];
+        tile->lastUsed = ticks;
 
         // It's possible that we failed to make the tile resident, either
         // because the texture file was bad, or there was an unresolvable
@@ -196,11 +325,39 @@ void VirtualTexture::beginUsage()
 {
     ticks++;
     tilesRequested = 0;
+    uploadedBytes = 0;
+    collectDecodedTiles();
 }
 
 
 void VirtualTexture::endUsage()
 {
+    // Tiles may only be evicted once the renderer is done with the texture
+    // names handed out by getTile.
+    evictTiles();
+}
+
+
+// Only the tiles that are resident now are counted; they're kept within
+// the virtual texture memory budget.
+unsigned int VirtualTexture::getMemoryUsage() const
+{
+    return (unsigned int) min(residentBytes, (uint64) ~0u);
+}
+
+
+VirtualTexture::Statistics VirtualTexture::getStatistics() const
+{
+    Statistics s = stats;
+    s.residentTiles = 0;
+    for (unsigned int i = 0; i < residentTiles.size(); i++)
+    {
+        if (residentTiles[i]->size != 0)
+            s.residentTiles++;
+    }
+    s.residentBytes = residentBytes;
+
+    return s;
 }
 
 
@@ -214,25 +371,27 @@ uint VirtualTexture::tileIndex(unsigned int lod,
 #endif
 
 
-ImageTexture* VirtualTexture::loadTileTexture(uint lod, uint u, uint v)
+string VirtualTexture::tileFilename(uint lod, uint u, uint v) const
 {
-    lod >>= baseSplit;
+    // The tile directories are numbered from the base split
+    lod -= baseSplit;
 
     assert(lod < (unsigned)MaxResolutionLevels);
 
     char filename[64];
     sprintf(filename, "level%d/%s%d_%d", lod, tilePrefix.c_str(), u, v);
 
-    string pathname = tilePath + filename + tileExt;
-    Image* img = LoadImageFromFile(pathname);
-    if (img == NULL)
-        return NULL;
+    return tilePath + filename + tileExt;
+}
 
+
+ImageTexture* VirtualTexture::createTileTexture(Image* img, uint lod)
+{
     ImageTexture* tex = NULL;
 
     // Only use mip maps for the LOD 0; for higher LODs, the function of mip
     // mapping is built into the texture.
-    MipMapMode mipMapMode = lod == 0 ? DefaultMipMaps : NoMipMaps;
+    MipMapMode mipMapMode = lod == baseSplit ? DefaultMipMaps : NoMipMaps;
 
     if (isPow2(img->getWidth()) && isPow2(img->getHeight()))
         tex = new ImageTexture(*img, EdgeClamp, mipMapMode);
@@ -242,24 +401,192 @@ ImageTexture* VirtualTexture::loadTileTexture(uint lod, uint u, uint v)
     // sense for them.
     compressed = img->isCompressed();
 
+    return tex;
+}
+
+
+// Replace the decoded image of a tile with a texture.
+void VirtualTexture::makeTexture(Tile* tile, uint lod)
+{
+    Image* img = tile->image;
+    unsigned int textureSize = (unsigned int) img->getSize();
+
+    // Mipmaps generated for the texture take another third
+    if (lod == baseSplit && img->getMipLevelCount() == 1)
+        textureSize += textureSize / 3;
+
+    tile->tex = createTileTexture(img, lod);
+    tile->image = NULL;
+    uploadedBytes += img->getSize();
+    residentBytes -= tile->size;
     delete img;
 
-    return tex;
+    if (tile->tex == NULL)
+    {
+        tile->size = 0;
+        tile->loadFailed = true;
+    }
+    else
+    {
+        tile->size = textureSize;
+        residentBytes += tile->size;
+        stats.uploads++;
+    }
 }
 
 
-void VirtualTexture::makeResident(Tile* tile, uint lod, uint u, uint v)
+/*! Start loading a tile in the background, or upload it if it has been
+ *  decoded and the upload budget for this frame allows. A synchronous load
+ *  reads the tile on the render thread and uploads it right away. Returns
+ *  true if the tile is resident.
+ */
+bool VirtualTexture::makeResident(Tile* tile, uint lod, uint u, uint v, bool synchronous)
 {
-    if (tile->tex == NULL && !tile->loadFailed)
+    if (tile->tex != NULL)
+        return true;
+    if (tile->loadFailed)
+        return false;
+
+    if (tile->image == NULL && (synchronous || !tile->loadPending))
     {
-        // Potentially evict other tiles in order to make this one fit
-        tile->tex = loadTileTexture(lod, u, v);
-        if (tile->tex == NULL)
+        if (synchronous)
+        {
+            // The tile may be being loaded in the background as well;
+            // the image from the loader thread is thrown away.
+            tile->image = LoadImageFromFile(tileFilename(lod, u, v));
+            if (tile->image == NULL)
+            {
+                tile->loadFailed = true;
+                return false;
+            }
+            tile->size = (unsigned int) tile->image->getSize();
+            residentBytes += tile->size;
+            residentTiles.push_back(tile);
+        }
+        else
         {
-            // cout << "Texture load failed!\n";
-            tile->loadFailed = true;
+            {
+                MutexLock lock(loadMutex);
+                if (pendingLoads >= MaxPendingLoads)
+                    return false;
+                pendingLoads++;
+            }
+
+            if (loaderPool == NULL)
+            {
+                // Reading tiles is mostly waiting for the disk, so there's
+                // no need for more than a couple of threads.
+                loaderPool = new ThreadPool(GetProcessorCount() > 2 ? 2 : 1);
+            }
+
+            tile->loadPending = true;
+            loaderPool->addTask(new TileLoader(this, tile, tileFilename(lod, u, v)));
+            return false;
         }
     }
+
+    if (tile->image != NULL)
+    {
+        uint64 imageSize = (uint64) tile->image->getSize();
+        if (synchronous || uploadedBytes == 0 || uploadedBytes + imageSize <= uploadBudget)
+            makeTexture(tile, lod);
+    }
+
+    return tile->tex != NULL;
+}
+
+
+// Pick up the images decoded by the loader threads since the last frame.
+void VirtualTexture::collectDecodedTiles()
+{
+    vector<pair<Tile*, Image*> > decoded;
+    {
+        MutexLock lock(loadMutex);
+        if (decodedTiles.empty())
+            return;
+        decoded.swap(decodedTiles);
+    }
+
+    for (unsigned int i = 0; i < decoded.size(); i++)
+    {
+        Tile* tile = decoded[i].first;
+        Image* img = decoded[i].second;
+
+        tile->loadPending = false;
+        if (img == NULL)
+        {
+            if (tile->tex == NULL && tile->image == NULL)
+                tile->loadFailed = true;
+        }
+        else if (tile->tex != NULL || tile->image != NULL)
+        {
+            // The tile was loaded synchronously in the meantime
+            delete img;
+        }
+        else
+        {
+            tile->image = img;
+            tile->size = (unsigned int) img->getSize();
+            residentBytes += tile->size;
+            residentTiles.push_back(tile);
+        }
+    }
+}
+
+
+void VirtualTexture::unloadTile(Tile* tile)
+{
+    delete tile->tex;
+    tile->tex = NULL;
+    delete tile->image;
+    tile->image = NULL;
+    residentBytes -= tile->size;
+    tile->size = 0;
+}
+
+
+static bool usedLongerAgo(const pair<unsigned int, unsigned int>& a,
+                          const pair<unsigned int, unsigned int>& b)
+{
+    return a.first > b.first;
+}
+
+
+// Evict the least recently used tiles until the tiles fit in the memory
+// budget. Tiles used since the last call to beginUsage are never evicted,
+// nor are the pinned tiles, so the budget may be exceeded when a lot of
+// tiles are visible at once.
+void VirtualTexture::evictTiles()
+{
+    if (residentBytes <= memoryBudget)
+        return;
+
+    // Order the tiles by the number of ticks since they were last used,
+    // which stays right when the tick counter wraps around.
+    vector<pair<unsigned int, unsigned int> > lru;
+    lru.reserve(residentTiles.size());
+    for (unsigned int i = 0; i < residentTiles.size(); i++)
+    {
+        Tile* tile = residentTiles[i];
+        if (tile->size != 0 && tile->lastUsed != ticks && !tile->pinned)
+            lru.push_back(make_pair(ticks - tile->lastUsed, i));
+    }
+    sort(lru.begin(), lru.end(), usedLongerAgo);
+
+    for (unsigned int i = 0; i < lru.size() && residentBytes > memoryBudget; i++)
+    {
+        unloadTile(residentTiles[lru[i].second]);
+        stats.evictions++;
+    }
+
+    // Forget the tiles that are no longer resident
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < residentTiles.size(); i++)
+    {
+        if (residentTiles[i]->size != 0)
+            residentTiles[n++] = residentTiles[i];
+    }
+    residentTiles.resize(n);
 }
 
 
@@ -327,7 +654,55 @@ void VirtualTexture::addTileToTree(Tile* tile, uint lod, uint u, uint v)
 
     // Verify that the tile doesn't already exist
     if (node->tile == NULL)
+    {
+        // The least detailed tiles are what's drawn when nothing else is
+        // resident, and they're few and small, so keep them around.
+        tile->pinned = lod == baseSplit;
         node->tile = tile;
+    }
+}
+
+
+void VirtualTexture::deleteTileTree(TileQuadtreeNode* node)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (node->children[i] != NULL)
+            deleteTileTree(node->children[i]);
+    }
+
+    if (node->tile != NULL)
+    {
+        unloadTile(node->tile);
+        delete node->tile;
+    }
+    delete node;
+}
+
+
+void SetVirtualTextureBudgets(uint64 _memoryBudget, uint64 _uploadBudget)
+{
+    memoryBudget = _memoryBudget;
+    uploadBudget = _uploadBudget;
+}
+
+
+VirtualTexture::Statistics GetVirtualTextureStatistics()
+{
+    VirtualTexture::Statistics total = unloadedStats;
+    for (vector<VirtualTexture*>::const_iterator iter = virtualTextures.begin();
+         iter != virtualTextures.end(); iter++)
+    {
+        VirtualTexture::Statistics s = (*iter)->getStatistics();
+        total.hits += s.hits;
+        total.misses += s.misses;
+        total.evictions += s.evictions;
+        total.uploads += s.uploads;
+        total.residentTiles += s.residentTiles;
+        total.residentBytes += s.residentBytes;
+    }
+
+    return total;
 }
 
 
@@ -11,10 +11,15 @@
 #define _CELENGINE_VIRTUALTEX_H_
 
 #include <string>
+#include <vector>
 #include "celutil/basictypes.h"
+#include <celutil/thread.h>
 #include <celengine/texture.h>
 
 
+class Image;
+
+
 class VirtualTexture : public Texture
 {
  public:
@@ -33,14 +38,38 @@ class VirtualTexture : public Texture
     virtual int getVTileCount(int lod) const;
     virtual void beginUsage();
     virtual void endUsage();
+    virtual unsigned int getMemoryUsage() const;
+
+    struct Statistics
+    {
+        // Tiles requested that were already resident
+        unsigned int hits;
+        // Tiles requested that had to be loaded first
+        unsigned int misses;
+        // Tiles removed from memory to stay within the memory budget
+        unsigned int evictions;
+        // Tiles copied to texture memory
+        unsigned int uploads;
+        unsigned int residentTiles;
+        uint64 residentBytes;
+    };
+
+    Statistics getStatistics() const;
 
  private:
     struct Tile
     {
-        Tile() : lastUsed(0), tex(NULL), loadFailed(false) {};
+        Tile() : lastUsed(0), tex(NULL), image(NULL), size(0), loadPending(false), loadFailed(false), pinned(false) {};
         unsigned int lastUsed;
         ImageTexture* tex;
+        // Image decoded in the background and waiting to be uploaded
+        Image* image;
+        // Memory used by the texture or image, in bytes
+        unsigned int size;
+        bool loadPending;
         bool loadFailed;
+        // Tiles of the least detailed level are never evicted
+        bool pinned;
     };
 
     struct TileQuadtreeNode
@@ -58,12 +87,18 @@ class VirtualTexture : public Texture
 
     void populateTileTree();
     void addTileToTree(Tile* tile, uint lod, uint v, uint u);
-    void makeResident(Tile* tile, uint lod, uint v, uint u);
-    ImageTexture* loadTileTexture(uint lod, uint u, uint v);
-
-    Tile* tiles;
-    Tile* findTile(unsigned int lod,
-                   unsigned int u, unsigned int v);
+    void deleteTileTree(TileQuadtreeNode* node);
+    bool makeResident(Tile* tile, uint lod, uint u, uint v, bool wait);
+    std::string tileFilename(uint lod, uint u, uint v) const;
+    ImageTexture* createTileTexture(Image* img, uint lod);
+    void makeTexture(Tile* tile, uint lod);
+    void unloadTile(Tile* tile);
+    void collectDecodedTiles();
+    void evictTiles();
+
+    class TileLoader;
+    friend class TileLoader;
+    void tileLoaded(Tile* tile, Image* img);
 
  private:
     std::string tilePath;
@@ -81,9 +116,35 @@ class VirtualTexture : public Texture
     };
 
     TileQuadtreeNode* tileTree[2];
+
+    // Tiles that have a texture or a decoded image; only touched by the
+    // render thread.
+    std::vector<Tile*> residentTiles;
+    uint64 residentBytes;
+    uint64 uploadedBytes;
+    Statistics stats;
+
+    // Guards the tiles handed back by the loader threads
+    Mutex loadMutex;
+    Condition loadFinished;
+    std::vector<std::pair<Tile*, Image*> > decodedTiles;
+    unsigned int pendingLoads;
 };
 
 
+/*! Set the memory budget shared by the tiles of each virtual texture, and
+ *  the amount of tile data copied to texture memory per frame, both in
+ *  bytes. At least one tile is uploaded each frame, whatever the upload
+ *  budget.
+ */
+extern void SetVirtualTextureBudgets(uint64 memoryBudget, uint64 uploadBudget);
+
+/*! Return the statistics of all virtual textures added together. The hit,
+ *  miss, eviction and upload counts include textures that have since been
+ *  unloaded. Must be called on the render thread.
+ */
+extern VirtualTexture::Statistics GetVirtualTextureStatistics();
+
 VirtualTexture* LoadVirtualTexture(const std::string& filename);
 
 #endif // _CELENGINE_VIRTUALTEX_H_
@@ -0,0 +1,350 @@
+// chebyorbit.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Approximate an expensive orbit with Chebyshev polynomials fitted to it
+// as they are needed.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "chebyorbit.h"
+#include <celengine/astro.h>
+#include <celmath/mathlib.h>
+#include <cmath>
+#include <cassert>
+
+using namespace Eigen;
+using namespace std;
+
+
+// Segment length to start with, as a fraction of the orbital period
+static const double InitialSegmentsPerPeriod = 4.0;
+
+// Segments are never made shorter than this fraction of the period, or than
+// one minute; fitting shorter segments costs more than it saves. Segments
+// that can't be fitted at the minimum length are evaluated directly.
+static const double MaxSegmentsPerPeriod = 64.0;
+static const double MinSegmentDuration = 1.0 / 1440.0;
+
+// The error of a fit is estimated from this many of its highest order
+// coefficients, and must be less than this fraction of the tolerance.
+static const unsigned int ErrorEstimateCoefficients = 3;
+static const double FitSafetyFactor = 0.5;
+
+// Give up on approximating an orbit if this many more segments have failed
+// to fit at the minimum length than have been fitted.
+static const unsigned int MaxExcessFailedSegments = 8;
+
+static double ephemerisCacheTolerance = 0.0;
+static unsigned int ephemerisCacheMaxSegments = 64;
+
+
+ChebyshevOrbit::ChebyshevOrbit(Orbit* _orbit,
+                               double _tolerance,
+                               unsigned int _maxSegments) :
+    orbit(_orbit),
+    tolerance(_tolerance),
+    validBegin(0.0),
+    validEnd(0.0),
+    minSegmentDuration(0.0),
+    segmentDuration(0.0),
+    fittedSegmentCount(0),
+    failedSegmentCount(0)
+{
+    assert(_maxSegments > 0);
+    orbit->getValidRange(validBegin, validEnd);
+
+    double period = orbit->getPeriod();
+    if (period > 0.0)
+    {
+        minSegmentDuration = max(period / MaxSegmentsPerPeriod, MinSegmentDuration);
+        segmentDuration = max(period / InitialSegmentsPerPeriod, minSegmentDuration);
+    }
+
+    // A segment with zero duration is empty
+    segments.resize(_maxSegments);
+    for (unsigned int i = 0; i < segments.size(); i++)
+        segments[i].duration = 0.0;
+}
+
+
+ChebyshevOrbit::~ChebyshevOrbit()
+{
+    delete orbit;
+}
+
+
+static void evaluateSegment(const double* coeffs,
+                            double u,
+                            double timeScale,
+                            Vector3d* position,
+                            Vector3d* velocity)
+{
+    const unsigned int nCoeffs = ChebyshevOrbit::CoefficientCount;
+
+    // Chebyshev polynomials and their derivatives at u
+    double t[nCoeffs];
+    double dt[nCoeffs];
+    t[0] = 1.0;
+    t[1] = u;
+    dt[0] = 0.0;
+    dt[1] = 1.0;
+    for (unsigned int j = 2; j < nCoeffs; j++)
+    {
+        t[j] = 2.0 * u * t[j - 1] - t[j - 2];
+        dt[j] = 2.0 * t[j - 1] + 2.0 * u * dt[j - 1] - dt[j - 2];
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        const double* c = coeffs + i * nCoeffs;
+        if (position != NULL)
+        {
+            double sum = 0.0;
+            for (unsigned int j = 0; j < nCoeffs; j++)
+                sum += c[j] * t[j];
+            (*position)[i] = sum;
+        }
+
+        if (velocity != NULL)
+        {
+            double sum = 0.0;
+            for (unsigned int j = 1; j < nCoeffs; j++)
+                sum += c[j] * dt[j];
+            (*velocity)[i] = sum * timeScale;
+        }
+    }
+}
+
+
+/*! Fit Chebyshev polynomials to the orbit over the segment with the
+ *  specified index and duration. Returns false if the fitted polynomials
+ *  deviate from the orbit by more than the tolerance.
+ */
+bool ChebyshevOrbit::fitSegment(int64 index, double duration, Segment& segment) const
+{
+    const unsigned int nCoeffs = CoefficientCount;
+
+    segment.index = index;
+    segment.duration = duration;
+    segment.startTime = astro::J2000 + (double) index * duration;
+
+    double halfDuration = duration * 0.5;
+    double midTime = segment.startTime + halfDuration;
+
+    // Sample the orbit at the Chebyshev nodes
+    Vector3d samples[nCoeffs];
+    for (unsigned int k = 0; k < nCoeffs; k++)
+    {
+        double u = cos(PI * (k + 0.5) / nCoeffs);
+        samples[k] = orbit->positionAtTime(midTime + u * halfDuration);
+    }
+
+    for (unsigned int j = 0; j < nCoeffs; j++)
+    {
+        Vector3d sum = Vector3d::Zero();
+        for (unsigned int k = 0; k < nCoeffs; k++)
+            sum += samples[k] * cos(PI * j * (k + 0.5) / nCoeffs);
+        sum *= (j == 0 ? 1.0 : 2.0) / nCoeffs;
+
+        for (int i = 0; i < 3; i++)
+            segment.coeffs[i * nCoeffs + j] = sum[i];
+    }
+
+    // The coefficients of a smooth function fall off rapidly, so the last
+    // few coefficients are a good estimate of the error of the fit; checking
+    // against the orbit directly would double the cost of fitting.
+    Vector3d tail = Vector3d::Zero();
+    for (unsigned int j = nCoeffs - ErrorEstimateCoefficients; j < nCoeffs; j++)
+    {
+        for (int i = 0; i < 3; i++)
+            tail[i] += fabs(segment.coeffs[i * nCoeffs + j]);
+    }
+
+    return tail.norm() <= tolerance * FitSafetyFactor;
+}
+
+
+/*! Compute the position and/or velocity from the segment containing the
+ *  specified time, fitting the segment first if necessary. Returns false
+ *  if the time can't be approximated and the orbit must be evaluated
+ *  directly.
+ */
+bool ChebyshevOrbit::evaluate(double jd, Vector3d* position, Vector3d* velocity) const
+{
+    for (;;)
+    {
+        double duration;
+        int64 index;
+        {
+            MutexLock lock(mutex);
+
+            duration = segmentDuration;
+            if (duration == 0.0)
+                return false;
+
+            index = (int64) floor((jd - astro::J2000) / duration);
+            int64 nSegments = (int64) segments.size();
+            const Segment& segment = segments[(unsigned int) (((index % nSegments) + nSegments) % nSegments)];
+            if (segment.index == index && segment.duration == duration)
+            {
+                if (!segment.approximated)
+                    return false;
+
+                double u = 2.0 * (jd - segment.startTime) / duration - 1.0;
+                evaluateSegment(segment.coeffs, u, 2.0 / duration, position, velocity);
+                return true;
+            }
+        }
+
+        // Don't approximate the orbit outside its valid range
+        double startTime = astro::J2000 + (double) index * duration;
+        if (validBegin != validEnd &&
+            (startTime < validBegin || startTime + duration > validEnd))
+        {
+            return false;
+        }
+
+        // Fitting is slow, so do it without holding the lock; if two threads
+        // fit the same segment, one of the fits is simply overwritten.
+        Segment segment;
+        segment.approximated = fitSegment(index, duration, segment);
+
+        MutexLock lock(mutex);
+        if (segmentDuration != duration)
+        {
+            // Another thread changed the segment length while we were
+            // fitting; start over.
+            continue;
+        }
+
+        if (!segment.approximated && duration * 0.5 >= minSegmentDuration)
+        {
+            // Try again with shorter segments
+            segmentDuration = duration * 0.5;
+            for (unsigned int i = 0; i < segments.size(); i++)
+                segments[i].duration = 0.0;
+            continue;
+        }
+
+        // Segments that can't be fitted even at the minimum length are
+        // stored too, so that they aren't fitted again.
+        int64 nSegments = (int64) segments.size();
+        segments[(unsigned int) (((index % nSegments) + nSegments) % nSegments)] = segment;
+        if (!segment.approximated)
+        {
+            failedSegmentCount++;
+            if (failedSegmentCount > fittedSegmentCount + MaxExcessFailedSegments)
+                segmentDuration = 0.0;
+            return false;
+        }
+        fittedSegmentCount++;
+
+        double u = 2.0 * (jd - segment.startTime) / duration - 1.0;
+        evaluateSegment(segment.coeffs, u, 2.0 / duration, position, velocity);
+        return true;
+    }
+}
+
+
+Vector3d ChebyshevOrbit::computePosition(double jd) const
+{
+    Vector3d position;
+    if (!evaluate(jd, &position, NULL))
+        position = orbit->positionAtTime(jd);
+    return position;
+}
+
+
+Vector3d ChebyshevOrbit::computeVelocity(double jd) const
+{
+    Vector3d velocity;
+    if (!evaluate(jd, NULL, &velocity))
+        velocity = orbit->velocityAtTime(jd);
+    return velocity;
+}
+
+
+double ChebyshevOrbit::getPeriod() const
+{
+    return orbit->getPeriod();
+}
+
+
+double ChebyshevOrbit::getBoundingRadius() const
+{
+    return orbit->getBoundingRadius();
+}
+
+
+bool ChebyshevOrbit::isPeriodic() const
+{
+    return orbit->isPeriodic();
+}
+
+
+void ChebyshevOrbit::getValidRange(double& begin, double& end) const
+{
+    orbit->getValidRange(begin, end);
+}
+
+
+bool ChebyshevOrbit::isThreadSafe() const
+{
+    return orbit->isThreadSafe();
+}
+
+
+unsigned int ChebyshevOrbit::getMemoryUsage() const
+{
+    return (unsigned int) (segments.size() * sizeof(Segment)) + orbit->getMemoryUsage();
+}
+
+
+// Some orbits sample themselves more sparsely than the default
+// implementation does, so sample with the parameters of the approximated
+// orbit, but evaluate the approximation.
+void ChebyshevOrbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
+{
+    AdaptiveSamplingParameters samplingParams;
+    orbit->getSamplingParameters(startTime, endTime, samplingParams);
+    adaptiveSample(startTime, endTime, proc, samplingParams);
+}
+
+
+/*! Return the current segment length in days; zero means that the orbit
+ *  couldn't be approximated and is always evaluated directly.
+ */
+double ChebyshevOrbit::getSegmentDuration() const
+{
+    MutexLock lock(mutex);
+    return segmentDuration;
+}
+
+
+/*! Return the number of segments that have been fitted and stored. */
+unsigned int ChebyshevOrbit::getFittedSegmentCount() const
+{
+    MutexLock lock(mutex);
+    return fittedSegmentCount;
+}
+
+
+void SetEphemerisCacheParameters(double tolerance, unsigned int maxSegments)
+{
+    ephemerisCacheTolerance = tolerance;
+    if (maxSegments > 0)
+        ephemerisCacheMaxSegments = maxSegments;
+}
+
+
+Orbit* CreateEphemerisCache(Orbit* orbit)
+{
+    if (orbit == NULL || ephemerisCacheTolerance <= 0.0)
+        return orbit;
+    else
+        return new ChebyshevOrbit(orbit, ephemerisCacheTolerance, ephemerisCacheMaxSegments);
+}
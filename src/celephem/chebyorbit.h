@@ -0,0 +1,104 @@
+// chebyorbit.h
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Approximate an expensive orbit with Chebyshev polynomials fitted to it
+// as they are needed.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELENGINE_CHEBYORBIT_H_
+#define _CELENGINE_CHEBYORBIT_H_
+
+#include "orbit.h"
+#include <celutil/basictypes.h>
+#include <celutil/thread.h>
+#include <vector>
+
+
+/*! A ChebyshevOrbit approximates another orbit--typically an analytic
+ *  theory with hundreds of periodic terms--with Chebyshev polynomials, much
+ *  like the JPL ephemerides do. Time is divided into segments of equal
+ *  length; the first time a segment is needed, the wrapped orbit is
+ *  evaluated at the Chebyshev nodes of the segment and the coefficients
+ *  are computed. If the error, estimated from the highest order
+ *  coefficients, exceeds the tolerance, the segment length is halved and
+ *  all segments are discarded. Once the segments reach a minimum length,
+ *  those that still can't be fitted are evaluated directly, and if most
+ *  of them can't be fitted, the approximation is abandoned altogether.
+ *
+ *  Segments are kept in a fixed size table indexed by segment number, so
+ *  the memory used by the orbit is bounded. Segments that would extend
+ *  beyond the valid range of the wrapped orbit aren't approximated.
+ */
+class ChebyshevOrbit : public CachingOrbit
+{
+ public:
+    ChebyshevOrbit(Orbit* _orbit,
+                   double _tolerance,
+                   unsigned int _maxSegments);
+    virtual ~ChebyshevOrbit();
+
+    virtual Eigen::Vector3d computePosition(double jd) const;
+    virtual Eigen::Vector3d computeVelocity(double jd) const;
+    virtual double getPeriod() const;
+    virtual double getBoundingRadius() const;
+    virtual bool isPeriodic() const;
+    virtual void getValidRange(double& begin, double& end) const;
+    virtual bool isThreadSafe() const;
+    virtual unsigned int getMemoryUsage() const;
+    virtual void sample(double startTime, double endTime, OrbitSampleProc& proc) const;
+
+    const Orbit* getApproximatedOrbit() const { return orbit; }
+    double getSegmentDuration() const;
+    unsigned int getFittedSegmentCount() const;
+
+    enum
+    {
+        CoefficientCount = 32,
+    };
+
+ private:
+    struct Segment
+    {
+        int64 index;
+        double startTime;
+        double duration;
+        bool approximated;
+        double coeffs[3 * CoefficientCount];
+    };
+
+    bool fitSegment(int64 index, double duration, Segment& segment) const;
+    bool evaluate(double jd, Eigen::Vector3d* position, Eigen::Vector3d* velocity) const;
+
+ private:
+    Orbit* orbit;
+    double tolerance;
+    double validBegin;
+    double validEnd;
+    double minSegmentDuration;
+
+    // Everything below is guarded by the mutex
+    mutable Mutex mutex;
+    mutable double segmentDuration;
+    mutable std::vector<Segment> segments;
+    mutable unsigned int fittedSegmentCount;
+    mutable unsigned int failedSegmentCount;
+};
+
+
+/*! Set the tolerance (in kilometers) and the maximum number of segments per
+ *  orbit used by orbits created with CreateEphemerisCache(). A tolerance of
+ *  zero disables the ephemeris cache.
+ */
+extern void SetEphemerisCacheParameters(double tolerance, unsigned int maxSegments);
+
+/*! Wrap an orbit in a ChebyshevOrbit if the ephemeris cache is enabled;
+ *  otherwise, just return the orbit.
+ */
+extern Orbit* CreateEphemerisCache(Orbit* orbit);
+
+#endif // _CELENGINE_CHEBYORBIT_H_
@@ -10,6 +10,7 @@
 #include "customorbit.h"
 #include "vsop87.h"
 #include "jpleph.h"
+#include "chebyorbit.h"
 #include <celengine/astro.h>
 #include <celmath/mathlib.h>
 #include <celmath/geomutil.h>
@@ -1579,7 +1580,6 @@ class IoOrbit : public CachingOrbit
           - 1.15e-3*sin(2*(l1 - 2*l2 + w2)) + 8.9e-4*sin(p2 - p4)
           + 8.5e-4*sin(l1 + p3 - 2*LPEJ - 2*G) + 8.3e-4*sin(w2 - w3)
           + 5.3e-4*sin(psi - w2);
-    sigma = pfmod(sigma, 360.0);
     sigma = degToRad(sigma);
     L = l1 + sigma;
 
@@ -1668,7 +1668,6 @@ class EuropaOrbit : public CachingOrbit
           - 4.3e-4*sin(l1 - p3) + 4.1e-4*sin(5*(l2 - l3))
           + 4.1e-4*sin(p4 - LPEJ) + 3.2e-4*sin(w2 - w3)
           + 3.2e-4*sin(2*(l3 - G - LPEJ));
-    sigma = pfmod(sigma, 360.0);
     sigma = degToRad(sigma);
     L = l2 + sigma;
 
@@ -1763,7 +1762,6 @@ class GanymedeOrbit : public CachingOrbit
           + 2.6e-4*sin(l3 - LPEJ - G) + 2.4e-4*sin(l2 - 3*l3 + 2*l4)
           + 2.1e-4*sin(2*(l3 - LPEJ - G)) - 2.1e-4*sin(l3 - p2)
           + 1.7e-4*sin(l3 - p3);
-    sigma = pfmod(sigma, 360.0);
     sigma = degToRad(sigma);
     L = l3 + sigma;
 
@@ -1887,7 +1885,6 @@ class CallistoOrbit : public CachingOrbit
         - 1.9e-4*sin(2*l4 - p3 - p4)
         - 1.8e-4*sin(l4 - p4 + G)
         - 1.6e-4*sin(l4 + p3 - 2*LPEJ - 2*G);
-    sigma = pfmod(sigma, 360.0);
     sigma = degToRad(sigma);
     L = l4 + sigma;
 
@@ -3170,25 +3167,25 @@ Orbit* GetCustomOrbit(const string& name)
     }
 
     if (name == "mercury")
-        return new MixedOrbit(new MercuryOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(CreateEphemerisCache(new MercuryOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "venus")
-        return new MixedOrbit(new VenusOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(CreateEphemerisCache(new VenusOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "earth")
-        return new MixedOrbit(new EarthOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(CreateEphemerisCache(new EarthOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "moon")
-        return new MixedOrbit(new LunarOrbit(), yearToJD(-2000), yearToJD(4000), astro::EarthMass + astro::LunarMass);
+        return new MixedOrbit(CreateEphemerisCache(new LunarOrbit()), yearToJD(-2000), yearToJD(4000), astro::EarthMass + astro::LunarMass);
     if (name == "mars")
-        return new MixedOrbit(new MarsOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(CreateEphemerisCache(new MarsOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "jupiter")
-        return new MixedOrbit(new JupiterOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(CreateEphemerisCache(new JupiterOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "saturn")
-        return new MixedOrbit(new SaturnOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(CreateEphemerisCache(new SaturnOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "uranus")
-        return new MixedOrbit(new UranusOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(CreateEphemerisCache(new UranusOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "neptune")
-        return new MixedOrbit(new NeptuneOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(CreateEphemerisCache(new NeptuneOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "pluto")
-        return new MixedOrbit(new PlutoOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(CreateEphemerisCache(new PlutoOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 
     // Two styles of custom orbit name are permitted for JPL ephemeris orbits.
     // The preferred is <ephemeris>-<object>, e.g. jpl-mercury. But the reverse
@@ -3249,54 +3246,54 @@ Orbit* GetCustomOrbit(const string& name)
 
     // HTC2.0 ephemeris for Saturnian satellites in Lagrange points of Tethys and Dione
     if (name == "htc20-helene")
-        return HTC20Orbit::CreateHeleneOrbit();
+        return CreateEphemerisCache(HTC20Orbit::CreateHeleneOrbit());
     if (name == "htc20-telesto")
-        return HTC20Orbit::CreateTelestoOrbit();
+        return CreateEphemerisCache(HTC20Orbit::CreateTelestoOrbit());
     if (name == "htc20-calypso")
-        return HTC20Orbit::CreateCalypsoOrbit();
+        return CreateEphemerisCache(HTC20Orbit::CreateCalypsoOrbit());
 
     if (name == "phobos")
-        return new PhobosOrbit();
+        return CreateEphemerisCache(new PhobosOrbit());
     if (name == "deimos")
-        return new DeimosOrbit();
+        return CreateEphemerisCache(new DeimosOrbit());
     if (name == "io")
-        return new IoOrbit();
+        return CreateEphemerisCache(new IoOrbit());
     if (name == "europa")
-        return new EuropaOrbit();
+        return CreateEphemerisCache(new EuropaOrbit());
     if (name == "ganymede")
-        return new GanymedeOrbit();
+        return CreateEphemerisCache(new GanymedeOrbit());
     if (name == "callisto")
-        return new CallistoOrbit();
+        return CreateEphemerisCache(new CallistoOrbit());
     if (name == "mimas")
-        return new MimasOrbit();
+        return CreateEphemerisCache(new MimasOrbit());
     if (name == "enceladus")
-        return new EnceladusOrbit();
+        return CreateEphemerisCache(new EnceladusOrbit());
     if (name == "tethys")
-        return new TethysOrbit();
+        return CreateEphemerisCache(new TethysOrbit());
     if (name == "dione")
-        return new DioneOrbit();
+        return CreateEphemerisCache(new DioneOrbit());
     if (name == "rhea")
-        return new RheaOrbit();
+        return CreateEphemerisCache(new RheaOrbit());
     if (name == "titan")
-        return new TitanOrbit();
+        return CreateEphemerisCache(new TitanOrbit());
     if (name == "hyperion")
-        return new HyperionOrbit();
+        return CreateEphemerisCache(new HyperionOrbit());
     if (name == "iapetus")
-        return new IapetusOrbit();
+        return CreateEphemerisCache(new IapetusOrbit());
     if (name == "phoebe")
-        return new PhoebeOrbit();
+        return CreateEphemerisCache(new PhoebeOrbit());
     if (name == "miranda")
-        return CreateUranianSatelliteOrbit(1);
+        return CreateEphemerisCache(CreateUranianSatelliteOrbit(1));
     if (name == "ariel")
-        return CreateUranianSatelliteOrbit(2);
+        return CreateEphemerisCache(CreateUranianSatelliteOrbit(2));
     if (name == "umbriel")
-        return CreateUranianSatelliteOrbit(3);
+        return CreateEphemerisCache(CreateUranianSatelliteOrbit(3));
     if (name == "titania")
-        return CreateUranianSatelliteOrbit(4);
+        return CreateEphemerisCache(CreateUranianSatelliteOrbit(4));
     if (name == "oberon")
-        return CreateUranianSatelliteOrbit(5);
+        return CreateEphemerisCache(CreateUranianSatelliteOrbit(5));
     if (name == "triton")
-        return new TritonOrbit();
+        return CreateEphemerisCache(new TritonOrbit());
     else
         return CreateVSOP87Orbit(name);
 }
@@ -13,6 +13,7 @@
 #include <celmath/mathlib.h>
 #include <celmath/solve.h>
 #include <celmath/geomutil.h>
+#include <celutil/atomic.h>
 #include <functional>
 #include <algorithm>
 #include <cmath>
@@ -42,7 +43,7 @@ static Vector3d cubicInterpolate(const Vector3d& p0, const Vector3d& v0,
   *
   * Subclasses of orbit should override this method as necessary. The default
   * implementation uses an adaptive sampling scheme with the following defaults:
-  *    tolerance: 1 km
+  *    tolerance: 1 km, or 1e-4 R for orbits with a bounding radius R < 10000 km
   *    start step: T / 1e5
   *    min step: T / 1e7
   *    max step: T / 100
@@ -51,6 +52,18 @@ static Vector3d cubicInterpolate(const Vector3d& p0, const Vector3d& v0,
   * time span for aperiodic trajectories.
   */
 void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
+{
+    AdaptiveSamplingParameters samplingParams;
+    getSamplingParameters(startTime, endTime, samplingParams);
+    adaptiveSample(startTime, endTime, proc, samplingParams);
+}
+
+
+/** Return the adaptive sampling parameters used by the default
+  * implementation of sample(). Orbits that only need different parameters
+  * should override this method rather than sample().
+  */
+void Orbit::getSamplingParameters(double startTime, double endTime, AdaptiveSamplingParameters& samplingParams) const
 {
     double span = 0.0;
     if (isPeriodic())
@@ -72,13 +85,10 @@ void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) cons
         }
     }
 
-    AdaptiveSamplingParameters samplingParams;
-    samplingParams.tolerance = 1.0; // kilometers
+    samplingParams.tolerance = min(1.0, getBoundingRadius() * 1.0e-4); // kilometers
     samplingParams.maxStep = span / 100.0;
     samplingParams.minStep = span / 1.0e7;
     samplingParams.startStep = span / 1.0e5;
-
-    adaptiveSample(startTime, endTime, proc, samplingParams);
 }
 
 
@@ -435,6 +445,7 @@ double EllipticalOrbit::getBoundingRadius() const
 
 
 CachingOrbit::CachingOrbit() :
+    cacheSequence(0),
 	lastTime(-1.0e30),
 	positionCacheValid(false),
 	velocityCacheValid(false)
@@ -449,39 +460,82 @@ CachingOrbit::~CachingOrbit()
 
 Vector3d CachingOrbit::positionAtTime(double jd) const
 {
-    if (jd != lastTime)
+    int32 seq = AtomicLoad(cacheSequence);
+    AtomicReadBarrier();
+    if ((seq & 1) == 0 && jd == lastTime && positionCacheValid)
     {
-        lastTime = jd;
-        lastPosition = computePosition(jd);
-		positionCacheValid = true;
-		velocityCacheValid = false;
+        Vector3d pos = lastPosition;
+        AtomicReadBarrier();
+        if (AtomicLoad(cacheSequence) == seq)
+            return pos;
     }
-	else if (!positionCacheValid)
-	{
-		lastPosition = computePosition(jd);
-		positionCacheValid = true;
-	}
 
-    return lastPosition;
+    Vector3d pos = computePosition(jd);
+    updateCache(jd, &pos, NULL);
+
+    return pos;
 }
 
 
 Vector3d CachingOrbit::velocityAtTime(double jd) const
 {
-	if (jd != lastTime)
-	{
-		lastVelocity = computeVelocity(jd);
-		lastTime = jd;  // must be set *after* call to computeVelocity
-		positionCacheValid = false;
-		velocityCacheValid = true;
-	}
-	else if (!velocityCacheValid)
-	{
-		lastVelocity = computeVelocity(jd);
-		velocityCacheValid = true;
-	}
+    int32 seq = AtomicLoad(cacheSequence);
+    AtomicReadBarrier();
+    if ((seq & 1) == 0 && jd == lastTime && velocityCacheValid)
+    {
+        Vector3d vel = lastVelocity;
+        AtomicReadBarrier();
+        if (AtomicLoad(cacheSequence) == seq)
+            return vel;
+    }
+
+    // computeVelocity() may itself update the cached position, so the
+    // cache must be updated *after* the call.
+    Vector3d vel = computeVelocity(jd);
+    updateCache(jd, NULL, &vel);
 
-	return lastVelocity;
+    return vel;
+}
+
+
+/*! Store a newly computed position and/or velocity in the cache. Values for
+ *  the cached time are merged; values for another time replace the cache.
+ *  If another thread is updating the cache, the new values are dropped.
+ */
+void CachingOrbit::updateCache(double jd,
+                               const Vector3d* position,
+                               const Vector3d* velocity) const
+{
+    int32 seq = AtomicLoad(cacheSequence);
+    if ((seq & 1) != 0)
+        return;
+
+    // Sequence numbers are allowed to wrap around
+    int32 busySeq = (int32) ((uint32) seq + 1);
+    if (!AtomicCompareAndSwap(cacheSequence, seq, busySeq))
+        return;
+
+    if (jd != lastTime)
+    {
+        lastTime = jd;
+        positionCacheValid = false;
+        velocityCacheValid = false;
+    }
+
+    if (position != NULL)
+    {
+        lastPosition = *position;
+        positionCacheValid = true;
+    }
+
+    if (velocity != NULL)
+    {
+        lastVelocity = *velocity;
+        velocityCacheValid = true;
+    }
+
+    AtomicWriteBarrier();
+    AtomicStore(cacheSequence, (int32) ((uint32) busySeq + 1));
 }
 
 
@@ -646,6 +700,12 @@ void MixedOrbit::sample(double startTime, double endTime, OrbitSampleProc& proc)
 }
 
 
+bool MixedOrbit::isThreadSafe() const
+{
+    return primary->isThreadSafe();
+}
+
+
 /*** FixedOrbit ***/
 
 FixedOrbit::FixedOrbit(const Vector3d& pos) :
@@ -734,3 +794,11 @@ void SynchronousOrbit::sample(double /* startTime */, double /* endTime */, Orbi
 }
 
 
+// The position depends on the body's rotation model, which caches its last
+// result without any protection against concurrent access.
+bool SynchronousOrbit::isThreadSafe() const
+{
+    return false;
+}
+
+
@@ -10,11 +10,19 @@
 #ifndef _CELENGINE_ORBIT_H_
 #define _CELENGINE_ORBIT_H_
 
+#include <celutil/basictypes.h>
 #include <Eigen/Core>
 
 
 class OrbitSampleProc;
 
+/*! Orbits may be evaluated from several threads at once: positionAtTime()
+ *  and velocityAtTime() must not modify any state that isn't protected
+ *  against concurrent access. Orbits that can't meet this requirement
+ *  (because they call into a scripting language, for instance) must
+ *  override isThreadSafe() to return false, and callers evaluating orbits
+ *  on more than one thread must check it first.
+ */
 class Orbit
 {
  public:
@@ -44,6 +52,15 @@ class Orbit
     virtual void getValidRange(double& begin, double& end) const
         { begin = 0.0; end = 0.0; };
 
+    // Return true if the orbit may be evaluated from several threads
+    // at the same time.
+    virtual bool isThreadSafe() const { return true; };
+
+    // Return the approximate number of bytes used by the orbit's data,
+    // such as trajectory samples; zero for orbits computed from a few
+    // elements.
+    virtual unsigned int getMemoryUsage() const { return 0; };
+
     struct AdaptiveSamplingParameters
     {
         double tolerance;
@@ -52,6 +69,9 @@ class Orbit
         double maxStep;
     };
 
+    // Return the parameters used by the default implementation of sample()
+    virtual void getSamplingParameters(double startTime, double endTime, AdaptiveSamplingParameters& samplingParameters) const;
+
     void adaptiveSample(double startTime, double endTime, OrbitSampleProc& proc, const AdaptiveSamplingParameters& samplingParameters) const;
 };
 
@@ -119,6 +139,13 @@ class CachingOrbit : public Orbit
     Eigen::Vector3d velocityAtTime(double jd) const;
 
  private:
+    void updateCache(double jd, const Eigen::Vector3d* position, const Eigen::Vector3d* velocity) const;
+
+    // The cached values are guarded by a sequence number rather than a
+    // lock: it's odd while a thread is updating the cache and changes with
+    // every update. Nobody ever waits for the cache; a thread that finds it
+    // busy or sees it change while reading it just computes the value.
+    mutable volatile int32 cacheSequence;
     mutable Eigen::Vector3d lastPosition;
     mutable Eigen::Vector3d lastVelocity;
     mutable double lastTime;
@@ -144,6 +171,7 @@ class MixedOrbit : public Orbit
     virtual double getPeriod() const;
     virtual double getBoundingRadius() const;
     virtual void sample(double startTime, double endTime, OrbitSampleProc& proc) const;
+    virtual bool isThreadSafe() const;
 
  private:
     Orbit* primary;
@@ -173,6 +201,7 @@ class SynchronousOrbit : public Orbit
     virtual double getPeriod() const;
     virtual double getBoundingRadius() const;
     virtual void sample(double, double, OrbitSampleProc& proc) const;
+    virtual bool isThreadSafe() const;
 
  private:
     const Body& body;
@@ -14,7 +14,11 @@
 #include "samporbit.h"
 #include <celengine/astro.h>
 #include <celmath/mathlib.h>
+#include <celutil/mappedfile.h>
+#include <celutil/bytes.h>
+#include <celutil/atomic.h>
 #include <cmath>
+#include <cstring>
 #include <string>
 #include <algorithm>
 #include <vector>
@@ -76,6 +80,7 @@ public:
 
     bool isPeriodic() const;
     void getValidRange(double& begin, double& end) const;
+    unsigned int getMemoryUsage() const;
 
     virtual void sample(double startTime, double endTime, OrbitSampleProc& proc) const;
 
@@ -83,7 +88,9 @@ private:
     vector<Sample<T> > samples;
     double boundingRadius;
     double period;
-    mutable int lastSample;
+    // Span found by the last lookup; it's only a starting point for the
+    // next lookup, so threads may overwrite each other's values.
+    mutable volatile int32 lastSample;
 
     TrajectoryInterpolation interpolation;
 };
@@ -117,6 +124,12 @@ template <typename T> void SampledOrbit<T>::addSample(double t, double x, double
     samples.insert(samples.end(), samp);
 }
 
+template <typename T> unsigned int SampledOrbit<T>::getMemoryUsage() const
+{
+    return (unsigned int) (samples.capacity() * sizeof(Sample<T>));
+}
+
+
 template <typename T> double SampledOrbit<T>::getPeriod() const
 {
     return samples[samples.size() - 1].t - samples[0].t;
@@ -177,7 +190,7 @@ template <typename T> Vector3d SampledOrbit<T>::computePosition(double jd) const
     {
         Sample<T> samp;
         samp.t = jd;
-        int n = lastSample;
+        int n = AtomicLoad(lastSample);
 
         if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
         {
@@ -189,7 +202,7 @@ template <typename T> Vector3d SampledOrbit<T>::computePosition(double jd) const
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            AtomicStore(lastSample, n);
         }
 
         if (n == 0)
@@ -292,7 +305,7 @@ template <typename T> Vector3d SampledOrbit<T>::computeVelocity(double jd) const
     {
         Sample<T> samp;
         samp.t = jd;
-        int n = lastSample;
+        int n = AtomicLoad(lastSample);
 
         if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
         {
@@ -303,7 +316,7 @@ template <typename T> Vector3d SampledOrbit<T>::computeVelocity(double jd) const
                 n = samples.size();
             else
                 n = iter - samples.begin();
-            lastSample = n;
+            AtomicStore(lastSample, n);
         }
 
         if (n == 0)
@@ -446,6 +459,7 @@ public:
 
     bool isPeriodic() const;
     void getValidRange(double& begin, double& end) const;
+    unsigned int getMemoryUsage() const;
 
     virtual void sample(double startTime, double endTime, OrbitSampleProc& proc) const;
 
@@ -453,7 +467,9 @@ private:
     vector<SampleXYZV<T> > samples;
     double boundingRadius;
     double period;
-    mutable int lastSample;
+    // Span found by the last lookup; it's only a starting point for the
+    // next lookup, so threads may overwrite each other's values.
+    mutable volatile int32 lastSample;
 
     TrajectoryInterpolation interpolation;
 };
@@ -491,6 +507,12 @@ template <typename T> void SampledOrbitXYZV<T>::addSample(double t, const Vector
     samples.push_back(samp);
 }
 
+template <typename T> unsigned int SampledOrbitXYZV<T>::getMemoryUsage() const
+{
+    return (unsigned int) (samples.capacity() * sizeof(SampleXYZV<T>));
+}
+
+
 template <typename T> double SampledOrbitXYZV<T>::getPeriod() const
 {
     if (samples.empty())
@@ -534,7 +556,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computePosition(double jd) c
     {
         SampleXYZV<T> samp;
         samp.t = jd;
-        int n = lastSample;
+        int n = AtomicLoad(lastSample);
 
         if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
         {
@@ -546,7 +568,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computePosition(double jd) c
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            AtomicStore(lastSample, n);
         }
 
         if (n == 0)
@@ -605,7 +627,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) c
     {
         SampleXYZV<T> samp;
         samp.t = jd;
-        int n = lastSample;
+        int n = AtomicLoad(lastSample);
 
         if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
         {
@@ -617,7 +639,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) c
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            AtomicStore(lastSample, n);
         }
 
         if (n > 0 && n < (int) samples.size())
@@ -671,6 +693,344 @@ template <typename T> void SampledOrbitXYZV<T>::sample(double /* startTime */, d
 }
 
 
+// Sampled trajectory read from a binary trajectory file. The samples are
+// used in place in the memory mapped file; they're only copied when the
+// file can't be mapped or its byte order differs from the machine's. No
+// state is kept between evaluations: in fixed step files the span
+// containing a time is computed directly, and in variable step files it's
+// found by binary search.
+class BinarySampledOrbit : public CachingOrbit
+{
+public:
+    BinarySampledOrbit(const BinaryTrajectoryHeader& header,
+                       MappedFile* file,
+                       const double* records,
+                       TrajectoryInterpolation interpolation);
+    BinarySampledOrbit(const BinaryTrajectoryHeader& header,
+                       const vector<double>& records,
+                       TrajectoryInterpolation interpolation);
+    virtual ~BinarySampledOrbit();
+
+    double getPeriod() const;
+    double getBoundingRadius() const;
+    Vector3d computePosition(double jd) const;
+    Vector3d computeVelocity(double jd) const;
+
+    bool isPeriodic() const;
+    void getValidRange(double& begin, double& end) const;
+    unsigned int getMemoryUsage() const;
+
+    virtual void sample(double startTime, double endTime, OrbitSampleProc& proc) const;
+
+private:
+    void init(const BinaryTrajectoryHeader& header);
+
+    double sampleTime(unsigned int i) const
+    {
+        return fixedStep ? startTime + i * stepSize : records[i * recordSize];
+    }
+
+    Vector3d samplePosition(unsigned int i) const
+    {
+        const double* p = records + i * recordSize + positionOffset;
+        return Vector3d(p[0], p[1], p[2]);
+    }
+
+    unsigned int findSpan(double jd) const;
+    Vector3d estimateVelocity(unsigned int i) const;
+    void getSpanTangents(unsigned int n, Vector3d& v0, Vector3d& v1) const;
+
+private:
+    MappedFile* file;
+    vector<double> copiedRecords;
+    const double* records;
+    unsigned int sampleCount;
+    unsigned int recordSize;
+    unsigned int positionOffset;
+    bool hasVelocities;
+    bool fixedStep;
+    double startTime;
+    double stepSize;
+    double boundingRadius;
+
+    TrajectoryInterpolation interpolation;
+};
+
+
+BinarySampledOrbit::BinarySampledOrbit(const BinaryTrajectoryHeader& header,
+                                       MappedFile* _file,
+                                       const double* _records,
+                                       TrajectoryInterpolation _interpolation) :
+    file(_file),
+    records(_records),
+    interpolation(_interpolation)
+{
+    init(header);
+}
+
+
+BinarySampledOrbit::BinarySampledOrbit(const BinaryTrajectoryHeader& header,
+                                       const vector<double>& _records,
+                                       TrajectoryInterpolation _interpolation) :
+    file(NULL),
+    copiedRecords(_records),
+    interpolation(_interpolation)
+{
+    records = &copiedRecords[0];
+    init(header);
+}
+
+
+BinarySampledOrbit::~BinarySampledOrbit()
+{
+    delete file;
+}
+
+
+void BinarySampledOrbit::init(const BinaryTrajectoryHeader& header)
+{
+    sampleCount = header.sampleCount;
+    hasVelocities = (header.flags & BinaryTrajectoryVelocities) != 0;
+    fixedStep = (header.flags & BinaryTrajectoryFixedStep) != 0;
+    positionOffset = fixedStep ? 0 : 1;
+    recordSize = positionOffset + (hasVelocities ? 6 : 3);
+    startTime = header.startTime;
+    stepSize = header.stepSize;
+    boundingRadius = header.boundingRadius;
+}
+
+
+// Mapped samples are counted too, though the system may drop them from
+// memory when they haven't been used for a while.
+unsigned int BinarySampledOrbit::getMemoryUsage() const
+{
+    return sampleCount * recordSize * sizeof(double);
+}
+
+
+double BinarySampledOrbit::getPeriod() const
+{
+    return sampleTime(sampleCount - 1) - sampleTime(0);
+}
+
+
+bool BinarySampledOrbit::isPeriodic() const
+{
+    return false;
+}
+
+
+void BinarySampledOrbit::getValidRange(double& begin, double& end) const
+{
+    begin = sampleTime(0);
+    end = sampleTime(sampleCount - 1);
+}
+
+
+double BinarySampledOrbit::getBoundingRadius() const
+{
+    return boundingRadius;
+}
+
+
+// Return the index of the first sample at or after jd, or the sample
+// count if every sample precedes jd. This matches the lower_bound search
+// used for text trajectories.
+unsigned int BinarySampledOrbit::findSpan(double jd) const
+{
+    if (fixedStep)
+    {
+        double x = ceil((jd - startTime) / stepSize);
+        if (!(x > 0.0))
+            return 0;
+        if (x >= (double) sampleCount)
+            return jd > sampleTime(sampleCount - 1) ? sampleCount : sampleCount - 1;
+
+        // Correct for rounding in the division
+        unsigned int n = (unsigned int) x;
+        if (sampleTime(n - 1) >= jd)
+            n--;
+        else if (sampleTime(n) < jd)
+            n++;
+        return n;
+    }
+    else
+    {
+        unsigned int low = 0;
+        unsigned int high = sampleCount;
+        while (low < high)
+        {
+            unsigned int mid = low + (high - low) / 2;
+            if (records[mid * recordSize] < jd)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return low;
+    }
+}
+
+
+// Velocity in km/day at a sample, estimated from the neighboring samples
+// when the file doesn't store velocities.
+Vector3d BinarySampledOrbit::estimateVelocity(unsigned int i) const
+{
+    if (hasVelocities)
+    {
+        const double* v = records + i * recordSize + positionOffset + 3;
+        return Vector3d(v[0], v[1], v[2]) * astro::daysToSecs(1.0);
+    }
+
+    if (sampleCount == 1)
+        return Vector3d::Zero();
+
+    Vector3d p = samplePosition(i);
+    if (i == 0)
+    {
+        return (samplePosition(1) - p) / (sampleTime(1) - sampleTime(0));
+    }
+    else if (i == sampleCount - 1)
+    {
+        return (p - samplePosition(i - 1)) / (sampleTime(i) - sampleTime(i - 1));
+    }
+    else
+    {
+        Vector3d v0 = (samplePosition(i + 1) - p) / (sampleTime(i + 1) - sampleTime(i));
+        Vector3d v1 = (p - samplePosition(i - 1)) / (sampleTime(i) - sampleTime(i - 1));
+        return (v0 + v1) * 0.5;
+    }
+}
+
+
+// Get the tangents at the ends of the span between samples n - 1 and n,
+// scaled to the span length, for cubic Hermite interpolation. Without
+// stored velocities, these are estimated the same way as for xyz files.
+void BinarySampledOrbit::getSpanTangents(unsigned int n, Vector3d& v0, Vector3d& v1) const
+{
+    double t1 = sampleTime(n - 1);
+    double t2 = sampleTime(n);
+    double h = t2 - t1;
+
+    if (hasVelocities)
+    {
+        v0 = estimateVelocity(n - 1) * h;
+        v1 = estimateVelocity(n) * h;
+        return;
+    }
+
+    Vector3d p1 = samplePosition(n - 1);
+    Vector3d p2 = samplePosition(n);
+    Vector3d v21 = p2 - p1;
+
+    if (n > 1)
+    {
+        double t0 = sampleTime(n - 2);
+        Vector3d v10 = p1 - samplePosition(n - 2);
+        v0 = (v10 * (0.5 / (t1 - t0)) + v21 * (0.5 / h)) * h;
+    }
+    else
+    {
+        v0 = v21;
+    }
+
+    if (n < sampleCount - 1)
+    {
+        double t3 = sampleTime(n + 1);
+        Vector3d v32 = samplePosition(n + 1) - p2;
+        v1 = (v21 * (0.5 / h) + v32 * (0.5 / (t3 - t2))) * h;
+    }
+    else
+    {
+        v1 = v21;
+    }
+}
+
+
+Vector3d BinarySampledOrbit::computePosition(double jd) const
+{
+    Vector3d pos;
+    unsigned int n = findSpan(jd);
+
+    if (n == 0)
+    {
+        pos = samplePosition(0);
+    }
+    else if (n == sampleCount)
+    {
+        pos = samplePosition(sampleCount - 1);
+    }
+    else
+    {
+        double t0 = sampleTime(n - 1);
+        double h = sampleTime(n) - t0;
+        double t = (jd - t0) / h;
+        Vector3d p0 = samplePosition(n - 1);
+        Vector3d p1 = samplePosition(n);
+
+        if (interpolation == TrajectoryInterpolationLinear)
+        {
+            pos = p0 + t * (p1 - p0);
+        }
+        else if (interpolation == TrajectoryInterpolationCubic)
+        {
+            Vector3d v0, v1;
+            getSpanTangents(n, v0, v1);
+            pos = cubicInterpolate(p0, v0, p1, v1, t);
+        }
+        else
+        {
+            // Unknown interpolation type
+            pos = Vector3d::Zero();
+        }
+    }
+
+    // Add correction for Celestia's coordinate system
+    return Vector3d(pos.x(), pos.z(), -pos.y());
+}
+
+
+Vector3d BinarySampledOrbit::computeVelocity(double jd) const
+{
+    Vector3d vel(Vector3d::Zero());
+    unsigned int n = findSpan(jd);
+
+    if (n > 0 && n < sampleCount)
+    {
+        double t0 = sampleTime(n - 1);
+        double h = sampleTime(n) - t0;
+        double t = (jd - t0) / h;
+        Vector3d p0 = samplePosition(n - 1);
+        Vector3d p1 = samplePosition(n);
+
+        if (interpolation == TrajectoryInterpolationLinear)
+        {
+            vel = (p1 - p0) * (1.0 / h);
+        }
+        else if (interpolation == TrajectoryInterpolationCubic)
+        {
+            Vector3d v0, v1;
+            getSpanTangents(n, v0, v1);
+            vel = cubicInterpolateVelocity(p0, v0, p1, v1, t) * (1.0 / h);
+        }
+    }
+
+    // Add correction for Celestia's coordinate system
+    return Vector3d(vel.x(), vel.z(), -vel.y());
+}
+
+
+void BinarySampledOrbit::sample(double /* startTime */, double /* endTime */,
+                                OrbitSampleProc& proc) const
+{
+    for (unsigned int i = 0; i < sampleCount; i++)
+    {
+        Vector3d p = samplePosition(i);
+        Vector3d v = estimateVelocity(i);
+        proc.sample(sampleTime(i), Vector3d(p.x(), p.z(), -p.y()), Vector3d(v.x(), v.z(), -v.y()));
+    }
+}
+
+
 // Scan past comments. A comment begins with the # character and ends
 // with a newline. Return true if the stream state is good. The stream
 // position will be at the first non-comment, non-whitespace character.
@@ -829,6 +1189,109 @@ template <typename T> SampledOrbitXYZV<T>* LoadSampledOrbitXYZV(const string& fi
 }
 
 
+// Read and check the header of a binary trajectory file. Returns the
+// number of doubles in the sample records, or zero if the header is bad
+// or the file is too short.
+static unsigned int ReadBinaryTrajectoryHeader(const char* data,
+                                               size_t size,
+                                               BinaryTrajectoryHeader& header)
+{
+    if (size < BINARY_TRAJECTORY_HEADER_SIZE)
+        return 0;
+
+    memcpy(header.magic, data, 8);
+    memcpy(&header.version, data + 8, 2);
+    memcpy(&header.flags, data + 10, 2);
+    memcpy(&header.sampleCount, data + 12, 4);
+    memcpy(&header.startTime, data + 16, 8);
+    memcpy(&header.stepSize, data + 24, 8);
+    memcpy(&header.boundingRadius, data + 32, 8);
+    LE_TO_CPU_INT16(header.version, header.version);
+    LE_TO_CPU_INT16(header.flags, header.flags);
+    LE_TO_CPU_INT32(header.sampleCount, header.sampleCount);
+#if defined(WORDS_BIGENDIAN) || defined(__BIG_ENDIAN__)
+    header.startTime = bswap_double(header.startTime);
+    header.stepSize = bswap_double(header.stepSize);
+    header.boundingRadius = bswap_double(header.boundingRadius);
+#endif
+
+    if (memcmp(header.magic, BINARY_TRAJECTORY_MAGIC, 8) != 0 ||
+        header.version != BINARY_TRAJECTORY_VERSION ||
+        header.sampleCount == 0)
+    {
+        return 0;
+    }
+
+    bool fixedStep = (header.flags & BinaryTrajectoryFixedStep) != 0;
+    if (fixedStep && !(header.stepSize > 0.0))
+        return 0;
+
+    unsigned int recordSize = (fixedStep ? 0 : 1) +
+        ((header.flags & BinaryTrajectoryVelocities) != 0 ? 6 : 3);
+    if (header.sampleCount > (size - BINARY_TRAJECTORY_HEADER_SIZE) / (recordSize * sizeof(double)))
+        return 0;
+
+    return header.sampleCount * recordSize;
+}
+
+
+/*! Load a binary trajectory file. The file is memory mapped when possible,
+ *  so loading takes constant time regardless of the size of the file. Binary
+ *  trajectories always have double precision samples.
+ */
+Orbit* LoadBinaryTrajectory(const string& filename, TrajectoryInterpolation interpolation)
+{
+    BinaryTrajectoryHeader header;
+
+#if !defined(WORDS_BIGENDIAN) && !defined(__BIG_ENDIAN__)
+    MappedFile* file = OpenMappedFile(filename);
+    if (file != NULL)
+    {
+        if (ReadBinaryTrajectoryHeader(file->data(), file->size(), header) == 0)
+        {
+            delete file;
+            return NULL;
+        }
+
+        // The header size keeps the records aligned in the mapping
+        const double* records = reinterpret_cast<const double*>(file->data() + BINARY_TRAJECTORY_HEADER_SIZE);
+        return new BinarySampledOrbit(header, file, records, interpolation);
+    }
+#endif
+
+    // Fall back to reading the samples into memory
+    ifstream in(filename.c_str(), ios::in | ios::binary);
+    if (!in.good())
+        return NULL;
+
+    char headerData[BINARY_TRAJECTORY_HEADER_SIZE];
+    in.read(headerData, sizeof(headerData));
+    if (!in.good())
+        return NULL;
+
+    // Check the header against the size of the file
+    in.seekg(0, ios::end);
+    size_t size = (size_t) in.tellg();
+    in.seekg(BINARY_TRAJECTORY_HEADER_SIZE, ios::beg);
+
+    unsigned int recordCount = ReadBinaryTrajectoryHeader(headerData, size, header);
+    if (recordCount == 0)
+        return NULL;
+
+    vector<double> records(recordCount);
+    in.read(reinterpret_cast<char*>(&records[0]), recordCount * sizeof(double));
+    if (!in.good())
+        return NULL;
+
+#if defined(WORDS_BIGENDIAN) || defined(__BIG_ENDIAN__)
+    for (unsigned int i = 0; i < recordCount; i++)
+        records[i] = bswap_double(records[i]);
+#endif
+
+    return new BinarySampledOrbit(header, records, interpolation);
+}
+
+
 /*! Load a trajectory file containing single precision positions.
  */
 Orbit* LoadSampledTrajectorySinglePrec(const string& filename, TrajectoryInterpolation interpolation)
@@ -11,6 +11,7 @@
 #define _CELENGINE_SAMPORBIT_H_
 
 #include "orbit.h"
+#include <celutil/basictypes.h>
 #include <string>
 
 enum TrajectoryInterpolation
@@ -29,5 +30,40 @@ extern Orbit* LoadSampledTrajectoryDoublePrec(const std::string& name, Trajector
 extern Orbit* LoadSampledTrajectorySinglePrec(const std::string& name, TrajectoryInterpolation interpolation);
 extern Orbit* LoadXYZVTrajectoryDoublePrec(const std::string& name, TrajectoryInterpolation interpolation);
 extern Orbit* LoadXYZVTrajectorySinglePrec(const std::string& name, TrajectoryInterpolation interpolation);
+extern Orbit* LoadBinaryTrajectory(const std::string& name, TrajectoryInterpolation interpolation);
+
+
+/*! Binary trajectory (.xyzvbin) files contain the same samples as xyz and
+ *  xyzv files, stored so that they can be memory mapped and used in place.
+ *  The file is a header followed by the sample records. All values are
+ *  little endian.
+ *
+ *  Each record holds the TDB time of the sample (omitted in fixed step
+ *  files), the position in km, and, if the file has velocities, the
+ *  velocity in km/s; all are doubles. Samples are sorted by time, with no
+ *  duplicate times. In a fixed step file, sample i is at time
+ *  startTime + i * stepSize, so finding the samples around a time doesn't
+ *  require a search.
+ */
+struct BinaryTrajectoryHeader
+{
+    char magic[8];          // BINARY_TRAJECTORY_MAGIC
+    uint16 version;         // BINARY_TRAJECTORY_VERSION
+    uint16 flags;           // BinaryTrajectoryFlags
+    uint32 sampleCount;
+    double startTime;       // TDB Julian date of the first sample
+    double stepSize;        // days between samples in fixed step files
+    double boundingRadius;  // largest distance from the center in km
+};
+
+enum BinaryTrajectoryFlags
+{
+    BinaryTrajectoryVelocities = 0x1,
+    BinaryTrajectoryFixedStep  = 0x2,
+};
+
+#define BINARY_TRAJECTORY_MAGIC "CELXYZV"
+static const uint16 BINARY_TRAJECTORY_VERSION = 0x0100;
+static const unsigned int BINARY_TRAJECTORY_HEADER_SIZE = 40;
 
 #endif // _CELENGINE_SAMPORBIT_H_
@@ -34,6 +34,9 @@ class ScriptedOrbit : public CachingOrbit
     virtual double getBoundingRadius() const;
     virtual void getValidRange(double& begin, double& end) const;
 
+    // Lua states can't be used from more than one thread at a time
+    virtual bool isThreadSafe() const { return false; }
+
  private:
     lua_State* luaState;
     std::string luaOrbitObjectName;
@@ -48,6 +48,9 @@ class SpiceOrbit : public CachingOrbit
 
     virtual void getValidRange(double& begin, double& end) const;
 
+    // The SPICE Toolkit isn't reentrant
+    virtual bool isThreadSafe() const { return false; }
+
  private:
     const std::string targetBodyName;
     const std::string originName;
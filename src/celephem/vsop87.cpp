@@ -16,6 +16,7 @@
 #include <celmath/mathlib.h>
 #include <celengine/astro.h>
 #include "vsop87.h"
+#include "chebyorbit.h"
 
 using namespace Eigen;
 using namespace std;
@@ -11097,14 +11098,14 @@ class VSOP87Orbit : public CachingOrbit
     }
 
 
-    /** Custom implementation of sample() for VSOP87 orbits. The default
-      * implementation runs too slowly and produces too many samples.
+    /** Custom sampling parameters for VSOP87 orbits. The default
+      * parameters make sampling run too slowly and produce too many samples.
       */
-    void sample(double startTime, double endTime, OrbitSampleProc& proc) const
+    void getSamplingParameters(double /* startTime */, double /* endTime */,
+                               AdaptiveSamplingParameters& samplingParams) const
     {
         double span = getPeriod();
 
-        AdaptiveSamplingParameters samplingParams;
         samplingParams.tolerance = 1.0; // kilometers
 
         // startStep, minStep, and maxStep are all set to identical values,
@@ -11113,8 +11114,6 @@ class VSOP87Orbit : public CachingOrbit
         samplingParams.startStep = span / 150.0;
         samplingParams.minStep   = samplingParams.startStep;
         samplingParams.maxStep   = samplingParams.startStep;
-
-        adaptiveSample(startTime, endTime, proc, samplingParams);
     }
 
 };
@@ -11221,7 +11220,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    mercury_R, 5,
                                    0.2408 * 365.25,
                                    60000000.0);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
+        return new MixedOrbit(CreateEphemerisCache(o), yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
     else if (name == "vsop87-venus")
@@ -11231,7 +11230,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    venus_R, 5,
                                    0.6152 * 365.25,
                                    100000000.0);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
+        return new MixedOrbit(CreateEphemerisCache(o), yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
     else if (name == "vsop87-earth")
@@ -11241,7 +11240,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    earth_R, 6,
                                    365.25,
                                    160000000.0);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
+        return new MixedOrbit(CreateEphemerisCache(o), yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
     else if (name == "vsop87-mars")
@@ -11251,7 +11250,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    mars_R, 6,
                                    1.8809 * 365.25,
                                    240000000);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
+        return new MixedOrbit(CreateEphemerisCache(o), yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
     else if (name == "vsop87-jupiter")
@@ -11261,7 +11260,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    jupiter_R, 6,
                                    11.86 * 365.25,
                                    800000000.0);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
+        return new MixedOrbit(CreateEphemerisCache(o), yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
     else if (name == "vsop87-saturn")
@@ -11271,7 +11270,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    saturn_R, 6,
                                    29.4577 * 365.25,
                                    1.5e9);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
+        return new MixedOrbit(CreateEphemerisCache(o), yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
     else if (name == "vsop87-uranus")
@@ -11281,7 +11280,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    uranus_R, 5,
                                    84.0139 * 365.25,
                                    3.0e9);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
+        return new MixedOrbit(CreateEphemerisCache(o), yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
     else if (name == "vsop87-neptune")
@@ -11291,7 +11290,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    neptune_R, 5,
                                    164.793 * 365.25,
                                    4.7e9);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
+        return new MixedOrbit(CreateEphemerisCache(o), yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
     else if (name == "vsop87-sun")
@@ -11301,7 +11300,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                        sun_Z, 3,
                                        0.0,
                                        2000000);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(6000),
+        return new MixedOrbit(CreateEphemerisCache(o), yearToJD(-4000), yearToJD(6000),
                               astro::SolarMass);
     }
 
@@ -13,6 +13,7 @@
 #include <windowsx.h>
 #include <celutil/debug.h>
 #include "avicapture.h"
+#include "framereadback.h"
 
 using namespace std;
 
@@ -22,11 +23,13 @@ AVICapture::AVICapture() :
     height(-1),
     frameRate(30.0f),
     frameCounter(0),
+    droppedFrames(0),
     capturing(false),
     aviFile(NULL),
     aviStream(NULL),
     compAviStream(NULL),
-    image(NULL)
+    image(NULL),
+    readback(NULL)
 {
     AVIFileInit();
 }
@@ -130,8 +133,12 @@ bool AVICapture::start(const string& filename,
         return false;
     }
 
+    // Frames are read back asynchronously and written a few frames later
+    readback = new FrameReadback(width, height, GL_BGR_EXT);
+
     capturing = true;
     frameCounter = 0;
+    droppedFrames = 0;
 
     return true;
 }
@@ -139,6 +146,13 @@ bool AVICapture::start(const string& filename,
 
 bool AVICapture::end()
 {
+    if (capturing)
+    {
+        while (readback->getPendingCount() > 0)
+            writeReadbackFrame();
+        readback->release();
+    }
+
     capturing = false;
     cleanup();
 
@@ -151,17 +165,31 @@ bool AVICapture::captureFrame()
     if (!capturing)
         return false;
 
+    // Write the oldest frame in the readback to make room for this one
+    if (readback->isFull() && !writeReadbackFrame())
+        return false;
+
     // Get the dimensions of the current viewport
     int viewport[4];
     glGetIntegerv(GL_VIEWPORT, viewport);
 
     int x = viewport[0] + (viewport[2] - width) / 2;
     int y = viewport[1] + (viewport[3] - height) / 2;
-    glReadPixels(x, y, width, height,
-                 GL_BGR_EXT, GL_UNSIGNED_BYTE,
-                 image);
+    readback->read(x, y);
 
-    int rowBytes = (width * 3 + 3) & ~0x3;
+    return true;
+}
+
+
+bool AVICapture::writeReadbackFrame()
+{
+    if (!readback->fetch(image))
+    {
+        droppedFrames++;
+        return true;
+    }
+
+    int rowBytes = readback->getRowBytes();
 
     LONG samplesWritten = 0;
     LONG bytesWritten = 0;
@@ -209,6 +237,13 @@ void AVICapture::cleanup()
         delete[] image;
         image = NULL;
     }
+    if (readback != NULL)
+    {
+        // Without end(), the frames still in the readback are lost
+        droppedFrames += readback->getPendingCount();
+        delete readback;
+        readback = NULL;
+    }
 }
 
 
@@ -231,3 +266,15 @@ int AVICapture::getFrameCount() const
 {
     return frameCounter;
 }
+
+
+int AVICapture::getQueuedFrameCount() const
+{
+    return readback != NULL ? (int) readback->getPendingCount() : 0;
+}
+
+
+int AVICapture::getDroppedFrameCount() const
+{
+    return droppedFrames;
+}
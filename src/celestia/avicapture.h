@@ -15,6 +15,8 @@
 #include <vfw.h>
 #include "moviecapture.h"
 
+class FrameReadback;
+
 
 class AVICapture : public MovieCapture
 {
@@ -30,6 +32,8 @@ class AVICapture : public MovieCapture
     int getHeight() const;
     float getFrameRate() const;
     int getFrameCount() const;
+    int getQueuedFrameCount() const;
+    int getDroppedFrameCount() const;
 
     // These are unused for now:
     virtual void setAspectRatio(int, int) {};
@@ -38,17 +42,20 @@ class AVICapture : public MovieCapture
 
  private:
     void cleanup();
+    bool writeReadbackFrame();
 
  private:
     int width;
     int height;
     float frameRate;
     int frameCounter;
+    int droppedFrames;
     bool capturing;
     PAVIFILE aviFile;
     PAVISTREAM aviStream;
     PAVISTREAM compAviStream;
     unsigned char* image;
+    FrameReadback* readback;
 };
 
 #endif // _AVICAPTURE_H_
@@ -25,10 +25,15 @@
 #include <celengine/cmdparser.h>
 #include <celengine/multitexture.h>
 #include <celephem/spiceinterface.h>
+#include <celephem/chebyorbit.h>
 #include <celengine/axisarrow.h>
 #include <celengine/planetgrid.h>
 #include <celengine/visibleregion.h>
 #include <celengine/eigenport.h>
+#include <celengine/catalogcache.h>
+#include <celengine/virtualtex.h>
+#include <celengine/texmanager.h>
+#include <celengine/meshmanager.h>
 #include <celmath/geomutil.h>
 #include <celutil/util.h>
 #include <celutil/filetype.h>
@@ -36,6 +41,8 @@
 #include <celutil/formatnum.h>
 #include <celutil/debug.h>
 #include <celutil/utf8.h>
+#include <celutil/threadpool.h>
+#include <celutil/profiler.h>
 #include <GL/glew.h>
 #include <cstdio>
 #include <iostream>
@@ -80,6 +87,11 @@ static float KeyRotationAccel = degToRad(120.0f);
 static float MouseRotationSensitivity = degToRad(1.0f);
 
 static const int ConsolePageRows = 10;
+
+// Limit on the names offered as completions of typed text; with large
+// catalogs, a single letter may match tens of thousands of names.
+static const unsigned int MaxTypedTextCompletions = 1000;
+
 static Console console(200, 120);
 
 
@@ -339,6 +351,8 @@ CelestiaCore::CelestiaCore() :
     nFrames(0),
     fps(0.0),
     fpsCounterStartTime(0.0),
+    orbitEvaluations(0),
+    rotationEvaluations(0),
     oldFOV(stdFOV),
     mouseMotion(0.0f),
     dollyMotion(0.0),
@@ -363,7 +377,9 @@ CelestiaCore::CelestiaCore() :
     showViewFrames(true),
     resizeSplit(0),
     screenDpi(96),
-    distanceToScreen(400)
+    distanceToScreen(400),
+    catalogCache(NULL),
+    rebuildCatalogCache(false)
 {
     /* Get a renderer here so it may be queried for capabilities of the
        underlying engine even before rendering is enabled. It's initRenderer()
@@ -389,8 +405,9 @@ CelestiaCore::CelestiaCore() :
 
 CelestiaCore::~CelestiaCore()
 {
-    if (movieCapture != NULL)
-        recordEnd();
+    // The GL context may already be gone, so the capture isn't ended; its
+    // destructor finishes the movie without making GL calls.
+    delete movieCapture;
 
 #ifdef CELX
     // Clean up all scripts
@@ -403,7 +420,7 @@ CelestiaCore::~CelestiaCore()
 #endif
 
     delete execEnv;
-
+    delete catalogCache;
 
 }
 
@@ -513,6 +530,12 @@ void showSelectionInfo(const Selection& sel)
 }
 
 
+bool CelestiaCore::isScriptRunning() const
+{
+    return scriptState != ScriptCompleted;
+}
+
+
 void CelestiaCore::cancelScript()
 {
     if (runningScript != NULL)
@@ -1272,7 +1295,7 @@ void CelestiaCore::charEntered(const char *c_p, int modifiers)
 #endif
         {
             typedText += string(c_p);
-            typedTextCompletion = sim->getObjectCompletion(typedText, (renderer->getLabelMode() & Renderer::LocationLabels) != 0);
+            typedTextCompletion = sim->getObjectCompletion(typedText, (renderer->getLabelMode() & Renderer::LocationLabels) != 0, MaxTypedTextCompletions);
             typedTextCompletionIdx = -1;
 #ifdef AUTO_COMPLETION
             if (typedTextCompletion.size() == 1)
@@ -1303,7 +1326,7 @@ void CelestiaCore::charEntered(const char *c_p, int modifiers)
                     typedText = string(typedText, 0, typedText.size() - 1);
                     if (typedText.size() > 0)
                     {
-                        typedTextCompletion = sim->getObjectCompletion(typedText, (renderer->getLabelMode() & Renderer::LocationLabels) != 0);
+                        typedTextCompletion = sim->getObjectCompletion(typedText, (renderer->getLabelMode() & Renderer::LocationLabels) != 0, MaxTypedTextCompletions);
                     } else {
                         typedTextCompletion.clear();
                     }
@@ -2266,6 +2289,25 @@ void CelestiaCore::tick()
         dt = sysTime - lastTime;
     }
 
+    tick(dt);
+}
+
+
+/*! Advance the simulation, scripts, and navigation by a fixed time step of
+ *  dt seconds instead of the time elapsed on the system clock; used by
+ *  front ends that render frames offline.
+ */
+void CelestiaCore::tick(double dt)
+{
+    // Profiled frames start with the tick that advances the simulation
+    // for them.
+    GetProfiler()->beginFrame();
+    PROFILE_ZONE("CelestiaCore::tick");
+
+    orbitEvaluations = Body::getOrbitEvaluationCount();
+    rotationEvaluations = Body::getRotationEvaluationCount();
+    Body::resetEvaluationCounts();
+
     // Pause script execution
     if (scriptState == ScriptPaused)
         dt = 0.0;
@@ -2456,6 +2498,8 @@ void CelestiaCore::draw()
         return;
     viewChanged = false;
 
+    PROFILE_ZONE("CelestiaCore::draw");
+
     if (views.size() == 1)
     {
         // I'm not certain that a special case for one view is required; but,
@@ -3378,6 +3422,7 @@ static void showViewFrame(const View* v, int width, int height)
 
 void CelestiaCore::renderOverlay()
 {
+    PROFILE_ZONE("CelestiaCore::renderOverlay");
 
 #ifdef CELX
     if (luaHook) luaHook->callLuaHook(this,"renderoverlay");
@@ -3518,7 +3563,11 @@ void CelestiaCore::renderOverlay()
         overlay->beginText();
         *overlay << '\n';
         if (showFPSCounter)
+        {
             *overlay << _("FPS: ") << SigDigitNum(fps, 3);
+            *overlay << _("  Orbit evaluations: ") << orbitEvaluations;
+            *overlay << _("  Rotation evaluations: ") << rotationEvaluations;
+        }
         overlay->setf(ios::fixed);
         *overlay << _("\nSpeed: ");
 
@@ -3538,6 +3587,43 @@ void CelestiaCore::renderOverlay()
         glPopMatrix();
     }
 
+    if (hudDetail > 0 && showFPSCounter)
+    {
+        // Time spent in the profiled zones per frame and the virtual
+        // texture tile counts, below the date
+        vector<ProfileZoneTotal> zones;
+        GetProfiler()->getZoneTotals(zones);
+        VirtualTexture::Statistics tileStats = GetVirtualTextureStatistics();
+        bool showTileStats = tileStats.hits != 0 || tileStats.misses != 0;
+        if (!zones.empty() || showTileStats)
+        {
+            glPushMatrix();
+            glTranslatef((float) (width - emWidth * 28),
+                         (float) (height - fontHeight * 4),
+                         0.0f);
+            glColor4f(0.7f, 0.7f, 1.0f, 1.0f);
+            overlay->beginText();
+            for (vector<ProfileZoneTotal>::const_iterator iter = zones.begin();
+                 iter != zones.end(); iter++)
+            {
+                overlay->oprintf("%*s%s  %.2f ms", (int) iter->depth * 2, "", iter->name, iter->time * 1000.0);
+                if (iter->calls >= 1.5)
+                    overlay->oprintf(" (%.0f)", iter->calls);
+                *overlay << '\n';
+            }
+            if (showTileStats)
+            {
+                overlay->oprintf(_("Virtual texture tiles: %u (%.1f MB)\n"),
+                                 tileStats.residentTiles,
+                                 (double) tileStats.residentBytes / (1 << 20));
+                overlay->oprintf(_("  Hits: %u  Misses: %u  Evictions: %u\n"),
+                                 tileStats.hits, tileStats.misses, tileStats.evictions);
+            }
+            overlay->endText();
+            glPopMatrix();
+        }
+    }
+
     if (hudDetail > 0 && (overlayElements & ShowFrame))
     {
         // Field of view and camera mode in lower right corner
@@ -3908,6 +3994,11 @@ void CelestiaCore::renderOverlay()
             *overlay << _("  Recording");
         else
             *overlay << _("  Paused");
+        if (movieCapture->getQueuedFrameCount() > 0 || movieCapture->getDroppedFrameCount() > 0)
+        {
+            *overlay << "  " << movieCapture->getQueuedFrameCount() << _(" queued, ") <<
+                movieCapture->getDroppedFrameCount() << _(" dropped");
+        }
 
         overlay->endText();
         glPopMatrix();
@@ -3997,51 +4088,164 @@ void CelestiaCore::renderOverlay()
 }
 
 
+// A catalog file found while enumerating an extras directory
+struct QueuedCatalogFile
+{
+    QueuedCatalogFile(const string& _filename, const string& _path) :
+        filename(_filename), path(_path) {};
+
+    string fullname() const { return path + '/' + filename; };
+
+    string filename;
+    string path;
+};
+
+// Number of files read at once per thread when catalogs are loaded in
+// parallel; this bounds the number of parsed files held in memory.
+static const unsigned int CatalogReadBatchFilesPerThread = 4;
+
+template <class CATALOGFILE> class CatalogReadTask : public ThreadTask
+{
+public:
+    CatalogReadTask(CatalogCache* _cache,
+                    const string& _filename,
+                    CATALOGFILE* _catalogFile,
+                    char* _opened) :
+        cache(_cache),
+        filename(_filename),
+        catalogFile(_catalogFile),
+        opened(_opened)
+    {
+    }
+
+    void run()
+    {
+        *opened = cache->read(filename, *catalogFile);
+    }
+
+private:
+    CatalogCache* cache;
+    string filename;
+    CATALOGFILE* catalogFile;
+    char* opened;
+};
+
+/* Read queued catalog files on a thread pool and pass them to
+ * loader.loadFile() in the order they were queued. Reading doesn't touch
+ * the universe or catalogs, so only loading has to be done in order.
+ */
+template <class CATALOGFILE, class LOADER>
+static void LoadQueuedCatalogFiles(LOADER& loader,
+                                   const vector<QueuedCatalogFile>& files,
+                                   CatalogCache* cache,
+                                   ThreadPool* pool)
+{
+    unsigned int batchSize = (pool->getThreadCount() + 1) * CatalogReadBatchFilesPerThread;
+
+    for (unsigned int first = 0; first < files.size(); first += batchSize)
+    {
+        unsigned int count = min(batchSize, (unsigned int) files.size() - first);
+        vector<CATALOGFILE*> catalogFiles(count);
+        vector<char> opened(count, 0);
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            catalogFiles[i] = new CATALOGFILE();
+            pool->addTask(new CatalogReadTask<CATALOGFILE>(cache,
+                                                           files[first + i].fullname(),
+                                                           catalogFiles[i],
+                                                           &opened[i]));
+        }
+        pool->wait();
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (opened[i])
+                loader.loadFile(*catalogFiles[i], files[first + i]);
+            delete catalogFiles[i];
+        }
+    }
+}
+
+
+/* The loaders below load catalog files as enumFiles finds them, or, when
+ * given a thread pool, queue them to be read in parallel by
+ * loadQueuedFiles().
+ */
 class SolarSystemLoader : public EnumFilesHandler
 {
  public:
     Universe* universe;
     ProgressNotifier* notifier;
-    SolarSystemLoader(Universe* u, ProgressNotifier* pn) : universe(u), notifier(pn) {};
+    CatalogCache* cache;
+    ThreadPool* pool;
+    vector<QueuedCatalogFile> queuedFiles;
+
+    SolarSystemLoader(Universe* u, ProgressNotifier* pn, CatalogCache* c, ThreadPool* tp = NULL) :
+        universe(u), notifier(pn), cache(c), pool(tp) {};
 
     bool process(const string& filename)
     {
         if (DetermineFileType(filename) == Content_CelestiaCatalog)
         {
+            if (pool != NULL)
+            {
+                queuedFiles.push_back(QueuedCatalogFile(filename, getPath()));
+                return true;
+            }
+
             string fullname = getPath() + '/' + filename;
             clog << _("Loading solar system catalog: ") << fullname << '\n';
             if (notifier)
                 notifier->update(filename);
 
-            ifstream solarSysFile(fullname.c_str(), ios::in);
-            if (solarSysFile.good())
-            {
-                LoadSolarSystemObjects(solarSysFile,
-                                       *universe,
-                                       getPath());
-            }
+            SolarSystemCatalogFile catalogFile;
+            if (cache->read(fullname, catalogFile))
+                LoadSolarSystemObjects(catalogFile, *universe, getPath());
         }
 
         return true;
     };
+
+    void loadFile(SolarSystemCatalogFile& catalogFile, const QueuedCatalogFile& file)
+    {
+        clog << _("Loading solar system catalog: ") << file.fullname() << '\n';
+        if (notifier)
+            notifier->update(file.filename);
+
+        LoadSolarSystemObjects(catalogFile, *universe, file.path);
+    }
+
+    void loadQueuedFiles()
+    {
+        LoadQueuedCatalogFiles<SolarSystemCatalogFile>(*this, queuedFiles, cache, pool);
+        queuedFiles.clear();
+    }
 };
 
-template <class OBJDB> class CatalogLoader : public EnumFilesHandler
+template <class OBJDB, class CATALOGFILE> class CatalogLoader : public EnumFilesHandler
 {
 public:
     OBJDB*      objDB;
     string      typeDesc;
     ContentType contentType;
     ProgressNotifier* notifier;
+    CatalogCache* cache;
+    ThreadPool* pool;
+    vector<QueuedCatalogFile> queuedFiles;
 
     CatalogLoader(OBJDB* db,
                   const std::string& typeDesc,
                   const ContentType& contentType,
-                  ProgressNotifier* pn) :
+                  ProgressNotifier* pn,
+                  CatalogCache* c,
+                  ThreadPool* tp = NULL) :
         objDB      (db),
         typeDesc   (typeDesc),
         contentType(contentType),
-        notifier(pn)
+        notifier(pn),
+        cache(c),
+        pool(tp)
     {
     }
 
@@ -4049,28 +4253,48 @@ public:
     {
         if (DetermineFileType(filename) == contentType)
         {
+            if (pool != NULL)
+            {
+                queuedFiles.push_back(QueuedCatalogFile(filename, getPath()));
+                return true;
+            }
+
             string fullname = getPath() + '/' + filename;
             clog << _("Loading ") << typeDesc << " catalog: " << fullname << '\n';
             if (notifier)
                 notifier->update(filename);
 
-            ifstream catalogFile(fullname.c_str(), ios::in);
-            if (catalogFile.good())
+            CATALOGFILE catalogFile;
+            if (cache->read(fullname, catalogFile) && !objDB->load(catalogFile, getPath()))
             {
-                bool success = objDB->load(catalogFile, getPath());
-                if (!success)
-                {
-                    //DPRINTF(0, _("Error reading star file: %s\n"), fullname.c_str());
-                    DPRINTF(0, "Error reading %s catalog file: %s\n", typeDesc.c_str(), fullname.c_str());
-                }
+                cerr << _("Error reading ") << typeDesc << " catalog file: " << fullname << '\n';
             }
         }
         return true;
     }
+
+    void loadFile(CATALOGFILE& catalogFile, const QueuedCatalogFile& file)
+    {
+        string fullname = file.fullname();
+        clog << _("Loading ") << typeDesc << " catalog: " << fullname << '\n';
+        if (notifier)
+            notifier->update(file.filename);
+
+        if (!objDB->load(catalogFile, file.path))
+        {
+            cerr << _("Error reading ") << typeDesc << " catalog file: " << fullname << '\n';
+        }
+    }
+
+    void loadQueuedFiles()
+    {
+        LoadQueuedCatalogFiles<CATALOGFILE>(*this, queuedFiles, cache, pool);
+        queuedFiles.clear();
+    }
 };
 
-typedef CatalogLoader<StarDatabase> StarLoader;
-typedef CatalogLoader<DSODatabase>  DeepSkyLoader;
+typedef CatalogLoader<StarDatabase, StarCatalogFile> StarLoader;
+typedef CatalogLoader<DSODatabase, DSOCatalogFile>  DeepSkyLoader;
 
 
 bool CelestiaCore::initSimulation(const string* configFileName,
@@ -4159,6 +4383,16 @@ bool CelestiaCore::initSimulation(const string* configFileName,
 
     universe = new Universe();
 
+    // Catalog files are read through the cache of preparsed catalogs; with
+    // no cache directory, the cache just reads the text files.
+    catalogCache = new CatalogCache(config->catalogCacheDirectory);
+    catalogCache->setRebuild(rebuildCatalogCache);
+
+    // Analytic orbits created while the solar system catalogs are loaded
+    // are approximated with Chebyshev polynomials if a tolerance is set.
+    SetEphemerisCacheParameters(config->ephemerisCacheTolerance,
+                                config->ephemerisCacheSegments);
+
 
     /***** Load star catalogs *****/
 
@@ -4183,8 +4417,8 @@ bool CelestiaCore::initSimulation(const string* configFileName,
     	if (progressNotifier)
         	progressNotifier->update(*iter);
 	
-		ifstream dsoFile(iter->c_str(), ios::in);
-        if (!dsoFile.good())
+		DSOCatalogFile dsoFile;
+        if (!catalogCache->read(*iter, dsoFile))
         {
         	cerr<< _("Error opening deepsky catalog file.") << '\n';
             delete dsoDB;
@@ -4198,6 +4432,12 @@ bool CelestiaCore::initSimulation(const string* configFileName,
         }
     }
 
+    // Catalogs in the extras directories are read on this pool when
+    // parallel loading is enabled.
+    ThreadPool* loaderPool = NULL;
+    if (config->parallelCatalogLoading)
+        loaderPool = new ThreadPool();
+
     // Next, read all the deep sky files in the extras directories
     {
         for (vector<string>::const_iterator iter = config->extrasDirs.begin();
@@ -4210,9 +4450,13 @@ bool CelestiaCore::initSimulation(const string* configFileName,
                 DeepSkyLoader loader(dsoDB,
                                      "deep sky object",
                                      Content_CelestiaDeepSkyCatalog,
-                                     progressNotifier);
+                                     progressNotifier,
+                                     catalogCache,
+                                     loaderPool);
                 loader.pushDir(*iter);
                 dir->enumFiles(loader, true);
+                if (loaderPool != NULL)
+                    loader.loadQueuedFiles();
 
                 delete dir;
             }
@@ -4235,8 +4479,8 @@ bool CelestiaCore::initSimulation(const string* configFileName,
             if (progressNotifier)
                 progressNotifier->update(*iter);
 
-            ifstream solarSysFile(iter->c_str(), ios::in);
-            if (!solarSysFile.good())
+            SolarSystemCatalogFile solarSysFile;
+            if (!catalogCache->read(*iter, solarSysFile))
             {
                 warning(_("Error opening solar system catalog.\n"));
             }
@@ -4256,14 +4500,17 @@ bool CelestiaCore::initSimulation(const string* configFileName,
             {
                 Directory* dir = OpenDirectory(*iter);
 
-                SolarSystemLoader loader(universe, progressNotifier);
+                SolarSystemLoader loader(universe, progressNotifier, catalogCache, loaderPool);
                 loader.pushDir(*iter);
                 dir->enumFiles(loader, true);
+                if (loaderPool != NULL)
+                    loader.loadQueuedFiles();
 
                 delete dir;
             }
         }
     }
+    delete loaderPool;
 
     // Load asterisms:
     if (config->asterismsFile != "")
@@ -4360,6 +4607,26 @@ bool CelestiaCore::initRenderer()
     detailOptions.orbitPathSamplePoints = config->orbitPathSamplePoints;
     detailOptions.shadowTextureSize = config->shadowTextureSize;
     detailOptions.eclipseTextureSize = config->eclipseTextureSize;
+    detailOptions.orbitCacheMemory = config->orbitCacheMemory << 20;
+    detailOptions.backgroundOrbitSampling = config->backgroundOrbitSampling;
+
+    SetVirtualTextureBudgets((uint64) config->virtualTextureMemory << 20,
+                             (uint64) config->virtualTextureUploadBudget << 10);
+
+    if (config->backgroundTextureLoading)
+    {
+        // Leave a processor for the render thread, but use at least one
+        // loader thread even on a single processor system, since much of
+        // the time is spent waiting for the disk.
+        unsigned int nThreads = max(GetProcessorCount(), 2u) - 1;
+        GetTextureManager()->setBackgroundLoading(nThreads,
+                                                  (uint64) config->textureUploadBudget << 10);
+    }
+
+    SetResourceMemoryBudget((uint64) config->resourceMemoryBudget << 20);
+    SetResourceUnloadDelay(config->resourceUnloadDelay);
+    GetTextureManager()->setMemoryBudget((uint64) config->textureMemoryBudget << 20);
+    GetGeometryManager()->setMemoryBudget((uint64) config->modelMemoryBudget << 20);
 
     // Prepare the scene for rendering.
     if (!renderer->init(context, (int) width, (int) height, detailOptions))
@@ -4472,15 +4739,7 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
         if (progressNotifier)
             progressNotifier->update(cfg.starDatabaseFile);
 
-        ifstream starFile(cfg.starDatabaseFile.c_str(), ios::in | ios::binary);
-        if (!starFile.good())
-        {
-            cerr << _("Error opening ") << cfg.starDatabaseFile << '\n';
-            delete starDB;
-            return false;
-        }
-
-        if (!starDB->loadBinary(starFile))
+        if (!starDB->loadBinary(cfg.starDatabaseFile))
         {
             delete starDB;
             cerr << _("Error reading stars file\n");
@@ -4503,8 +4762,8 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
         {
             if (*iter != "")
             {
-                ifstream starFile(iter->c_str(), ios::in);
-                if (starFile.good())
+                StarCatalogFile starFile;
+                if (catalogCache->read(*iter, starFile))
                 {
                     starDB->load(starFile, "");
                 }
@@ -4524,7 +4783,7 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
         {
             Directory* dir = OpenDirectory(*iter);
 
-            StarLoader loader(starDB, "star", Content_CelestiaStarCatalog, progressNotifier);
+            StarLoader loader(starDB, "star", Content_CelestiaStarCatalog, progressNotifier, catalogCache);
             loader.pushDir(*iter);
             dir->enumFiles(loader, true);
 
@@ -4589,6 +4848,13 @@ CelestiaCore::CursorHandler* CelestiaCore::getCursorHandler() const
     return cursorHandler;
 }
 
+/// Discard and rebuild the cached copies of catalog files.
+/// This must be set before calling initSimulation.
+void CelestiaCore::setRebuildCatalogCache(bool rebuild)
+{
+    rebuildCatalogCache = rebuild;
+}
+
 int CelestiaCore::getTimeZoneBias() const
 {
     return timeZoneBias;
@@ -30,6 +30,7 @@
 #include "celx.h"
 #endif
 class Url;
+class CatalogCache;
 
 // class CelestiaWatcher;
 class CelestiaCore;
@@ -237,6 +238,7 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     void resize(GLsizei w, GLsizei h);
     void draw();
     void tick();
+    void tick(double dt);
 
     Simulation* getSimulation() const;
     Renderer* getRenderer() const;
@@ -275,6 +277,7 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     void runScript(CommandSequence*);
     void runScript(const std::string& filename);
     void cancelScript();
+    bool isScriptRunning() const;
     void resumeScript();
 
     int getHudDetail();
@@ -341,6 +344,8 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     void setCursorHandler(CursorHandler*);
     CursorHandler* getCursorHandler() const;
 
+    void setRebuildCatalogCache(bool);
+
     void toggleReferenceMark(const std::string& refMark, Selection sel = Selection());
     bool referenceMarkEnabled(const std::string& refMark, Selection sel = Selection()) const;
     
@@ -419,6 +424,9 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     int nFrames;
     double fps;
     double fpsCounterStartTime;
+    // Orbit and rotation model evaluations made during the last frame
+    unsigned int orbitEvaluations;
+    unsigned int rotationEvaluations;
 
     float oldFOV;
     float mouseMotion;
@@ -463,6 +471,9 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     int screenDpi;
     int distanceToScreen;
 
+    CatalogCache* catalogCache;
+    bool rebuildCatalogCache;
+
     Selection lastSelection;
     string selectionNames;
 
@@ -15,6 +15,7 @@
 #include <cstdio>
 #include <ctime>
 #include <map>
+#include <fstream>
 #include <celengine/astro.h>
 #include <celengine/asterism.h>
 #include <celengine/celestia.h>
@@ -24,6 +25,7 @@
 #include <celmath/vecmath.h>
 #include <celengine/timeline.h>
 #include <celengine/timelinephase.h>
+#include <celutil/profiler.h>
 #include "imagecapture.h"
 #include "url.h"
 
@@ -507,6 +509,7 @@ LuaState::LuaState() :
     state = luaL_newstate();
     timer = CreateTimer();
     screenshotCount = 0;
+    profileTraceCount = 0;
 }
 
 LuaState::~LuaState()
@@ -3310,6 +3313,32 @@ static int celestia_takescreenshot(lua_State* l)
     return 1;
 }
 
+// Write the times of the profiled zones during the last frames as a Chrome
+// trace, in the screenshot directory.
+static int celestia_writeprofiletrace(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No argument expected for celestia:writeprofiletrace");
+    CelestiaCore* appCore = this_celestia(l);
+    LuaState* luastate = getLuaStateObject(l);
+
+    string path = appCore->getConfig()->scriptScreenshotDirectory;
+    if (path.length() > 0 &&
+        path[path.length()-1] != '/' &&
+        path[path.length()-1] != '\\')
+
+        path.append("/");
+
+    luastate->profileTraceCount++;
+    char filename[32];
+    sprintf(filename, "profile-%06i.json", luastate->profileTraceCount);
+
+    ofstream out((path + filename).c_str(), ios::out);
+    bool success = out.good() && GetProfiler()->writeChromeTrace(out);
+    lua_pushboolean(l, success);
+
+    return 1;
+}
+
 static int celestia_createcelscript(lua_State* l)
 {
     Celx_CheckArgs(l, 2, 2, "Need one argument for celestia:createcelscript()");
@@ -3509,6 +3538,7 @@ static void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "getscripttime", celestia_getscripttime);
     Celx_RegisterMethod(l, "requestkeyboard", celestia_requestkeyboard);
     Celx_RegisterMethod(l, "takescreenshot", celestia_takescreenshot);
+    Celx_RegisterMethod(l, "writeprofiletrace", celestia_writeprofiletrace);
     Celx_RegisterMethod(l, "createcelscript", celestia_createcelscript);
     Celx_RegisterMethod(l, "requestsystemaccess", celestia_requestsystemaccess);
     Celx_RegisterMethod(l, "getscriptpath", celestia_getscriptpath);
@@ -59,6 +59,7 @@ public:
     bool charEntered(const char*);
     double getTime() const;
     int screenshotCount;
+    int profileTraceCount;
     double timeout;
 
     // Celx script event handlers
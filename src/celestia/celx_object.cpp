@@ -19,6 +19,7 @@
 #include <celengine/visibleregion.h>
 #include <celengine/planetgrid.h>
 #include "celestiacore.h"
+#include "eclipsefinder.h"
 
 using namespace Eigen;
 using namespace std;
@@ -1297,6 +1298,74 @@ static int object_phases(lua_State* l)
 }
 
 
+/*! table object:eclipses(number starttime, number endtime [, string type])
+*
+* Find the eclipses involving a solar system body and its satellites
+* between two times (TDB). The type is "solar", "lunar" or "all"
+* (the default). The result is a table of eclipses sorted by start time;
+* each is a table with the fields occulter, receiver, starttime and endtime.
+* Satellites that are spacecraft, surface features, components or
+* invisible objects are ignored.
+*
+* \verbatim
+* -- Example: list the lunar eclipses of 2010
+* --
+* earth = celestia:find("Sol/Earth")
+* t0 = celestia:utctotdb(2010, 1, 1)
+* t1 = celestia:utctotdb(2011, 1, 1)
+* for i, e in ipairs(earth:eclipses(t0, t1, "lunar")) do
+*     celestia:print(e.occulter:name() .. " " .. e.receiver:name() .. " " .. e.starttime)
+* end
+*
+* \endverbatim
+*/
+static int object_eclipses(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(3, 4, "Two or three arguments expected for object:eclipses");
+
+    Selection* sel = this_object(l);
+    double startTime = celx.safeGetNumber(2, AllErrors, "Start time expected as first argument to object:eclipses");
+    double endTime = celx.safeGetNumber(3, AllErrors, "End time expected as second argument to object:eclipses");
+
+    int eclipseTypeMask = EclipseFinder::SolarEclipse | EclipseFinder::LunarEclipse;
+    const char* typeName = celx.safeGetString(4, WrongType, "Eclipse type expected as third argument to object:eclipses");
+    if (typeName != NULL)
+    {
+        if (compareIgnoringCase(typeName, "solar") == 0)
+            eclipseTypeMask = EclipseFinder::SolarEclipse;
+        else if (compareIgnoringCase(typeName, "lunar") == 0)
+            eclipseTypeMask = EclipseFinder::LunarEclipse;
+        else if (compareIgnoringCase(typeName, "all") != 0)
+            celx.doError("Eclipse type must be solar, lunar or all");
+    }
+
+    lua_newtable(l);
+    if (sel->body() == NULL)
+        return 1;
+
+    vector<EclipseRecord> eclipses;
+    EclipseFinder finder(sel->body());
+    finder.findEclipses(startTime, endTime, eclipseTypeMask, eclipses);
+
+    for (unsigned int i = 0; i < eclipses.size(); i++)
+    {
+        lua_newtable(l);
+        lua_pushstring(l, "occulter");
+        object_new(l, Selection(eclipses[i].occulter));
+        lua_settable(l, -3);
+        lua_pushstring(l, "receiver");
+        object_new(l, Selection(eclipses[i].receiver));
+        lua_settable(l, -3);
+        celx.setTable("starttime", eclipses[i].startTime);
+        celx.setTable("endtime", eclipses[i].endTime);
+        lua_rawseti(l, -2, i + 1);
+    }
+
+    return 1;
+}
+
+
 void CreateObjectMetaTable(lua_State* l)
 {
     CelxLua celx(l);
@@ -1333,6 +1402,7 @@ void CreateObjectMetaTable(lua_State* l)
     celx.registerMethod("bodyframe", object_bodyframe);
     celx.registerMethod("getphase", object_getphase);
     celx.registerMethod("phases", object_phases);
+    celx.registerMethod("eclipses", object_eclipses);
     celx.registerMethod("preloadtexture", object_preloadtexture);
     
     lua_pop(l, 1); // pop metatable off the stack
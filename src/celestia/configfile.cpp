@@ -10,6 +10,7 @@
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <cstdlib>
 #include <celutil/debug.h>
 #include <celutil/directory.h>
 #include <celutil/util.h>
@@ -32,6 +33,34 @@ static unsigned int getUint(Hash* params,
 }
 
 
+// Parsed catalogs are cached in a per-user directory unless the config file
+// names another one.
+static string defaultCatalogCacheDirectory()
+{
+#ifdef _WIN32
+    const char* appData = getenv("LOCALAPPDATA");
+    if (appData == NULL || *appData == '\0')
+        return "";
+    return string(appData) + "\\Celestia\\Cache";
+#else
+    const char* cacheHome = getenv("XDG_CACHE_HOME");
+    if (cacheHome != NULL && *cacheHome != '\0')
+        return string(cacheHome) + "/celestia";
+
+#ifdef __APPLE__
+    string directory = WordExp("~/Library/Caches/Celestia");
+#else
+    string directory = WordExp("~/.cache/celestia");
+#endif
+    // With no home directory, ~ isn't expanded; don't create a directory
+    // named ~ wherever Celestia happens to be running.
+    if (directory[0] == '~')
+        return "";
+    return directory;
+#endif
+}
+
+
 CelestiaConfig* ReadCelestiaConfig(string filename, CelestiaConfig *config)
 {
     ifstream configFile(filename.c_str());
@@ -121,6 +150,28 @@ CelestiaConfig* ReadCelestiaConfig(string filename, CelestiaConfig *config)
     configParams->getBoolean("ReverseMouseWheel", config->reverseMouseWheel);
     configParams->getString("ScriptScreenshotDirectory", config->scriptScreenshotDirectory);
     config->scriptScreenshotDirectory = WordExp(config->scriptScreenshotDirectory);
+    // An empty CatalogCacheDirectory turns the catalog cache off.
+    if (configParams->getString("CatalogCacheDirectory", config->catalogCacheDirectory))
+        config->catalogCacheDirectory = WordExp(config->catalogCacheDirectory);
+    else
+        config->catalogCacheDirectory = defaultCatalogCacheDirectory();
+    config->parallelCatalogLoading = false;
+    configParams->getBoolean("ParallelCatalogLoading", config->parallelCatalogLoading);
+    config->ephemerisCacheTolerance = 0.0;
+    configParams->getNumber("EphemerisCacheTolerance", config->ephemerisCacheTolerance);
+    config->ephemerisCacheSegments = getUint(configParams, "EphemerisCacheSegments", 64);
+    config->virtualTextureMemory = getUint(configParams, "VirtualTextureMemory", 256);
+    config->virtualTextureUploadBudget = getUint(configParams, "VirtualTextureUploadBudget", 4096);
+    config->backgroundTextureLoading = false;
+    configParams->getBoolean("BackgroundTextureLoading", config->backgroundTextureLoading);
+    config->textureUploadBudget = getUint(configParams, "TextureUploadBudget", 8192);
+    config->resourceMemoryBudget = getUint(configParams, "ResourceMemoryBudget", 0);
+    config->textureMemoryBudget = getUint(configParams, "TextureMemoryBudget", 0);
+    config->modelMemoryBudget = getUint(configParams, "ModelMemoryBudget", 0);
+    config->resourceUnloadDelay = getUint(configParams, "ResourceUnloadDelay", 300);
+    config->orbitCacheMemory = getUint(configParams, "OrbitCacheMemory", 32);
+    config->backgroundOrbitSampling = false;
+    configParams->getBoolean("BackgroundOrbitSampling", config->backgroundOrbitSampling);
     config->scriptSystemAccessPolicy = "ask";
     configParams->getString("ScriptSystemAccessPolicy", config->scriptSystemAccessPolicy);
 
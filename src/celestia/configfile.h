@@ -43,6 +43,20 @@ public:
     float mouseRotationSensitivity;
     bool  reverseMouseWheel;
     std::string scriptScreenshotDirectory;
+    std::string catalogCacheDirectory;
+    bool parallelCatalogLoading;
+    double ephemerisCacheTolerance;
+    unsigned int ephemerisCacheSegments;
+    unsigned int virtualTextureMemory;
+    unsigned int virtualTextureUploadBudget;
+    bool backgroundTextureLoading;
+    unsigned int textureUploadBudget;
+    unsigned int resourceMemoryBudget;
+    unsigned int textureMemoryBudget;
+    unsigned int modelMemoryBudget;
+    unsigned int resourceUnloadDelay;
+    unsigned int orbitCacheMemory;
+    bool backgroundOrbitSampling;
     std::string scriptSystemAccessPolicy;
 #ifdef CELX
     std::string luaHook;
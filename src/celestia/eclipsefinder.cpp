@@ -1,6 +1,6 @@
 // eclipsefinder.cpp by Christophe Teyssier <chris@teyssier.org>
 // adapted form wineclipses.cpp by Kendrix <kendrix@wanadoo.fr>
-// 
+//
 // Copyright (C) 2001-2009, the Celestia Development Team
 //
 // Compute Solar Eclipses for our Solar System planets
@@ -19,7 +19,12 @@
 #include "celmath/mathlib.h"
 #include "celmath/ray.h"
 #include "celmath/distance.h"
+#include "celmath/solve.h"
 #include <celengine/eigenport.h>
+#include <celengine/frame.h>
+#include <celengine/timeline.h>
+#include <celengine/timelinephase.h>
+#include <celutil/threadpool.h>
 
 using namespace Eigen;
 using namespace std;
@@ -43,92 +48,408 @@ Eclipse::Eclipse(double JD) :
 // TODO: share this constant and function with render.cpp
 static const float MinRelativeOccluderRadius = 0.005f;
 
-bool EclipseFinder::testEclipse(const Body& receiver, const Body& caster,
-                                double now) const
-{
-    // Ignore situations where the shadow casting body is much smaller than
-    // the receiver, as these shadows aren't likely to be relevant.  Also,
-    // ignore eclipses where the caster is not an ellipsoid, since we can't
-    // generate correct shadows in this case.
-    if (caster.getRadius() >= receiver.getRadius() * MinRelativeOccluderRadius &&
-        caster.isEllipsoid())
-    {
-        // All of the eclipse related code assumes that both the caster
-        // and receiver are spherical.  Irregular receivers will work more
-        // or less correctly, but casters that are sufficiently non-spherical
-        // will produce obviously incorrect shadows.  Another assumption we
-        // make is that the distance between the caster and receiver is much
-        // less than the distance between the sun and the receiver.  This
-        // approximation works everywhere in the solar system, and likely
-        // works for any orbitally stable pair of objects orbiting a star.
-        Vector3d posReceiver = receiver.getAstrocentricPosition(now);
-        Vector3d posCaster = caster.getAstrocentricPosition(now);
-
-        const Star* sun = receiver.getSystem()->getStar();
-        assert(sun != NULL);
-        double distToSun = posReceiver.norm();
-        float appSunRadius = (float) (sun->getRadius() / distToSun);
-
-        Vector3d dir = posCaster - posReceiver;
-        double distToCaster = dir.norm() - receiver.getRadius();
-        float appOccluderRadius = (float) (caster.getRadius() / distToCaster);
-
-        // The shadow radius is the radius of the occluder plus some additional
-        // amount that depends upon the apparent radius of the sun.  For
-        // a sun that's distant/small and effectively a point, the shadow
-        // radius will be the same as the radius of the occluder.
-        float shadowRadius = (1 + appSunRadius / appOccluderRadius) *
-            caster.getRadius();
-
-        // Test whether a shadow is cast on the receiver.  We want to know
-        // if the receiver lies within the shadow volume of the caster.  Since
-        // we're assuming that everything is a sphere and the sun is far
-        // away relative to the caster, the shadow volume is a
-        // cylinder capped at one end.  Testing for the intersection of a
-        // singly capped cylinder is as simple as checking the distance
-        // from the center of the receiver to the axis of the shadow cylinder.
-        // If the distance is less than the sum of the caster's and receiver's
-        // radii, then we have an eclipse.
-        float R = receiver.getRadius() + shadowRadius;
-        double dist = distance(posReceiver, Ray3d(posCaster, posCaster));
-        if (dist < R)
+// Satellites of these classes are searched; spacecraft, surface features,
+// components and invisible objects are skipped.
+static const int EclipseObjectMask = Body::Planet | Body::Moon | Body::MinorMoon |
+                                     Body::DwarfPlanet | Body::Asteroid | Body::Comet;
+
+// The shadow distance is sampled this many times per orbital period of
+// the satellite, but at least once a day. Between three samples, it has
+// at most one minimum.
+static const double SamplesPerPeriod = 16.0;
+static const double MaxSearchStep = 1.0;
+static const double MinSearchStep = 1.0 / 1440.0;
+
+// Contact times are found to within this many days (about 0.01 seconds)
+static const double ContactPrecision = 1.0e-7;
+
+// Give up following an eclipse after this many samples; a body doesn't
+// stay in a shadow for long unless the orbits are bogus.
+static const int MaxEclipseSamples = 1000;
+
+// The search is done in spans of this many days; the watcher is notified
+// after each span.
+static const double SearchSpan = 30.0;
+
+
+// Return the distance of the receiver from the shadow of the occulter, in
+// kilometers: negative when the receiver is at least partly in shadow.
+//
+// All of the eclipse related code assumes that both the occulter and
+// receiver are spherical.  Irregular receivers will work more or less
+// correctly, but occulters that are sufficiently non-spherical will
+// produce obviously incorrect shadows.  Another assumption we make is
+// that the distance between the occulter and receiver is much less than
+// the distance between the sun and the receiver.  This approximation
+// works everywhere in the solar system, and likely works for any
+// orbitally stable pair of objects orbiting a star.
+static double ShadowDistance(const Body& receiver, const Body& occulter, double t)
+{
+    Vector3d posReceiver = receiver.getAstrocentricPosition(t);
+    Vector3d posOcculter = occulter.getAstrocentricPosition(t);
+
+    const Star* sun = receiver.getSystem()->getStar();
+    assert(sun != NULL);
+    double distToSun = posReceiver.norm();
+    double appSunRadius = sun->getRadius() / distToSun;
+
+    Vector3d dir = posOcculter - posReceiver;
+    double distToOcculter = dir.norm() - receiver.getRadius();
+    double appOccluderRadius = occulter.getRadius() / distToOcculter;
+
+    // The shadow radius is the radius of the occulter plus some additional
+    // amount that depends upon the apparent radius of the sun.  For
+    // a sun that's distant/small and effectively a point, the shadow
+    // radius will be the same as the radius of the occulter.
+    double shadowRadius = (1 + appSunRadius / appOccluderRadius) * occulter.getRadius();
+
+    // Since we're assuming that everything is a sphere and the sun is far
+    // away relative to the occulter, the shadow volume is a cylinder
+    // capped at one end, and the receiver is in it if the distance from
+    // its center to the axis of the cylinder is less than the sum of the
+    // radii.
+    double R = receiver.getRadius() + shadowRadius;
+    return distance(posReceiver, Ray3d(posOcculter, posOcculter)) - R;
+}
+
+
+// "Eclipses" where the occulter and receiver have intersecting bounding
+// spheres are ignored.
+static bool BoundingSpheresIntersect(const Body& receiver, const Body& occulter, double t)
+{
+    Vector3d dir = occulter.getAstrocentricPosition(t) - receiver.getAstrocentricPosition(t);
+    return dir.norm() - receiver.getRadius() <= occulter.getRadius();
+}
+
+
+// Return true if the position of the body may be computed from several
+// threads at once: its orbits must be thread safe, and its frames mustn't
+// depend on rotation models, which cache their results unprotected.
+static bool IsPositionThreadSafe(const Body* body, unsigned int depth = 0)
+{
+    if (depth > 16)
+        return false;
+
+    const Timeline* timeline = body->getTimeline();
+    for (unsigned int i = 0; i < timeline->phaseCount(); i++)
+    {
+        const TimelinePhase* phase = timeline->getPhase(i);
+        if (!phase->orbit()->isThreadSafe())
+            return false;
+
+        const ReferenceFrame* frame = phase->orbitFrame();
+        if (dynamic_cast<const J2000EclipticFrame*>(frame) == NULL &&
+            dynamic_cast<const J2000EquatorFrame*>(frame) == NULL)
+        {
+            return false;
+        }
+
+        Selection center = frame->getCenter();
+        if (center.body() != NULL && !IsPositionThreadSafe(center.body(), depth + 1))
+            return false;
+    }
+
+    return true;
+}
+
+
+struct ShadowDistanceFunction
+{
+    ShadowDistanceFunction(const Body& _receiver, const Body& _occulter) :
+        receiver(_receiver), occulter(_occulter) {};
+
+    double operator()(double t) const
+    {
+        return ShadowDistance(receiver, occulter, t);
+    }
+
+    const Body& receiver;
+    const Body& occulter;
+};
+
+
+/*! Search for the eclipses of one receiver by one occulter. The shadow
+ *  distance is sampled on a grid of times; each search covers a range of
+ *  grid points and finds the eclipses that start there, so that searches
+ *  of consecutive ranges find each eclipse once.
+ */
+class EclipsePairSearch
+{
+ public:
+    EclipsePairSearch(Body* _receiver, Body* _occulter, double _startTime, double _step) :
+        receiver(_receiver),
+        occulter(_occulter),
+        startTime(_startTime),
+        step(_step),
+        f(*_receiver, *_occulter)
+    {
+    }
+
+    void search(int first, int last);
+
+    bool isThreadSafe() const
+    {
+        return IsPositionThreadSafe(receiver) && IsPositionThreadSafe(occulter);
+    }
+
+    double getStep() const { return step; }
+
+    Body* receiver;
+    Body* occulter;
+    vector<EclipseRecord> eclipses;
+
+ private:
+    double sampleTime(int i) const { return startTime + step * i; }
+    double findContact(double t0, double t1) const;
+    void addEclipse(double start, double end);
+
+    double startTime;
+    double step;
+    ShadowDistanceFunction f;
+};
+
+
+double EclipsePairSearch::findContact(double t0, double t1) const
+{
+    return solve_brent(f, t0, t1, ContactPrecision).first;
+}
+
+
+void EclipsePairSearch::addEclipse(double start, double end)
+{
+    if (BoundingSpheresIntersect(*receiver, *occulter, (start + end) * 0.5))
+        return;
+
+    EclipseRecord eclipse;
+    eclipse.receiver = receiver;
+    eclipse.occulter = occulter;
+    eclipse.startTime = start;
+    eclipse.endTime = end;
+    eclipses.push_back(eclipse);
+}
+
+
+// Find the eclipses that start between grid points first and last + 1.
+void EclipsePairSearch::search(int first, int last)
+{
+    // Shadow distances at the previous, current and next grid points
+    double f0 = f(sampleTime(first - 1));
+    double f1 = f(sampleTime(first));
+
+    // The search of the first range also reports an eclipse in progress
+    if (first == 0 && f1 < 0.0)
+    {
+        int j = 0;
+        while (j > -MaxEclipseSamples && f(sampleTime(j - 1)) < 0.0)
+            j--;
+        double start = findContact(sampleTime(j - 1), sampleTime(j));
+        j = 0;
+        while (j < MaxEclipseSamples && f(sampleTime(j + 1)) < 0.0)
+            j++;
+        addEclipse(start, findContact(sampleTime(j), sampleTime(j + 1)));
+    }
+
+    for (int i = first; i <= last; i++)
+    {
+        double f2 = f(sampleTime(i + 1));
+
+        if (f1 >= 0.0 && f2 < 0.0)
+        {
+            // The receiver enters the shadow; follow it until it leaves.
+            double start = findContact(sampleTime(i), sampleTime(i + 1));
+            int j = i + 1;
+            while (j < i + MaxEclipseSamples && f(sampleTime(j + 1)) < 0.0)
+                j++;
+            addEclipse(start, findContact(sampleTime(j), sampleTime(j + 1)));
+        }
+        else if (f0 > f1 && f1 <= f2 && f1 >= 0.0 && f2 >= 0.0 && f0 >= 0.0)
         {
-            // Ignore "eclipses" where the caster and receiver have
-            // intersecting bounding spheres.
-            if (distToCaster > caster.getRadius())
-                return true;
+            // A minimum between the samples; the receiver may graze the
+            // shadow without being in it at any of the samples.
+            pair<double, double> minimum =
+                minimize_brent(f, sampleTime(i - 1), sampleTime(i + 1), ContactPrecision);
+            if (minimum.second < 0.0)
+            {
+                addEclipse(findContact(sampleTime(i - 1), minimum.first),
+                           findContact(minimum.first, sampleTime(i + 1)));
+            }
         }
+
+        f0 = f1;
+        f1 = f2;
+    }
+}
+
+
+class EclipseSearchTask : public ThreadTask
+{
+ public:
+    EclipseSearchTask(EclipsePairSearch* _search, int _first, int _last) :
+        search(_search), first(_first), last(_last) {};
+
+    void run()
+    {
+        search->search(first, last);
     }
 
-    return false;
+ private:
+    EclipsePairSearch* search;
+    int first;
+    int last;
+};
+
+
+struct EclipseStartTimePredicate
+{
+    bool operator()(const EclipseRecord& e0, const EclipseRecord& e1) const
+    {
+        return e0.startTime < e1.startTime;
+    }
+};
+
+
+EclipseFinder::EclipseFinder(Body* _body,
+                             EclipseFinderWatcher* _watcher) :
+    body(_body),
+    watcher(_watcher),
+    appCore(NULL),
+    type(Eclipse::Solar),
+    JDfrom(0.0),
+    JDto(0.0),
+    toProcess(false)
+{
+}
+
+
+EclipseFinder::EclipseFinder(CelestiaCore* core,
+                             const std::string& strPlaneteToFindOn_,
+                             Eclipse::Type type_,
+                             double from,
+                             double to ) :
+    body(NULL),
+    watcher(NULL),
+    appCore(core),
+    strPlaneteToFindOn(strPlaneteToFindOn_),
+    type(type_),
+    JDfrom(from),
+    JDto(to),
+    toProcess(true)
+{
 }
 
 
-double EclipseFinder::findEclipseSpan(const Body& receiver, const Body& caster,
-                       double now, double dt) const
+/*! Find the eclipses involving the body and its satellites that start
+ *  between startDate and endDate (TDB), sorted by start time. Solar
+ *  eclipses are those where a satellite casts its shadow on the body, and
+ *  lunar eclipses those where a satellite is in the body's shadow.
+ */
+void EclipseFinder::findEclipses(double startDate,
+                                 double endDate,
+                                 int eclipseTypeMask,
+                                 vector<EclipseRecord>& eclipses)
 {
-    double t = now;
-    while (testEclipse(receiver, caster, t))
-        t += dt;
+    PlanetarySystem* satellites = body->getSatellites();
+
+    // See if there's anything that could test
+    if (satellites == NULL || endDate < startDate)
+        return;
+
+    // Make a list of the pairs of bodies that we'll actually test for
+    // eclipses; ignore spacecraft, other non-natural objects and very small
+    // objects.
+    vector<EclipsePairSearch*> searches;
+    for (int i = 0; i < satellites->getSystemSize(); i++)
+    {
+        Body* obj = satellites->getBody(i);
+        if ((obj->getClassification() & EclipseObjectMask) == 0)
+            continue;
+
+        double period = obj->getOrbit(startDate)->getPeriod();
+        double step = min(max(period / SamplesPerPeriod, MinSearchStep), MaxSearchStep);
+
+        if ((eclipseTypeMask & SolarEclipse) != 0 && obj->isEllipsoid() &&
+            obj->getRadius() >= body->getRadius() * MinRelativeOccluderRadius)
+        {
+            searches.push_back(new EclipsePairSearch(body, obj, startDate, step));
+        }
+
+        if ((eclipseTypeMask & LunarEclipse) != 0 && body->isEllipsoid() &&
+            body->getRadius() >= obj->getRadius() * MinRelativeOccluderRadius)
+        {
+            searches.push_back(new EclipsePairSearch(obj, body, startDate, step));
+        }
+    }
+
+    // Pairs whose positions can't be computed from several threads are
+    // searched on this thread.
+    vector<bool> threadSafe(searches.size());
+    for (unsigned int i = 0; i < searches.size(); i++)
+        threadSafe[i] = searches[i]->isThreadSafe();
 
-    return t;
+    ThreadPool* pool = searches.size() > 1 ? new ThreadPool() : NULL;
+
+    for (double spanStart = startDate; spanStart <= endDate; spanStart += SearchSpan)
+    {
+        double spanEnd = min(spanStart + SearchSpan, endDate);
+        for (unsigned int i = 0; i < searches.size(); i++)
+        {
+            // Grid points of the pair within the span
+            double step = searches[i]->getStep();
+            int first = (int) ceil((spanStart - startDate) / step);
+            int last = (int) ceil((spanEnd - startDate) / step) - 1;
+            if (spanEnd == endDate)
+                last++;
+            if (first > last)
+                continue;
+
+            if (pool != NULL && threadSafe[i])
+                pool->addTask(new EclipseSearchTask(searches[i], first, last));
+            else
+                searches[i]->search(first, last);
+        }
+
+        if (pool != NULL)
+            pool->wait();
+
+        if (watcher != NULL)
+        {
+            if (watcher->eclipseFinderProgressUpdate(spanEnd) == EclipseFinderWatcher::AbortOperation)
+                break;
+        }
+
+        if (spanEnd == endDate)
+            break;
+    }
+
+    delete pool;
+
+    vector<EclipseRecord> found;
+    for (unsigned int i = 0; i < searches.size(); i++)
+    {
+        for (vector<EclipseRecord>::const_iterator iter = searches[i]->eclipses.begin();
+             iter != searches[i]->eclipses.end(); iter++)
+        {
+            if (iter->startTime <= endDate)
+                found.push_back(*iter);
+        }
+        delete searches[i];
+    }
+
+    sort(found.begin(), found.end(), EclipseStartTimePredicate());
+    eclipses.insert(eclipses.end(), found.begin(), found.end());
 }
 
 
 int EclipseFinder::CalculateEclipses()
 {
     Simulation* sim = appCore->getSimulation();
-    
+
     Eclipse* eclipse;
-    double* JDback = NULL;
-    
-    int nIDplanetetofindon = 0;
-    int nSattelites = 0;
 
     const SolarSystem* sys = sim->getNearestSolarSystem();
-    
+
     toProcess = false;
-    
+
     if ((!sys))
     {
         eclipse = new Eclipse(0.);
@@ -149,74 +470,42 @@ int EclipseFinder::CalculateEclipses()
     PlanetarySystem* system = sys->getPlanets();
     int nbPlanets = system->getSystemSize();
 
+    Body* planete = NULL;
     for (int i = 0; i < nbPlanets; ++i)
     {
-        Body* planete = system->getBody(i);
-        if (planete != NULL)
-            if (strPlaneteToFindOn == planete->getName())
-            {
-                nIDplanetetofindon = i;
-                PlanetarySystem* satellites = planete->getSatellites();
-                if (satellites)
-                {
-                    nSattelites = satellites->getSystemSize();
-                    JDback = new double[nSattelites];
-                    memset(JDback, 0, nSattelites*sizeof(double));
-                }
-                break;
-            }
+        Body* obj = system->getBody(i);
+        if (obj != NULL && strPlaneteToFindOn == obj->getName())
+        {
+            planete = obj;
+            break;
+        }
     }
 
-    Body* planete = system->getBody(nIDplanetetofindon);
-    while (JDfrom < JDto)
+    if (planete != NULL)
     {
-        PlanetarySystem* satellites = planete->getSatellites();
-        if (satellites)
+        body = planete;
+
+        vector<EclipseRecord> eclipses;
+        findEclipses(JDfrom, JDto,
+                     type == Eclipse::Solar ? SolarEclipse : LunarEclipse,
+                     eclipses);
+
+        for (vector<EclipseRecord>::const_iterator iter = eclipses.begin();
+             iter != eclipses.end(); iter++)
         {
-            for (int j = 0; j < nSattelites; ++j)
-            {
-                Body* caster = NULL;
-                Body* receiver = NULL;
-                bool test = false;
-
-                if (satellites->getBody(j)->getClassification() != Body::Spacecraft)
-                {
-                    if (type == Eclipse::Solar)
-                    {
-                        caster = satellites->getBody(j);
-                        receiver = planete;
-                    }
-                    else
-                    {
-                        caster = planete;
-                        receiver = satellites->getBody(j);
-                    }
-
-                    test = testEclipse(*receiver, *caster, JDfrom);
-                }
-
-                if (test && JDfrom - JDback[j] > 1)
-                {
-                    JDback[j] = JDfrom;
-                    eclipse = new Eclipse(JDfrom);
-                    eclipse->startTime = findEclipseSpan(*receiver, *caster,
-                                                         JDfrom,
-                                                         -1.0 / (24.0 * 60.0));
-                    eclipse->endTime   = findEclipseSpan(*receiver, *caster,
-                                                         JDfrom,
-                                                         1.0 / (24.0 * 60.0));
-                    eclipse->body = receiver;
-                    eclipse->planete = planete->getName();
-                    eclipse->sattelite = satellites->getBody(j)->getName();
-                    Eclipses_.insert(Eclipses_.end(), *eclipse);
-                    delete eclipse;
-                }
-            }
+            Body* satellite = type == Eclipse::Solar ? iter->occulter : iter->receiver;
+
+            eclipse = new Eclipse(iter->startTime);
+            eclipse->startTime = iter->startTime;
+            eclipse->endTime = iter->endTime;
+            eclipse->body = iter->receiver;
+            eclipse->planete = planete->getName();
+            eclipse->sattelite = satellite->getName();
+            Eclipses_.insert(Eclipses_.end(), *eclipse);
+            delete eclipse;
         }
-        JDfrom += 1.0 / 24.0;
     }
-    if (JDback)
-        delete JDback;
+
     if (Eclipses_.empty())
     {
         eclipse = new Eclipse(0.);
@@ -226,4 +515,3 @@ int EclipseFinder::CalculateEclipses()
     }
     return 0;
 }
-
@@ -37,24 +37,84 @@ public:
     double endTime;
 };
 
+
+/*! An eclipse found by the eclipse finder. The start and end times (TDB)
+ *  are the contacts of the receiver with the occulter's shadow.
+ */
+class EclipseRecord
+{
+public:
+    EclipseRecord() :
+        occulter(NULL),
+        receiver(NULL),
+        startTime(0.0),
+        endTime(0.0)
+    {
+    }
+
+    Body* occulter;
+    Body* receiver;
+    double startTime;
+    double endTime;
+};
+
+
+class EclipseFinderWatcher
+{
+public:
+    virtual ~EclipseFinderWatcher() {};
+
+    enum Status
+    {
+        ContinueOperation = 0,
+        AbortOperation = 1,
+    };
+
+    virtual Status eclipseFinderProgressUpdate(double t) = 0;
+};
+
+
+/*! The eclipse finder searches for eclipses involving a body and its
+ *  satellites. Eclipses are found as the times when the distance of the
+ *  receiver from the axis of the occulter's shadow, less the radius of
+ *  the shadow and the receiver, is negative. That function is sampled at
+ *  a fraction of the satellite's orbital period; sign changes bracket the
+ *  contacts, and local minima between samples are searched for grazing
+ *  eclipses that the samples miss. The contact times are then refined
+ *  with Brent's method. Body pairs whose positions may be computed from
+ *  several threads at once are searched in parallel.
+ */
 class EclipseFinder
 {
  public:
-    EclipseFinder(CelestiaCore* core, 
-                  const std::string& strPlaneteToFindOn_, 
+    EclipseFinder(Body* _body,
+                  EclipseFinderWatcher* _watcher = NULL);
+
+    // Constructor for the older interface used by the GTK, KDE and Windows
+    // front ends; the planet is found by name in the nearest solar system.
+    EclipseFinder(CelestiaCore* core,
+                  const std::string& strPlaneteToFindOn_,
                   Eclipse::Type type_,
-                  double from, 
-                  double to )
-                   :appCore(core),
-                    strPlaneteToFindOn(strPlaneteToFindOn_),
-                    type(type_),
-                    JDfrom(from),
-                    JDto(to),
-                    toProcess(true) {};
-       
+                  double from,
+                  double to );
+
+    enum
+    {
+        SolarEclipse = 0x1,
+        LunarEclipse = 0x2,
+    };
+
+    void findEclipses(double startDate,
+                      double endDate,
+                      int eclipseTypeMask,
+                      std::vector<EclipseRecord>& eclipses);
+
     const std::vector<Eclipse>& getEclipses() { if (toProcess) CalculateEclipses(); return Eclipses_; };
     
  private:
+    Body* body;
+    EclipseFinderWatcher* watcher;
+
     CelestiaCore* appCore;
     std::vector<Eclipse> Eclipses_;
 
@@ -63,11 +123,8 @@ class EclipseFinder
     double JDfrom, JDto;  
     
     bool toProcess;
-    
-    int CalculateEclipses();
-    bool testEclipse(const Body& receiver, const Body& caster, double now) const;
-    double findEclipseSpan(const Body& receiver, const Body& caster, double now, double dt) const;
 
+    int CalculateEclipses();
 };
-#endif // _ECLIPSEFINDER_H_
 
+#endif // _ECLIPSEFINDER_H_
@@ -0,0 +1,133 @@
+// framereadback.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Read frames from the frame buffer without stalling the renderer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstring>
+#include <GL/glew.h>
+#include "framereadback.h"
+
+using namespace std;
+
+
+static int bytesPerPixel(unsigned int format)
+{
+    switch (format)
+    {
+    case GL_RGBA:
+    case GL_BGRA_EXT:
+        return 4;
+    case GL_LUMINANCE:
+        return 1;
+    default:
+        return 3;
+    }
+}
+
+
+FrameReadback::FrameReadback(int _width, int _height,
+                             unsigned int _format,
+                             unsigned int _bufferCount) :
+    width(_width),
+    height(_height),
+    format(_format),
+    rowBytes((_width * bytesPerPixel(_format) + 3) & ~0x3),
+    bufferCount(1),
+    nextBuffer(0),
+    pendingCount(0),
+    pixels(NULL)
+{
+    if (GLEW_ARB_pixel_buffer_object && _bufferCount > 1)
+    {
+        bufferObjects.resize(_bufferCount);
+        glGenBuffersARB(_bufferCount, &bufferObjects[0]);
+        for (unsigned int i = 0; i < _bufferCount; i++)
+        {
+            glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, bufferObjects[i]);
+            glBufferDataARB(GL_PIXEL_PACK_BUFFER_ARB, rowBytes * height, NULL, GL_STREAM_READ_ARB);
+        }
+        glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+        bufferCount = _bufferCount;
+    }
+    else
+    {
+        pixels = new unsigned char[rowBytes * height];
+    }
+}
+
+
+FrameReadback::~FrameReadback()
+{
+    delete[] pixels;
+}
+
+
+void FrameReadback::release()
+{
+    if (!bufferObjects.empty())
+        glDeleteBuffersARB(bufferObjects.size(), &bufferObjects[0]);
+    bufferObjects.clear();
+    pendingCount = 0;
+}
+
+
+/*! Start reading the frame with lower left corner at (x, y). The readback
+ *  must not be full.
+ */
+void FrameReadback::read(int x, int y)
+{
+    if (isFull())
+        return;
+
+    if (isAsynchronous())
+    {
+        glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, bufferObjects[nextBuffer]);
+        glReadPixels(x, y, width, height, format, GL_UNSIGNED_BYTE, NULL);
+        glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+    }
+    else
+    {
+        glReadPixels(x, y, width, height, format, GL_UNSIGNED_BYTE, pixels);
+    }
+
+    nextBuffer = (nextBuffer + 1) % bufferCount;
+    pendingCount++;
+}
+
+
+/*! Copy the oldest frame that hasn't been fetched into pixels, which must
+ *  hold getRowBytes() * getHeight() bytes. Returns false if there was no
+ *  frame pending, or if the buffer holding it couldn't be mapped; the frame
+ *  is lost in the latter case.
+ */
+bool FrameReadback::fetch(unsigned char* _pixels)
+{
+    if (pendingCount == 0)
+        return false;
+
+    unsigned int buffer = (nextBuffer + bufferCount - pendingCount) % bufferCount;
+    pendingCount--;
+
+    if (!isAsynchronous())
+    {
+        memcpy(_pixels, pixels, rowBytes * height);
+        return true;
+    }
+
+    glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, bufferObjects[buffer]);
+    const void* data = glMapBufferARB(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB);
+    if (data != NULL)
+    {
+        memcpy(_pixels, data, rowBytes * height);
+        glUnmapBufferARB(GL_PIXEL_PACK_BUFFER_ARB);
+    }
+    glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+    return data != NULL;
+}
@@ -0,0 +1,72 @@
+// framereadback.h
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Read frames from the frame buffer without stalling the renderer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _FRAMEREADBACK_H_
+#define _FRAMEREADBACK_H_
+
+#include <vector>
+
+
+/*! FrameReadback reads a sequence of equally sized frames from the frame
+ *  buffer. When pixel buffer objects are supported, each frame is read
+ *  into the next of a ring of buffers and is only copied out after the
+ *  ring wraps around, so the GPU has had several frames to finish the
+ *  transfer and glReadPixels doesn't wait for rendering to finish.
+ *  Otherwise frames are read synchronously into a single buffer.
+ *
+ *  Frames are fetched in the order they were read. The GL context the
+ *  readback was created in must be current for every call except the
+ *  destructor. The destructor makes no GL calls, since it may run after
+ *  the context is gone; call release() first while the context is still
+ *  current, or the buffer objects are only freed along with the context.
+ */
+class FrameReadback
+{
+ public:
+    FrameReadback(int width, int height, unsigned int format,
+                  unsigned int bufferCount = 3);
+    ~FrameReadback();
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    // Bytes per row of a fetched frame; rows are four byte aligned as
+    // with the default GL pack alignment.
+    int getRowBytes() const { return rowBytes; }
+
+    // Number of frames read but not yet fetched
+    unsigned int getPendingCount() const { return pendingCount; }
+    // When full, the oldest frame must be fetched before another is read.
+    bool isFull() const { return pendingCount == bufferCount; }
+    bool isAsynchronous() const { return !bufferObjects.empty(); }
+
+    void read(int x, int y);
+    bool fetch(unsigned char* pixels);
+    // Delete the pixel buffer objects; frames not yet fetched are lost, and
+    // the readback may only be destroyed afterwards.
+    void release();
+
+ private:
+    FrameReadback(const FrameReadback&);
+    FrameReadback& operator=(const FrameReadback&);
+
+    int width;
+    int height;
+    unsigned int format;
+    int rowBytes;
+
+    unsigned int bufferCount;
+    unsigned int nextBuffer;
+    unsigned int pendingCount;
+    std::vector<unsigned int> bufferObjects;
+    unsigned char* pixels;
+};
+
+#endif // _FRAMEREADBACK_H_
@@ -79,6 +79,7 @@ static gchar* installDir = NULL;
 static gchar** extrasDir = NULL;
 static gboolean fullScreen = FALSE;
 static gboolean noSplash = FALSE;
+static gboolean rebuildCache = FALSE;
 
 /* Command-Line Options specification */
 static GOptionEntry optionEntries[] =
@@ -88,6 +89,7 @@ static GOptionEntry optionEntries[] =
 	{ "extrasdir", 'e', 0, G_OPTION_ARG_FILENAME_ARRAY, &extrasDir, "Additional \"extras\" directory", "directory" },
 	{ "fullscreen", 'f', 0, G_OPTION_ARG_NONE, &fullScreen, "Start full-screen", NULL },
 	{ "nosplash", 's', 0, G_OPTION_ARG_NONE, &noSplash, "Disable splash screen", NULL },
+	{ "rebuild-cache", 0, 0, G_OPTION_ARG_NONE, &rebuildCache, "Rebuild the cache of preparsed catalogs", NULL },
 	{ NULL, NULL, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
 };
 
@@ -384,6 +386,7 @@ int main(int argc, char* argv[])
 	}
 
 	/* Initialize the simulation */	
+	app->core->setRebuildCatalogCache(rebuildCache);
 	if (!app->core->initSimulation(altConfig, &configDirs, ss->notifier))
 		return 1;
 	
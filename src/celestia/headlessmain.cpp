@@ -0,0 +1,708 @@
+// headlessmain.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Headless front-end for Celestia: renders image sequences driven by a
+// script or a list of cel:// URLs into an offscreen EGL pbuffer, with no
+// window, event loop, or vsync. It can also measure the time spent
+// rendering the same frames, for comparing the performance of versions.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <time.h>
+#include <unistd.h>
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <celengine/astro.h>
+#include <celengine/render.h>
+#include <celutil/util.h>
+#include <celutil/debug.h>
+#include <celutil/timer.h>
+#include <celutil/resmanager.h>
+#include <celutil/profiler.h>
+#include "celestiacore.h"
+#include "imagecapture.h"
+
+using namespace std;
+
+
+char AppName[] = "Celestia";
+
+static int width = 640;
+static int height = 480;
+static string scriptFilename;
+static string urlsFilename;
+static string outputPrefix = "frame";
+static bool jpegOutput = false;
+static int pngCompression = 1;
+static double frameRate = 30.0;
+static unsigned int maxFrames = 0;
+static bool printTiming = false;
+static bool showHud = true;
+static string configFilename;
+static string dataDir;
+static vector<string> extrasDirs;
+static unsigned int benchmarkFrames = 0;
+static string reportFilename;
+static string traceFilename;
+// Julian date (TDB) at which the simulation starts
+static double simulationStartTime = 0.0;
+static bool startTimeGiven = false;
+
+// Longest time to wait for textures loading in the background before a
+// frame is written anyway, in seconds
+static const double MaxLoadWait = 60.0;
+
+// Frames drawn at the start of each benchmark scene before it's timed
+static const unsigned int BenchmarkWarmupFrames = 10;
+
+
+class HeadlessAlerter : public CelestiaCore::Alerter
+{
+public:
+    HeadlessAlerter() : failed(false) {};
+
+    void fatalError(const string& msg)
+    {
+        cerr << msg << '\n';
+        failed = true;
+    }
+
+    bool failed;
+};
+
+
+static void Usage()
+{
+    cerr << "Usage: celestia-headless [options] (--script <file> | --urls <file>)\n";
+    cerr << "  Options:\n";
+    cerr << "    --script <file>    : run a CEL or CELX script, writing a frame per time step\n";
+    cerr << "                         until the script finishes\n";
+    cerr << "    --urls <file>      : write a frame for each cel:// URL in a file, one per line\n";
+    cerr << "    --size <w> <h>     : size of the frames (default 640 480)\n";
+    cerr << "    --output <prefix>  : frame file names are prefix00000.png, ... (default frame)\n";
+    cerr << "    --jpeg             : write JPEG instead of PNG frames\n";
+    cerr << "    --compression <n>  : PNG compression level, 0-9 (default 1, fastest)\n";
+    cerr << "    --fps <rate>       : time steps per second of simulation time (default 30)\n";
+    cerr << "    --frames <n>       : stop after n frames\n";
+    cerr << "    --time <jd>        : start the simulation at a Julian date (TDB) instead of\n";
+    cerr << "                         the current time; benchmarks start at J2000\n";
+    cerr << "    --no-hud           : don't draw the information text\n";
+    cerr << "    --timing           : print the time spent on each frame\n";
+    cerr << "    --benchmark <n>    : don't write frames, but time n frames of each URL, or\n";
+    cerr << "                         of the script, and report statistics of the times\n";
+    cerr << "    --report <file>    : write the benchmark results to a file as JSON\n";
+    cerr << "    --trace <file>     : write the time spent in the profiled zones during\n";
+    cerr << "                         the last frames as a Chrome trace\n";
+    cerr << "    --conf <file>      : configuration file\n";
+    cerr << "    --dir <dir>        : data directory (default " << CONFIG_DATA_DIR << ")\n";
+    cerr << "    --extrasdir <dir>  : additional extras directory\n";
+}
+
+
+static bool parseCommandLine(int argc, char* argv[])
+{
+    int i = 1;
+
+    while (i < argc)
+    {
+        // Options with a single argument
+        if (i + 1 < argc && !strcmp(argv[i], "--script"))
+            scriptFilename = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "--urls"))
+            urlsFilename = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "--output"))
+            outputPrefix = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "--compression"))
+            pngCompression = atoi(argv[++i]);
+        else if (i + 1 < argc && !strcmp(argv[i], "--fps"))
+            frameRate = atof(argv[++i]);
+        else if (i + 1 < argc && !strcmp(argv[i], "--frames"))
+            maxFrames = (unsigned int) atoi(argv[++i]);
+        else if (i + 1 < argc && !strcmp(argv[i], "--time"))
+        {
+            simulationStartTime = atof(argv[++i]);
+            startTimeGiven = true;
+        }
+        else if (i + 1 < argc && !strcmp(argv[i], "--benchmark"))
+            benchmarkFrames = (unsigned int) atoi(argv[++i]);
+        else if (i + 1 < argc && !strcmp(argv[i], "--report"))
+            reportFilename = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "--trace"))
+            traceFilename = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "--conf"))
+            configFilename = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "--dir"))
+            dataDir = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "--extrasdir"))
+            extrasDirs.push_back(argv[++i]);
+        else if (i + 2 < argc && !strcmp(argv[i], "--size"))
+        {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--jpeg"))
+            jpegOutput = true;
+        else if (!strcmp(argv[i], "--no-hud"))
+            showHud = false;
+        else if (!strcmp(argv[i], "--timing"))
+            printTiming = true;
+        else
+        {
+            cerr << "Unknown or incomplete command line option: " << argv[i] << '\n';
+            return false;
+        }
+        i++;
+    }
+
+    return (scriptFilename.empty() != urlsFilename.empty()) &&
+        width > 0 && height > 0 && frameRate > 0.0 &&
+        pngCompression >= 0 && pngCompression <= 9 &&
+        (reportFilename.empty() || benchmarkFrames > 0);
+}
+
+
+// Create a pbuffer of the frame size with an OpenGL context current. The
+// default display is used if there is one; otherwise Mesa's surfaceless
+// platform, which renders without any window system.
+static bool CreateOffscreenContext(int w, int h)
+{
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+    {
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay == NULL)
+            return false;
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+            return false;
+#else
+        return false;
+#endif
+    }
+
+    const EGLint configAttribs[] =
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0)
+        return false;
+
+    const EGLint surfaceAttribs[] =
+    {
+        EGL_WIDTH, w,
+        EGL_HEIGHT, h,
+        EGL_NONE
+    };
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+    if (surface == EGL_NO_SURFACE)
+        return false;
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+        return false;
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+    if (context == EGL_NO_CONTEXT)
+        return false;
+
+    return eglMakeCurrent(display, surface, surface, context) == EGL_TRUE;
+}
+
+
+static bool WriteFrame(unsigned int frame)
+{
+    char filename[32];
+    sprintf(filename, "%05u", frame);
+    string path = outputPrefix + filename + (jpegOutput ? ".jpg" : ".png");
+
+    if (jpegOutput)
+        return CaptureGLBufferToJPEG(path, 0, 0, width, height);
+    else
+        return CaptureGLBufferToPNG(path, 0, 0, width, height, pngCompression);
+}
+
+
+// Number of resources used by the last frame drawn that are still being
+// loaded in the background
+static unsigned int PendingResourceCount()
+{
+    unsigned int count = 0;
+    const vector<ResourceManagerBase*>& managers = GetResourceManagers();
+    for (unsigned int i = 0; i < managers.size(); i++)
+        count += managers[i]->getUsage().pendingUsedCount;
+
+    return count;
+}
+
+
+// Objects whose textures are loading in the background are drawn without
+// them; draw the frame again, without advancing time, until they've all
+// been loaded. Returns the number of times the frame was redrawn.
+static unsigned int WaitForLoads(CelestiaCore* appCore, const Timer* timer)
+{
+    double startTime = timer->getTime();
+    unsigned int redraws = 0;
+    while (PendingResourceCount() > 0 && timer->getTime() - startTime < MaxLoadWait)
+    {
+        usleep(5000);
+        appCore->draw();
+        redraws++;
+    }
+
+    return redraws;
+}
+
+
+static bool WriteProfileTrace(const string& filename)
+{
+    ofstream out(filename.c_str(), ios::out);
+    if (!out.good() || !GetProfiler()->writeChromeTrace(out))
+    {
+        cerr << "Error writing profile trace to " << filename << '\n';
+        return false;
+    }
+
+    return true;
+}
+
+
+static bool ReadURLs(const string& filename, vector<string>& urls)
+{
+    ifstream in(filename.c_str(), ios::in);
+    if (!in.good())
+        return false;
+
+    string line;
+    while (getline(in, line))
+    {
+        string::size_type start = line.find_first_not_of(" \t\r");
+        if (start == string::npos || line[start] == '#')
+            continue;
+        string::size_type end = line.find_last_not_of(" \t\r");
+        urls.push_back(line.substr(start, end - start + 1));
+    }
+
+    return !in.bad();
+}
+
+
+// The stages timed by the benchmark. The frame time is the time to tick
+// the simulation, draw the frame and wait for OpenGL to finish it; the
+// other stages are the CPU time spent in the renderer.
+enum BenchmarkStage
+{
+    StageFrame,
+    StageTick,
+    StageRender,
+    StageRenderLists,
+    StageStarCulling,
+    StageStars,
+    StageDeepSkyObjects,
+    StageOrbits,
+    StageLabels,
+    StageCount
+};
+
+static const char* StageNames[StageCount] =
+{
+    "frame",
+    "tick",
+    "render",
+    "renderLists",
+    "starCulling",
+    "stars",
+    "deepSkyObjects",
+    "orbits",
+    "labels",
+};
+
+
+struct BenchmarkScene
+{
+    string name;
+    // Times of each stage for every frame, in seconds
+    vector<double> times[StageCount];
+};
+
+
+struct Statistics
+{
+    double min;
+    double median;
+    double p99;
+    double mean;
+};
+
+
+// Percentiles are nearest rank: the smallest sample that's greater than or
+// equal to the given fraction of the samples.
+static Statistics ComputeStatistics(vector<double> samples)
+{
+    Statistics stats = { 0.0, 0.0, 0.0, 0.0 };
+    if (samples.empty())
+        return stats;
+
+    sort(samples.begin(), samples.end());
+    unsigned int n = samples.size();
+    stats.min = samples[0];
+    stats.median = samples[(n + 1) / 2 - 1];
+    stats.p99 = samples[(n * 99 + 99) / 100 - 1];
+    for (unsigned int i = 0; i < n; i++)
+        stats.mean += samples[i];
+    stats.mean /= n;
+
+    return stats;
+}
+
+
+// Tick, draw and time a frame; the frame is redrawn afterwards, untimed, if
+// it was missing resources still being loaded.
+static void TimeFrame(CelestiaCore* appCore, const Timer* timer, double dt,
+                      BenchmarkScene& scene)
+{
+    double t0 = timer->getTime();
+    appCore->tick(dt);
+    double t1 = timer->getTime();
+    appCore->draw();
+    glFinish();
+    double t2 = timer->getTime();
+
+    const Renderer::FrameTimings& timings = appCore->getRenderer()->getFrameTimings();
+    scene.times[StageFrame].push_back(t2 - t0);
+    scene.times[StageTick].push_back(t1 - t0);
+    scene.times[StageRender].push_back(timings.total);
+    scene.times[StageRenderLists].push_back(timings.renderLists);
+    scene.times[StageStarCulling].push_back(timings.starCulling);
+    scene.times[StageStars].push_back(timings.stars);
+    scene.times[StageDeepSkyObjects].push_back(timings.deepSkyObjects);
+    scene.times[StageOrbits].push_back(timings.orbits);
+    scene.times[StageLabels].push_back(timings.labels);
+
+    WaitForLoads(appCore, timer);
+}
+
+
+static string JSONString(const string& s)
+{
+    string quoted = "\"";
+    for (unsigned int i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '"' || s[i] == '\\')
+            quoted += '\\';
+        quoted += s[i];
+    }
+
+    return quoted + "\"";
+}
+
+
+static void PrintStatistics(FILE* out, const char* name, const Statistics& stats)
+{
+    fprintf(out, "\"%s\": { \"min\": %.4f, \"median\": %.4f, \"p99\": %.4f, \"mean\": %.4f }",
+            name, stats.min * 1000.0, stats.median * 1000.0, stats.p99 * 1000.0, stats.mean * 1000.0);
+}
+
+
+static bool WriteReport(const string& filename, const vector<BenchmarkScene>& scenes)
+{
+    FILE* out = fopen(filename.c_str(), "w");
+    if (out == NULL)
+        return false;
+
+    const char* glRenderer = (const char*) glGetString(GL_RENDERER);
+    fprintf(out, "{\n");
+    fprintf(out, "  \"version\": %s,\n", JSONString(VERSION).c_str());
+    fprintf(out, "  \"glRenderer\": %s,\n", JSONString(glRenderer != NULL ? glRenderer : "").c_str());
+    fprintf(out, "  \"width\": %d,\n", width);
+    fprintf(out, "  \"height\": %d,\n", height);
+    fprintf(out, "  \"frameRate\": %g,\n", frameRate);
+    fprintf(out, "  \"startTime\": %.6f,\n", simulationStartTime);
+    fprintf(out, "  \"units\": \"ms\",\n");
+    fprintf(out, "  \"scenes\": [\n");
+    for (unsigned int i = 0; i < scenes.size(); i++)
+    {
+        const BenchmarkScene& scene = scenes[i];
+        fprintf(out, "    {\n");
+        fprintf(out, "      \"name\": %s,\n", JSONString(scene.name).c_str());
+        fprintf(out, "      \"frames\": %u,\n", (unsigned int) scene.times[StageFrame].size());
+        fprintf(out, "      \"stages\": {\n");
+        for (unsigned int stage = 0; stage < StageCount; stage++)
+        {
+            fprintf(out, "        ");
+            PrintStatistics(out, StageNames[stage], ComputeStatistics(scene.times[stage]));
+            fprintf(out, stage + 1 < StageCount ? ",\n" : "\n");
+        }
+        fprintf(out, "      }\n");
+        fprintf(out, i + 1 < scenes.size() ? "    },\n" : "    }\n");
+    }
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+
+    bool good = !ferror(out);
+    return fclose(out) == 0 && good;
+}
+
+
+// Time benchmarkFrames frames of each URL, or of the running script. Each
+// URL is drawn until its resources are loaded, then for a few more frames,
+// before it's timed; the script is timed from its start.
+static bool RunBenchmark(CelestiaCore* appCore, const vector<string>& urls)
+{
+    Timer* timer = CreateTimer();
+    double dt = 1.0 / frameRate;
+    vector<BenchmarkScene> scenes;
+
+    if (urls.empty())
+    {
+        scenes.push_back(BenchmarkScene());
+        scenes.back().name = scriptFilename;
+        for (unsigned int i = 0; i < benchmarkFrames && appCore->isScriptRunning(); i++)
+            TimeFrame(appCore, timer, dt, scenes.back());
+    }
+    else
+    {
+        for (unsigned int i = 0; i < urls.size(); i++)
+        {
+            appCore->goToUrl(urls[i]);
+            appCore->tick(0.0);
+            for (unsigned int j = 0; j <= BenchmarkWarmupFrames; j++)
+            {
+                if (j > 0)
+                    appCore->tick(dt);
+                appCore->draw();
+                WaitForLoads(appCore, timer);
+            }
+
+            scenes.push_back(BenchmarkScene());
+            scenes.back().name = urls[i];
+            for (unsigned int j = 0; j < benchmarkFrames; j++)
+                TimeFrame(appCore, timer, dt, scenes.back());
+        }
+    }
+
+    delete timer;
+
+    for (unsigned int i = 0; i < scenes.size(); i++)
+    {
+        const BenchmarkScene& scene = scenes[i];
+        Statistics frame = ComputeStatistics(scene.times[StageFrame]);
+        printf("scene %u: %u frames; frame min %.2f ms, median %.2f ms, p99 %.2f ms\n",
+               i, (unsigned int) scene.times[StageFrame].size(),
+               frame.min * 1000.0, frame.median * 1000.0, frame.p99 * 1000.0);
+        for (unsigned int stage = StageTick; stage < StageCount; stage++)
+        {
+            printf("    %-16s median %.2f ms\n", StageNames[stage],
+                   ComputeStatistics(scene.times[stage]).median * 1000.0);
+        }
+    }
+
+    if (!reportFilename.empty() && !WriteReport(reportFilename, scenes))
+    {
+        cerr << "Error writing benchmark report to " << reportFilename << '\n';
+        return false;
+    }
+
+    return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+    setlocale(LC_ALL, "");
+    setlocale(LC_NUMERIC, "C");
+    bindtextdomain(PACKAGE, LOCALEDIR);
+    bind_textdomain_codeset(PACKAGE, "UTF-8");
+    textdomain(PACKAGE);
+
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    // Relative paths given on the command line are relative to the
+    // directory celestia-headless was started in, not the data directory.
+    char cwd[4096];
+    string startDir;
+    if (getcwd(cwd, sizeof(cwd)) != NULL)
+        startDir = string(cwd) + '/';
+    if (!scriptFilename.empty() && scriptFilename[0] != '/')
+        scriptFilename = startDir + scriptFilename;
+    if (!urlsFilename.empty() && urlsFilename[0] != '/')
+        urlsFilename = startDir + urlsFilename;
+    if (outputPrefix[0] != '/')
+        outputPrefix = startDir + outputPrefix;
+    if (!reportFilename.empty() && reportFilename[0] != '/')
+        reportFilename = startDir + reportFilename;
+    if (!traceFilename.empty() && traceFilename[0] != '/')
+        traceFilename = startDir + traceFilename;
+
+    vector<string> urls;
+    if (!urlsFilename.empty() && (!ReadURLs(urlsFilename, urls) || urls.empty()))
+    {
+        cerr << "Error reading URLs from " << urlsFilename << '\n';
+        return 1;
+    }
+
+    string dir = dataDir.empty() ? string(CONFIG_DATA_DIR) : dataDir;
+    if (chdir(dir.c_str()) == -1)
+    {
+        cerr << "Cannot chdir to '" << dir << "'\n";
+        return 1;
+    }
+
+    if (!CreateOffscreenContext(width, height))
+    {
+        cerr << "Unable to create an offscreen OpenGL context.\n";
+        return 1;
+    }
+
+    GLenum glewErr = glewInit();
+    if (glewErr != GLEW_OK)
+    {
+        cerr << "Celestia was unable to initialize OpenGL extensions: "
+             << glewGetErrorString(glewErr) << '\n';
+    }
+
+    CelestiaCore* appCore = new CelestiaCore();
+    HeadlessAlerter alerter;
+    appCore->setAlerter(&alerter);
+
+    if (!appCore->initSimulation(configFilename.empty() ? NULL : &configFilename,
+                                 extrasDirs.empty() ? NULL : &extrasDirs))
+    {
+        return 1;
+    }
+
+    if (!appCore->initRenderer())
+    {
+        cerr << "Failed to initialize renderer.\n";
+        return 1;
+    }
+
+    appCore->resize(width, height);
+    if (!showHud)
+        appCore->setHudDetail(0);
+
+    // Benchmarks must draw the same sky every time they're run, so they
+    // start at a fixed time unless the script or URLs set one.
+    time_t curtime = time(NULL);
+    if (!startTimeGiven)
+    {
+        if (benchmarkFrames > 0)
+            simulationStartTime = astro::J2000;
+        else
+            simulationStartTime = (double) curtime / 86400.0 + (double) astro::Date(1970, 1, 1);
+    }
+    appCore->start(simulationStartTime);
+    localtime(&curtime); // Only doing this to set timezone as a side effect
+    appCore->setTimeZoneBias(-timezone);
+    appCore->setTimeZoneName(tzname[daylight?0:1]);
+
+    if (!scriptFilename.empty())
+    {
+        appCore->runScript(scriptFilename);
+        if (alerter.failed || !appCore->isScriptRunning())
+            return 1;
+    }
+
+    if (benchmarkFrames > 0)
+    {
+        bool succeeded = RunBenchmark(appCore, urls);
+        if (!traceFilename.empty() && !WriteProfileTrace(traceFilename))
+            succeeded = false;
+        return succeeded && !alerter.failed ? 0 : 1;
+    }
+
+    Timer* timer = CreateTimer();
+    double startTime = timer->getTime();
+    double tickTotal = 0.0;
+    double drawTotal = 0.0;
+    double writeTotal = 0.0;
+    unsigned int frame = 0;
+
+    for (;;)
+    {
+        if (maxFrames != 0 && frame == maxFrames)
+            break;
+
+        double t0 = timer->getTime();
+        if (urls.empty())
+        {
+            appCore->tick(1.0 / frameRate);
+        }
+        else
+        {
+            if (frame == urls.size())
+                break;
+            appCore->goToUrl(urls[frame]);
+            appCore->tick(0.0);
+        }
+
+        double t1 = timer->getTime();
+        appCore->draw();
+        unsigned int redraws = WaitForLoads(appCore, timer);
+        glFinish();
+
+        double t2 = timer->getTime();
+        if (!WriteFrame(frame))
+        {
+            cerr << "Error writing frame " << frame << '\n';
+            return 1;
+        }
+        double t3 = timer->getTime();
+
+        tickTotal += t1 - t0;
+        drawTotal += t2 - t1;
+        writeTotal += t3 - t2;
+        if (printTiming)
+        {
+            printf("frame %u: tick %.2f ms, render %.2f ms, write %.2f ms",
+                   frame, (t1 - t0) * 1000.0, (t2 - t1) * 1000.0, (t3 - t2) * 1000.0);
+            if (redraws != 0)
+                printf(" (drawn %u times while loading)", redraws + 1);
+            printf("\n");
+        }
+        frame++;
+
+        // The frame at the end of the script is written too.
+        if (urls.empty() && !appCore->isScriptRunning())
+            break;
+    }
+
+    double elapsed = timer->getTime() - startTime;
+    delete timer;
+
+    if (frame > 0)
+    {
+        printf("%u frames in %.2f s, %.2f frames/s; per frame: tick %.2f ms, render %.2f ms, write %.2f ms\n",
+               frame, elapsed, frame / elapsed,
+               tickTotal * 1000.0 / frame, drawTotal * 1000.0 / frame, writeTotal * 1000.0 / frame);
+    }
+
+    if (!traceFilename.empty() && !WriteProfileTrace(traceFilename))
+        return 1;
+
+    return alerter.failed ? 1 : 0;
+}
@@ -121,7 +121,8 @@ void PNGWriteData(png_structp png_ptr, png_bytep data, png_size_t length)
                            
 bool CaptureGLBufferToPNG(const string& filename,
                            int x, int y,
-                           int width, int height)
+                           int width, int height,
+                           int compressionLevel)
 {
     int rowStride = (width * 3 + 3) & ~0x3;
     int imageSize = height * rowStride;
@@ -186,7 +187,7 @@ bool CaptureGLBufferToPNG(const string& filename,
     // png_init_io(png_ptr, out);
     png_set_write_fn(png_ptr, (void*) out, PNGWriteData, NULL);
 
-    png_set_compression_level(png_ptr, Z_BEST_COMPRESSION);
+    png_set_compression_level(png_ptr, compressionLevel);
     png_set_IHDR(png_ptr, info_ptr,
                  width, height,
                  8,
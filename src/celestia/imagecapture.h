@@ -16,8 +16,11 @@
 extern bool CaptureGLBufferToJPEG(const std::string& filename,
                                   int x, int y,
                                   int width, int height);
+// The compression level is a zlib level from 0 (none) to 9 (best, but
+// slowest).
 extern bool CaptureGLBufferToPNG(const std::string& filename,
                                  int x, int y,
-                                 int width, int height);
+                                 int width, int height,
+                                 int compressionLevel = 9);
 
 #endif // _IMAGECAPTURE_H_
@@ -22,6 +22,10 @@ class MovieCapture
     virtual bool start(const std::string& filename,
                        int width, int height,
                        float fps) = 0;
+    // Write the frames still pending and finish the movie. Captures may read
+    // frames back from the GL, so end() must be called with the GL context
+    // current. A capture destroyed without end() makes no GL calls; it
+    // finishes the movie without the frames still being read back.
     virtual bool end() = 0;
     virtual bool captureFrame() = 0;
 
@@ -30,6 +34,12 @@ class MovieCapture
     virtual int getHeight() const = 0;
     virtual float getFrameRate() const = 0;
 
+    // Frames captured but not yet written, and frames lost because they
+    // couldn't be read back; zero for captures that write each frame
+    // before captureFrame() returns.
+    virtual int getQueuedFrameCount() const { return 0; }
+    virtual int getDroppedFrameCount() const { return 0; }
+
     virtual void setAspectRatio(int aspectNumerator, int aspectDenominator) = 0;
     virtual void setQuality(float) = 0;
     virtual void recordingStatus(bool started) = 0; /* to update UI recording status indicator */
@@ -64,14 +64,19 @@
 #include <cmath>
 #include <celutil/debug.h>
 #include <celutil/util.h>
+#include <celutil/atomic.h>
 #include <GL/glew.h>
 #include <string>
 #include <cstring>
 #include "theora/theora.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
 #include "oggtheoracapture.h"
+#include "framereadback.h"
 
 //  {"video-rate-target",required_argument,NULL,'V'},
 //  {"video-quality",required_argument,NULL,'v'},
@@ -81,6 +86,116 @@ using namespace std;
 //  {"framerate-denominator",optional_argument,NULL,'F'},
 
 
+// Convert a row of RGBA pixels to Y, U and V with the integer formulas
+// above. The sums are never negative, so the abs() of the formulas is
+// left out.
+static void convertRow(const unsigned char* rgba, int n,
+                       unsigned char* yptr, unsigned char* uptr, unsigned char* vptr)
+{
+    int x = 0;
+
+#ifdef __SSE2__
+    // Eight pixels at a time: the 16-bit RGBA components of two pixels
+    // are multiplied and summed in pairs by madd, giving r*cr + g*cg and
+    // b*cb for each pixel, and the pairs are then added.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ycoeff = _mm_setr_epi16(2104, 4130, 802, 0, 2104, 4130, 802, 0);
+    const __m128i ucoeff = _mm_setr_epi16(-1214, -2384, 3598, 0, -1214, -2384, 3598, 0);
+    const __m128i vcoeff = _mm_setr_epi16(3598, -3013, -585, 0, 3598, -3013, -585, 0);
+    const __m128i ybias = _mm_set1_epi32(4096 + 131072);
+    const __m128i uvbias = _mm_set1_epi32(4096 + 1048576);
+    const __m128i ymax = _mm_set1_epi16(235);
+    const __m128i uvmax = _mm_set1_epi16(240);
+
+    for (; x + 8 <= n; x += 8, rgba += 32)
+    {
+        __m128i ysum[2], usum[2], vsum[2];
+        for (int i = 0; i < 2; i++)
+        {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 16));
+            __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+            __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+
+            __m128 a = _mm_castsi128_ps(_mm_madd_epi16(lo, ycoeff));
+            __m128 b = _mm_castsi128_ps(_mm_madd_epi16(hi, ycoeff));
+            ysum[i] = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))),
+                                    _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+            a = _mm_castsi128_ps(_mm_madd_epi16(lo, ucoeff));
+            b = _mm_castsi128_ps(_mm_madd_epi16(hi, ucoeff));
+            usum[i] = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))),
+                                    _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+            a = _mm_castsi128_ps(_mm_madd_epi16(lo, vcoeff));
+            b = _mm_castsi128_ps(_mm_madd_epi16(hi, vcoeff));
+            vsum[i] = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))),
+                                    _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+        }
+
+        __m128i y = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(ysum[0], ybias), 13),
+                                    _mm_srai_epi32(_mm_add_epi32(ysum[1], ybias), 13));
+        __m128i u = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(usum[0], uvbias), 13),
+                                    _mm_srai_epi32(_mm_add_epi32(usum[1], uvbias), 13));
+        __m128i v = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(vsum[0], uvbias), 13),
+                                    _mm_srai_epi32(_mm_add_epi32(vsum[1], uvbias), 13));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(yptr + x), _mm_packus_epi16(_mm_min_epi16(y, ymax), zero));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(uptr + x), _mm_packus_epi16(_mm_min_epi16(u, uvmax), zero));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(vptr + x), _mm_packus_epi16(_mm_min_epi16(v, uvmax), zero));
+    }
+#endif
+
+    for (; x < n; x++, rgba += 4)
+    {
+        int r = rgba[0];
+        int g = rgba[1];
+        int b = rgba[2];
+        yptr[x] = (unsigned char) min((r * 2104 + g * 4130 + b * 802 + 4096 + 131072) >> 13, 235);
+        uptr[x] = (unsigned char) min((r * -1214 + g * -2384 + b * 3598 + 4096 + 1048576) >> 13, 240);
+        vptr[x] = (unsigned char) min((r * 3598 + g * -3013 + b * -585 + 4096 + 1048576) >> 13, 240);
+    }
+}
+
+
+// Average 2x2 blocks of two rows of n (even) chroma samples.
+static void subsampleRows(const unsigned char* row0, const unsigned char* row1, int n,
+                          unsigned char* out)
+{
+    int x = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    for (; x + 16 <= n; x += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x));
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        __m128i sum = _mm_packs_epi32(_mm_madd_epi16(lo, ones), _mm_madd_epi16(hi, ones));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x / 2),
+                         _mm_packus_epi16(_mm_srli_epi16(sum, 2), zero));
+    }
+#endif
+
+    for (; x < n; x += 2)
+        out[x / 2] = (unsigned char) ((row0[x] + row0[x + 1] + row1[x] + row1[x + 1]) >> 2);
+}
+
+
+class OggTheoraCapture::Encoder : public ThreadTask
+{
+public:
+    Encoder(OggTheoraCapture& _capture) : capture(_capture) {};
+
+    void run()
+    {
+        capture.encoderLoop();
+    }
+
+private:
+    OggTheoraCapture& capture;
+};
+
+
+
 OggTheoraCapture::OggTheoraCapture():
     video_x(0),
     video_y(0),
@@ -96,9 +211,18 @@ OggTheoraCapture::OggTheoraCapture():
     video_q(63), // 0-63 aka 0-10 * 6.3 the higher the value the faster the encoding and the larger the output file
     capturing(false),
     video_frame_count(0),
+    video_dropped_count(0),
     video_bytesout(0),
     rowStride(0),
-    pixels(NULL),
+    readback(NULL),
+    frameQueued(queueMutex),
+    frameFreed(queueMutex),
+    queuedFrames(0),
+    encoderStopping(false),
+    encoder(NULL),
+    encoderThread(NULL),
+    encodedFrameCount(0),
+    chromaRows(NULL),
     outfile(NULL)
 {
     yuvframe[0] = NULL;
@@ -278,33 +402,52 @@ bool OggTheoraCapture::start(const std::string& filename,
         fwrite(videopage.header,1,videopage.header_len,outfile);
         fwrite(videopage.body,1,  videopage.body_len,outfile);
     }
-    /* Initialize the double frame buffer.
-     * We allocate enough for a 4:4:4 color sampling
-     */
-    yuvframe[0]= new unsigned char[video_x*video_y*3];
-    yuvframe[1]= new unsigned char[video_x*video_y*3];
-
-    // Now the buffer for reading the GL RGB pixels
-    rowStride = (frame_x * 3 + 3) & ~0x3;
-    pixels = new unsigned char[rowStride*frame_y];
-
-        /* clear initial frame as it may be larger than actual video data */
-        /* fill Y plane with 0x10 and UV planes with 0x80, for black data */
-    // The UV plane must be 4:2:0
-    memset(yuvframe[0],0x10,video_x*video_y);
-    memset(yuvframe[0]+video_x*video_y,0x80,video_x*video_y*2);
-    memset(yuvframe[1],0x10,video_x*video_y);
-    memset(yuvframe[1]+video_x*video_y,0x80,video_x*video_y*2);
+    /* Initialize the double frame buffer with 4:2:0 color sampling */
+    int y_size = video_x*video_y;
+    int uv_size = (video_x/2)*(video_y/2);
+    yuvframe[0]= new unsigned char[y_size+uv_size*2];
+    yuvframe[1]= new unsigned char[y_size+uv_size*2];
+
+    /* clear initial frame as it may be larger than actual video data */
+    /* fill Y plane with 0x10 and UV planes with 0x80, for black data */
+    memset(yuvframe[0],0x10,y_size);
+    memset(yuvframe[0]+y_size,0x80,uv_size*2);
+    memset(yuvframe[1],0x10,y_size);
+    memset(yuvframe[1]+y_size,0x80,uv_size*2);
+
+    // Two rows each of full resolution U and V, subsampled into the UV
+    // planes; the samples outside the frame stay black.
+    chromaRows = new unsigned char[video_x*4];
+    memset(chromaRows,0x80,video_x*4);
 
     yuv.y_width=video_x;
     yuv.y_height=video_y;
     yuv.y_stride=video_x;
 
-    // Note we lie here by saying it's 4:2:0 and we will convert 4:4:4 to 4:2;0 later
     yuv.uv_width=video_x/2;
     yuv.uv_height=video_y/2;
     yuv.uv_stride=video_x/2;
 
+    // RGBA is read back rather than RGB: it's the faster path for most
+    // drivers, and keeps the pixels aligned for the color conversion.
+    readback = new FrameReadback(frame_x, frame_y, GL_RGBA, ReadbackBufferCount);
+    rowStride = readback->getRowBytes();
+    for (int i = 0; i < MaxQueuedFrames; i++)
+        freeFrames.push_back(new unsigned char[rowStride*frame_y]);
+    encodedFrameCount = 0;
+    encoderStopping = false;
+
+    encoder = new Encoder(*this);
+    encoderThread = new Thread(encoder);
+    if (!encoderThread->start())
+    {
+        // Encode frames on the render thread instead
+        delete encoderThread;
+        delete encoder;
+        encoderThread = NULL;
+        encoder = NULL;
+    }
+
     printf(_("OggTheoraCapture::start() - Theora video: %s %.2f(%d/%d) fps quality %d %dx%d offset (%dx%d)\n"),
            filename.c_str(),
            (double)video_hzn/(double)video_hzd,
@@ -322,14 +465,10 @@ bool OggTheoraCapture::captureFrame()
     if (!capturing)
         return false;
 
-    while (ogg_stream_pageout(&to,&videopage)>0)
-    {
-        /* flush a video page */
-        video_bytesout+=fwrite(videopage.header,1,videopage.header_len,outfile);
-        video_bytesout+=fwrite(videopage.body,1,videopage.body_len,outfile);
-
-    }
-    if(ogg_stream_eos(&to)) return false;
+    // The oldest frame in the readback ring is passed on to the encoder
+    // to make room for this one.
+    if (readback->isFull())
+        queueReadbackFrame();
 
     // Get the dimensions of the current viewport
     int viewport[4];
@@ -337,82 +476,164 @@ bool OggTheoraCapture::captureFrame()
 
     int x = viewport[0] + (viewport[2] - frame_x) / 2;
     int y = viewport[1] + (viewport[3] - frame_y) / 2;
-    glReadPixels(x, y, frame_x, frame_y,
-             GL_RGB, GL_UNSIGNED_BYTE,
-             pixels);
+    readback->read(x, y);
 
-    unsigned char *ybase = yuvframe[0];
-    unsigned char *ubase = yuvframe[0]+ video_x*video_y;
-    unsigned char *vbase = yuvframe[0]+ video_x*video_y*2;
-    // We go ahead and build 4:4:4 frames
-    for (int y=0; y<frame_y; y++)
+    video_frame_count += 1;
+    //if ((video_frame_count % 10) == 0)
+    //    printf("Writing frame %d\n", video_frame_count);
+    frameCaptured();
+
+    return true;
+}
+
+/* Fetch the oldest frame from the readback and queue it for encoding,
+ * waiting for a free frame buffer if the queue is full.
+ */
+void OggTheoraCapture::queueReadbackFrame()
+{
+    unsigned char* frame;
+    {
+        MutexLock lock(queueMutex);
+        while (freeFrames.empty())
+            frameFreed.wait();
+        frame = freeFrames.back();
+        freeFrames.pop_back();
+    }
+
+    bool fetched = readback->fetch(frame);
+    if (!fetched)
+        video_dropped_count++;
+
+    if (fetched && encoderThread == NULL)
     {
-        unsigned char *yptr = ybase + (video_x*(y+frame_y_offset))+frame_x_offset;
-        unsigned char *uptr = ubase + (video_x*(y+frame_y_offset))+frame_x_offset;
-        unsigned char *vptr = vbase + (video_x*(y+frame_y_offset))+frame_x_offset;
-        unsigned char *rgb = pixels + ((frame_y-1-y)*rowStride); // The video is inverted
-        for (int x=0; x<frame_x; x++)
+        convertFrame(frame);
+        encodeFrame(false);
+        writePages();
+    }
+
+    MutexLock lock(queueMutex);
+    if (fetched && encoderThread != NULL)
+    {
+        fullFrames.push_back(frame);
+        AtomicAdd(queuedFrames, 1);
+        frameQueued.signal();
+    }
+    else
+    {
+        freeFrames.push_back(frame);
+    }
+}
+
+void OggTheoraCapture::encoderLoop()
+{
+    for (;;)
+    {
+        unsigned char* frame;
         {
-            unsigned char r = *rgb++;
-            unsigned char g = *rgb++;
-            unsigned char b = *rgb++;
-            *yptr++ = min(abs(r * 2104 + g * 4130 + b * 802 + 4096 + 131072) >> 13,235);
-            *uptr++ = min(abs(r * -1214 + g * -2384 + b * 3598 + 4096 + 1048576) >> 13,240);
-            *vptr++ = min(abs(r * 3598 + g * -3013 + b * -585 + 4096 + 1048576) >> 13,240);
+            MutexLock lock(queueMutex);
+            while (fullFrames.empty() && !encoderStopping)
+                frameQueued.wait();
+            if (fullFrames.empty())
+                break;
+            frame = fullFrames.front();
+            fullFrames.pop_front();
         }
+
+        // The frame buffer is returned as soon as it has been converted,
+        // before the slower encoding.
+        convertFrame(frame);
+        {
+            MutexLock lock(queueMutex);
+            freeFrames.push_back(frame);
+            frameFreed.signal();
+        }
+
+        encodeFrame(false);
+        writePages();
+        AtomicAdd(queuedFrames, -1);
     }
+}
+
+/* Convert RGBA pixels read back from the frame buffer to 4:2:0 YUV in
+ * yuvframe[0], two rows at a time.
+ */
+void OggTheoraCapture::convertFrame(const unsigned char* rgba)
+{
+    int uv_stride = video_x/2;
+    unsigned char *ybase = yuvframe[0];
+    unsigned char *ubase = yuvframe[0] + video_x*video_y;
+    unsigned char *vbase = ubase + uv_stride*(video_y/2);
 
-    /*
-     * The video strategy is to capture one frame ahead so when we're at end of
-     * stream we can mark last video frame as such.  Have two YUV frames before
-     * encoding. Theora is a one-frame-in,one-frame-out system; submit a frame
-     * for compression and pull out the packet
-     */
+    // Chroma is subsampled over an even number of columns, which may
+    // include one of the black samples to the right of the frame.
+    int uv_width = (frame_x + 1) & ~1;
 
-    if (video_frame_count > 0)
+    for (int y = 0; y < frame_y; y += 2)
     {
-        yuv.y= yuvframe[1];
-        yuv.u= yuvframe[1]+ video_x*video_y;
-        yuv.v= yuvframe[1]+ video_x*video_y*2;
-        // Convert to 4:2:0
-        unsigned char * uin0 = yuv.u;
-        unsigned char * uin1 = yuv.u + video_x;
-        unsigned char * uout = yuv.u;
-        unsigned char * vin0 = yuv.v;
-        unsigned char * vin1 = yuv.v + video_x;
-        unsigned char * vout = yuv.v; 
-        for (int y = 0; y < video_y; y += 2)
+        for (int row = 0; row < 2; row++)
         {
-            for (int x = 0; x < video_x; x += 2)
+            unsigned char *uptr = chromaRows + video_x*row + frame_x_offset;
+            unsigned char *vptr = chromaRows + video_x*(row+2) + frame_x_offset;
+            if (y + row < frame_y)
+            {
+                unsigned char *yptr = ybase + (video_x*(y+row+frame_y_offset))+frame_x_offset;
+                const unsigned char *rgb = rgba + ((frame_y-1-(y+row))*rowStride); // The video is inverted
+                convertRow(rgb, frame_x, yptr, uptr, vptr);
+            }
+            else
             {
-                *uout = (uin0[0] + uin0[1] + uin1[0] + uin1[1]) >> 2;
-                uin0 += 2;
-                uin1 += 2;
-                uout++;
-                *vout = (vin0[0] + vin0[1] + vin1[0] + vin1[1]) >> 2;
-                vin0 += 2;
-                vin1 += 2;
-                vout++;
+                memset(uptr, 0x80, frame_x);
+                memset(vptr, 0x80, frame_x);
             }
-            uin0 += video_x;
-            uin1 += video_x;
-            vin0 += video_x;
-            vin1 += video_x;
         }
+
+        int uv_offset = uv_stride*((y+frame_y_offset)/2) + frame_x_offset/2;
+        subsampleRows(chromaRows + frame_x_offset, chromaRows + video_x + frame_x_offset,
+                      uv_width, ubase + uv_offset);
+        subsampleRows(chromaRows + video_x*2 + frame_x_offset, chromaRows + video_x*3 + frame_x_offset,
+                      uv_width, vbase + uv_offset);
+    }
+}
+
+/*
+ * The video strategy is to encode one frame behind so when we're at end of
+ * stream we can mark last video frame as such.  Have two YUV frames before
+ * encoding: convertFrame() fills yuvframe[0], and encodeFrame() encodes the
+ * previous frame in yuvframe[1], if there is one, then swaps them. Theora
+ * is a one-frame-in,one-frame-out system; submit a frame for compression
+ * and pull out the packet
+ */
+void OggTheoraCapture::encodeFrame(bool last)
+{
+    if (encodedFrameCount > 0)
+    {
+        yuv.y= yuvframe[1];
+        yuv.u= yuvframe[1]+ video_x*video_y;
+        yuv.v= yuv.u + (video_x/2)*(video_y/2);
         theora_encode_YUVin(&td,&yuv);
-        theora_encode_packetout(&td,0,&op);
+        theora_encode_packetout(&td,last ? 1 : 0,&op);
         ogg_stream_packetin(&to,&op);
     }
-    video_frame_count += 1;
-    //if ((video_frame_count % 10) == 0)
-    //    printf("Writing frame %d\n", video_frame_count);
-    unsigned char *temp = yuvframe[0];
-    yuvframe[0] = yuvframe[1];
-    yuvframe[1] = temp;
-    frameCaptured();
 
-    return true;
+    if (!last)
+    {
+        encodedFrameCount += 1;
+        unsigned char *temp = yuvframe[0];
+        yuvframe[0] = yuvframe[1];
+        yuvframe[1] = temp;
+    }
 }
+
+void OggTheoraCapture::writePages()
+{
+    while (ogg_stream_pageout(&to,&videopage)>0)
+    {
+        /* flush a video page */
+        AtomicAdd(video_bytesout, fwrite(videopage.header,1,videopage.header_len,outfile));
+        AtomicAdd(video_bytesout, fwrite(videopage.body,1,videopage.body_len,outfile));
+    }
+}
+
 void OggTheoraCapture::cleanup()
 {
     capturing = false;
@@ -420,53 +641,38 @@ void OggTheoraCapture::cleanup()
 
     if(outfile)
     {
-        printf(_("OggTheoraCapture::cleanup() - wrote %d frames\n"), video_frame_count);
-        if (video_frame_count > 0)
+        // Frames still in the readback ring are lost unless end() queued
+        // them; the encoder finishes the queue before it stops.
+        if (readback != NULL)
+        {
+            video_dropped_count += readback->getPendingCount();
+            delete readback;
+            readback = NULL;
+        }
+
+        if (encoderThread != NULL)
         {
-            yuv.y= yuvframe[1];
-            yuv.u= yuvframe[1]+ video_x*video_y;
-            yuv.v= yuvframe[1]+ video_x*video_y*2 ;
-            // Convert to 4:2:0
-            unsigned char * uin0 = yuv.u;
-            unsigned char * uin1 = yuv.u + video_x;
-            unsigned char * uout = yuv.u;
-            unsigned char * vin0 = yuv.v;
-            unsigned char * vin1 = yuv.v + video_x;
-            unsigned char * vout = yuv.v;
-            for (int y = 0; y < video_y; y += 2)
             {
-                for (int x = 0; x < video_x; x += 2)
-                {
-                    *uout = (uin0[0] + uin0[1] + uin1[0] + uin1[1]) >> 2;
-                    uin0 += 2;
-                    uin1 += 2;
-                    uout++;
-                    *vout = (vin0[0] + vin0[1] + vin1[0] + vin1[1]) >> 2;
-                    vin0 += 2;
-                    vin1 += 2;
-                    vout++;
-                }
-                uin0 += video_x;
-                uin1 += video_x;
-                vin0 += video_x;
-                vin1 += video_x;
+                MutexLock lock(queueMutex);
+                encoderStopping = true;
+                frameQueued.signal();
             }
-            theora_encode_YUVin(&td,&yuv);
-            theora_encode_packetout(&td,1,&op);
-            ogg_stream_packetin(&to,&op);
+            encoderThread->join();
+            delete encoderThread;
+            delete encoder;
+            encoderThread = NULL;
+            encoder = NULL;
         }
-        while(ogg_stream_pageout(&to,&videopage)>0)
-        {
-            /* flush a video page */
-            video_bytesout+=fwrite(videopage.header,1,videopage.header_len,outfile);
-            video_bytesout+=fwrite(videopage.body,1,videopage.body_len,outfile);
 
-        }
+        printf(_("OggTheoraCapture::cleanup() - wrote %d frames, %d dropped\n"),
+               encodedFrameCount, video_dropped_count);
+        encodeFrame(true);
+        writePages();
         if(ogg_stream_flush(&to,&videopage)>0)
         {
             /* flush a video page */
-            video_bytesout+=fwrite(videopage.header,1,videopage.header_len,outfile);
-            video_bytesout+=fwrite(videopage.body,1,videopage.body_len,outfile);
+            AtomicAdd(video_bytesout, fwrite(videopage.header,1,videopage.header_len,outfile));
+            AtomicAdd(video_bytesout, fwrite(videopage.body,1,videopage.body_len,outfile));
 
         }
         theora_clear(&td);
@@ -477,12 +683,24 @@ void OggTheoraCapture::cleanup()
         outfile = NULL;
         delete [] yuvframe[0];
         delete [] yuvframe[1];
-        delete [] pixels;
+        delete [] chromaRows;
+        yuvframe[0] = NULL;
+        yuvframe[1] = NULL;
+        chromaRows = NULL;
+        for (unsigned int i = 0; i < freeFrames.size(); i++)
+            delete [] freeFrames[i];
+        freeFrames.clear();
     }
 }
 
 bool OggTheoraCapture::end()
 {
+    if (readback != NULL)
+    {
+        while (readback->getPendingCount() > 0)
+            queueReadbackFrame();
+        readback->release();
+    }
     cleanup();
     return true;
 }
@@ -498,6 +716,19 @@ int OggTheoraCapture::getFrameCount() const
 {
     return video_frame_count;
 }
+int OggTheoraCapture::getBytesOut() const
+{
+    return AtomicLoad(video_bytesout);
+}
+int OggTheoraCapture::getQueuedFrameCount() const
+{
+    int pending = readback != NULL ? (int) readback->getPendingCount() : 0;
+    return pending + AtomicLoad(queuedFrames);
+}
+int OggTheoraCapture::getDroppedFrameCount() const
+{
+    return video_dropped_count;
+}
 float OggTheoraCapture::getFrameRate() const
 {
     return float(video_hzn)/float(video_hzd);
@@ -2,9 +2,20 @@
 #ifndef _OGGTHEORACAPTURE_H_
 #define _OGGTHEORACAPTURE_H_
 
+#include <deque>
+#include <vector>
+#include <celutil/basictypes.h>
+#include <celutil/thread.h>
 #include "theora/theora.h"
 #include "moviecapture.h"
 
+class FrameReadback;
+
+/*! Frames are read back from the frame buffer asynchronously, and are
+ *  converted to YUV and encoded on a separate thread. The render thread
+ *  only waits when MaxQueuedFrames frames are already waiting to be
+ *  encoded.
+ */
 class OggTheoraCapture : public MovieCapture
 {
 public:
@@ -19,13 +30,29 @@ public:
     int getHeight() const;
     float getFrameRate() const;
     int getFrameCount() const;
-    int getBytesOut() const { return video_bytesout; } ;
+    int getBytesOut() const;
+    int getQueuedFrameCount() const;
+    int getDroppedFrameCount() const;
     void setAspectRatio(int, int);
     void setQuality(float);
     void recordingStatus(bool) {};  // Added to allow GTK compilation
 
+    enum
+    {
+        MaxQueuedFrames = 4,
+        ReadbackBufferCount = 3,
+    };
+
 private:
     void cleanup();
+    void queueReadbackFrame();
+    void encoderLoop();
+    void convertFrame(const unsigned char* rgba);
+    void encodeFrame(bool last);
+    void writePages();
+
+    class Encoder;
+    friend class Encoder;
 
 private:
     int video_x;
@@ -43,14 +70,31 @@ private:
 
     bool        capturing;
     int        video_frame_count;
-    int        video_bytesout;
+    int        video_dropped_count;
+    volatile int32 video_bytesout;
 
     // Consider RGB to YUV Color converstion table - jpeglib has one
     // but according the standards it's incorrect (generates values 0-255,
     // instead of clamped to 16-240).
 
     int        rowStride;
-    unsigned char  *pixels;
+    FrameReadback  *readback;
+
+    // Frames read back wait in fullFrames to be encoded; freeFrames are
+    // the remaining frame buffers. Both are guarded by queueMutex.
+    Mutex           queueMutex;
+    Condition       frameQueued;
+    Condition       frameFreed;
+    std::deque<unsigned char*> fullFrames;
+    std::vector<unsigned char*> freeFrames;
+    volatile int32  queuedFrames;
+    bool            encoderStopping;
+    Encoder        *encoder;
+    Thread         *encoderThread;
+
+    // Used only by the encoder
+    int        encodedFrameCount;
+    unsigned char  *chromaRows;
     unsigned char  *yuvframe[2];
     yuv_buffer    yuv;
     FILE           *outfile;
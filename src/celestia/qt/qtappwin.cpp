@@ -165,7 +165,8 @@ CelestiaAppWindow::~CelestiaAppWindow()
 
 
 void CelestiaAppWindow::init(const QString& qConfigFileName,
-                             const QStringList& qExtrasDirectories)
+                             const QStringList& qExtrasDirectories,
+                             bool rebuildCatalogCache)
 {
 	QString celestia_data_dir = QString::fromLocal8Bit(::getenv("CELESTIA_DATA_DIR"));
 	
@@ -234,6 +235,7 @@ void CelestiaAppWindow::init(const QString& qConfigFileName,
 
 	setWindowIcon(QIcon(":/icons/celestia.png"));
 
+    m_appCore->setRebuildCatalogCache(rebuildCatalogCache);
     m_appCore->initSimulation(&configFileName,
                             &extrasDirectories,
                             progress);
@@ -41,7 +41,8 @@ class CelestiaAppWindow : public QMainWindow
     ~CelestiaAppWindow();
 
     void init(const QString& configFileName,
-              const QStringList& extrasDirectories);
+              const QStringList& extrasDirectories,
+              bool rebuildCatalogCache = false);
 
     void readSettings();
     void writeSettings();
@@ -39,6 +39,7 @@ static QStringList extrasDirectories;
 static QString configFileName;
 static bool useAlternateConfigFile = false;
 static bool skipSplashScreen = false;
+static bool rebuildCatalogCache = false;
 
 static bool ParseCommandLine();
 
@@ -83,7 +84,7 @@ int main(int argc, char *argv[])
     QObject::connect(&window, SIGNAL(progressUpdate(const QString&, int, const QColor&)),
                      &splash, SLOT(showMessage(const QString&, int, const QColor&)));
 
-    window.init(configFileName, extrasDirectories);
+    window.init(configFileName, extrasDirectories, rebuildCatalogCache);
     window.show();
 
     splash.finish(&window);
@@ -171,6 +172,10 @@ bool ParseCommandLine()
         {
             skipSplashScreen = true;
         }
+        else if (args.at(i) == "--rebuild-cache")
+        {
+            rebuildCatalogCache = true;
+        }
         else
         {
             char* buf = new char[args.at(i).length() + 256];
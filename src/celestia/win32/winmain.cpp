@@ -3055,6 +3055,7 @@ static vector<string> extrasDirectories;
 static string configFileName;
 static bool useAlternateConfigFile = false;
 static bool skipSplashScreen = false;
+static bool rebuildCatalogCache = false;
 
 static bool parseCommandLine(int argc, char* argv[])
 {
@@ -3129,6 +3130,10 @@ static bool parseCommandLine(int argc, char* argv[])
         {
             skipSplashScreen = true;
         }
+        else if (strcmp(argv[i], "--rebuild-cache") == 0)
+        {
+            rebuildCatalogCache = true;
+        }
         else
         {
             char* buf = new char[strlen(argv[i]) + 256];
@@ -3340,6 +3345,7 @@ int APIENTRY WinMain(HINSTANCE hInstance,
         progressNotifier = new WinSplashProgressNotifier(s_splash);
         
     string* altConfig = useAlternateConfigFile ? &configFileName : NULL;
+    appCore->setRebuildCatalogCache(rebuildCatalogCache);
     bool initSucceeded = appCore->initSimulation(altConfig, &extrasDirectories, progressNotifier);
     
     delete progressNotifier;
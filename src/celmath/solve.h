@@ -8,6 +8,9 @@
 // of the License, or (at your option) any later version.
 
 #include <utility>
+#include <algorithm>
+#include <limits>
+#include <cmath>
 
 
 // Solve a function using the bisection method.  Returns a pair
@@ -74,3 +77,206 @@ template<class T, class F> std::pair<T, T> solve_iteration_fixed(F f,
 
     return std::make_pair(x2, x2 - x);
 }
+
+
+// Solve a function using Brent's method, which combines bisection with
+// secant steps and inverse quadratic interpolation. The function must have
+// opposite signs at lower and upper. Returns a pair with the solution as
+// the first element and the error as the second.
+template<class T, class F> std::pair<T, T> solve_brent(F f,
+                                                       T lower, T upper,
+                                                       T err,
+                                                       int maxIter = 100)
+{
+    T a = lower;
+    T b = upper;
+    T c = upper;
+    T fa = f(a);
+    T fb = f(b);
+    T fc = fb;
+    T d = b - a;
+    T e = d;
+
+    for (int i = 0; i < maxIter; i++)
+    {
+        // Keep the root between b and c
+        if ((fb > 0 && fc > 0) || (fb < 0 && fc < 0))
+        {
+            c = a;
+            fc = fa;
+            d = b - a;
+            e = d;
+        }
+
+        // Make b the best estimate
+        if (std::abs(fc) < std::abs(fb))
+        {
+            a = b;
+            b = c;
+            c = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+
+        T tol = 2 * std::numeric_limits<T>::epsilon() * std::abs(b) + err * (T) 0.5;
+        T m = (c - b) * (T) 0.5;
+        if (std::abs(m) <= tol || fb == 0)
+            return std::make_pair(b, std::abs(m));
+
+        if (std::abs(e) >= tol && std::abs(fa) > std::abs(fb))
+        {
+            // Try interpolation: secant if only two points are distinct,
+            // otherwise inverse quadratic.
+            T s = fb / fa;
+            T p;
+            T q;
+            if (a == c)
+            {
+                p = 2 * m * s;
+                q = 1 - s;
+            }
+            else
+            {
+                T r = fb / fc;
+                q = fa / fc;
+                p = s * (2 * m * q * (q - r) - (b - a) * (r - 1));
+                q = (q - 1) * (r - 1) * (s - 1);
+            }
+
+            if (p > 0)
+                q = -q;
+            else
+                p = -p;
+
+            // Accept the interpolation only if it stays well within the
+            // bracket and converges faster than bisection would.
+            if (2 * p < std::min(3 * m * q - std::abs(tol * q), std::abs(e * q)))
+            {
+                e = d;
+                d = p / q;
+            }
+            else
+            {
+                d = m;
+                e = d;
+            }
+        }
+        else
+        {
+            d = m;
+            e = d;
+        }
+
+        a = b;
+        fa = fb;
+        if (std::abs(d) > tol)
+            b += d;
+        else
+            b += (m > 0 ? tol : -tol);
+        fb = f(b);
+    }
+
+    return std::make_pair(b, std::abs(c - b) * (T) 0.5);
+}
+
+
+// Find a minimum of a function within [ lower, upper ] using Brent's
+// method, which combines golden section search with parabolic
+// interpolation. Returns a pair with the location of the minimum as the
+// first element and the value of the function there as the second.
+template<class T, class F> std::pair<T, T> minimize_brent(F f,
+                                                          T lower, T upper,
+                                                          T err,
+                                                          int maxIter = 100)
+{
+    const T GoldenSection = (T) 0.3819660112501051;
+
+    T a = lower;
+    T b = upper;
+    T x = a + GoldenSection * (b - a);
+    T w = x;
+    T v = x;
+    T fx = f(x);
+    T fw = fx;
+    T fv = fx;
+    T d = 0;
+    T e = 0;
+
+    for (int i = 0; i < maxIter; i++)
+    {
+        T xm = (a + b) * (T) 0.5;
+        T tol1 = 2 * std::numeric_limits<T>::epsilon() * std::abs(x) + err * (T) 0.5;
+        T tol2 = 2 * tol1;
+        if (std::abs(x - xm) <= tol2 - (b - a) * (T) 0.5)
+            break;
+
+        bool golden = true;
+        if (std::abs(e) > tol1)
+        {
+            // Fit a parabola through x, v and w
+            T r = (x - w) * (fx - fv);
+            T q = (x - v) * (fx - fw);
+            T p = (x - v) * q - (x - w) * r;
+            q = 2 * (q - r);
+            if (q > 0)
+                p = -p;
+            q = std::abs(q);
+
+            T etemp = e;
+            e = d;
+            if (std::abs(p) < std::abs((T) 0.5 * q * etemp) &&
+                p > q * (a - x) && p < q * (b - x))
+            {
+                d = p / q;
+                T u = x + d;
+                if (u - a < tol2 || b - u < tol2)
+                    d = xm - x >= 0 ? tol1 : -tol1;
+                golden = false;
+            }
+        }
+
+        if (golden)
+        {
+            e = x >= xm ? a - x : b - x;
+            d = GoldenSection * e;
+        }
+
+        T u = std::abs(d) >= tol1 ? x + d : x + (d >= 0 ? tol1 : -tol1);
+        T fu = f(u);
+        if (fu <= fx)
+        {
+            if (u >= x)
+                a = x;
+            else
+                b = x;
+            v = w;
+            w = x;
+            x = u;
+            fv = fw;
+            fw = fx;
+            fx = fu;
+        }
+        else
+        {
+            if (u < x)
+                a = u;
+            else
+                b = u;
+            if (fu <= fw || w == x)
+            {
+                v = w;
+                w = u;
+                fv = fw;
+                fw = fu;
+            }
+            else if (fu <= fv || v == x || v == w)
+            {
+                v = u;
+                fv = fu;
+            }
+        }
+    }
+
+    return std::make_pair(x, fx);
+}
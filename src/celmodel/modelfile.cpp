@@ -2136,18 +2136,27 @@ BinaryModelLoader::loadMesh()
             return NULL;
         }
 
+        // Read all indices of the group at once, then convert and check them
+        // in place.
+        in.read(reinterpret_cast<char*>(indices), indexCount * sizeof(uint32));
+        if (!in.good())
+        {
+            reportError("Unexpected end of file in index data");
+            delete[] indices;
+            delete mesh;
+            return NULL;
+        }
+
         for (unsigned int i = 0; i < indexCount; i++)
         {
-            uint32 index = readUint(in);
-            if (index >= vertexCount)
+            LE_TO_CPU_INT32(indices[i], indices[i]);
+            if (indices[i] >= vertexCount)
             {
                 reportError("Index out of range");
-                delete indices;
+                delete[] indices;
                 delete mesh;
                 return NULL;
             }
-
-            indices[i] = index;
         }
 
         mesh->addGroup(type, materialIndex, indexCount, indices);
@@ -2176,46 +2185,40 @@ BinaryModelLoader::loadVertices(const Mesh::VertexDescription& vertexDesc,
         return NULL;
     }
 
-    unsigned int offset = 0;
+    // The vertex description read from the file packs the attributes in
+    // file order, so the vertex data can be read in a single block. Only
+    // the floating point attributes need to be converted on big-endian
+    // systems; UByte4 attributes are stored as plain bytes.
+    in.read(vertexData, vertexDataSize);
+    if (!in.good())
+    {
+        reportError("Unexpected end of file in vertex data");
+        delete[] vertexData;
+        return NULL;
+    }
 
-    for (unsigned int i = 0; i < vertexCount; i++, offset += vertexDesc.stride)
+#if defined(WORDS_BIGENDIAN) || defined(__BIG_ENDIAN__)
+    for (unsigned int attr = 0; attr < vertexDesc.nAttributes; attr++)
     {
-        assert(offset < vertexDataSize);
-        for (unsigned int attr = 0; attr < vertexDesc.nAttributes; attr++)
+        unsigned int floatCount = 0;
+        switch (vertexDesc.attributes[attr].format)
         {
-            unsigned int base = offset + vertexDesc.attributes[attr].offset;
-            Mesh::VertexAttributeFormat fmt = vertexDesc.attributes[attr].format;
-            /*int readCount = 0;    Unused*/
-            switch (fmt)
-            {
-            case Mesh::Float1:
-                reinterpret_cast<float*>(vertexData + base)[0] = readFloat(in);
-                break;
-            case Mesh::Float2:
-                reinterpret_cast<float*>(vertexData + base)[0] = readFloat(in);
-                reinterpret_cast<float*>(vertexData + base)[1] = readFloat(in);
-                break;
-            case Mesh::Float3:
-                reinterpret_cast<float*>(vertexData + base)[0] = readFloat(in);
-                reinterpret_cast<float*>(vertexData + base)[1] = readFloat(in);
-                reinterpret_cast<float*>(vertexData + base)[2] = readFloat(in);
-                break;
-            case Mesh::Float4:
-                reinterpret_cast<float*>(vertexData + base)[0] = readFloat(in);
-                reinterpret_cast<float*>(vertexData + base)[1] = readFloat(in);
-                reinterpret_cast<float*>(vertexData + base)[2] = readFloat(in);
-                reinterpret_cast<float*>(vertexData + base)[3] = readFloat(in);
-                break;
-            case Mesh::UByte4:
-                in.get(reinterpret_cast<char*>(vertexData + base), 4);
-                break;
-            default:
-                assert(0);
-                delete[] vertexData;
-                return NULL;
-            }
+        case Mesh::Float1: floatCount = 1; break;
+        case Mesh::Float2: floatCount = 2; break;
+        case Mesh::Float3: floatCount = 3; break;
+        case Mesh::Float4: floatCount = 4; break;
+        default: break;
+        }
+
+        char* base = vertexData + vertexDesc.attributes[attr].offset;
+        for (unsigned int i = 0; i < vertexCount; i++, base += vertexDesc.stride)
+        {
+            float* f = reinterpret_cast<float*>(base);
+            for (unsigned int j = 0; j < floatCount; j++)
+                LE_TO_CPU_FLOAT(f[j], f[j]);
         }
     }
+#endif
 
     return vertexData;
 }
@@ -0,0 +1,106 @@
+// atomic.h
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Minimal portable atomic operations and memory barriers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELUTIL_ATOMIC_H_
+#define _CELUTIL_ATOMIC_H_
+
+#include <celutil/basictypes.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#pragma intrinsic(_InterlockedCompareExchange, _InterlockedExchangeAdd, _ReadWriteBarrier)
+#endif
+
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+// x86 processors never reorder loads with other loads or stores with other
+// stores, so only the compiler needs to be prevented from reordering them.
+#define CELUTIL_ATOMIC_ORDERED_LOADS_STORES 1
+#endif
+
+
+/*! Full memory barrier: no load or store is moved across the barrier by
+ *  either the compiler or the processor.
+ */
+inline void AtomicFullBarrier()
+{
+#ifdef _MSC_VER
+    long dummy = 0;
+    _InterlockedExchangeAdd(&dummy, 0);
+#else
+    __sync_synchronize();
+#endif
+}
+
+
+/*! Loads before the barrier complete before loads after it.
+ */
+inline void AtomicReadBarrier()
+{
+#if defined(CELUTIL_ATOMIC_ORDERED_LOADS_STORES)
+#ifdef _MSC_VER
+    _ReadWriteBarrier();
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+#else
+    AtomicFullBarrier();
+#endif
+}
+
+
+/*! Stores before the barrier become visible before stores after it.
+ */
+inline void AtomicWriteBarrier()
+{
+    AtomicReadBarrier();
+}
+
+
+inline int32 AtomicLoad(const volatile int32& value)
+{
+    return value;
+}
+
+
+inline void AtomicStore(volatile int32& value, int32 newValue)
+{
+    value = newValue;
+}
+
+
+/*! Set value to newValue if it is equal to expected. Returns true if the
+ *  value was changed. Implies a full memory barrier.
+ */
+inline bool AtomicCompareAndSwap(volatile int32& value, int32 expected, int32 newValue)
+{
+#ifdef _MSC_VER
+    return _InterlockedCompareExchange(reinterpret_cast<volatile long*>(&value),
+                                       newValue, expected) == expected;
+#else
+    return __sync_bool_compare_and_swap(&value, expected, newValue);
+#endif
+}
+
+
+/*! Add delta to value and return the new value. Implies a full memory
+ *  barrier.
+ */
+inline int32 AtomicAdd(volatile int32& value, int32 delta)
+{
+#ifdef _MSC_VER
+    return _InterlockedExchangeAdd(reinterpret_cast<volatile long*>(&value), delta) + delta;
+#else
+    return __sync_add_and_fetch(&value, delta);
+#endif
+}
+
+#endif // _CELUTIL_ATOMIC_H_
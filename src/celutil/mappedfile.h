@@ -0,0 +1,37 @@
+// mappedfile.h
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Read-only memory mapped files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELUTIL_MAPPEDFILE_H_
+#define _CELUTIL_MAPPEDFILE_H_
+
+#include <string>
+#include <cstddef>
+
+/*! A MappedFile gives read-only access to the complete contents of a
+ *  file without copying it through a stream. The mapping stays valid
+ *  until the MappedFile is deleted.
+ */
+class MappedFile
+{
+ public:
+    MappedFile() {};
+    virtual ~MappedFile() {};
+
+    virtual const char* data() const = 0;
+    virtual std::size_t size() const = 0;
+};
+
+/*! Map the named file into memory; returns NULL if the file can't be
+ *  opened or mapped. Callers should fall back to stream I/O in that case.
+ */
+extern MappedFile* OpenMappedFile(const std::string& filename);
+
+#endif // _CELUTIL_MAPPEDFILE_H_
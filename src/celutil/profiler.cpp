@@ -0,0 +1,217 @@
+// profiler.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Record the time spent in nested zones of code during each frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <ostream>
+#include <iomanip>
+#include "timer.h"
+#include "profiler.h"
+
+using namespace std;
+
+
+static Profiler* profiler = NULL;
+
+
+Profiler::Profiler(unsigned int maxFrames) :
+    timer(NULL),
+    frames(maxFrames + 1),
+    currentFrame(0),
+    frameCount(0)
+{
+    timer = CreateTimer();
+    frames[0].start = timer->getTime();
+    frames[0].duration = 0.0;
+}
+
+
+Profiler::~Profiler()
+{
+    delete timer;
+}
+
+
+void Profiler::beginFrame()
+{
+    double now = timer->getTime();
+
+    // Zones still open belong to the frame that's ending.
+    ProfileFrame& frame = frames[currentFrame];
+    for (vector<unsigned int>::const_iterator iter = openZones.begin();
+         iter != openZones.end(); iter++)
+    {
+        frame.samples[*iter].duration = now - frame.samples[*iter].start;
+    }
+    openZones.clear();
+    frame.duration = now - frame.start;
+
+    currentFrame = (currentFrame + 1) % frames.size();
+    if (frameCount < frames.size() - 1)
+        frameCount++;
+
+    // Clearing the samples keeps their storage, so recording doesn't
+    // allocate memory once the ring buffer has filled.
+    frames[currentFrame].start = now;
+    frames[currentFrame].duration = 0.0;
+    frames[currentFrame].samples.clear();
+}
+
+
+void Profiler::enter(const char* name)
+{
+    ProfileFrame& frame = frames[currentFrame];
+
+    ProfileSample sample;
+    sample.name = name;
+    sample.start = timer->getTime();
+    sample.duration = 0.0;
+    sample.depth = openZones.size();
+
+    openZones.push_back(frame.samples.size());
+    frame.samples.push_back(sample);
+}
+
+
+void Profiler::leave()
+{
+    // Zones entered before the frame began were closed by beginFrame().
+    if (openZones.empty())
+        return;
+
+    ProfileSample& sample = frames[currentFrame].samples[openZones.back()];
+    sample.duration = timer->getTime() - sample.start;
+    openZones.pop_back();
+}
+
+
+const ProfileFrame& Profiler::getFrame(unsigned int age) const
+{
+    unsigned int n = frames.size();
+    return frames[(currentFrame + n - 1 - age) % n];
+}
+
+
+void Profiler::getZoneTotals(vector<ProfileZoneTotal>& totals) const
+{
+    totals.clear();
+    if (frameCount == 0)
+        return;
+
+    // A zone seen for the first time is placed after the zone of the
+    // previous sample and the zones nested in it, so that zones stay below
+    // the zones enclosing them even when they're first entered in a later
+    // frame. There are only a few distinct zones, so a linear search is fast
+    // enough.
+    for (unsigned int age = frameCount; age-- > 0; )
+    {
+        const vector<ProfileSample>& samples = getFrame(age).samples;
+        unsigned int previous = 0;
+        for (vector<ProfileSample>::const_iterator iter = samples.begin();
+             iter != samples.end(); iter++)
+        {
+            unsigned int index = 0;
+            while (index < totals.size() &&
+                   (totals[index].name != iter->name || totals[index].depth != iter->depth))
+            {
+                index++;
+            }
+
+            if (index == totals.size())
+            {
+                ProfileZoneTotal zone;
+                zone.name = iter->name;
+                zone.depth = iter->depth;
+                zone.time = 0.0;
+                zone.calls = 0.0;
+                if (iter == samples.begin())
+                {
+                    index = totals.size();
+                }
+                else
+                {
+                    // Skip the zones nested in the previous one
+                    index = previous + 1;
+                    while (index < totals.size() && totals[index].depth > zone.depth)
+                        index++;
+                }
+                totals.insert(totals.begin() + index, zone);
+            }
+
+            totals[index].time += iter->duration;
+            totals[index].calls += 1.0;
+            previous = index;
+        }
+    }
+
+    for (vector<ProfileZoneTotal>::iterator iter = totals.begin();
+         iter != totals.end(); iter++)
+    {
+        iter->time /= frameCount;
+        iter->calls /= frameCount;
+    }
+}
+
+
+static void writeTraceEvent(ostream& out, const char* name,
+                            double start, double duration, bool first)
+{
+    if (!first)
+        out << ",\n";
+    out << "{\"name\": \"";
+    for (const char* c = name; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            out << '\\';
+        out << *c;
+    }
+    out << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": "
+        << start * 1.0e6 << ", \"dur\": " << duration * 1.0e6 << '}';
+}
+
+
+/*! Write the recorded frames in the JSON trace event format read by the
+ *  Chrome trace viewer (chrome://tracing); each frame is an event enclosing
+ *  the samples recorded during it.
+ */
+bool Profiler::writeChromeTrace(ostream& out) const
+{
+    ios_base::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << fixed << setprecision(1);
+
+    out << "{\"traceEvents\": [\n";
+    bool first = true;
+    for (unsigned int age = frameCount; age-- > 0; )
+    {
+        const ProfileFrame& frame = getFrame(age);
+        writeTraceEvent(out, "Frame", frame.start, frame.duration, first);
+        first = false;
+
+        for (vector<ProfileSample>::const_iterator iter = frame.samples.begin();
+             iter != frame.samples.end(); iter++)
+        {
+            writeTraceEvent(out, iter->name, iter->start, iter->duration, false);
+        }
+    }
+    out << "\n],\n\"displayTimeUnit\": \"ms\"}\n";
+
+    out.flags(flags);
+    out.precision(precision);
+
+    return out.good();
+}
+
+
+Profiler* GetProfiler()
+{
+    if (profiler == NULL)
+        profiler = new Profiler();
+    return profiler;
+}
@@ -0,0 +1,121 @@
+// profiler.h
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Record the time spent in nested zones of code during each frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELUTIL_PROFILER_H_
+#define _CELUTIL_PROFILER_H_
+
+#include <vector>
+#include <iosfwd>
+
+class Timer;
+
+
+/*! One execution of a zone. Times are in seconds since the profiler was
+ *  created; depth is the number of zones the sample is nested in.
+ */
+struct ProfileSample
+{
+    const char* name;
+    double start;
+    double duration;
+    unsigned int depth;
+};
+
+
+/*! The samples recorded during a frame, in the order the zones were
+ *  entered; a zone's samples follow the zone enclosing it.
+ */
+struct ProfileFrame
+{
+    double start;
+    double duration;
+    std::vector<ProfileSample> samples;
+};
+
+
+/*! The time spent in a zone per frame, averaged over the recorded frames.
+ *  Zones with the same name are only merged when they're at the same depth.
+ */
+struct ProfileZoneTotal
+{
+    const char* name;
+    unsigned int depth;
+    double time;
+    double calls;
+};
+
+
+/*! The profiler keeps the samples of the most recent frames in a ring
+ *  buffer. Zones may only be entered and left on the thread that calls
+ *  beginFrame(); they're normally marked with PROFILE_ZONE.
+ */
+class Profiler
+{
+ public:
+    Profiler(unsigned int maxFrames = 120);
+    ~Profiler();
+
+    // End the current frame and start recording the next one.
+    void beginFrame();
+
+    void enter(const char* name);
+    void leave();
+
+    // Number of complete frames recorded
+    unsigned int getFrameCount() const { return frameCount; }
+    // A complete frame; age 0 is the one that ended most recently, and age
+    // must be less than getFrameCount().
+    const ProfileFrame& getFrame(unsigned int age) const;
+
+    void getZoneTotals(std::vector<ProfileZoneTotal>& totals) const;
+    bool writeChromeTrace(std::ostream& out) const;
+
+ private:
+    Profiler(const Profiler&);
+    Profiler& operator=(const Profiler&);
+
+    Timer* timer;
+    std::vector<ProfileFrame> frames;
+    unsigned int currentFrame;
+    unsigned int frameCount;
+    // Indices of the samples of the zones entered but not left yet
+    std::vector<unsigned int> openZones;
+};
+
+
+extern Profiler* GetProfiler();
+
+
+/*! Records a sample of a zone from its construction until it's destroyed.
+ */
+class ProfileZone
+{
+ public:
+    ProfileZone(const char* name) { GetProfiler()->enter(name); }
+    ~ProfileZone() { GetProfiler()->leave(); }
+
+ private:
+    ProfileZone(const ProfileZone&);
+    ProfileZone& operator=(const ProfileZone&);
+};
+
+
+// The name must be a string that lives as long as the profiler, normally a
+// literal. Building with NO_PROFILE_ZONES defined removes all zones.
+#ifdef NO_PROFILE_ZONES
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_ZONE_CONCAT(a, b) a##b
+#define PROFILE_ZONE_VARIABLE(line) PROFILE_ZONE_CONCAT(profileZone, line)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_ZONE_VARIABLE(__LINE__)(name)
+#endif
+
+#endif // _CELUTIL_PROFILER_H_
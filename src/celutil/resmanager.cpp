@@ -0,0 +1,136 @@
+// resmanager.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Memory accounting shared by all resource managers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "resmanager.h"
+#include "debug.h"
+#include <algorithm>
+
+using namespace std;
+
+
+unsigned int ResourceManagerBase::currentFrame = 0;
+
+static vector<ResourceManagerBase*>* resourceManagers = NULL;
+static uint64 totalMemoryUsed = 0;
+static uint64 totalMemoryBudget = 0;
+static unsigned int unloadDelay = 300;
+
+
+ResourceManagerBase::ResourceManagerBase(const string& _name) :
+    unloadCount(0),
+    name(_name),
+    memoryUsed(0),
+    memoryBudget(0)
+{
+    if (resourceManagers == NULL)
+        resourceManagers = new vector<ResourceManagerBase*>();
+    resourceManagers->push_back(this);
+}
+
+
+ResourceManagerBase::~ResourceManagerBase()
+{
+    vector<ResourceManagerBase*>::iterator iter =
+        find(resourceManagers->begin(), resourceManagers->end(), this);
+    if (iter != resourceManagers->end())
+        resourceManagers->erase(iter);
+    totalMemoryUsed -= memoryUsed;
+}
+
+
+void ResourceManagerBase::addMemoryUsed(unsigned int size)
+{
+    memoryUsed += size;
+    totalMemoryUsed += size;
+}
+
+
+void ResourceManagerBase::removeMemoryUsed(unsigned int size)
+{
+    memoryUsed -= size;
+    totalMemoryUsed -= size;
+}
+
+
+void SetResourceMemoryBudget(uint64 budget)
+{
+    totalMemoryBudget = budget;
+}
+
+
+void SetResourceUnloadDelay(unsigned int frames)
+{
+    unloadDelay = frames;
+}
+
+
+uint64 GetResourceMemoryUsed()
+{
+    return totalMemoryUsed;
+}
+
+
+const vector<ResourceManagerBase*>& GetResourceManagers()
+{
+    if (resourceManagers == NULL)
+        resourceManagers = new vector<ResourceManagerBase*>();
+    return *resourceManagers;
+}
+
+
+struct UsedLongerAgoPredicate
+{
+    UsedLongerAgoPredicate(unsigned int _frame) : frame(_frame) {};
+
+    template<class C> bool operator()(const C& a, const C& b) const
+    {
+        return frame - a.lastUsed > frame - b.lastUsed;
+    }
+
+    unsigned int frame;
+};
+
+
+void UpdateResourceManagers()
+{
+    ResourceManagerBase::currentFrame++;
+    unsigned int frame = ResourceManagerBase::currentFrame;
+    unsigned int usedBefore = frame - unloadDelay;
+
+    const vector<ResourceManagerBase*>& managers = GetResourceManagers();
+    vector<ResourceManagerBase::UnloadCandidate> candidates;
+
+    for (unsigned int i = 0; i < managers.size(); i++)
+    {
+        ResourceManagerBase* manager = managers[i];
+        manager->beginFrame();
+
+        if (manager->memoryBudget != 0 && manager->memoryUsed > manager->memoryBudget)
+        {
+            candidates.clear();
+            manager->getUnloadCandidates(usedBefore, candidates);
+            sort(candidates.begin(), candidates.end(), UsedLongerAgoPredicate(frame));
+            for (unsigned int j = 0; j < candidates.size() && manager->memoryUsed > manager->memoryBudget; j++)
+                manager->unload(candidates[j].resource);
+        }
+    }
+
+    if (totalMemoryBudget != 0 && totalMemoryUsed > totalMemoryBudget)
+    {
+        // Unload resources of any type, least recently used first
+        candidates.clear();
+        for (unsigned int i = 0; i < managers.size(); i++)
+            managers[i]->getUnloadCandidates(usedBefore, candidates);
+        sort(candidates.begin(), candidates.end(), UsedLongerAgoPredicate(frame));
+        for (unsigned int j = 0; j < candidates.size() && totalMemoryUsed > totalMemoryBudget; j++)
+            candidates[j].manager->unload(candidates[j].resource);
+    }
+}
@@ -13,48 +13,184 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
+#include <celutil/basictypes.h>
 #include <celutil/reshandle.h>
+#include <celutil/threadpool.h>
+#include <celutil/profiler.h>
 
 
 enum ResourceState {
     ResourceNotLoaded     = 0,
     ResourceLoaded        = 1,
     ResourceLoadingFailed = 2,
+    ResourceLoadPending   = 3,
+};
+
+
+/*! Data read and decoded by a loader thread, from which the resource is
+ *  created later on the thread using the resource manager.
+ */
+class DecodedResource
+{
+ public:
+    virtual ~DecodedResource() {};
+
+    // Approximate size in bytes; used to limit how much is turned into
+    // resources each frame.
+    virtual unsigned int getSize() const = 0;
 };
 
 
 template<class T> class ResourceInfo
 {
  public:
-    ResourceInfo() : state(ResourceNotLoaded), resource(NULL) {};
+    ResourceInfo() : state(ResourceNotLoaded), resource(NULL), lastUsed(0) {};
     virtual ~ResourceInfo() {};
 
     virtual std::string resolve(const std::string&) = 0;
     virtual T* load(const std::string&) = 0;
 
+    // Resources that can be loaded in the background are loaded in two
+    // steps instead of with load(): decode() runs on a loader thread, and
+    // may only read the resource info, and create() makes the resource from
+    // the decoded data on the thread that calls ResourceManager::find().
+    virtual bool canDecodeInBackground(const std::string&) const { return false; };
+    virtual DecodedResource* decode(const std::string&) const { return NULL; };
+    virtual T* create(const std::string&, DecodedResource*) { return NULL; };
+
+    // Return the approximate number of bytes used by the loaded resource.
+    virtual unsigned int getResourceSize() const { return 0; };
+
+    // Return true if the resource may be deleted when it hasn't been used
+    // for a while. That's only safe for resources that are looked up with
+    // find() whenever they're used, rather than kept by pointer.
+    virtual bool canUnload() const { return false; };
+
     typedef T ResourceType;
     ResourceState state;
     std::string resolvedName;
     T* resource;
+    // Frame in which the resource was last looked up
+    unsigned int lastUsed;
+};
+
+
+/*! Resources loaded by a resource manager and the memory they use.
+ */
+struct ResourceUsage
+{
+    unsigned int loadedCount;
+    unsigned int pendingCount;
+    // Pending resources that were looked up in the current frame; the
+    // others may not be needed again.
+    unsigned int pendingUsedCount;
+    uint64 memoryUsed;
+    // Zero when there's no budget
+    uint64 memoryBudget;
+    // Number of resources unloaded to stay within the budgets
+    unsigned int unloadCount;
+};
+
+
+/*! The part of the resource manager that doesn't depend on the type of
+ *  resource: memory accounting, and unloading resources that haven't been
+ *  used recently when a manager exceeds its memory budget, or all managers
+ *  together exceed the global budget. See UpdateResourceManagers().
+ */
+class ResourceManagerBase
+{
+ public:
+    ResourceManagerBase(const std::string& _name);
+    virtual ~ResourceManagerBase();
+
+    const std::string& getName() const { return name; };
+
+    // Set the memory budget in bytes; zero means no budget.
+    void setMemoryBudget(uint64 budget) { memoryBudget = budget; };
+    uint64 getMemoryBudget() const { return memoryBudget; };
+    uint64 getMemoryUsed() const { return memoryUsed; };
+
+    virtual ResourceUsage getUsage() const = 0;
+
+ protected:
+    struct UnloadCandidate
+    {
+        unsigned int lastUsed;
+        ResourceManagerBase* manager;
+        const void* resource;
+    };
+
+    // Called once per frame by UpdateResourceManagers()
+    virtual void beginFrame() = 0;
+    // Add the resources that may be unloaded and haven't been used since
+    // the specified frame.
+    virtual void getUnloadCandidates(unsigned int usedBefore,
+                                     std::vector<UnloadCandidate>& candidates) const = 0;
+    virtual void unload(const void* resource) = 0;
+
+    void addMemoryUsed(unsigned int size);
+    void removeMemoryUsed(unsigned int size);
+
+    static unsigned int currentFrame;
+
+    unsigned int unloadCount;
+
+ private:
+    std::string name;
+    uint64 memoryUsed;
+    uint64 memoryBudget;
+
+    friend void UpdateResourceManagers();
 };
 
 
-template<class T> class ResourceManager
+/*! The resource manager loads resources when they're first looked up.
+ *  When background loading is enabled, resources that support it are
+ *  decoded on loader threads instead: find() returns NULL and the state of
+ *  the resource is ResourceLoadPending until the decoded data has been
+ *  turned into a resource. No more than the creation budget is turned into
+ *  resources per frame, though at least one resource is always created.
+ */
+template<class T> class ResourceManager : public ResourceManagerBase
 {
  private:
     std::string baseDir;
 
  public:
     ResourceManager();
-    ResourceManager(std::string _baseDir) : baseDir(_baseDir) {};
-    ~ResourceManager();
+    // The name identifies the manager in reports; it's the base directory
+    // unless specified.
+    ResourceManager(std::string _baseDir, const std::string& _name = "") :
+        ResourceManagerBase(_name.empty() ? _baseDir : _name),
+        baseDir(_baseDir),
+        loaderPool(NULL),
+        creationBudget(0),
+        createdBytes(0)
+    {
+    };
+
+    ~ResourceManager()
+    {
+        delete loaderPool;
+        for (typename DecodedList::iterator iter = newlyDecoded.begin(); iter != newlyDecoded.end(); iter++)
+            delete iter->second;
+        for (typename DecodedMap::iterator iter = decodedResources.begin(); iter != decodedResources.end(); iter++)
+            delete iter->second;
+    };
 
     typedef typename T::ResourceType ResourceType;
 
  private:
+    struct LoadedResource
+    {
+        ResourceType* resource;
+        unsigned int size;
+    };
+
     typedef std::vector<T> ResourceTable;
     typedef std::map<T, ResourceHandle> ResourceHandleMap;
-    typedef std::map<std::string, ResourceType*> NameMap;
+    typedef std::map<std::string, LoadedResource> NameMap;
 
     typedef typename ResourceHandleMap::value_type ResourceHandleMapValue;
     typedef typename NameMap::value_type NameMapValue;
@@ -63,7 +199,238 @@ template<class T> class ResourceManager
     ResourceHandleMap handles;
     NameMap loadedResources;
 
+    // Decoded data is keyed by resolved name, so that any of the handles
+    // waiting for it may turn it into the resource.
+    typedef std::map<std::string, DecodedResource*> DecodedMap;
+    typedef std::vector<std::pair<std::string, DecodedResource*> > DecodedList;
+
+    ThreadPool* loaderPool;
+    uint64 creationBudget;
+    uint64 createdBytes;
+    // Resolved names of the resources being decoded; only one resource is
+    // decoded for handles that resolve to the same name.
+    std::set<std::string> pendingNames;
+    // Decoded data waiting to be turned into resources
+    DecodedMap decodedResources;
+
+    // Guards the data handed back by the loader threads
+    Mutex decodedMutex;
+    DecodedList newlyDecoded;
+
+    class DecodeTask : public ThreadTask
+    {
+     public:
+        DecodeTask(ResourceManager* _manager, const T& _info) :
+            manager(_manager),
+            info(_info)
+        {
+        };
+
+        void run()
+        {
+            DecodedResource* decoded = info.decode(info.resolvedName);
+            MutexLock lock(manager->decodedMutex);
+            manager->newlyDecoded.push_back(std::make_pair(info.resolvedName, decoded));
+        };
+
+     private:
+        ResourceManager* manager;
+        // A copy, since the resource table may be reallocated while decoding
+        T info;
+    };
+
+    void collectDecoded()
+    {
+        DecodedList decoded;
+        {
+            MutexLock lock(decodedMutex);
+            decoded.swap(newlyDecoded);
+        }
+
+        for (typename DecodedList::const_iterator iter = decoded.begin(); iter != decoded.end(); iter++)
+            decodedResources.insert(typename DecodedMap::value_type(iter->first, iter->second));
+    }
+
+    // Record a newly created resource, or mark it as failed
+    void finishCreating(T& info)
+    {
+        if (info.resource == NULL)
+        {
+            info.state = ResourceLoadingFailed;
+        }
+        else
+        {
+            info.state = ResourceLoaded;
+
+            LoadedResource loaded;
+            loaded.resource = info.resource;
+            loaded.size = info.getResourceSize();
+            loadedResources.insert(NameMapValue(info.resolvedName, loaded));
+            addMemoryUsed(loaded.size);
+        }
+    }
+
+    // Create a resource that has been decoded in the background, if the
+    // creation budget allows. Whichever handle with the resource's name is
+    // looked up first creates it, and completes the other handles waiting
+    // for it.
+    void finishLoading(ResourceHandle h)
+    {
+        T& info = resources[h];
+
+        collectDecoded();
+        typename DecodedMap::iterator iter = decodedResources.find(info.resolvedName);
+        if (iter == decodedResources.end())
+        {
+            if (pendingNames.find(info.resolvedName) == pendingNames.end())
+            {
+                // The resource was created for another handle with the same
+                // name, or it failed.
+                typename NameMap::iterator loaded = loadedResources.find(info.resolvedName);
+                if (loaded != loadedResources.end())
+                {
+                    info.resource = loaded->second.resource;
+                    info.state = ResourceLoaded;
+                }
+                else
+                {
+                    info.state = ResourceLoadingFailed;
+                }
+            }
+            return;
+        }
+
+        DecodedResource* decoded = iter->second;
+        if (decoded != NULL)
+        {
+            if (createdBytes != 0 && createdBytes + decoded->getSize() > creationBudget)
+                return;
+            createdBytes += decoded->getSize();
+            PROFILE_ZONE("ResourceManager::create");
+            info.resource = info.create(info.resolvedName, decoded);
+            delete decoded;
+        }
+        decodedResources.erase(iter);
+        pendingNames.erase(info.resolvedName);
+
+        finishCreating(info);
+
+        for (typename ResourceTable::iterator other = resources.begin(); other != resources.end(); other++)
+        {
+            if (other->state == ResourceLoadPending && other->resolvedName == info.resolvedName)
+            {
+                other->resource = info.resource;
+                other->state = info.state;
+            }
+        }
+    }
+
+ protected:
+    void beginFrame()
+    {
+        createdBytes = 0;
+    }
+
+    void getUnloadCandidates(unsigned int usedBefore,
+                             std::vector<UnloadCandidate>& candidates) const
+    {
+        // Several handles may share a resource, so find the last time that
+        // any of them was used.
+        std::map<const void*, unsigned int> lastUsed;
+        for (typename ResourceTable::const_iterator iter = resources.begin(); iter != resources.end(); iter++)
+        {
+            if (iter->state != ResourceLoaded)
+                continue;
+
+            // Count backwards from the current frame, so that the frame
+            // counter may wrap around.
+            unsigned int age = currentFrame - iter->lastUsed;
+            std::map<const void*, unsigned int>::iterator used = lastUsed.find(iter->resource);
+            if (!iter->canUnload())
+                age = 0;
+            if (used == lastUsed.end())
+                lastUsed.insert(std::make_pair((const void*) iter->resource, age));
+            else if (age < used->second)
+                used->second = age;
+        }
+
+        unsigned int minAge = currentFrame - usedBefore;
+        for (std::map<const void*, unsigned int>::const_iterator iter = lastUsed.begin();
+             iter != lastUsed.end(); iter++)
+        {
+            if (iter->second > minAge)
+            {
+                UnloadCandidate candidate;
+                candidate.lastUsed = currentFrame - iter->second;
+                candidate.manager = const_cast<ResourceManager*>(this);
+                candidate.resource = iter->first;
+                candidates.push_back(candidate);
+            }
+        }
+    }
+
+    void unload(const void* resource)
+    {
+        std::string name;
+        for (typename ResourceTable::iterator iter = resources.begin(); iter != resources.end(); iter++)
+        {
+            if (iter->state == ResourceLoaded && iter->resource == resource)
+            {
+                name = iter->resolvedName;
+                iter->state = ResourceNotLoaded;
+                iter->resource = NULL;
+            }
+        }
+
+        typename NameMap::iterator iter = loadedResources.find(name);
+        if (iter != loadedResources.end() && iter->second.resource == resource)
+        {
+            removeMemoryUsed(iter->second.size);
+            delete iter->second.resource;
+            loadedResources.erase(iter);
+            unloadCount++;
+        }
+    }
+
  public:
+    /*! Decode resources on nThreads loader threads, and turn no more than
+     *  budget bytes of decoded data into resources per frame. Zero threads
+     *  disables background loading.
+     */
+    void setBackgroundLoading(unsigned int nThreads, uint64 budget)
+    {
+        if (loaderPool != NULL)
+        {
+            // Wait for the resources being decoded; they're picked up by
+            // find() as usual.
+            loaderPool->wait();
+            delete loaderPool;
+            loaderPool = NULL;
+        }
+
+        if (nThreads != 0)
+            loaderPool = new ThreadPool(nThreads);
+        creationBudget = budget;
+    }
+
+    ResourceUsage getUsage() const
+    {
+        ResourceUsage usage;
+        usage.loadedCount = (unsigned int) loadedResources.size();
+        usage.pendingCount = (unsigned int) pendingNames.size();
+        usage.pendingUsedCount = 0;
+        for (typename ResourceTable::const_iterator iter = resources.begin(); iter != resources.end(); iter++)
+        {
+            if (iter->state == ResourceLoadPending && iter->lastUsed == currentFrame)
+                usage.pendingUsedCount++;
+        }
+        usage.memoryUsed = getMemoryUsed();
+        usage.memoryBudget = getMemoryBudget();
+        usage.unloadCount = unloadCount;
+
+        return usage;
+    }
+
     ResourceHandle getHandle(const T& info)
     {
         typename ResourceHandleMap::iterator iter = handles.find(info);
@@ -88,6 +455,8 @@ template<class T> class ResourceManager
         }
         else
         {
+            resources[h].lastUsed = currentFrame;
+
             if (resources[h].state == ResourceNotLoaded)
             {
                 resources[h].resolvedName = resources[h].resolve(baseDir);
@@ -95,24 +464,27 @@ template<class T> class ResourceManager
                     loadedResources.find(resources[h].resolvedName);
                 if (iter != loadedResources.end())
                 {
-                    resources[h].resource = iter->second;
+                    resources[h].resource = iter->second.resource;
                     resources[h].state = ResourceLoaded;
                 }
+                else if (loaderPool != NULL &&
+                         resources[h].canDecodeInBackground(resources[h].resolvedName))
+                {
+                    resources[h].state = ResourceLoadPending;
+                    if (pendingNames.insert(resources[h].resolvedName).second)
+                        loaderPool->addTask(new DecodeTask(this, resources[h]));
+                }
                 else
                 {
+                    PROFILE_ZONE("ResourceManager::load");
                     resources[h].resource = resources[h].load(resources[h].resolvedName);
-                    if (resources[h].resource == NULL)
-                    {
-                        resources[h].state = ResourceLoadingFailed;
-                    }
-                    else
-                    {
-                        resources[h].state = ResourceLoaded;
-                        loadedResources.insert(NameMapValue(resources[h].resolvedName, resources[h].resource));
-                    }
+                    finishCreating(resources[h]);
                 }
             }
 
+            if (resources[h].state == ResourceLoadPending)
+                finishLoading(h);
+
             if (resources[h].state == ResourceLoaded)
                 return resources[h].resource;
             else
@@ -129,5 +501,25 @@ template<class T> class ResourceManager
     }
 };
 
-#endif // _CELUTIL_RESMANAGER_H_
 
+/*! Set the memory budget in bytes for all resource managers together; zero
+ *  means no budget.
+ */
+extern void SetResourceMemoryBudget(uint64 budget);
+
+/*! Resources are only unloaded if they haven't been used for at least this
+ *  many frames.
+ */
+extern void SetResourceUnloadDelay(unsigned int frames);
+
+extern uint64 GetResourceMemoryUsed();
+extern const std::vector<ResourceManagerBase*>& GetResourceManagers();
+
+/*! Start a new frame: reset the per frame creation budgets, and unload the
+ *  least recently used resources of managers that exceed their budgets.
+ *  This must be called when no resource found in the previous frame is
+ *  still in use.
+ */
+extern void UpdateResourceManagers();
+
+#endif // _CELUTIL_RESMANAGER_H_
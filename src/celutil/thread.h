@@ -0,0 +1,111 @@
+// thread.h
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Minimal portable threads, mutexes, and condition variables.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELUTIL_THREAD_H_
+#define _CELUTIL_THREAD_H_
+
+/*! A unit of work to be run on another thread.
+ */
+class ThreadTask
+{
+ public:
+    ThreadTask() {};
+    virtual ~ThreadTask() {};
+
+    virtual void run() = 0;
+};
+
+
+/*! A Thread runs a single task. The thread isn't started until start() is
+ *  called; the Thread must be joined before it is destroyed.
+ */
+class Thread
+{
+ public:
+    Thread(ThreadTask* task);
+    ~Thread();
+
+    bool start();
+    void join();
+
+ private:
+    // Not copyable
+    Thread(const Thread&);
+    Thread& operator=(const Thread&);
+
+    ThreadTask* task;
+    void* handle;
+};
+
+
+class Mutex
+{
+ public:
+    Mutex();
+    ~Mutex();
+
+    void lock();
+    void unlock();
+
+ private:
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+
+    void* handle;
+
+    friend class Condition;
+};
+
+
+/*! Locks a mutex for the lifetime of the MutexLock object.
+ */
+class MutexLock
+{
+ public:
+    MutexLock(Mutex& _mutex) : mutex(_mutex) { mutex.lock(); }
+    ~MutexLock() { mutex.unlock(); }
+
+ private:
+    MutexLock(const MutexLock&);
+    MutexLock& operator=(const MutexLock&);
+
+    Mutex& mutex;
+};
+
+
+/*! A condition variable associated with a mutex. The mutex must be locked
+ *  by the caller of wait().
+ */
+class Condition
+{
+ public:
+    Condition(Mutex& _mutex);
+    ~Condition();
+
+    void wait();
+    void signal();
+    void broadcast();
+
+ private:
+    Condition(const Condition&);
+    Condition& operator=(const Condition&);
+
+    Mutex& mutex;
+    void* handle;
+};
+
+
+/*! Return the number of processors available to run threads; always at
+ *  least one.
+ */
+extern unsigned int GetProcessorCount();
+
+#endif // _CELUTIL_THREAD_H_
@@ -0,0 +1,132 @@
+// threadpool.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "threadpool.h"
+
+using namespace std;
+
+
+class ThreadPool::Worker : public ThreadTask
+{
+public:
+    Worker(ThreadPool& _pool) : pool(_pool) {};
+
+    void run()
+    {
+        pool.workerLoop();
+    }
+
+private:
+    ThreadPool& pool;
+};
+
+
+ThreadPool::ThreadPool(unsigned int nThreads) :
+    changed(mutex),
+    unfinishedTasks(0),
+    stopping(false)
+{
+    if (nThreads == 0)
+        nThreads = GetProcessorCount() - 1;
+
+    for (unsigned int i = 0; i < nThreads; i++)
+    {
+        Worker* worker = new Worker(*this);
+        Thread* thread = new Thread(worker);
+        if (!thread->start())
+        {
+            // Run with the threads we have; wait() picks up the slack.
+            delete thread;
+            delete worker;
+            break;
+        }
+
+        workers.push_back(worker);
+        threads.push_back(thread);
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    wait();
+
+    {
+        MutexLock lock(mutex);
+        stopping = true;
+        changed.broadcast();
+    }
+
+    for (unsigned int i = 0; i < threads.size(); i++)
+    {
+        threads[i]->join();
+        delete threads[i];
+        delete workers[i];
+    }
+}
+
+
+unsigned int ThreadPool::getThreadCount() const
+{
+    return (unsigned int) threads.size();
+}
+
+
+void ThreadPool::addTask(ThreadTask* task)
+{
+    MutexLock lock(mutex);
+    tasks.push_back(task);
+    unfinishedTasks++;
+    changed.broadcast();
+}
+
+
+// Run one queued task if there is one; the mutex must be locked by the
+// caller, and is locked again on return.
+bool ThreadPool::runNextTask()
+{
+    if (tasks.empty())
+        return false;
+
+    ThreadTask* task = tasks.front();
+    tasks.pop_front();
+
+    mutex.unlock();
+    task->run();
+    delete task;
+    mutex.lock();
+
+    unfinishedTasks--;
+    if (unfinishedTasks == 0)
+        changed.broadcast();
+
+    return true;
+}
+
+
+void ThreadPool::workerLoop()
+{
+    MutexLock lock(mutex);
+    while (!stopping)
+    {
+        if (!runNextTask())
+            changed.wait();
+    }
+}
+
+
+void ThreadPool::wait()
+{
+    MutexLock lock(mutex);
+    while (unfinishedTasks != 0)
+    {
+        if (!runNextTask())
+            changed.wait();
+    }
+}
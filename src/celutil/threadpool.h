@@ -0,0 +1,61 @@
+// threadpool.h
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELUTIL_THREADPOOL_H_
+#define _CELUTIL_THREADPOOL_H_
+
+#include <deque>
+#include <vector>
+#include <celutil/thread.h>
+
+
+/*! A fixed set of worker threads that run queued tasks. Tasks may queue
+ *  more tasks while they run. The thread calling wait() helps run tasks
+ *  until the queue is drained, so a pool with no worker threads simply
+ *  runs everything on the waiting thread.
+ */
+class ThreadPool
+{
+ public:
+    // Zero threads means one worker per processor, minus one for the
+    // thread that waits on the pool.
+    ThreadPool(unsigned int nThreads = 0);
+    ~ThreadPool();
+
+    unsigned int getThreadCount() const;
+
+    // Queue a task; the pool deletes the task after running it.
+    void addTask(ThreadTask* task);
+
+    // Block until every queued task, including tasks added by other tasks,
+    // has finished.
+    void wait();
+
+ private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void workerLoop();
+    bool runNextTask();
+
+    class Worker;
+    friend class Worker;
+
+    Mutex mutex;
+    // Signaled whenever a task is queued or finished, or the pool stops
+    Condition changed;
+    std::deque<ThreadTask*> tasks;
+    unsigned int unfinishedTasks;
+    bool stopping;
+
+    std::vector<Worker*> workers;
+    std::vector<Thread*> threads;
+};
+
+#endif // _CELUTIL_THREADPOOL_H_
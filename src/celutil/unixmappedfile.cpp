@@ -0,0 +1,84 @@
+// unixmappedfile.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mappedfile.h"
+
+using namespace std;
+
+
+class UnixMappedFile : public MappedFile
+{
+public:
+    UnixMappedFile(void* _addr, size_t _length);
+    virtual ~UnixMappedFile();
+
+    virtual const char* data() const;
+    virtual size_t size() const;
+
+private:
+    void* addr;
+    size_t length;
+};
+
+
+UnixMappedFile::UnixMappedFile(void* _addr, size_t _length) :
+    addr(_addr),
+    length(_length)
+{
+}
+
+
+UnixMappedFile::~UnixMappedFile()
+{
+    if (addr != NULL)
+        munmap(addr, length);
+}
+
+
+const char* UnixMappedFile::data() const
+{
+    return reinterpret_cast<const char*>(addr);
+}
+
+
+size_t UnixMappedFile::size() const
+{
+    return length;
+}
+
+
+MappedFile* OpenMappedFile(const string& filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    size_t length = (size_t) st.st_size;
+    void* addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping remains valid after the descriptor is closed
+    close(fd);
+
+    if (addr == MAP_FAILED)
+        return NULL;
+
+    return new UnixMappedFile(addr, length);
+}
@@ -0,0 +1,132 @@
+// unixthread.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <pthread.h>
+#include <unistd.h>
+#include "thread.h"
+
+
+static void* threadMain(void* arg)
+{
+    reinterpret_cast<ThreadTask*>(arg)->run();
+    return NULL;
+}
+
+
+Thread::Thread(ThreadTask* _task) :
+    task(_task),
+    handle(NULL)
+{
+}
+
+
+Thread::~Thread()
+{
+    join();
+}
+
+
+bool Thread::start()
+{
+    if (handle != NULL)
+        return false;
+
+    pthread_t* thread = new pthread_t;
+    if (pthread_create(thread, NULL, threadMain, task) != 0)
+    {
+        delete thread;
+        return false;
+    }
+
+    handle = thread;
+    return true;
+}
+
+
+void Thread::join()
+{
+    if (handle != NULL)
+    {
+        pthread_t* thread = reinterpret_cast<pthread_t*>(handle);
+        pthread_join(*thread, NULL);
+        delete thread;
+        handle = NULL;
+    }
+}
+
+
+Mutex::Mutex()
+{
+    pthread_mutex_t* mutex = new pthread_mutex_t;
+    pthread_mutex_init(mutex, NULL);
+    handle = mutex;
+}
+
+
+Mutex::~Mutex()
+{
+    pthread_mutex_t* mutex = reinterpret_cast<pthread_mutex_t*>(handle);
+    pthread_mutex_destroy(mutex);
+    delete mutex;
+}
+
+
+void Mutex::lock()
+{
+    pthread_mutex_lock(reinterpret_cast<pthread_mutex_t*>(handle));
+}
+
+
+void Mutex::unlock()
+{
+    pthread_mutex_unlock(reinterpret_cast<pthread_mutex_t*>(handle));
+}
+
+
+Condition::Condition(Mutex& _mutex) :
+    mutex(_mutex)
+{
+    pthread_cond_t* cond = new pthread_cond_t;
+    pthread_cond_init(cond, NULL);
+    handle = cond;
+}
+
+
+Condition::~Condition()
+{
+    pthread_cond_t* cond = reinterpret_cast<pthread_cond_t*>(handle);
+    pthread_cond_destroy(cond);
+    delete cond;
+}
+
+
+void Condition::wait()
+{
+    pthread_cond_wait(reinterpret_cast<pthread_cond_t*>(handle),
+                      reinterpret_cast<pthread_mutex_t*>(mutex.handle));
+}
+
+
+void Condition::signal()
+{
+    pthread_cond_signal(reinterpret_cast<pthread_cond_t*>(handle));
+}
+
+
+void Condition::broadcast()
+{
+    pthread_cond_broadcast(reinterpret_cast<pthread_cond_t*>(handle));
+}
+
+
+unsigned int GetProcessorCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned int) count : 1;
+}
@@ -595,6 +595,37 @@ int UTF8StringCompare(const std::string& s0, const std::string& s1, size_t n)
 }
 
 
+//! Return the string with each character normalized as in
+//! UTF8StringCompare(), so that a normalized comparison of two strings
+//! is a plain comparison of their normalized forms. Invalid UTF-8
+//! sequences are copied unchanged.
+std::string UTF8Normalize(const std::string& s)
+{
+    std::string normalized;
+    normalized.reserve(s.length());
+
+    int len = s.length();
+    int i = 0;
+    while (i < len)
+    {
+        wchar_t ch = 0;
+        if (!UTF8Decode(s, i, ch))
+        {
+            normalized.append(s, i, std::string::npos);
+            break;
+        }
+
+        i += UTF8EncodedSize(ch);
+
+        char buf[7];
+        UTF8Encode(UTF8Normalize(ch), buf);
+        normalized += buf;
+    }
+
+    return normalized;
+}
+
+
 //! Currently incomplete, but could be a helpful class for dealing with
 //! UTF-8 streams
 class UTF8StringIterator
@@ -0,0 +1,130 @@
+// winthread.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// Condition variables require Windows Vista or later.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <windows.h>
+#include <process.h>
+#include "thread.h"
+
+
+static unsigned int __stdcall threadMain(void* arg)
+{
+    reinterpret_cast<ThreadTask*>(arg)->run();
+    return 0;
+}
+
+
+Thread::Thread(ThreadTask* _task) :
+    task(_task),
+    handle(NULL)
+{
+}
+
+
+Thread::~Thread()
+{
+    join();
+}
+
+
+bool Thread::start()
+{
+    if (handle != NULL)
+        return false;
+
+    uintptr_t thread = _beginthreadex(NULL, 0, threadMain, task, 0, NULL);
+    if (thread == 0)
+        return false;
+
+    handle = reinterpret_cast<void*>(thread);
+    return true;
+}
+
+
+void Thread::join()
+{
+    if (handle != NULL)
+    {
+        WaitForSingleObject(reinterpret_cast<HANDLE>(handle), INFINITE);
+        CloseHandle(reinterpret_cast<HANDLE>(handle));
+        handle = NULL;
+    }
+}
+
+
+Mutex::Mutex()
+{
+    CRITICAL_SECTION* cs = new CRITICAL_SECTION;
+    InitializeCriticalSection(cs);
+    handle = cs;
+}
+
+
+Mutex::~Mutex()
+{
+    CRITICAL_SECTION* cs = reinterpret_cast<CRITICAL_SECTION*>(handle);
+    DeleteCriticalSection(cs);
+    delete cs;
+}
+
+
+void Mutex::lock()
+{
+    EnterCriticalSection(reinterpret_cast<CRITICAL_SECTION*>(handle));
+}
+
+
+void Mutex::unlock()
+{
+    LeaveCriticalSection(reinterpret_cast<CRITICAL_SECTION*>(handle));
+}
+
+
+Condition::Condition(Mutex& _mutex) :
+    mutex(_mutex)
+{
+    CONDITION_VARIABLE* cond = new CONDITION_VARIABLE;
+    InitializeConditionVariable(cond);
+    handle = cond;
+}
+
+
+Condition::~Condition()
+{
+    delete reinterpret_cast<CONDITION_VARIABLE*>(handle);
+}
+
+
+void Condition::wait()
+{
+    SleepConditionVariableCS(reinterpret_cast<CONDITION_VARIABLE*>(handle),
+                             reinterpret_cast<CRITICAL_SECTION*>(mutex.handle),
+                             INFINITE);
+}
+
+
+void Condition::signal()
+{
+    WakeConditionVariable(reinterpret_cast<CONDITION_VARIABLE*>(handle));
+}
+
+
+void Condition::broadcast()
+{
+    WakeAllConditionVariable(reinterpret_cast<CONDITION_VARIABLE*>(handle));
+}
+
+
+unsigned int GetProcessorCount()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (unsigned int) info.dwNumberOfProcessors : 1;
+}
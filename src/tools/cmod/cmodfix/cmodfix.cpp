@@ -37,6 +37,7 @@ bool genTangents = false;
 bool weldVertices = false;
 bool mergeMeshes = false;
 bool stripify = false;
+bool reorderVertices = false;
 unsigned int vertexCacheSize = 16;
 float smoothAngle = 60.0f;
 
@@ -52,6 +53,7 @@ void usage()
     cerr << "   --smooth (or -s) <angle> : smoothing angle for normal generation\n";
     cerr << "   --weld (or -w)        : join identical vertices before normal generation\n";
     cerr << "   --merge (or -m)       : merge submeshes to improve rendering performance\n";
+    cerr << "   --reorder (or -r)     : reorder triangles and vertices for the vertex cache\n";
 #ifdef TRISTRIP
     cerr << "   --optimize (or -o)    : optimize by converting triangle lists to strips\n";
 #endif
@@ -474,6 +476,256 @@ bool uniquifyVertices(Mesh& mesh)
 }
 
 
+// Vertex cache optimization, after Tom Forsyth's "Linear-Speed Vertex Cache
+// Optimisation". Triangles are emitted greedily: each vertex is scored by
+// its position in a modeled LRU cache and by the number of triangles still
+// using it, and the next triangle is the one with the highest total score
+// among those touching the cache.
+static const int ModeledCacheSize = 32;
+static const float CacheDecayPower = 1.5f;
+static const float LastTriangleScore = 0.75f;
+static const float ValenceBoostScale = 2.0f;
+static const float ValenceBoostPower = 0.5f;
+
+static float
+vertexCacheScore(int cachePosition, uint32 remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3)
+        {
+            // The vertices of the last triangle get a fixed score, so that
+            // the same triangle isn't favored just for being used last.
+            score = LastTriangleScore;
+        }
+        else
+        {
+            float scale = 1.0f / (ModeledCacheSize - 3);
+            score = pow(1.0f - (cachePosition - 3) * scale, CacheDecayPower);
+        }
+    }
+
+    // Boost vertices with few remaining triangles, so that lone triangles
+    // are not left behind.
+    score += ValenceBoostScale * pow((float) remainingTriangles, -ValenceBoostPower);
+
+    return score;
+}
+
+
+// Reorder the triangles of a triangle list for the post-transform vertex
+// cache.
+static void
+optimizeTriangleOrder(uint32* indices, uint32 nTriangles, uint32 nVertices)
+{
+    if (nTriangles < 2)
+        return;
+
+    // Build the lists of triangles using each vertex
+    vector<uint32> vertexTriangleStart(nVertices + 1, 0);
+    uint32 i;
+    for (i = 0; i < nTriangles * 3; i++)
+        vertexTriangleStart[indices[i] + 1]++;
+    for (i = 0; i < nVertices; i++)
+        vertexTriangleStart[i + 1] += vertexTriangleStart[i];
+
+    vector<uint32> remainingTriangles(nVertices, 0);
+    vector<uint32> vertexTriangles(nTriangles * 3);
+    for (i = 0; i < nTriangles * 3; i++)
+    {
+        uint32 v = indices[i];
+        vertexTriangles[vertexTriangleStart[v] + remainingTriangles[v]] = i / 3;
+        remainingTriangles[v]++;
+    }
+
+    vector<int> cachePosition(nVertices, -1);
+    vector<float> vertexScore(nVertices);
+    for (i = 0; i < nVertices; i++)
+        vertexScore[i] = vertexCacheScore(-1, remainingTriangles[i]);
+
+    vector<bool> triangleAdded(nTriangles, false);
+
+    vector<uint32> newIndices(nTriangles * 3);
+    vector<uint32> cache;
+    vector<uint32> newCache;
+    cache.reserve(ModeledCacheSize + 3);
+    newCache.reserve(ModeledCacheSize + 3);
+
+    uint32 nextUnadded = 0;
+    int bestTriangle = -1;
+    for (uint32 t = 0; t < nTriangles; t++)
+    {
+        // When no triangle touches the cache, continue with the first
+        // triangle that hasn't been emitted yet.
+        if (bestTriangle < 0)
+        {
+            while (triangleAdded[nextUnadded])
+                nextUnadded++;
+            bestTriangle = (int) nextUnadded;
+        }
+
+        const uint32* tri = indices + bestTriangle * 3;
+        triangleAdded[bestTriangle] = true;
+        newIndices[t * 3]     = tri[0];
+        newIndices[t * 3 + 1] = tri[1];
+        newIndices[t * 3 + 2] = tri[2];
+
+        // Remove the triangle from the triangle lists of its vertices, and
+        // move the vertices to the front of the cache.
+        newCache.clear();
+        for (uint32 j = 0; j < 3; j++)
+        {
+            uint32 v = tri[j];
+            uint32* triangles = &vertexTriangles[vertexTriangleStart[v]];
+            uint32 k = 0;
+            while (triangles[k] != (uint32) bestTriangle)
+                k++;
+            triangles[k] = triangles[remainingTriangles[v] - 1];
+            remainingTriangles[v]--;
+
+            newCache.push_back(v);
+        }
+
+        for (vector<uint32>::const_iterator iter = cache.begin(); iter != cache.end(); iter++)
+        {
+            if (*iter != tri[0] && *iter != tri[1] && *iter != tri[2])
+                newCache.push_back(*iter);
+        }
+
+        // Update the scores of the vertices in the cache, including those
+        // just pushed out of it.
+        for (uint32 j = 0; j < newCache.size(); j++)
+        {
+            uint32 v = newCache[j];
+            cachePosition[v] = j < (uint32) ModeledCacheSize ? (int) j : -1;
+            vertexScore[v] = vertexCacheScore(cachePosition[v], remainingTriangles[v]);
+        }
+
+        // Score the triangles using the cached vertices, and pick the best
+        // one for the next step.
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (uint32 j = 0; j < newCache.size(); j++)
+        {
+            uint32 v = newCache[j];
+            const uint32* triangles = &vertexTriangles[vertexTriangleStart[v]];
+            for (uint32 k = 0; k < remainingTriangles[v]; k++)
+            {
+                uint32 adj = triangles[k];
+                float score = vertexScore[indices[adj * 3]] +
+                              vertexScore[indices[adj * 3 + 1]] +
+                              vertexScore[indices[adj * 3 + 2]];
+                if (score > bestScore && cachePosition[v] >= 0)
+                {
+                    bestScore = score;
+                    bestTriangle = (int) adj;
+                }
+            }
+        }
+
+        if (newCache.size() > (uint32) ModeledCacheSize)
+            newCache.resize(ModeledCacheSize);
+        cache.swap(newCache);
+    }
+
+    copy(newIndices.begin(), newIndices.end(), indices);
+}
+
+
+// Compute the average number of vertex cache misses per triangle (ACMR) of
+// the triangle lists in a mesh, modeling a FIFO cache of the given size
+// that is flushed between primitive groups.
+float
+averageCacheMissRatio(const Mesh& mesh, uint32 cacheSize)
+{
+    vector<int> cacheTime(mesh.getVertexCount());
+    uint32 misses = 0;
+    uint32 triangles = 0;
+    int time = 0;
+
+    for (uint32 i = 0; mesh.getGroup(i) != NULL; i++)
+    {
+        const Mesh::PrimitiveGroup* group = mesh.getGroup(i);
+        if (group->prim != Mesh::TriList)
+            continue;
+
+        // A vertex is in the cache if it was added no more than cacheSize
+        // misses ago in this group.
+        fill(cacheTime.begin(), cacheTime.end(), -1);
+        int groupStart = time;
+        for (uint32 j = 0; j < group->nIndices; j++)
+        {
+            int added = cacheTime[group->indices[j]];
+            if (added < groupStart || time - added >= (int) cacheSize)
+            {
+                cacheTime[group->indices[j]] = time;
+                time++;
+                misses++;
+            }
+        }
+
+        triangles += group->nIndices / 3;
+    }
+
+    return triangles == 0 ? 0.0f : (float) misses / (float) triangles;
+}
+
+
+// Reorder the triangle lists of a mesh for the post-transform vertex cache,
+// then renumber the vertices in order of first use so that vertex fetches
+// are mostly sequential.
+bool
+optimizeVertexCache(Mesh& mesh)
+{
+    uint32 nVertices = mesh.getVertexCount();
+    const Mesh::VertexDescription& desc = mesh.getVertexDescription();
+    const char* vertexData = reinterpret_cast<const char*>(mesh.getVertexData());
+    if (nVertices == 0 || vertexData == NULL)
+        return false;
+
+    uint32 i;
+    for (i = 0; mesh.getGroup(i) != NULL; i++)
+    {
+        Mesh::PrimitiveGroup* group = mesh.getGroup(i);
+        if (group->prim == Mesh::TriList)
+            optimizeTriangleOrder(group->indices, group->nIndices / 3, nVertices);
+    }
+
+    // Build the vertex map; unused vertices are kept at the end.
+    const uint32 Unused = ~0u;
+    vector<uint32> vertexMap(nVertices, Unused);
+    uint32 nextVertex = 0;
+    for (i = 0; mesh.getGroup(i) != NULL; i++)
+    {
+        const Mesh::PrimitiveGroup* group = mesh.getGroup(i);
+        for (uint32 j = 0; j < group->nIndices; j++)
+        {
+            if (vertexMap[group->indices[j]] == Unused)
+                vertexMap[group->indices[j]] = nextVertex++;
+        }
+    }
+
+    char* newVertexData = new char[nVertices * desc.stride];
+    for (i = 0; i < nVertices; i++)
+    {
+        if (vertexMap[i] == Unused)
+            vertexMap[i] = nextVertex++;
+        memcpy(newVertexData + vertexMap[i] * desc.stride,
+               vertexData + i * desc.stride,
+               desc.stride);
+    }
+
+    mesh.setVertices(nVertices, newVertexData);
+    mesh.remapIndices(vertexMap);
+
+    return true;
+}
+
+
 Vector3f
 getVertex(const void* vertexData,
           int positionOffset,
@@ -1472,6 +1724,10 @@ bool parseCommandLine(int argc, char* argv[])
             {
                 mergeMeshes = true;
             }
+            else if (!strcmp(argv[i], "-r") || !strcmp(argv[i], "--reorder"))
+            {
+                reorderVertices = true;
+            }
             else if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--optimize"))
             {
                 stripify = true;
@@ -1613,6 +1869,19 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (reorderVertices)
+    {
+        for (uint32 i = 0; model->getMesh(i) != NULL; i++)
+        {
+            Mesh* mesh = model->getMesh(i);
+            float acmrBefore = averageCacheMissRatio(*mesh, vertexCacheSize);
+            optimizeVertexCache(*mesh);
+            float acmrAfter = averageCacheMissRatio(*mesh, vertexCacheSize);
+            cerr << "Mesh " << i << ": ACMR " << acmrBefore << " -> " << acmrAfter
+                 << " (" << vertexCacheSize << " entry FIFO cache)\n";
+        }
+    }
+
 #ifdef TRISTRIP
     if (stripify)
     {
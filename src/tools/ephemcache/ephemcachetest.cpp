@@ -0,0 +1,234 @@
+// ephemcachetest.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Compare analytic orbits approximated by the Chebyshev ephemeris cache
+// with the series they approximate, and time both.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <celutil/timer.h>
+#include <celengine/astro.h>
+#include <celephem/orbit.h>
+#include <celephem/customorbit.h>
+#include <celephem/chebyorbit.h>
+
+using namespace std;
+using namespace Eigen;
+
+
+static const char* DefaultOrbits[] =
+{
+    "mercury", "venus", "earth", "moon", "mars", "jupiter", "saturn",
+    "uranus", "neptune", "pluto",
+    "phobos", "deimos", "io", "europa", "ganymede", "callisto",
+    "mimas", "enceladus", "tethys", "dione", "rhea", "titan", "hyperion",
+    "iapetus", "phoebe", "htc20-helene", "htc20-telesto", "htc20-calypso",
+    "miranda", "ariel", "umbriel", "titania", "oberon", "triton",
+    "vsop87-mercury", "vsop87-venus", "vsop87-earth", "vsop87-mars",
+    "vsop87-jupiter", "vsop87-saturn", "vsop87-uranus", "vsop87-neptune",
+    "vsop87-sun",
+};
+
+static vector<string> orbitNames;
+static double tolerance = 1.0;
+static unsigned int maxSegments = 64;
+static unsigned int sampleCount = 2000;
+static double yearRange = 100.0;
+
+
+void Usage()
+{
+    cerr << "Usage: ephemcachetest [options] [<orbit name> ...]\n";
+    cerr << "  Options:\n";
+    cerr << "    --tolerance <km>  : cache tolerance in kilometers (default 1)\n";
+    cerr << "    --segments <n>    : maximum cached segments per orbit (default 64)\n";
+    cerr << "    --samples <n>     : number of random times to check (default 2000)\n";
+    cerr << "    --years <n>       : check times within n years of J2000 (default 100)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    int i = 1;
+
+    while (i < argc)
+    {
+        if (argv[i][0] == '-')
+        {
+            if (i == argc - 1)
+                return false;
+
+            if (!strcmp(argv[i], "--tolerance"))
+                tolerance = atof(argv[i + 1]);
+            else if (!strcmp(argv[i], "--segments"))
+                maxSegments = (unsigned int) atoi(argv[i + 1]);
+            else if (!strcmp(argv[i], "--samples"))
+                sampleCount = (unsigned int) atoi(argv[i + 1]);
+            else if (!strcmp(argv[i], "--years"))
+                yearRange = atof(argv[i + 1]);
+            else
+            {
+                cerr << "Unknown command line switch: " << argv[i] << '\n';
+                return false;
+            }
+            i++;
+        }
+        else
+        {
+            orbitNames.push_back(argv[i]);
+        }
+        i++;
+    }
+
+    return tolerance > 0.0 && maxSegments > 0 && sampleCount > 0;
+}
+
+
+class ChecksumSampler : public OrbitSampleProc
+{
+ public:
+    ChecksumSampler() : checksum(0.0) {}
+
+    void sample(double /* t */, const Vector3d& position, const Vector3d& /* velocity */)
+    {
+        checksum += position.x();
+    }
+
+    double checksum;
+};
+
+
+// Sample the orbit over a few orbital periods the way the renderer does
+// while drawing orbit paths.
+static double timePathSampling(const Orbit* orbit, double& checksum)
+{
+    const unsigned int periods = 5;
+    double period = orbit->getPeriod();
+
+    ChecksumSampler sampler;
+    Timer* timer = CreateTimer();
+    for (unsigned int i = 0; i < periods; i++)
+    {
+        double t = astro::J2000 + period * i;
+        orbit->sample(t, t + period, sampler);
+    }
+    double elapsed = timer->getTime();
+    delete timer;
+
+    checksum += sampler.checksum;
+
+    return elapsed;
+}
+
+
+static Orbit* createOrbit(const string& name, double cacheTolerance)
+{
+    SetEphemerisCacheParameters(cacheTolerance, maxSegments);
+    return GetCustomOrbit(name);
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (orbitNames.empty())
+        orbitNames.assign(DefaultOrbits, DefaultOrbits + sizeof(DefaultOrbits) / sizeof(DefaultOrbits[0]));
+
+    cout << setw(16) << left << "orbit" << right
+         << setw(13) << "segment (d)"
+         << setw(13) << "max err (km)"
+         << setw(13) << "vel err"
+         << setw(13) << "direct (ms)"
+         << setw(13) << "cached (ms)" << '\n';
+
+    unsigned int failures = 0;
+    srand(1);
+
+    for (vector<string>::const_iterator iter = orbitNames.begin(); iter != orbitNames.end(); iter++)
+    {
+        Orbit* direct = createOrbit(*iter, 0.0);
+        Orbit* cached = createOrbit(*iter, tolerance);
+        if (direct == NULL || cached == NULL)
+        {
+            cerr << "Unknown orbit " << *iter << '\n';
+            return 1;
+        }
+
+        double begin = astro::J2000 - yearRange * 365.25;
+        double end = astro::J2000 + yearRange * 365.25;
+        direct->getValidRange(begin, end);
+        if (begin == end)
+        {
+            begin = astro::J2000 - yearRange * 365.25;
+            end = astro::J2000 + yearRange * 365.25;
+        }
+
+        // Maximum position error in km, and maximum velocity error relative
+        // to the orbital speed
+        double maxError = 0.0;
+        double maxVelocityError = 0.0;
+        for (unsigned int i = 0; i < sampleCount; i++)
+        {
+            double t = begin + (end - begin) * ((double) rand() / (double) RAND_MAX);
+            Vector3d p0 = direct->positionAtTime(t);
+            Vector3d p1 = cached->positionAtTime(t);
+            maxError = max(maxError, (p0 - p1).norm());
+
+            Vector3d v0 = direct->velocityAtTime(t);
+            Vector3d v1 = cached->velocityAtTime(t);
+            maxVelocityError = max(maxVelocityError, (v0 - v1).norm() / v0.norm());
+        }
+
+        double checksum0 = 0.0;
+        double checksum1 = 0.0;
+        double directTime = timePathSampling(direct, checksum0);
+        double cachedTime = timePathSampling(cached, checksum1);
+
+        // The custom planet orbits are mixed orbits, so the approximation
+        // is hidden inside them; report the segment length when we can.
+        const ChebyshevOrbit* cheby = dynamic_cast<const ChebyshevOrbit*>(cached);
+        cout << setw(16) << left << *iter << right << setprecision(4);
+        if (cheby != NULL)
+            cout << setw(13) << cheby->getSegmentDuration();
+        else
+            cout << setw(13) << "-";
+        cout << setw(13) << maxError
+             << setw(13) << maxVelocityError
+             << setw(13) << directTime * 1000.0
+             << setw(13) << cachedTime * 1000.0;
+
+        if (maxError > tolerance)
+        {
+            cout << "  FAILED";
+            failures++;
+        }
+        cout << '\n';
+
+        delete direct;
+        delete cached;
+    }
+
+    if (failures != 0)
+    {
+        cerr << failures << " orbits deviate from the series by more than the tolerance!\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,310 @@
+// orbitstress.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Evaluate the same orbits from many threads at once and check that every
+// thread gets the same positions and velocities as a single thread does.
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <celutil/thread.h>
+#include <celutil/timer.h>
+#include <celutil/filetype.h>
+#include <celephem/orbit.h>
+#include <celephem/customorbit.h>
+#include <celephem/vsop87.h>
+#include <celephem/samporbit.h>
+
+using namespace std;
+using namespace Eigen;
+
+
+static vector<string> orbitNames;
+static vector<string> trajectoryFilenames;
+static unsigned int threadCount = 8;
+static unsigned int sampleCount = 2000;
+static unsigned int passCount = 4;
+
+
+void Usage()
+{
+    cerr << "Usage: orbitstress [options] [<trajectory file> ...]\n";
+    cerr << "  Options:\n";
+    cerr << "    --orbit <name>  : test a custom or VSOP87 orbit (default: a few of each)\n";
+    cerr << "    --threads <n>   : number of threads (default 8)\n";
+    cerr << "    --samples <n>   : number of times at which to evaluate each orbit (default 2000)\n";
+    cerr << "    --passes <n>    : number of passes each thread makes over the times (default 4)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    int i = 1;
+
+    while (i < argc)
+    {
+        if (argv[i][0] == '-')
+        {
+            if (i == argc - 1)
+                return false;
+
+            if (!strcmp(argv[i], "--orbit"))
+                orbitNames.push_back(argv[i + 1]);
+            else if (!strcmp(argv[i], "--threads"))
+                threadCount = (unsigned int) atoi(argv[i + 1]);
+            else if (!strcmp(argv[i], "--samples"))
+                sampleCount = (unsigned int) atoi(argv[i + 1]);
+            else if (!strcmp(argv[i], "--passes"))
+                passCount = (unsigned int) atoi(argv[i + 1]);
+            else
+            {
+                cerr << "Unknown command line switch: " << argv[i] << '\n';
+                return false;
+            }
+            i++;
+        }
+        else
+        {
+            trajectoryFilenames.push_back(argv[i]);
+        }
+        i++;
+    }
+
+    return threadCount > 0 && sampleCount > 0 && passCount > 0;
+}
+
+
+static Orbit* LoadTrajectory(const string& filename)
+{
+    switch (DetermineFileType(filename))
+    {
+    case Content_CelestiaXYZTrajectory:
+        return LoadSampledTrajectoryDoublePrec(filename, TrajectoryInterpolationCubic);
+    case Content_CelestiaXYZVTrajectory:
+        return LoadXYZVTrajectoryDoublePrec(filename, TrajectoryInterpolationCubic);
+    case Content_CelestiaXYZVBinary:
+        return LoadBinaryTrajectory(filename, TrajectoryInterpolationCubic);
+    default:
+        return NULL;
+    }
+}
+
+
+struct TestOrbit
+{
+    string name;
+    Orbit* orbit;
+    vector<double> times;
+    vector<Vector3d> positions;
+    vector<Vector3d> velocities;
+};
+
+
+static bool sameVector(const Vector3d& a, const Vector3d& b)
+{
+    // Sampled orbits may pick a different span for a time that falls
+    // exactly on a sample, so allow for roundoff.
+    return (a - b).norm() <= 1.0e-12 * max(1.0, a.norm());
+}
+
+
+/*! Each thread evaluates every orbit at the test times, asking for
+ *  positions, velocities, or both, and sometimes asking for the same time
+ *  twice so that the cached values are used too.
+ */
+class StressTask : public ThreadTask
+{
+public:
+    StressTask(const vector<TestOrbit>& _orbits, unsigned int _seed) :
+        orbits(_orbits),
+        seed(_seed),
+        evaluations(0),
+        errors(0)
+    {
+    }
+
+    void run()
+    {
+        for (unsigned int pass = 0; pass < passCount; pass++)
+        {
+            for (vector<TestOrbit>::const_iterator iter = orbits.begin(); iter != orbits.end(); iter++)
+            {
+                for (unsigned int i = 0; i < sampleCount; i++)
+                {
+                    // On even passes, all threads step through the times
+                    // in the same order, so they race to fill the cache.
+                    unsigned int r = nextRandom();
+                    unsigned int j = (pass % 2 == 0) ? i : (r >> 4) % sampleCount;
+                    check(*iter, j, r & 0x3);
+                    if ((r & 0xc) == 0)
+                        check(*iter, j, (r >> 2) & 0x3);
+                }
+            }
+        }
+    }
+
+    const vector<TestOrbit>& orbits;
+    unsigned int seed;
+    unsigned int evaluations;
+    unsigned int errors;
+
+private:
+    unsigned int nextRandom()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    }
+
+    void check(const TestOrbit& test, unsigned int i, unsigned int mode)
+    {
+        double t = test.times[i];
+        if (mode != 1)
+        {
+            if (!sameVector(test.orbit->positionAtTime(t), test.positions[i]))
+                errors++;
+            evaluations++;
+        }
+        if (mode != 0)
+        {
+            if (!sameVector(test.orbit->velocityAtTime(t), test.velocities[i]))
+                errors++;
+            evaluations++;
+        }
+    }
+};
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (orbitNames.empty() && trajectoryFilenames.empty())
+    {
+        orbitNames.push_back("earth");
+        orbitNames.push_back("moon");
+        orbitNames.push_back("io");
+        orbitNames.push_back("vsop87-mars");
+        orbitNames.push_back("vsop87-jupiter");
+    }
+
+    vector<TestOrbit> orbits;
+    for (vector<string>::const_iterator iter = orbitNames.begin(); iter != orbitNames.end(); iter++)
+    {
+        TestOrbit test;
+        test.name = *iter;
+        test.orbit = GetCustomOrbit(*iter);
+        if (test.orbit == NULL)
+            test.orbit = CreateVSOP87Orbit(*iter);
+        if (test.orbit == NULL)
+        {
+            cerr << "Unknown orbit " << *iter << '\n';
+            return 1;
+        }
+        orbits.push_back(test);
+    }
+
+    for (vector<string>::const_iterator iter = trajectoryFilenames.begin();
+         iter != trajectoryFilenames.end(); iter++)
+    {
+        TestOrbit test;
+        test.name = *iter;
+        test.orbit = LoadTrajectory(*iter);
+        if (test.orbit == NULL)
+        {
+            cerr << "Error loading trajectory " << *iter << '\n';
+            return 1;
+        }
+        orbits.push_back(test);
+    }
+
+    // Compute the expected values on a single thread. Times are random, but
+    // clustered so that threads often evaluate an orbit at nearby times.
+    srand(1);
+    for (vector<TestOrbit>::iterator iter = orbits.begin(); iter != orbits.end(); iter++)
+    {
+        double begin = 2451545.0 - 3650.0;
+        double end = 2451545.0 + 3650.0;
+        iter->orbit->getValidRange(begin, end);
+        if (begin == end)
+        {
+            begin = 2451545.0 - 3650.0;
+            end = 2451545.0 + 3650.0;
+        }
+
+        double center = begin;
+        for (unsigned int i = 0; i < sampleCount; i++)
+        {
+            if (i % 16 == 0)
+                center = begin + (end - begin) * ((double) rand() / (double) RAND_MAX);
+            double t = center + (end - begin) * 1.0e-4 * ((double) rand() / (double) RAND_MAX);
+            t = min(max(t, begin), end);
+
+            iter->times.push_back(t);
+            iter->positions.push_back(iter->orbit->positionAtTime(t));
+            iter->velocities.push_back(iter->orbit->velocityAtTime(t));
+        }
+
+        if (!iter->orbit->isThreadSafe())
+            cerr << "Warning: " << iter->name << " isn't thread safe\n";
+    }
+
+    vector<StressTask*> tasks;
+    vector<Thread*> threads;
+    for (unsigned int i = 0; i < threadCount; i++)
+    {
+        tasks.push_back(new StressTask(orbits, i * 7919 + 1));
+        threads.push_back(new Thread(tasks.back()));
+    }
+
+    Timer* timer = CreateTimer();
+    for (unsigned int i = 0; i < threadCount; i++)
+    {
+        if (!threads[i]->start())
+        {
+            cerr << "Error starting thread\n";
+            return 1;
+        }
+    }
+
+    unsigned int evaluations = 0;
+    unsigned int errors = 0;
+    for (unsigned int i = 0; i < threadCount; i++)
+    {
+        threads[i]->join();
+        evaluations += tasks[i]->evaluations;
+        errors += tasks[i]->errors;
+        delete threads[i];
+        delete tasks[i];
+    }
+    double t = timer->getTime();
+    delete timer;
+
+    cout << threadCount << " threads, " << orbits.size() << " orbits, "
+         << evaluations << " evaluations, " << t * 1000.0 << " ms\n";
+
+    if (errors != 0)
+    {
+        cerr << errors << " evaluations returned the wrong values!\n";
+        return 1;
+    }
+
+    cout << "All evaluations matched\n";
+
+    for (vector<TestOrbit>::iterator iter = orbits.begin(); iter != orbits.end(); iter++)
+        delete iter->orbit;
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+# Visual C++ makefile for parsebench.exe
+
+TARGET=parsebench.exe
+
+!IF "$(CFG)" == ""
+CFG=Release
+!ENDIF
+
+SOURCE_FILES=\
+	parsebench.cpp
+
+CEL_LIBS=\
+	..\..\celutil\$(CFG)\cel_utils.lib \
+	..\..\celmath\$(CFG)\cel_math.lib \
+	..\..\celengine\$(CFG)\cel_engine.lib
+
+$(TARGET): $(SOURCE_FILES)
+	cl /EHsc /Ox /MT $(SOURCE_FILES) /Fe$(TARGET) /I ..\.. /I ..\..\..\thirdparty\Eigen $(CEL_LIBS)
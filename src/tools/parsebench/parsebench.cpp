@@ -0,0 +1,205 @@
+// parsebench.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Measure the throughput of the tokenizer and parser on catalog files
+// such as the ssc, stc and dsc files in the data directory.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <celutil/timer.h>
+#include <celengine/tokenizer.h>
+#include <celengine/parser.h>
+
+using namespace std;
+
+
+static vector<string> inputFilenames;
+static unsigned int repeatCount = 10;
+
+
+void Usage()
+{
+    cerr << "Usage: parsebench [options] <catalog file> [<catalog file> ...]\n";
+    cerr << "  Options:\n";
+    cerr << "    --repeat <n>    : number of times each file is read (default 10)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    int i = 1;
+
+    while (i < argc)
+    {
+        if (argv[i][0] == '-')
+        {
+            if (!strcmp(argv[i], "--repeat"))
+            {
+                if (i == argc - 1)
+                    return false;
+                i++;
+                repeatCount = (unsigned int) atoi(argv[i]);
+            }
+            else
+            {
+                cerr << "Unknown command line switch: " << argv[i] << '\n';
+                return false;
+            }
+        }
+        else
+        {
+            inputFilenames.push_back(argv[i]);
+        }
+        i++;
+    }
+
+    return true;
+}
+
+
+// Read all tokens of a file; returns the number of tokens, or zero if
+// there was a syntax error.
+static unsigned int tokenize(const string& text)
+{
+    istringstream in(text);
+    Tokenizer tokenizer(&in);
+    unsigned int count = 0;
+
+    for (;;)
+    {
+        Tokenizer::TokenType tok = tokenizer.nextToken();
+        if (tok == Tokenizer::TokenError)
+            return 0;
+        count++;
+        if (tok == Tokenizer::TokenEnd)
+            break;
+    }
+
+    return count;
+}
+
+
+// Parse all values of a file, skipping the object names and dispositions
+// between them. Returns the number of values. If an arena is given, the
+// values are allocated from it and it is cleared after each object, as
+// when loading star catalogs.
+static unsigned int parse(const string& text, ValueArena* arena)
+{
+    istringstream in(text);
+    Tokenizer tokenizer(&in);
+    Parser parser(&tokenizer, arena);
+    unsigned int count = 0;
+
+    for (;;)
+    {
+        Value* value = parser.readValue();
+        if (value != NULL)
+        {
+            count++;
+            if (arena != NULL)
+                arena->clear();
+            else
+                delete value;
+        }
+        else
+        {
+            Tokenizer::TokenType tok = tokenizer.nextToken();
+            if (tok == Tokenizer::TokenEnd || tok == Tokenizer::TokenError)
+                break;
+        }
+    }
+
+    return count;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv) || inputFilenames.empty() || repeatCount == 0)
+    {
+        Usage();
+        return 1;
+    }
+
+    // Files are read into memory first, so that only the tokenizer and
+    // parser are timed.
+    vector<string> texts;
+    unsigned int totalBytes = 0;
+    for (vector<string>::const_iterator iter = inputFilenames.begin();
+         iter != inputFilenames.end(); iter++)
+    {
+        ifstream in(iter->c_str(), ios::in | ios::binary);
+        if (!in.good())
+        {
+            cerr << "Error opening " << *iter << '\n';
+            return 1;
+        }
+        ostringstream contents;
+        contents << in.rdbuf();
+        texts.push_back(contents.str());
+        totalBytes += texts.back().size();
+    }
+
+    Timer* timer = CreateTimer();
+
+    unsigned int tokenCount = 0;
+    double startTime = timer->getTime();
+    for (unsigned int i = 0; i < repeatCount; i++)
+    {
+        tokenCount = 0;
+        for (unsigned int j = 0; j < texts.size(); j++)
+        {
+            unsigned int count = tokenize(texts[j]);
+            if (count == 0)
+            {
+                cerr << "Syntax error in " << inputFilenames[j] << '\n';
+                return 1;
+            }
+            tokenCount += count;
+        }
+    }
+    double tokenizeTime = (timer->getTime() - startTime) / repeatCount;
+
+    unsigned int valueCount = 0;
+    startTime = timer->getTime();
+    for (unsigned int i = 0; i < repeatCount; i++)
+    {
+        valueCount = 0;
+        for (unsigned int j = 0; j < texts.size(); j++)
+            valueCount += parse(texts[j], NULL);
+    }
+    double parseTime = (timer->getTime() - startTime) / repeatCount;
+
+    ValueArena arena;
+    startTime = timer->getTime();
+    for (unsigned int i = 0; i < repeatCount; i++)
+    {
+        for (unsigned int j = 0; j < texts.size(); j++)
+            parse(texts[j], &arena);
+    }
+    double arenaParseTime = (timer->getTime() - startTime) / repeatCount;
+
+    delete timer;
+
+    double megabytes = totalBytes / 1.0e6;
+    cout << texts.size() << " files, " << megabytes << " MB\n";
+    cout << "tokenize: " << tokenCount << " tokens in " << tokenizeTime * 1000.0 << " ms, "
+         << megabytes / tokenizeTime << " MB/s\n";
+    cout << "parse: " << valueCount << " values in " << parseTime * 1000.0 << " ms, "
+         << megabytes / parseTime << " MB/s\n";
+    cout << "parse with arena: " << arenaParseTime * 1000.0 << " ms, "
+         << megabytes / arenaParseTime << " MB/s\n";
+
+    return 0;
+}
@@ -12,12 +12,16 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <vector>
 #include <cctype>
 #include <cassert>
+#include <cstring>
+#include <cmath>
 #include <celutil/basictypes.h>
 #include <celutil/bytes.h>
 #include <celengine/astro.h>
 #include <celengine/star.h>
+#include <celengine/stardb.h>
 
 using namespace std;
 
@@ -25,6 +29,7 @@ using namespace std;
 static string inputFilename;
 static string outputFilename;
 static bool useSphericalCoords = false;
+static bool writeSorted = false;
 
 
 void Usage()
@@ -32,6 +37,7 @@ void Usage()
     cerr << "Usage: makestardb [options] <input file> <output star database>\n";
     cerr << "  Options:\n";
     cerr << "    --spherical (or -s) : input file has spherical coords (RA/dec/distance\n";
+    cerr << "    --sorted            : write a spatially sorted (version 2.0) database\n";
 }
 
 
@@ -48,6 +54,10 @@ bool parseCommandLine(int argc, char* argv[])
             {
                 useSphericalCoords = true;
             }
+            else if (!strcmp(argv[i], "--sorted"))
+            {
+                writeSorted = true;
+            }
             else
             {
                 cerr << "Unknown command line switch: " << argv[i] << '\n';
@@ -107,7 +117,7 @@ static void writeShort(ostream& out, int16 n)
 }
 
 
-bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
+bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords, bool sorted)
 {
     unsigned int record = 0;
     unsigned int nStarsInFile = 0;
@@ -119,13 +129,20 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
         return 1;
     }
 
-    // Write the header
-    out.write("CELSTARS", 8);
+    // Sorted databases can only be written once all the stars have been
+    // read, since the octree determines the order of the records.
+    vector<StarDatabase::PackedStar> records;
 
-    // Write the version
-    writeShort(out, 0x0100);
+    if (!sorted)
+    {
+        // Write the header
+        out.write("CELSTARS", 8);
 
-    writeUint(out, nStarsInFile);
+        // Write the version
+        writeShort(out, 0x0100);
+
+        writeUint(out, nStarsInFile);
+    }
 
     for (unsigned int record = 0; record < nStarsInFile; record++)
     {
@@ -135,7 +152,7 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
 
         in >> catalogNumber;
         if (in.eof())
-            return true;
+            break;
 
         if (!in.good())
         {
@@ -162,13 +179,13 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
                 return false;
             }
 
-            Point3d pos =
+            Eigen::Vector3d pos =
                 astro::equatorialToCelestialCart((double) RA * 24.0 / 360.0,
                                                  (double) dec,
                                                  (double) distance);
-            x = (float) pos.x;
-            y = (float) pos.y;
-            z = (float) pos.z;
+            x = (float) pos.x();
+            y = (float) pos.y();
+            z = (float) pos.z();
             absMag = (float) (appMag + 5 - 5 * log10(distance / 3.26));
         }
         else
@@ -203,6 +220,19 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
         cout << scString << ' ' << details->getSpectralType() << '\n';
 #endif
 
+        if (sorted)
+        {
+            StarDatabase::PackedStar star;
+            star.catalogNumber = catalogNumber;
+            star.x = x;
+            star.y = y;
+            star.z = z;
+            star.absMag = (int16) (absMag * 256.0f);
+            star.spectralType = sc.pack();
+            records.push_back(star);
+            continue;
+        }
+
         writeUint(out, catalogNumber);
         writeFloat(out, x);
         writeFloat(out, y);
@@ -211,6 +241,9 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
         writeUshort(out, sc.pack());
     }
 
+    if (sorted)
+        return StarDatabase::writeSortedBinary(out, records);
+
     return true;
 }
 
@@ -237,7 +270,7 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    bool success = WriteStarDatabase(inputFile, stardbFile, useSphericalCoords);
+    bool success = WriteStarDatabase(inputFile, stardbFile, useSphericalCoords, writeSorted);
 
     return success ? 0 : 1;
 }
@@ -0,0 +1,208 @@
+// namebench.cpp
+//
+// Copyright (C) 2010, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Time name completion with the sorted name index against a scan of all
+// names, and check that both find the same names.
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <celutil/timer.h>
+#include <celutil/utf8.h>
+#include <celengine/starname.h>
+
+using namespace std;
+
+
+static string inputFilename;
+static unsigned int catalogNames = 0;
+static unsigned int maxCompletions = 0;
+
+static const unsigned int SampledNames = 200;
+
+
+void Usage()
+{
+    cerr << "Usage: namebench [options] <star names file>\n";
+    cerr << "  Options:\n";
+    cerr << "    --catalog <n>   : add n catalog designations (HIP 1 ...) to the names\n";
+    cerr << "    --max <n>       : maximum completions returned by the index (default all)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    int i = 1;
+
+    while (i < argc)
+    {
+        if (argv[i][0] == '-')
+        {
+            if (i == argc - 1)
+                return false;
+
+            if (!strcmp(argv[i], "--catalog"))
+                catalogNames = (unsigned int) atoi(argv[i + 1]);
+            else if (!strcmp(argv[i], "--max"))
+                maxCompletions = (unsigned int) atoi(argv[i + 1]);
+            else
+            {
+                cerr << "Unknown command line switch: " << argv[i] << '\n';
+                return false;
+            }
+            i += 2;
+        }
+        else if (inputFilename.empty())
+        {
+            inputFilename = argv[i];
+            i++;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Read the names of a star names file: one star per line, with the catalog
+// number followed by names separated by colons.
+static bool readNames(istream& in, vector<pair<uint32, string> >& names)
+{
+    string line;
+    while (getline(in, line))
+    {
+        string::size_type pos = line.find(':');
+        if (pos == string::npos)
+            continue;
+
+        uint32 catalogNumber = (uint32) strtoul(line.c_str(), NULL, 10);
+        while (pos != string::npos)
+        {
+            string::size_type next = line.find(':', pos + 1);
+            string name(line, pos + 1, next == string::npos ? string::npos : next - pos - 1);
+            if (!name.empty())
+                names.push_back(make_pair(catalogNumber, name));
+            pos = next;
+        }
+    }
+
+    return !in.bad();
+}
+
+
+// The completion that the name database used to do, testing every name
+static vector<string> scanCompletion(const vector<string>& names, const string& prefix)
+{
+    vector<string> completion;
+    int prefixLength = UTF8Length(prefix);
+
+    for (vector<string>::const_iterator iter = names.begin(); iter != names.end(); ++iter)
+    {
+        if (!UTF8StringCompare(*iter, prefix, prefixLength))
+            completion.push_back(*iter);
+    }
+
+    return completion;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv) || inputFilename.empty())
+    {
+        Usage();
+        return 1;
+    }
+
+    ifstream in(inputFilename.c_str(), ios::in);
+    vector<pair<uint32, string> > names;
+    if (!in.good() || !readNames(in, names))
+    {
+        cerr << "Error reading star names file " << inputFilename << '\n';
+        return 1;
+    }
+
+    char buf[32];
+    for (unsigned int i = 1; i <= catalogNames; i++)
+    {
+        sprintf(buf, "HIP %u", i);
+        names.push_back(make_pair(i, string(buf)));
+    }
+
+    StarNameDatabase db;
+    vector<string> allNames;
+    for (vector<pair<uint32, string> >::const_iterator iter = names.begin(); iter != names.end(); ++iter)
+    {
+        if (db.getCatalogNumberByName(iter->second) == Star::InvalidCatalogNumber)
+            allNames.push_back(iter->second);
+        db.add(iter->first, iter->second);
+    }
+
+    // Every prefix of up to three characters typed while entering each of
+    // a sample of the names.
+    vector<string> prefixes;
+    unsigned int sampleStep = max((unsigned int) allNames.size() / SampledNames, 1u);
+    for (unsigned int i = 0; i < allNames.size(); i += sampleStep)
+    {
+        const string& name = allNames[i];
+        for (unsigned int len = 1; len <= 3 && len <= name.length(); len++)
+            prefixes.push_back(string(name, 0, len));
+    }
+
+    Timer* timer = CreateTimer();
+
+    // The first completion builds the index.
+    db.getCompletion("a");
+    double buildTime = timer->getTime();
+
+    unsigned int indexCount = 0;
+    for (vector<string>::const_iterator iter = prefixes.begin(); iter != prefixes.end(); ++iter)
+        indexCount += db.getCompletion(*iter, maxCompletions).size();
+    double indexTime = timer->getTime() - buildTime;
+
+    unsigned int scanCount = 0;
+    for (vector<string>::const_iterator iter = prefixes.begin(); iter != prefixes.end(); ++iter)
+        scanCount += scanCompletion(allNames, *iter).size();
+    double scanTime = timer->getTime() - buildTime - indexTime;
+
+    delete timer;
+
+    cout << allNames.size() << " names, " << prefixes.size() << " prefixes\n";
+    cout << "index: built in " << buildTime * 1000.0 << " ms, "
+         << indexTime * 1.0e6 / prefixes.size() << " us per completion, "
+         << indexCount << " names found\n";
+    cout << "scan: " << scanTime * 1.0e6 / prefixes.size() << " us per completion, "
+         << scanCount << " names found\n";
+
+    // Compare the names found without a limit
+    for (vector<string>::const_iterator iter = prefixes.begin(); iter != prefixes.end(); ++iter)
+    {
+        vector<string> indexed = db.getCompletion(*iter);
+        vector<string> scanned = scanCompletion(allNames, *iter);
+        sort(indexed.begin(), indexed.end());
+        sort(scanned.begin(), scanned.end());
+        if (indexed != scanned)
+        {
+            cerr << "Index and scan found different names for '" << *iter << "'!\n";
+            return 1;
+        }
+    }
+
+    cout << "speedup: " << scanTime / indexTime << '\n';
+
+    return 0;
+}
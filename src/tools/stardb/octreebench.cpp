@@ -0,0 +1,213 @@
+// octreebench.cpp
+//
+// Copyright (C) 2009, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Time star octree queries with the linked and flat node layouts, and
+// check that both layouts find the same stars.
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <celutil/timer.h>
+#include <celengine/stardb.h>
+
+using namespace std;
+using namespace Eigen;
+
+
+static string inputFilename;
+static vector<string> stcFilenames;
+static unsigned int viewCount = 1000;
+
+
+void Usage()
+{
+    cerr << "Usage: octreebench [options] <star database> [<stc file> ...]\n";
+    cerr << "  Options:\n";
+    cerr << "    --views <n>     : number of random views to query (default 1000)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    int i = 1;
+
+    while (i < argc)
+    {
+        if (argv[i][0] == '-')
+        {
+            if (!strcmp(argv[i], "--views"))
+            {
+                if (i == argc - 1)
+                    return false;
+                i++;
+                viewCount = (unsigned int) atoi(argv[i]);
+            }
+            else
+            {
+                cerr << "Unknown command line switch: " << argv[i] << '\n';
+                return false;
+            }
+        }
+        else if (inputFilename.empty())
+        {
+            inputFilename = argv[i];
+        }
+        else
+        {
+            stcFilenames.push_back(argv[i]);
+        }
+        i++;
+    }
+
+    return true;
+}
+
+
+// Star handler that accumulates a checksum of the stars it is given,
+// so that the queries can't be optimized away and the two layouts can
+// be compared.
+class StarCounter : public StarHandler
+{
+public:
+    StarCounter() : count(0), catalogSum(0) {}
+
+    void process(const Star& star, float, float)
+    {
+        count++;
+        catalogSum += star.getCatalogNumber();
+    }
+
+    unsigned int count;
+    uint32 catalogSum;
+};
+
+
+struct View
+{
+    Vector3f position;
+    Quaternionf orientation;
+    float limitingMag;
+};
+
+
+static float randomFloat(float low, float high)
+{
+    return low + (high - low) * ((float) rand() / (float) RAND_MAX);
+}
+
+
+static double runQueries(const StarDatabase& starDB,
+                         const vector<View>& views,
+                         unsigned int& starCount,
+                         uint32& checksum)
+{
+    Timer* timer = CreateTimer();
+    starCount = 0;
+    checksum = 0;
+
+    for (vector<View>::const_iterator iter = views.begin(); iter != views.end(); iter++)
+    {
+        StarCounter visible;
+        starDB.findVisibleStars(visible, iter->position, iter->orientation,
+                                0.8f, 1.33f, iter->limitingMag);
+        StarCounter close;
+        starDB.findCloseStars(close, iter->position, 1.0f);
+
+        starCount += visible.count + close.count;
+        checksum += visible.catalogSum + close.catalogSum;
+    }
+
+    double t = timer->getTime();
+    delete timer;
+
+    return t;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv) || inputFilename.empty() || viewCount == 0)
+    {
+        Usage();
+        return 1;
+    }
+
+    StarDatabase* starDB = new StarDatabase();
+    if (!starDB->loadBinary(inputFilename))
+    {
+        cerr << "Error reading star database " << inputFilename << '\n';
+        return 1;
+    }
+
+    for (vector<string>::const_iterator iter = stcFilenames.begin();
+         iter != stcFilenames.end(); iter++)
+    {
+        ifstream stcFile(iter->c_str(), ios::in);
+        if (!stcFile.good() || !starDB->load(stcFile, ""))
+        {
+            cerr << "Error reading stc file " << *iter << '\n';
+            return 1;
+        }
+    }
+
+    starDB->finish();
+
+    // A mix of views from the solar neighborhood, where most of the
+    // rendering time is spent, and views from farther away.
+    vector<View> views(viewCount);
+    srand(1);
+    for (unsigned int i = 0; i < viewCount; i++)
+    {
+        float range = (i % 4 == 0) ? 1000.0f : 50.0f;
+        views[i].position = Vector3f(randomFloat(-range, range),
+                                     randomFloat(-range, range),
+                                     randomFloat(-range, range));
+        Vector3f axis(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f));
+        if (axis.squaredNorm() == 0.0f)
+            axis = Vector3f::UnitY();
+        views[i].orientation = Quaternionf(AngleAxisf(randomFloat(0.0f, 2.0f * (float) M_PI),
+                                                      axis.normalized()));
+        views[i].limitingMag = randomFloat(5.0f, 8.0f);
+    }
+
+    StarDatabase::OctreeLayout layouts[2] = { StarDatabase::LinkedOctree, StarDatabase::FlatOctree };
+    const char* layoutNames[2] = { "linked", "flat" };
+    unsigned int starCounts[2];
+    uint32 checksums[2];
+    double times[2];
+
+    for (int i = 0; i < 2; i++)
+    {
+        starDB->setOctreeLayout(layouts[i]);
+
+        // Run once to warm the caches, then time the second run
+        runQueries(*starDB, views, starCounts[i], checksums[i]);
+        times[i] = runQueries(*starDB, views, starCounts[i], checksums[i]);
+
+        cout << layoutNames[i] << ": " << viewCount << " views, "
+             << starCounts[i] << " stars found, "
+             << times[i] * 1000.0 << " ms ("
+             << times[i] * 1.0e6 / viewCount << " us per view)\n";
+    }
+
+    if (starCounts[0] != starCounts[1] || checksums[0] != checksums[1])
+    {
+        cerr << "Layouts returned different stars!\n";
+        return 1;
+    }
+
+    cout << "speedup: " << times[0] / times[1] << '\n';
+
+    delete starDB;
+
+    return 0;
+}
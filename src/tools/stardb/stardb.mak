@@ -28,6 +28,12 @@ MAKESTARDB_OBJS=\
 MAKEXINDEX_OBJS=\
 	$(INTDIR)\makexindex.obj
 
+OCTREEBENCH_OBJS=\
+	$(INTDIR)\octreebench.obj
+
+NAMEBENCH_OBJS=\
+	$(INTDIR)\namebench.obj
+
 CEL_INCLUDEDIRS=\
 	/I ../..
 
@@ -79,7 +85,7 @@ RSC_FLAGS=/l 0x409 /d "_DEBUG"
 <<
 
 
-all : $(OUTDIR)\startextdump.exe $(OUTDIR)\makestardb.exe $(OUTDIR)\makexindex.exe
+all : $(OUTDIR)\startextdump.exe $(OUTDIR)\makestardb.exe $(OUTDIR)\makexindex.exe $(OUTDIR)\octreebench.exe $(OUTDIR)\namebench.exe
 
 startextdump.exe : $(OUTDIR)\startextdump.exe
 
@@ -87,6 +93,10 @@ makestardb.exe : $(OUTDIR)\makestardb.exe
 
 makexindex.exe : $(OUTDIR)\makexindex.exe
 
+octreebench.exe : $(OUTDIR)\octreebench.exe
+
+namebench.exe : $(OUTDIR)\namebench.exe
+
 $(OUTDIR)\startextdump.exe : $(OUTDIR) $(STARTEXTDUMP_OBJS)
 	$(LINK32) $(LINK32_FLAGS) /out:$(OUTDIR)\startextdump.exe $(STARTEXTDUMP_OBJS) $(CEL_LIBS)
 
@@ -96,6 +106,12 @@ $(OUTDIR)\makestardb.exe : $(OUTDIR) $(MAKESTARDB_OBJS)
 $(OUTDIR)\makexindex.exe : $(OUTDIR) $(MAKEXINDEX_OBJS)
 	$(LINK32) $(LINK32_FLAGS) /out:$(OUTDIR)\makexindex.exe $(MAKEXINDEX_OBJS) $(CEL_LIBS)
 
+$(OUTDIR)\octreebench.exe : $(OUTDIR) $(OCTREEBENCH_OBJS)
+	$(LINK32) $(LINK32_FLAGS) /out:$(OUTDIR)\octreebench.exe $(OCTREEBENCH_OBJS) $(CEL_LIBS)
+
+$(OUTDIR)\namebench.exe : $(OUTDIR) $(NAMEBENCH_OBJS)
+	$(LINK32) $(LINK32_FLAGS) /out:$(OUTDIR)\namebench.exe $(NAMEBENCH_OBJS) $(CEL_LIBS)
+
 
 "$(OUTDIR)" :
 	if not exist "$(OUTDIR)/$(NULL)" mkdir "$(OUTDIR)"
@@ -186,12 +186,12 @@ bool DumpOldStarDatabase(istream& in, ostream& out, ostream* hdOut,
         }
         else
         {
-            Point3d pos = astro::equatorialToCelestialCart((double) RA, (double) dec, distance);
+            Eigen::Vector3d pos = astro::equatorialToCelestialCart((double) RA, (double) dec, distance);
             float absMag = (float) (appMag / 256.0 + 5 -
                                     5 * log10(distance / 3.26));
-            out << (float) pos.x << ' ' <<
-                   (float) pos.y << ' ' <<
-                   (float) pos.z << ' ';
+            out << (float) pos.x() << ' ' <<
+                   (float) pos.y() << ' ' <<
+                   (float) pos.z() << ' ';
             out << setprecision(5);
             out << absMag << ' ';
         }
@@ -218,14 +218,22 @@ bool DumpStarDatabase(istream& in, ostream& out, ostream* hdOut)
     }
 
     uint16 version = readUshort(in);
-    if (version != 0x0100)
+    if (version != 0x0100 && version != 0x0200)
     {
         cerr << "Unsupported file version " << (version >> 8) << '.' <<
             (version & 0xff) << '\n';
         return false;
     }
 
+    // Version 2.0 files have the stars in octree order, and an octree
+    // node count in the header; the octree itself follows the star records
+    // and isn't dumped.
+    if (version == 0x0200)
+        readUshort(in);
+
     uint32 nStarsInFile = readUint(in);
+    if (version == 0x0200)
+        readUint(in);
     if (!in.good())
     {
         cerr << "Error reading count of stars from database.\n";
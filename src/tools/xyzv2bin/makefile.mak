@@ -0,0 +1,9 @@
+# Visual C++ makefile for xyzv2bin.exe
+
+TARGET=xyzv2bin.exe
+
+SOURCE_FILES=\
+	xyzv2bin.cpp
+
+$(TARGET): $(SOURCE_FILES)
+	cl /EHsc /Ox /MT $(SOURCE_FILES) /Fe$(TARGET) /I ..\.. /I ..\..\..\thirdparty\Eigen
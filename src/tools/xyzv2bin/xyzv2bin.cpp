@@ -0,0 +1,300 @@
+// xyzv2bin.cpp
+//
+// Copyright (C) 2010, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Convert a Celestia xyz or xyzv trajectory file to the binary trajectory
+// format (.xyzvbin), which Celestia can memory map instead of parsing.
+
+#include <celephem/samporbit.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+
+using namespace std;
+
+
+// Samples are considered evenly spaced if no sample time differs from the
+// ideal time by more than this fraction of the step, or by more than
+// FIXED_STEP_MAX_ERROR days.
+const double FIXED_STEP_TOLERANCE = 1.0e-3;
+const double FIXED_STEP_MAX_ERROR = 1.0e-6;
+
+
+static string inputFilename;
+static string outputFilename;
+static bool velocities = false;
+static bool velocitiesSet = false;
+static bool allowFixedStep = true;
+
+
+void Usage()
+{
+    cerr << "Usage: xyzv2bin [options] <input file> <output file>\n";
+    cerr << "  Options:\n";
+    cerr << "    --xyz           : input has time and position only (default for .xyz files)\n";
+    cerr << "    --xyzv          : input has time, position, and velocity (default for .xyzv files)\n";
+    cerr << "    --variable-step : always store sample times, even if they're evenly spaced\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    int i = 1;
+    int fileCount = 0;
+
+    while (i < argc)
+    {
+        if (argv[i][0] == '-')
+        {
+            if (!strcmp(argv[i], "--xyz"))
+            {
+                velocities = false;
+                velocitiesSet = true;
+            }
+            else if (!strcmp(argv[i], "--xyzv"))
+            {
+                velocities = true;
+                velocitiesSet = true;
+            }
+            else if (!strcmp(argv[i], "--variable-step"))
+            {
+                allowFixedStep = false;
+            }
+            else
+            {
+                cerr << "Unknown command line switch: " << argv[i] << '\n';
+                return false;
+            }
+        }
+        else
+        {
+            if (fileCount == 0)
+                inputFilename = argv[i];
+            else if (fileCount == 1)
+                outputFilename = argv[i];
+            else
+                return false;
+            fileCount++;
+        }
+        i++;
+    }
+
+    return fileCount == 2;
+}
+
+
+// Skip whitespace and comments; a comment starts with a # and runs to the
+// end of the line. Comments are only allowed before the numeric data.
+static const char* skipComments(const char* p, const char* end)
+{
+    while (p != end)
+    {
+        if (*p == '#')
+        {
+            while (p != end && *p != '\n')
+                p++;
+        }
+        else if (isspace((unsigned char) *p))
+        {
+            p++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return p;
+}
+
+
+static void writeUint16(ostream& out, uint16 n)
+{
+    out.put((char) (n & 0xff));
+    out.put((char) (n >> 8));
+}
+
+
+static void writeUint32(ostream& out, uint32 n)
+{
+    for (int i = 0; i < 4; i++)
+        out.put((char) ((n >> (i * 8)) & 0xff));
+}
+
+
+static void writeDouble(ostream& out, double d)
+{
+    uint64 n;
+    memcpy(&n, &d, sizeof(n));
+    for (int i = 0; i < 8; i++)
+        out.put((char) ((n >> (i * 8)) & 0xff));
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (!velocitiesSet)
+    {
+        string::size_type dot = inputFilename.rfind('.');
+        velocities = dot != string::npos && inputFilename.substr(dot) == ".xyzv";
+    }
+
+    ifstream in(inputFilename.c_str(), ios::in | ios::binary);
+    if (!in.good())
+    {
+        cerr << "Error opening " << inputFilename << '\n';
+        return 1;
+    }
+
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    text.push_back('\0');
+
+    // Each sample is a time followed by the position and optionally the
+    // velocity, all parsed as doubles.
+    unsigned int valuesPerSample = velocities ? 7 : 4;
+    vector<double> samples;
+    const char* p = skipComments(text.data(), text.data() + text.size() - 1);
+    double lastTime = -HUGE_VAL;
+    unsigned int lineCount = 0;
+
+    for (;;)
+    {
+        double values[7];
+        unsigned int n;
+        for (n = 0; n < valuesPerSample; n++)
+        {
+            char* next = NULL;
+            values[n] = strtod(p, &next);
+            if (next == p)
+                break;
+            p = next;
+        }
+
+        if (n == 0)
+            break;
+        if (n < valuesPerSample)
+        {
+            cerr << "Incomplete sample at end of " << inputFilename << '\n';
+            return 1;
+        }
+        lineCount++;
+
+        // Skip samples with duplicate times, as Celestia does when loading
+        // text trajectories.
+        if (values[0] == lastTime)
+            continue;
+        if (values[0] < lastTime)
+        {
+            cerr << "Sample times aren't in increasing order (sample " << lineCount << ")\n";
+            return 1;
+        }
+        lastTime = values[0];
+
+        samples.insert(samples.end(), values, values + valuesPerSample);
+    }
+
+    while (p != text.data() + text.size() - 1 && isspace((unsigned char) *p))
+        p++;
+    if (p != text.data() + text.size() - 1)
+    {
+        cerr << "Bad number after sample " << lineCount << " in " << inputFilename << '\n';
+        return 1;
+    }
+
+    unsigned int sampleCount = samples.size() / valuesPerSample;
+    if (sampleCount == 0)
+    {
+        cerr << "No samples in " << inputFilename << '\n';
+        return 1;
+    }
+
+    double startTime = samples[0];
+    double endTime = samples[(sampleCount - 1) * valuesPerSample];
+    double boundingRadius = 0.0;
+    for (unsigned int i = 0; i < sampleCount; i++)
+    {
+        const double* s = &samples[i * valuesPerSample];
+        double r = sqrt(s[1] * s[1] + s[2] * s[2] + s[3] * s[3]);
+        if (r > boundingRadius)
+            boundingRadius = r;
+    }
+
+    // Check whether the samples are evenly spaced
+    bool fixedStep = false;
+    double stepSize = 0.0;
+    if (allowFixedStep && sampleCount > 1)
+    {
+        stepSize = (endTime - startTime) / (sampleCount - 1);
+        double tolerance = stepSize * FIXED_STEP_TOLERANCE;
+        if (tolerance > FIXED_STEP_MAX_ERROR)
+            tolerance = FIXED_STEP_MAX_ERROR;
+
+        fixedStep = true;
+        for (unsigned int i = 0; i < sampleCount && fixedStep; i++)
+        {
+            double t = samples[i * valuesPerSample];
+            fixedStep = fabs(t - (startTime + i * stepSize)) <= tolerance;
+        }
+    }
+    if (!fixedStep)
+        stepSize = 0.0;
+
+    ofstream out(outputFilename.c_str(), ios::out | ios::binary);
+    if (!out.good())
+    {
+        cerr << "Error opening " << outputFilename << " for writing\n";
+        return 1;
+    }
+
+    uint16 flags = 0;
+    if (velocities)
+        flags |= BinaryTrajectoryVelocities;
+    if (fixedStep)
+        flags |= BinaryTrajectoryFixedStep;
+
+    out.write(BINARY_TRAJECTORY_MAGIC, 8);
+    writeUint16(out, BINARY_TRAJECTORY_VERSION);
+    writeUint16(out, flags);
+    writeUint32(out, sampleCount);
+    writeDouble(out, startTime);
+    writeDouble(out, stepSize);
+    writeDouble(out, boundingRadius);
+
+    for (unsigned int i = 0; i < sampleCount; i++)
+    {
+        const double* s = &samples[i * valuesPerSample];
+        for (unsigned int j = fixedStep ? 1 : 0; j < valuesPerSample; j++)
+            writeDouble(out, s[j]);
+    }
+
+    out.close();
+    if (out.fail())
+    {
+        cerr << "Error writing " << outputFilename << '\n';
+        return 1;
+    }
+
+    cerr << sampleCount << " samples written, "
+         << (fixedStep ? "fixed step" : "variable step")
+         << (velocities ? ", with velocities\n" : ", positions only\n");
+
+    return 0;
+}